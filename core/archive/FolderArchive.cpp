@@ -0,0 +1,28 @@
+#include "FolderArchive.h"
+#include "oslib/directory.h"
+#include "nowide/cstdio.hpp"
+
+bool FolderArchive::Open(const char* path)
+{
+	struct stat st;
+	if (flycast::stat(path, &st) != 0 || (st.st_mode & S_IFDIR) == 0)
+		return false;
+	this->path = path;
+	if (this->path.back() != '/' && this->path.back() != '\\')
+		this->path += '/';
+	return true;
+}
+
+ArchiveFile* FolderArchive::OpenFile(const char* name)
+{
+	FILE *file = nowide::fopen((path + name).c_str(), "rb");
+	if (file == nullptr)
+		return nullptr;
+
+	return new FolderArchiveFile(file);
+}
+
+u32 FolderArchiveFile::Read(void* buffer, u32 length)
+{
+	return std::fread(buffer, 1, length, file);
+}
@@ -0,0 +1,34 @@
+/*
+	Uncompressed archive: a folder containing the files of a MAME set.
+
+	The files can be mapped in memory instead of being read (see ArchiveFile::GetFile).
+	Files are only found by name since computing their CRC would read them entirely.
+*/
+#pragma once
+
+#include "archive.h"
+#include <string>
+
+class FolderArchive : public Archive
+{
+public:
+	ArchiveFile* OpenFile(const char* name) override;
+	ArchiveFile* OpenFileByCrc(u32 crc) override { return nullptr; }
+
+private:
+	bool Open(const char* path) override;
+
+	std::string path;
+};
+
+class FolderArchiveFile : public ArchiveFile
+{
+public:
+	FolderArchiveFile(FILE *file) : file(file) {}
+	~FolderArchiveFile() override { std::fclose(file); }
+	u32 Read(void* buffer, u32 length) override;
+	FILE *GetFile() override { return file; }
+
+private:
+	FILE *file;
+};
@@ -22,6 +22,8 @@
 #include "archive.h"
 #include "7zArchive.h"
 #include "ZipArchive.h"
+#include "FolderArchive.h"
+#include "stdclass.h"
 
 Archive *OpenArchive(const char *path)
 {
@@ -37,6 +39,12 @@ Archive *OpenArchive(const char *path)
 		return zip_archive;
 	delete zip_archive;
 
+	// Uncompressed set in a folder named after the archive
+	Archive *folder_archive = new FolderArchive();
+	if (folder_archive->Open(base_path.c_str()) || folder_archive->Open(get_file_basename(base_path).c_str()))
+		return folder_archive;
+	delete folder_archive;
+
 	return NULL;
 }
 
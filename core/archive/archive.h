@@ -27,6 +27,8 @@ class ArchiveFile
 public:
 	virtual ~ArchiveFile() = default;
 	virtual u32 Read(void *buffer, u32 length) = 0;
+	// The file itself if it's stored uncompressed, so that it can be mapped
+	virtual FILE *GetFile() { return nullptr; }
 };
 
 class Archive
@@ -25,6 +25,12 @@ namespace config {
 
 Option<bool> DynarecEnabled("Dynarec.Enabled", true);
 Option<bool> DynarecIdleSkip("Dynarec.idleskip", true);
+Option<bool> DynarecBlockCache("Dynarec.BlockCache", false);
+Option<bool> DynarecTieredCompilation("Dynarec.TieredCompilation", false);
+Option<bool> DynarecTraceFormation("Dynarec.TraceFormation", false);
+Option<bool> DynarecBackgroundCompile("Dynarec.BackgroundCompile", false);
+Option<bool> DynarecProfiler("Dynarec.Profiler", false);
+Option<bool> DynarecSubPageSMC("Dynarec.SubPageSMC", false);
 #ifdef __vita__
 Option<float> DynarecDownclock("Dynarec.downclock", 1.5f);
 Option<int> DynarecSmcChecks("Dynarec.smcChecks", 0);
@@ -44,10 +50,13 @@ Option<bool> AutoLoadState("Dreamcast.AutoLoadState");
 Option<bool> AutoSaveState("Dreamcast.AutoSaveState");
 Option<int> SavestateSlot("Dreamcast.SavestateSlot");
 Option<bool> ForceFreePlay("ForceFreePlay", true);
+Option<bool> NaomiDimmCache("Dreamcast.NaomiDimmCache");
+Option<bool> CartDecryptWarmUp("Dreamcast.CartDecryptWarmUp");
 
 // Sound
 
 Option<bool> DSPEnabled("aica.DSPEnabled", false);
+Option<bool> ThreadedAudio("aica.Threaded", false);
 #if HOST_CPU == CPU_ARM
 Option<int> AudioBufferSize("aica.BufferSize", 5644);	// 128 ms
 #else
@@ -79,6 +88,12 @@ Option<int> MaxFilteredTextureSize("rend.MaxFilteredTextureSize", 256);
 Option<float> ExtraDepthScale("rend.ExtraDepthScale", 1.f);
 Option<bool> CustomTextures("rend.CustomTextures");
 Option<bool> DumpTextures("rend.DumpTextures");
+Option<bool> AsyncTextureDecode("rend.AsyncTextureDecode");
+Option<int> TextureMaxStaleFrames("rend.TextureMaxStaleFrames", 2);
+Option<int> TextureContentCacheSize("rend.TextureContentCacheSize", 0);
+Option<int> TextureCacheBudget("rend.TextureCacheBudget");
+Option<bool> VramDirtyBitmap("rend.VramDirtyBitmap");
+Option<bool> CaptureTAFrames("rend.CaptureTAFrames");
 Option<int> ScreenStretching("rend.ScreenStretching", 100);
 Option<bool> Fog("rend.Fog", true);
 Option<bool> FloatVMUs("rend.FloatVMUs");
@@ -102,6 +117,8 @@ std::array<Option<int>, 4> CrosshairColor {
 Option<int> SkipFrame("ta.skip");
 Option<int> MaxThreads("pvr.MaxThreads", 3);
 Option<int> AutoSkipFrame("pvr.AutoSkipFrame", 0);
+Option<int> RenderQueueDepth("pvr.RenderQueueDepth", 2);
+Option<int> RenderQueuePolicy("pvr.RenderQueuePolicy", 0);
 Option<int> RenderResolution("rend.Resolution", 480);
 Option<bool> VSync("rend.vsync", true);
 Option<int64_t> PixelBufferSize("rend.PixelBufferSize", 512 * 1024 * 1024);
@@ -360,6 +360,12 @@ using OptionString = Option<std::string>;
 
 extern Option<bool> DynarecEnabled;
 extern Option<bool> DynarecIdleSkip;
+extern Option<bool> DynarecBlockCache;
+extern Option<bool> DynarecTieredCompilation;
+extern Option<bool> DynarecTraceFormation;
+extern Option<bool> DynarecBackgroundCompile;
+extern Option<bool> DynarecProfiler;
+extern Option<bool> DynarecSubPageSMC;
 #ifdef __vita__
 extern Option<float> DynarecDownclock;
 extern Option<int> DynarecSmcChecks;
@@ -381,11 +387,14 @@ extern Option<bool> AutoLoadState;
 extern Option<bool> AutoSaveState;
 extern Option<int> SavestateSlot;
 extern Option<bool> ForceFreePlay;
+extern Option<bool> NaomiDimmCache;	// Keep the decrypted data of Naomi GD-ROM games on disk
+extern Option<bool> CartDecryptWarmUp;	// Decrypt Atomiswave and M4 cartridge data in the background after boot
 
 // Sound
 
 constexpr bool LimitFPS = true;
 extern Option<bool> DSPEnabled;
+extern Option<bool> ThreadedAudio;
 extern Option<int> AudioBufferSize;	//In samples ,*4 for bytes
 extern Option<bool> AutoLatency;
 
@@ -452,6 +461,12 @@ extern Option<int> PerPixelLayers;
 extern Option<float> ExtraDepthScale;
 extern Option<bool> CustomTextures;
 extern Option<bool> DumpTextures;
+extern Option<bool> AsyncTextureDecode;
+extern Option<int> TextureMaxStaleFrames;	// max frames a texture being decoded asynchronously is drawn with its previous content
+extern Option<int> TextureCacheBudget;		// max size of the texture cache in MB. 0 for no limit
+extern Option<bool> VramDirtyBitmap;		// track VRAM writes with a dirty bitmap instead of page protection
+extern Option<int> TextureContentCacheSize;	// size of the decoded texture content cache in MB. 0 to disable
+extern Option<bool> CaptureTAFrames;	// save one frame per second into data/<game>_<frame>.tac for replay
 extern Option<int> ScreenStretching;	// in percent. 150 means stretch from 4/3 to 6/3
 extern Option<bool> Fog;
 extern Option<bool> FloatVMUs;
@@ -463,6 +478,8 @@ extern std::array<Option<int>, 4> CrosshairColor;
 extern Option<int> SkipFrame;
 extern Option<int> MaxThreads;
 extern Option<int> AutoSkipFrame;		// 0: none, 1: some, 2: more
+extern Option<int> RenderQueueDepth;	// max frames queued or being rendered: 1 or 2
+extern Option<int> RenderQueuePolicy;	// 0: throughput (wait for a free slot), 1: latency (drop the oldest queued frame)
 extern Option<int> RenderResolution;
 extern Option<bool> VSync;
 extern Option<int64_t> PixelBufferSize;
@@ -7,6 +7,11 @@
 #include "hw/sh4/sh4_sched.h"
 #include "hw/arm7/arm7.h"
 #include "hw/arm7/arm_mem.h"
+#include "cfg/option.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 #define SH4_IRQ_BIT (1 << (holly_SPU_IRQ & 31))
 
@@ -66,9 +71,26 @@ static void update_arm_interrupts()
 	libARM_InterruptChange(p_ints,Lval);
 }
 
+// Threaded mode: the ARM7 and sound generation of each 32-sample batch run on a dedicated thread
+// while the SH4 keeps going. The SH4 waits for the batch in progress before accessing the AICA
+// registers, starting a G2 DMA or running the next batch. SH4 interrupts raised by the AICA thread
+// are applied at that point. CDDA sectors are read by the SH4 thread before the batch that needs them.
+static std::thread aicaThread;
+static std::mutex aicaMutex;
+static std::condition_variable aicaCond;
+static bool aicaThreadRunning;
+static bool batchPending;
+static bool sh4IntsPending;
+static thread_local bool onAicaThread;
+
 //sh4 side
 static void UpdateSh4Ints()
 {
+	if (onAicaThread)
+	{
+		sh4IntsPending = true;
+		return;
+	}
 	u32 p_ints = MCIEB->full & MCIPD->full;
 	if (p_ints)
 	{
@@ -87,11 +109,82 @@ AicaTimer timers[3];
 int aica_schid = -1;
 const int AICA_TICK = 145125;	// 44.1 KHz / 32
 
-static int AicaUpdate(int tag, int c, int j)
+static void runBatch()
 {
 	aicaarm::run(32);
 	if (!settings.aica.NoBatch)
 		AICA_Sample32();
+}
+
+static void aicaThreadLoop()
+{
+	onAicaThread = true;
+	std::unique_lock<std::mutex> lock(aicaMutex);
+	for (;;)
+	{
+		aicaCond.wait(lock, []() { return batchPending || !aicaThreadRunning; });
+		if (!batchPending)
+			break;
+		lock.unlock();
+		runBatch();
+		lock.lock();
+		batchPending = false;
+		aicaCond.notify_all();
+	}
+}
+
+void aica_threadSync()
+{
+	if (!aicaThreadRunning || onAicaThread)
+		return;
+	{
+		std::unique_lock<std::mutex> lock(aicaMutex);
+		aicaCond.wait(lock, []() { return !batchPending; });
+	}
+	if (sh4IntsPending)
+	{
+		sh4IntsPending = false;
+		UpdateSh4Ints();
+	}
+}
+
+static void stopAicaThread()
+{
+	if (!aicaThreadRunning)
+		return;
+	aica_threadSync();
+	{
+		std::lock_guard<std::mutex> _(aicaMutex);
+		aicaThreadRunning = false;
+	}
+	aicaCond.notify_all();
+	aicaThread.join();
+}
+
+static int AicaUpdate(int tag, int c, int j)
+{
+	// Netplay needs deterministic emulation
+	if (config::ThreadedAudio && !config::GGPOEnable)
+	{
+		if (!aicaThreadRunning)
+		{
+			aicaThreadRunning = true;
+			aicaThread = std::thread(aicaThreadLoop);
+		}
+		aica_threadSync();
+		if (!settings.aica.NoBatch)
+			AICA_PrefetchCdda();
+		{
+			std::lock_guard<std::mutex> _(aicaMutex);
+			batchPending = true;
+		}
+		aicaCond.notify_all();
+	}
+	else
+	{
+		stopAicaThread();
+		runBatch();
+	}
 
 	return AICA_TICK;
 }
@@ -238,6 +331,7 @@ template void WriteAicaReg<>(u32 reg, u32 data);
 
 void aica_midiSend(u8 data)
 {
+	aica_threadSync();
 	midiSendBuffer.push_back(data);
 	SCIPD->MIDI_IN = 1;
 	update_arm_interrupts();
@@ -275,6 +369,7 @@ s32 libAICA_Init()
 
 void libAICA_Reset(bool hard)
 {
+	stopAicaThread();
 	if (hard)
 	{
 		init_mem();
@@ -288,6 +383,7 @@ void libAICA_Reset(bool hard)
 
 void libAICA_Term()
 {
+	stopAicaThread();
 	sgc_Term();
 	term_mem();
 	sh4_sched_unregister(aica_schid);
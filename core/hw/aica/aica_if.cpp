@@ -102,6 +102,7 @@ template void WriteMem_aica_rtc<>(u32 addr, u32 data);
 template<typename T>
 T ReadMem_aica_reg(u32 addr)
 {
+	aica_threadSync();
 	addr &= 0x7FFF;
 	if (sizeof(T) == 1)
 	{
@@ -136,6 +137,7 @@ static void ArmSetRST()
 template<typename T>
 void WriteMem_aica_reg(u32 addr, T data)
 {
+	aica_threadSync();
 	addr &= 0x7FFF;
 
 	if (sizeof(T) == 1)
@@ -317,6 +319,7 @@ void Write_DmaStart(u32 addr, u32 data)
 		std::swap(src, dst);
 	DEBUG_LOG(AICA, "%s: DMA Write to %X from %X %d bytes", LogTag, dst, src, len);
 
+	aica_threadSync();
 	WriteMemBlock_nommu_dma(dst, src, len);
 
 	if (lenReg & 0x80000000)
@@ -386,6 +389,7 @@ static void Write_SB_ADST(u32 addr, u32 data)
 			else
 				DEBUG_LOG(AICA, "AICA-DMA : SB_ADDIR==0:DMA Write to 0x%X from 0x%X %x bytes", dst, src, SB_ADLEN);
 
+			aica_threadSync();
 			WriteMemBlock_nommu_dma(dst, src, len);
 
 			// indicate that dma is in progress
@@ -24,3 +24,5 @@ s32 libAICA_Init();
 void libAICA_Reset(bool hard);
 void libAICA_Term();
 void libAICA_TimeStep();
+// Waits for the AICA thread to complete its current batch. Must be called before accessing the AICA state from the SH4 side.
+void aica_threadSync();
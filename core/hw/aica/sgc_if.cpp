@@ -32,6 +32,13 @@
 #include <algorithm>
 #include <cmath>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AICA_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 #undef FAR
 
 //#define CLIP_WARN
@@ -477,16 +484,14 @@ struct ChannelEx
 
 		return rv;
 	}
-	__forceinline bool Step(SampleType& oLeft, SampleType& oRight, SampleType& oDsp)
+	// Generates the next sample and its left, right and DSP send gains (xx.15)
+	__forceinline bool Generate(SampleType& sample, s32& gainLeft, s32& gainRight, s32& gainDsp)
 	{
 		if (!enabled)
-		{
-			oLeft=oRight=oDsp=0;
 			return false;
-		}
 		else
 		{
-			SampleType sample = InterpolateSample();
+			sample = InterpolateSample();
 
 			// Low-pass filter
 			if (FEG.active)
@@ -526,16 +531,9 @@ struct ChannelEx
 			u32 dr = std::min(VolMix.DRAtt, max_att);
 			u32 ds = std::min(VolMix.DSPAtt, max_att);
 
-			oLeft = FPMul(sample, logtable[dl], 15);
-			oRight = FPMul(sample, logtable[dr], 15);
-			oDsp = FPMul(sample, logtable[ds], 11);	// 20 bits
-
-			clip_verify(((s16)oLeft)==oLeft);
-			clip_verify(((s16)oRight)==oRight);
-			clip_verify((oDsp << 12) >> 12 == oDsp);
-			clip_verify(sample*oLeft>=0);
-			clip_verify(sample*oRight>=0);
-			clip_verify((s64)sample*oDsp>=0);
+			gainLeft = logtable[dl];
+			gainRight = logtable[dr];
+			gainDsp = logtable[ds];
 
 			StepAEG(this);
 			StepFEG(this);
@@ -545,6 +543,29 @@ struct ChannelEx
 		}
 	}
 
+	__forceinline bool Step(SampleType& oLeft, SampleType& oRight, SampleType& oDsp)
+	{
+		SampleType sample;
+		s32 gainLeft, gainRight, gainDsp;
+		if (!Generate(sample, gainLeft, gainRight, gainDsp))
+		{
+			oLeft=oRight=oDsp=0;
+			return false;
+		}
+		oLeft = FPMul(sample, gainLeft, 15);
+		oRight = FPMul(sample, gainRight, 15);
+		oDsp = FPMul(sample, gainDsp, 11);	// 20 bits
+
+		clip_verify(((s16)oLeft)==oLeft);
+		clip_verify(((s16)oRight)==oRight);
+		clip_verify((oDsp << 12) >> 12 == oDsp);
+		clip_verify(sample*oLeft>=0);
+		clip_verify(sample*oRight>=0);
+		clip_verify((s64)sample*oDsp>=0);
+
+		return true;
+	}
+
 	__forceinline void Step(SampleType& mixl, SampleType& mixr)
 	{
 		SampleType oLeft,oRight,oDsp;
@@ -1281,6 +1302,13 @@ static u32 CalcAttackEgSteps(float t)
 	return (u32)lround(factor);
 }
 
+constexpr int CDDA_SIZE = 2352 / 2;
+static s16 cdda_sector[CDDA_SIZE];
+static u32 cdda_index = CDDA_SIZE;
+// Sector read ahead on the SH4 thread for the next batch in threaded mode
+static s16 cdda_next_sector[CDDA_SIZE];
+static bool cdda_next_ready;
+
 void sgc_Init()
 {
 	staticinitialise();
@@ -1318,6 +1346,8 @@ void sgc_Init()
 	beepOn = 0;
 	beepPeriod = 0;
 	beepCounter = 0;
+	cdda_index = CDDA_SIZE;
+	cdda_next_ready = false;
 
 	dsp::init();
 }
@@ -1418,129 +1448,101 @@ static SampleType vmuBeepSample()
 	return s;
 }
 
-constexpr int CDDA_SIZE = 2352 / 2;
-static s16 cdda_sector[CDDA_SIZE];
-static u32 cdda_index = CDDA_SIZE;
+// Samples and gains of one channel for a 32-sample batch
+struct ChannelBatch
+{
+	alignas(16) SampleType sample[32];
+	alignas(16) s32 gainLeft[32];
+	alignas(16) s32 gainRight[32];
+	alignas(16) s32 gainDsp[32];
+};
 
-//no DSP for now in this version
-void AICA_Sample32()
+#ifdef AICA_SSE2
+// Low 32 bits of the products, like _mm_mullo_epi32 (SSE4.1)
+static inline __m128i mullo_epi32(__m128i a, __m128i b)
 {
-	SampleType mxlr[64];
-	memset(mxlr,0,sizeof(mxlr));
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
 
-	//Generate 32 samples for each channel, before moving to next channel
-	//much more cache efficient !
-	for (int ch = 0; ch < 64; ch++)
+// Selects b where mask is set, a elsewhere, like _mm_blendv_epi8 (SSE4.1)
+static inline __m128i blend_epi32(__m128i a, __m128i b, __m128i mask)
+{
+	return _mm_or_si128(_mm_and_si128(mask, b), _mm_andnot_si128(mask, a));
+}
+#endif
+
+// Applies the gains of a channel batch and accumulates the result in the left, right and DSP MIXS mixes.
+// Same as ChannelEx::Step(mixl, mixr) for each sample, 4 samples at a time.
+static void MixBatch(const ChannelBatch& batch, SampleType *mixl, SampleType *mixr, SampleType *mixs, bool dspEnabled)
+{
+#ifdef AICA_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	for (int i = 0; i < 32; i += 4)
 	{
-		for (int i=0;i<32;i++)
+		__m128i sample = _mm_load_si128((const __m128i *)&batch.sample[i]);
+		__m128i left = _mm_srai_epi32(mullo_epi32(sample, _mm_load_si128((const __m128i *)&batch.gainLeft[i])), 15);
+		__m128i right = _mm_srai_epi32(mullo_epi32(sample, _mm_load_si128((const __m128i *)&batch.gainRight[i])), 15);
+		__m128i dsp = _mm_srai_epi32(mullo_epi32(sample, _mm_load_si128((const __m128i *)&batch.gainDsp[i])), 11);
+		_mm_store_si128((__m128i *)&mixs[i], _mm_add_epi32(_mm_load_si128((const __m128i *)&mixs[i]), dsp));
+		if (!dspEnabled)
 		{
-			SampleType oLeft,oRight,oDsp;
-			//stop working on this channel if its turned off ...
-			if (!Chans[ch].Step(oLeft, oRight, oDsp))
-				break;
-
-			if (oLeft + oRight == 0)
-				oLeft = oRight = oDsp >> 4;
-
-			mxlr[i*2+0] += oLeft;
-			mxlr[i*2+1] += oRight;
+			__m128i silent = _mm_cmpeq_epi32(_mm_add_epi32(left, right), zero);
+			__m128i dry = _mm_srai_epi32(dsp, 4);
+			left = blend_epi32(left, dry, silent);
+			right = blend_epi32(right, dry, silent);
 		}
+		_mm_store_si128((__m128i *)&mixl[i], _mm_add_epi32(_mm_load_si128((const __m128i *)&mixl[i]), left));
+		_mm_store_si128((__m128i *)&mixr[i], _mm_add_epi32(_mm_load_si128((const __m128i *)&mixr[i]), right));
 	}
-	//OK , generated all Channels  , now DSP/ect + final mix ;p
-	//CDDA EXTS input
-	
-	for (int i=0;i<32;i++)
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	for (int i = 0; i < 32; i += 4)
 	{
-		SampleType mixl,mixr;
-
-		mixl=mxlr[i*2+0];
-		mixr=mxlr[i*2+1];
-
-		if (cdda_index>=CDDA_SIZE)
-		{
-			cdda_index=0;
-			libCore_CDDA_Sector(cdda_sector);
-		}
-		s32 EXTS0L=cdda_sector[cdda_index];
-		s32 EXTS0R=cdda_sector[cdda_index+1];
-		cdda_index+=2;
-
-		//Final MIX ..
-		//Add CDDA / DSP effect(s)
-
-		//CDDA
-		VolumePan(EXTS0L, dsp_out_vol[16].EFSDL, dsp_out_vol[16].EFPAN, mixl, mixr);
-		VolumePan(EXTS0R, dsp_out_vol[17].EFSDL, dsp_out_vol[17].EFPAN, mixl, mixr);
-
-		/*
-		no dsp for now -- needs special handling of oDSP for ch paraller version ...
-		if (config::DSPEnabled)
-		{
-			dsp::step();
-
-			for (int i=0;i<16;i++)
-			{
-				VolumePan( (*(s16*)&DSPData->EFREG[i]) ,dsp_out_vol[i].EFSDL,dsp_out_vol[i].EFPAN,mixl,mixr);
-			}
-		}
-		*/
-
-		//Mono !
-		if (CommonData->Mono)
-		{
-			//Yay for mono =P
-			mixl+=mixr;
-			mixr=mixl;
-		}
-
-		//MVOL !
-		//we want to make sure mix* is *At least* 23 bits wide here, so 64 bit mul !
-		u32 mvol=CommonData->MVOL;
-		s32 val=volume_lut[mvol];
-		mixl = (s32)FPMul<s64>(mixl, val, 15);
-		mixr = (s32)FPMul<s64>(mixr, val, 15);
-
-
-		if (CommonData->DAC18B)
+		int32x4_t sample = vld1q_s32(&batch.sample[i]);
+		int32x4_t left = vshrq_n_s32(vmulq_s32(sample, vld1q_s32(&batch.gainLeft[i])), 15);
+		int32x4_t right = vshrq_n_s32(vmulq_s32(sample, vld1q_s32(&batch.gainRight[i])), 15);
+		int32x4_t dsp = vshrq_n_s32(vmulq_s32(sample, vld1q_s32(&batch.gainDsp[i])), 11);
+		vst1q_s32(&mixs[i], vaddq_s32(vld1q_s32(&mixs[i]), dsp));
+		if (!dspEnabled)
 		{
-			//If 18 bit output , make it 16b :p
-			mixl=FPs(mixl,2);
-			mixr=FPs(mixr,2);
+			uint32x4_t silent = vceqq_s32(vaddq_s32(left, right), vdupq_n_s32(0));
+			int32x4_t dry = vshrq_n_s32(dsp, 4);
+			left = vbslq_s32(silent, dry, left);
+			right = vbslq_s32(silent, dry, right);
 		}
-
-		//Sample is ready ! clip/saturate and store :}
-
-#ifdef CLIP_WARN
-		if (((s16)mixl) != mixl)
-			printf("Clipped mixl %d\n",mixl);
-		if (((s16)mixr) != mixr)
-			printf("Clipped mixr %d\n",mixr);
-#endif
-
-		clip16(mixl);
-		clip16(mixr);
-
-		if (!settings.input.fastForwardMode && !settings.aica.muteAudio)
-			WriteSample(mixr,mixl);
+		vst1q_s32(&mixl[i], vaddq_s32(vld1q_s32(&mixl[i]), left));
+		vst1q_s32(&mixr[i], vaddq_s32(vld1q_s32(&mixr[i]), right));
 	}
+#else
+	for (int i = 0; i < 32; i++)
+	{
+		SampleType left = FPMul(batch.sample[i], batch.gainLeft[i], 15);
+		SampleType right = FPMul(batch.sample[i], batch.gainRight[i], 15);
+		SampleType dsp = FPMul(batch.sample[i], batch.gainDsp[i], 11);
+		mixs[i] += dsp;
+		if (left + right == 0 && !dspEnabled)
+			left = right = dsp >> 4;
+		mixl[i] += left;
+		mixr[i] += right;
+	}
+#endif
 }
 
-void AICA_Sample()
+// CDDA, DSP effects and final mix of one sample
+static void MixOutput(SampleType mixl, SampleType mixr)
 {
-	SampleType mixl,mixr;
-	mixl = 0;
-	mixr = 0;
-	memset(dsp::state.MIXS, 0, sizeof(dsp::state.MIXS));
-
-	ChannelEx::StepAll(mixl,mixr);
-	
-	//OK , generated all Channels  , now DSP/ect + final mix ;p
 	//CDDA EXTS input
-	
 	if (cdda_index>=CDDA_SIZE)
 	{
 		cdda_index=0;
-		libCore_CDDA_Sector(cdda_sector);
+		if (cdda_next_ready)
+		{
+			memcpy(cdda_sector, cdda_next_sector, sizeof(cdda_sector));
+			cdda_next_ready = false;
+		}
+		else
+			libCore_CDDA_Sector(cdda_sector);
 	}
 	s32 EXTS0L=cdda_sector[cdda_index];
 	s32 EXTS0R=cdda_sector[cdda_index+1];
@@ -1606,6 +1608,64 @@ void AICA_Sample()
 	WriteSample(mixr,mixl);
 }
 
+// Generates 32 samples at once. Produces the same output as 32 calls to AICA_Sample()
+// as long as the registers aren't modified in between.
+void AICA_Sample32()
+{
+	alignas(16) SampleType mixl[32] {};
+	alignas(16) SampleType mixr[32] {};
+	alignas(16) SampleType mixs[16][32] {};
+	const bool dspEnabled = config::DSPEnabled;
+
+	//Generate 32 samples for each channel, before moving to next channel
+	//much more cache efficient !
+	for (ChannelEx& channel : Chans)
+	{
+		ChannelBatch batch;
+		int count = 0;
+		for (; count < 32; count++)
+			//stop working on this channel if its turned off ...
+			if (!channel.Generate(batch.sample[count], batch.gainLeft[count], batch.gainRight[count], batch.gainDsp[count]))
+				break;
+		if (count == 0)
+			continue;
+		for (int i = count; i < 32; i++)
+			batch.sample[i] = batch.gainLeft[i] = batch.gainRight[i] = batch.gainDsp[i] = 0;
+
+		MixBatch(batch, mixl, mixr, mixs[channel.VolMix.DSPOut - dsp::state.MIXS], dspEnabled);
+	}
+	//OK , generated all Channels  , now DSP/ect + final mix ;p
+	for (int i = 0; i < 32; i++)
+	{
+		for (int j = 0; j < 16; j++)
+			dsp::state.MIXS[j] = mixs[j][i];
+		MixOutput(mixl[i], mixr[i]);
+	}
+}
+
+void AICA_PrefetchCdda()
+{
+	// A batch reads at most one new sector
+	if (!cdda_next_ready && cdda_index + 32 * 2 > CDDA_SIZE)
+	{
+		libCore_CDDA_Sector(cdda_next_sector);
+		cdda_next_ready = true;
+	}
+}
+
+void AICA_Sample()
+{
+	SampleType mixl,mixr;
+	mixl = 0;
+	mixr = 0;
+	memset(dsp::state.MIXS, 0, sizeof(dsp::state.MIXS));
+
+	ChannelEx::StepAll(mixl,mixr);
+	
+	//OK , generated all Channels  , now DSP/ect + final mix ;p
+	MixOutput(mixl, mixr);
+}
+
 void channel_serialize(Serializer& ser)
 {
 	for (const ChannelEx& channel : Chans)
@@ -1772,6 +1832,7 @@ void channel_deserialize(Deserializer& deser)
 	}
 	deser >> cdda_sector;
 	deser >> cdda_index;
+	cdda_next_ready = false;
 	if (deser.version() < Deserializer::V9_LIBRETRO)
 	{
 		deser.skip(4 * 64); 		// mxlr
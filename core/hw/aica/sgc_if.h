@@ -3,6 +3,8 @@
 
 void AICA_Sample();
 void AICA_Sample32();
+// Reads the CDDA sector needed by the next batch so that the GD-ROM is only accessed by the SH4 thread
+void AICA_PrefetchCdda();
 
 void WriteChannelReg(u32 channel, u32 reg, int size);
 
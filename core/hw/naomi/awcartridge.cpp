@@ -163,6 +163,7 @@ ROM board internal layouts:
 #include "awcartridge.h"
 #include "awave_regs.h"
 #include "serialize.h"
+#include "cfg/option.h"
 
 u32 AWCartridge::ReadMem(u32 address, u32 size) {
 	verify(size != 1);
@@ -334,18 +335,40 @@ u16 AWCartridge::decrypt(u16 cipherText, u32 address, const u8 key)
 }
 
 
+AWCartridge::AWCartridge(u32 size) : Cartridge(size),
+	decryptCache([this](u64 page, u8 *data) { decryptPage(page, data); })
+{
+}
+
 void AWCartridge::Init(LoadProgress *progress, std::vector<u8> *digest)
 {
 	mpr_offset = decrypt16(0x58/2) | (decrypt16(0x5a/2) << 16);
 	INFO_LOG(NAOMI, "AWCartridge::SetKey rombd_key %02x mpr_offset %08x", rombd_key, mpr_offset);
 	device_reset();
+	if (config::CartDecryptWarmUp)
+	{
+		std::vector<u64> pages;
+		for (u32 page = 0; page < (RomSize + DecryptCache::PageSize - 1) / DecryptCache::PageSize; page++)
+			pages.push_back(page);
+		decryptCache.warmUp(pages);
+	}
 }
 
 void AWCartridge::SetKey(u32 key)
 {
+	// Stops the warm-up thread, which reads the key
+	decryptCache.clear();
 	rombd_key = key;
 }
 
+void AWCartridge::decryptPage(u64 page, u8 *data)
+{
+	u16 *words = (u16 *)data;
+	const u32 offset = page * (DecryptCache::PageSize / 2);
+	for (u32 i = 0; i < DecryptCache::PageSize / 2; i++)
+		words[i] = decrypt16(offset + i);
+}
+
 void AWCartridge::device_reset()
 {
 	epr_offset = 0;
@@ -389,20 +412,13 @@ void AWCartridge::recalc_dma_offset(int mode)
 
 void *AWCartridge::GetDmaPtr(u32 &size)
 {
-	size = std::min(std::min(size, 32u), dma_limit - dma_offset);
-	u32 offset = dma_offset / 2;
-	for (u32 i = 0; i < size / 2; i++)
-		decrypted_buf[i] = decrypt16(offset + i);
-
-//	printf("AWCART Decrypted data @ %08x:\n", dma_offset);
-//	for (int i = 0; i < 16; i++)
-//	{
-//		printf("%02x %02x ", decrypted_buf[i] & 0xff, decrypted_buf[i] >> 8);
-//		if ((i + 1) % 8 == 0)
-//			printf("\n");
-//	}
-
-	return decrypted_buf;
+	// Data is returned up to the end of the decrypted page
+	const u32 wordOffset = dma_offset / 2;
+	const u32 pageOffset = wordOffset % (DecryptCache::PageSize / 2) * 2;
+	size = std::min(std::min(size, DecryptCache::PageSize - pageOffset), dma_limit - dma_offset);
+	const u8 *page = decryptCache.get(wordOffset / (DecryptCache::PageSize / 2));
+
+	return (void *)(page + pageOffset);
 }
 
 void AWCartridge::AdvancePtr(u32 size)
@@ -13,11 +13,12 @@
 #define CORE_HW_NAOMI_AWCARTRIDGE_H_
 
 #include "naomi_cart.h"
+#include "decrypt_cache.h"
 
 class AWCartridge: public Cartridge
 {
 public:
-	AWCartridge(u32 size) : Cartridge(size) {}
+	AWCartridge(u32 size);
 
 	void Init(LoadProgress *progress = nullptr, std::vector<u8> *digest = nullptr) override;
 	u32 ReadMem(u32 address, u32 size) override;
@@ -40,7 +41,6 @@ private:
 	u32 mpr_offset, mpr_bank;
 	u32 epr_offset, mpr_file_offset;
 	u16 mpr_record_index, mpr_first_file_index;
-	u16 decrypted_buf[16];
 
 	u32 dma_offset, dma_limit;
 
@@ -58,6 +58,9 @@ private:
 	u16 decrypt16(u32 address) { return decrypt(((u16 *)RomPtr)[address % (RomSize / 2)], address, rombd_key); }
 
 	void recalc_dma_offset(int mode);
+	void decryptPage(u64 page, u8 *data);
+
+	DecryptCache decryptCache;
 };
 
 #endif /* CORE_HW_NAOMI_AWCARTRIDGE_H_ */
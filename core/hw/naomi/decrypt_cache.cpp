@@ -0,0 +1,120 @@
+#include "decrypt_cache.h"
+
+#include <chrono>
+
+DecryptCache::~DecryptCache()
+{
+	stopWarmUp();
+	DecryptCacheStats stats = getStats();
+	if (stats.hits + stats.misses > 0)
+		INFO_LOG(NAOMI, "Decrypt cache: %.1f%% hits, %.1f MB decrypted at %.1f MB/s",
+				100.0 * stats.hits / (stats.hits + stats.misses), stats.bytesDecrypted / 1024.0 / 1024.0,
+				stats.decryptSeconds > 0 ? stats.bytesDecrypted / 1024.0 / 1024.0 / stats.decryptSeconds : 0.0);
+}
+
+void DecryptCache::decrypt(u64 key, u8 *data)
+{
+	auto start = std::chrono::steady_clock::now();
+	decryptor(key, data);
+	decryptNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	bytesDecrypted += PageSize;
+}
+
+const u8 *DecryptCache::get(u64 key)
+{
+	std::lock_guard<std::mutex> _(mutex);
+	auto it = pages.find(key);
+	if (it != pages.end())
+	{
+		hits++;
+		lru.splice(lru.begin(), lru, it->second.lruPos);
+		return it->second.data.get();
+	}
+	misses++;
+	std::unique_ptr<u8[]> data;
+	if (pages.size() >= maxPages)
+	{
+		// Reuse the least recently used page
+		auto lruIt = pages.find(lru.back());
+		data = std::move(lruIt->second.data);
+		pages.erase(lruIt);
+		lru.pop_back();
+	}
+	else
+		data.reset(new u8[PageSize]);
+	decrypt(key, data.get());
+
+	lru.push_front(key);
+	Page& page = pages[key];
+	page.data = std::move(data);
+	page.lruPos = lru.begin();
+
+	return page.data.get();
+}
+
+void DecryptCache::warmUp(const std::vector<u64>& keys)
+{
+	stopWarmUp();
+	warmUpThread = std::thread([this, keys]() {
+		for (u64 key : keys)
+		{
+			if (warmUpStop)
+				break;
+			{
+				std::lock_guard<std::mutex> _(mutex);
+				if (pages.size() >= maxPages)
+					break;
+				if (pages.count(key) != 0)
+					continue;
+			}
+			std::unique_ptr<u8[]> data(new u8[PageSize]);
+			decrypt(key, data.get());
+
+			std::lock_guard<std::mutex> _(mutex);
+			// Never evict pages in use
+			if (pages.size() >= maxPages)
+				break;
+			if (pages.count(key) != 0)
+				continue;
+			lru.push_back(key);
+			Page& page = pages[key];
+			page.data = std::move(data);
+			page.lruPos = std::prev(lru.end());
+		}
+		DEBUG_LOG(NAOMI, "Decrypt cache warm-up done");
+	});
+}
+
+void DecryptCache::waitWarmUp()
+{
+	if (warmUpThread.joinable())
+		warmUpThread.join();
+}
+
+void DecryptCache::stopWarmUp()
+{
+	if (warmUpThread.joinable())
+	{
+		warmUpStop = true;
+		warmUpThread.join();
+		warmUpStop = false;
+	}
+}
+
+void DecryptCache::clear()
+{
+	stopWarmUp();
+	std::lock_guard<std::mutex> _(mutex);
+	pages.clear();
+	lru.clear();
+}
+
+DecryptCacheStats DecryptCache::getStats() const
+{
+	DecryptCacheStats stats;
+	stats.hits = hits;
+	stats.misses = misses;
+	stats.bytesDecrypted = bytesDecrypted;
+	stats.decryptSeconds = decryptNanos / 1e9;
+	return stats;
+}
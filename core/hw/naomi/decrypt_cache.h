@@ -0,0 +1,71 @@
+/*
+	Cache of decrypted cartridge ROM pages.
+
+	Atomiswave and M4 cartridges decrypt ROM data on the fly. Games streaming data from the ROM
+	read the same areas again and again so decrypted pages are kept in a bounded LRU cache.
+	Pages can also be decrypted ahead of time by a background thread after boot.
+	The page contents only depend on the page key, so the decryptor must be thread-safe.
+*/
+#pragma once
+#include "types.h"
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct DecryptCacheStats
+{
+	u64 hits;
+	u64 misses;
+	u64 bytesDecrypted;
+	double decryptSeconds;
+};
+
+class DecryptCache
+{
+public:
+	static constexpr u32 PageSize = 4096;
+	using Decryptor = std::function<void(u64 key, u8 *page)>;
+
+	DecryptCache(Decryptor decryptor, u32 maxPages = 4096)
+		: decryptor(decryptor), maxPages(maxPages) {}
+	~DecryptCache();
+
+	// Returns the decrypted page, valid until the next call
+	const u8 *get(u64 key);
+	// Decrypts the pages with the given keys in the background until the cache is full
+	void warmUp(const std::vector<u64>& keys);
+	// Waits until the background decryption is done
+	void waitWarmUp();
+	void clear();
+
+	DecryptCacheStats getStats() const;
+
+private:
+	struct Page
+	{
+		std::unique_ptr<u8[]> data;
+		std::list<u64>::iterator lruPos;
+	};
+	void decrypt(u64 key, u8 *data);
+	void stopWarmUp();
+
+	Decryptor decryptor;
+	const u32 maxPages;
+	std::unordered_map<u64, Page> pages;
+	std::list<u64> lru;		// most recently used first
+	std::mutex mutex;
+
+	std::thread warmUpThread;
+	std::atomic<bool> warmUpStop { false };
+
+	std::atomic<u64> hits { 0 };
+	std::atomic<u64> misses { 0 };
+	std::atomic<u64> bytesDecrypted { 0 };
+	std::atomic<u64> decryptNanos { 0 };
+};
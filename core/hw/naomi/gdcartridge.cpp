@@ -13,6 +13,12 @@
 #include "gdcartridge.h"
 #include "stdclass.h"
 #include "emulator.h"
+#include "cfg/option.h"
+#include "oslib/oslib.h"
+#include "oslib/directory.h"
+
+#include <atomic>
+#include <thread>
 
 /*
 
@@ -493,15 +499,22 @@ void GDCartridge::device_start(LoadProgress *progress, std::vector<u8> *digest)
 
 		u8 buffer[2048];
 		std::string gdrom_path = get_game_basename() + "/" + gdrom_name;
-		std::unique_ptr<Disc> gdrom = std::unique_ptr<Disc>(OpenDisc(gdrom_path + ".chd", digest));
-		if (gdrom == nullptr)
-			gdrom = std::unique_ptr<Disc>(OpenDisc(gdrom_path + ".gdi", digest));
-		if (gdrom_parent_name != nullptr && gdrom == nullptr)
+		std::string image_path;
+		std::unique_ptr<Disc> gdrom;
+		auto openImage = [&](const std::string& path) {
+			if (gdrom == nullptr)
+			{
+				gdrom = std::unique_ptr<Disc>(OpenDisc(path, digest));
+				image_path = path;
+			}
+		};
+		openImage(gdrom_path + ".chd");
+		openImage(gdrom_path + ".gdi");
+		if (gdrom_parent_name != nullptr)
 		{
 			std::string gdrom_parent_path = get_game_dir() + "/" + gdrom_parent_name + "/" + gdrom_name;
-			gdrom = std::unique_ptr<Disc>(OpenDisc(gdrom_parent_path + ".chd", digest));
-			if (gdrom == nullptr)
-				gdrom = std::unique_ptr<Disc>(OpenDisc(gdrom_parent_path + ".gdi", digest));
+			openImage(gdrom_parent_path + ".chd");
+			openImage(gdrom_parent_path + ".gdi");
 		}
 		if (gdrom == nullptr)
 			throw NaomiCartException("Naomi GDROM: Cannot open " + gdrom_path + ".chd or " + gdrom_path + ".gdi");
@@ -567,24 +580,17 @@ void GDCartridge::device_start(LoadProgress *progress, std::vector<u8> *digest)
 			if (dimm_data_size != file_rounded_size)
 				memset(dimm_data + file_rounded_size, 0, dimm_data_size - file_rounded_size);
 
-			// read encrypted data into dimm_data
 			u32 sectors = file_rounded_size / 2048;
-			read_gdrom(gdrom.get(), file_start, dimm_data, sectors, progress);
-
-			// decrypt loaded data
-			u32 des_subkeys[32];
-			des_generate_subkeys(rev64(key), des_subkeys);
-
-			for (u32 i = 0; i < file_rounded_size; i += 8)
+			std::string cachePath;
+			if (config::NaomiDimmCache)
+				cachePath = cache_path(gdrom.get(), image_path, key, file_start, sectors, digest);
+			if (cachePath.empty() || !load_cache(cachePath, file_rounded_size))
 			{
-				if (progress != nullptr)
-				{
-					if (progress->cancelled)
-						throw LoadCancelledException();
-					progress->label = "Decrypting...";
-					progress->progress = (float)(i + 8) / file_rounded_size;
-				}
-				*(u64 *)(dimm_data + i) = des_encrypt_decrypt<true>(*(u64 *)(dimm_data + i), des_subkeys);
+				// read encrypted data into dimm_data
+				read_gdrom(gdrom.get(), file_start, dimm_data, sectors, progress);
+				des_decrypt(dimm_data, file_rounded_size, key, progress);
+				if (!cachePath.empty())
+					save_cache(cachePath, file_rounded_size);
 			}
 		}
 
@@ -593,6 +599,119 @@ void GDCartridge::device_start(LoadProgress *progress, std::vector<u8> *digest)
 	}
 }
 
+void GDCartridge::des_decrypt(u8 *data, u32 size, u64 key, LoadProgress *progress)
+{
+	u32 des_subkeys[32];
+	des_generate_subkeys(rev64(key), des_subkeys);
+	if (progress != nullptr)
+		progress->label = "Decrypting...";
+
+	// ECB mode: each 8-byte block is decrypted independently so chunks are spread over all cpu cores
+	constexpr u32 CHUNK_SIZE = 256 * 1024;
+	const u32 chunks = (size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	std::atomic<u32> nextChunk(0);
+	std::atomic<u32> doneChunks(0);
+	std::atomic<bool> cancelled(false);
+	auto decryptChunks = [&](bool mainThread) {
+		for (u32 chunk = nextChunk++; chunk < chunks && !cancelled; chunk = nextChunk++)
+		{
+			const u32 end = std::min(size, (chunk + 1) * CHUNK_SIZE);
+			for (u32 i = chunk * CHUNK_SIZE; i < end; i += 8)
+				*(u64 *)(data + i) = des_encrypt_decrypt<true>(*(u64 *)(data + i), des_subkeys);
+			doneChunks++;
+			if (mainThread && progress != nullptr)
+			{
+				if (progress->cancelled)
+					cancelled = true;
+				progress->progress = (float)doneChunks / chunks;
+			}
+		}
+	};
+	const u32 threadCount = std::min(std::max(std::thread::hardware_concurrency(), 1u), chunks);
+	std::vector<std::thread> threads;
+	for (u32 i = 1; i < threadCount; i++)
+		threads.emplace_back(decryptChunks, false);
+	decryptChunks(true);
+	for (std::thread& thread : threads)
+		thread.join();
+	if (cancelled)
+		throw LoadCancelledException();
+	DEBUG_LOG(NAOMI, "Decrypted %d bytes using %d threads", size, threadCount);
+}
+
+// The cache file name is derived from the disc image path, size and modification time, the key,
+// the file location and a sample of its encrypted data, plus the disc digest when available.
+std::string GDCartridge::cache_path(Disc *gdrom, const std::string& imagePath, u64 key, u32 file_start, u32 sectors,
+		const std::vector<u8> *digest)
+{
+	struct stat st;
+	if (flycast::stat(imagePath.c_str(), &st) != 0)
+		return "";
+	MD5Sum md5;
+	md5.add(imagePath.c_str(), (unsigned long)imagePath.length());
+	md5.add((u64)st.st_size).add((u64)st.st_mtime);
+	md5.add(key).add(file_start).add(sectors);
+	if (digest != nullptr && !digest->empty())
+		md5.add(*digest);
+	u8 buffer[2048];
+	read_gdrom(gdrom, file_start, buffer);
+	md5.add(buffer, sizeof(buffer));
+	read_gdrom(gdrom, file_start + sectors - 1, buffer);
+	md5.add(buffer, sizeof(buffer));
+	u8 md5digest[16];
+	md5.getDigest(md5digest);
+
+	std::string name = std::string(gdrom_name) + "-";
+	for (u8 b : md5digest)
+	{
+		char hex[3];
+		sprintf(hex, "%02x", b);
+		name += hex;
+	}
+	return hostfs::getNaomiDimmCachePath(name + ".dimm");
+}
+
+bool GDCartridge::load_cache(const std::string& path, u32 size)
+{
+	FILE *f = nowide::fopen(path.c_str(), "rb");
+	if (f == nullptr)
+		return false;
+	u32 header[3];
+	bool loaded = std::fread(header, sizeof(header), 1, f) == 1
+			&& header[0] == DIMM_CACHE_MAGIC && header[1] == DIMM_CACHE_VERSION && header[2] == size
+			&& std::fread(dimm_data, 1, size, f) == size;
+	std::fclose(f);
+	if (loaded)
+		INFO_LOG(NAOMI, "Decrypted DIMM data loaded from %s", path.c_str());
+	else
+		WARN_LOG(NAOMI, "Invalid DIMM cache file %s", path.c_str());
+	return loaded;
+}
+
+void GDCartridge::save_cache(const std::string& path, u32 size)
+{
+	// Written to a temporary file first so that an interrupted write isn't used later
+	std::string tmpPath = path + ".tmp";
+	FILE *f = nowide::fopen(tmpPath.c_str(), "wb");
+	if (f == nullptr)
+	{
+		WARN_LOG(NAOMI, "Can't create DIMM cache file %s", tmpPath.c_str());
+		return;
+	}
+	const u32 header[3] { DIMM_CACHE_MAGIC, DIMM_CACHE_VERSION, size };
+	bool saved = std::fwrite(header, sizeof(header), 1, f) == 1
+			&& std::fwrite(dimm_data, 1, size, f) == size;
+	saved = std::fclose(f) == 0 && saved;
+	nowide::remove(path.c_str());
+	if (!saved || nowide::rename(tmpPath.c_str(), path.c_str()) != 0)
+	{
+		WARN_LOG(NAOMI, "Error writing DIMM cache file %s", path.c_str());
+		nowide::remove(tmpPath.c_str());
+		return;
+	}
+	INFO_LOG(NAOMI, "Decrypted DIMM data saved to %s", path.c_str());
+}
+
 void GDCartridge::device_reset()
 {
 	dimm_cur_address = 0;
@@ -60,6 +60,9 @@ private:
 	static const u32 DES_MASK_TABLE[];
 	static const u8 DES_ROTATE_TABLE[16];
 
+	static constexpr u32 DIMM_CACHE_MAGIC = 0x4d4d4944;	// DIMM
+	static constexpr u32 DIMM_CACHE_VERSION = 1;
+
 	void device_start(LoadProgress *progress, std::vector<u8> *digest);
 	void device_reset();
 	void find_file(const char *name, const u8 *dir_sector, u32 &file_start, u32 &file_size);
@@ -70,6 +73,13 @@ private:
 	u64 des_encrypt_decrypt(u64 src, const u32 *des_subkeys);
 	u64 rev64(u64 src);
 	void read_gdrom(Disc *gdrom, u32 sector, u8* dst, u32 count = 1, LoadProgress *progress = nullptr);
+	void des_decrypt(u8 *data, u32 size, u64 key, LoadProgress *progress);
+
+	// On-disk cache of the decrypted DIMM data
+	std::string cache_path(Disc *gdrom, const std::string& imagePath, u64 key, u32 file_start, u32 sectors,
+			const std::vector<u8> *digest);
+	bool load_cache(const std::string& path, u32 size);
+	void save_cache(const std::string& path, u32 size);
 };
 
 #endif /* CORE_HW_NAOMI_GDCARTRIDGE_H_ */
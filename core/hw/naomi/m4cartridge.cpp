@@ -10,6 +10,7 @@
 
 #include "m4cartridge.h"
 #include "serialize.h"
+#include "cfg/option.h"
 
 
 // Decoder for M4-type NAOMI cart encryption
@@ -46,6 +47,24 @@ static u8 cfidata[] = {
 0x01,0x00
 };
 
+M4Cartridge::M4Cartridge(u32 size) : NaomiCartridge(size),
+	decryptCache([this](u64 key, u8 *data) { decryptPage(key, data); })
+{
+}
+
+void M4Cartridge::Init(LoadProgress *progress, std::vector<u8> *digest)
+{
+	device_start();
+	device_reset();
+	if (config::CartDecryptWarmUp)
+	{
+		std::vector<u64> pages;
+		for (u32 page = 0; page < RomSize / DecryptCache::PageSize; page++)
+			pages.push_back((u64)page * 32);
+		decryptCache.warmUp(pages);
+	}
+}
+
 void M4Cartridge::device_start()
 {
 	if (m4id == 0)
@@ -225,12 +244,56 @@ u16 M4Cartridge::decrypt_one_round(u16 word, u16 subkey)
 	return one_round[word ^ subkey] ^ subkey ;
 }
 
+//
+// Blocks of 16 words are decrypted independently so a page only depends on its offset in the ROM.
+// The key is the page number times 32 plus the offset of the first block.
+//
+void M4Cartridge::decryptPage(u64 key, u8 *data)
+{
+	const u8 *src = RomPtr + (key / 32) * DecryptCache::PageSize + key % 32;
+	for (u32 i = 0; i < DecryptCache::PageSize; i += 32)
+	{
+		u16 blockIv = 0;
+		for (u32 j = i; j < i + 32; j += 2)
+		{
+			u16 enc = src[j] | (src[j + 1] << 8);
+			u16 dec = blockIv;
+			blockIv = decrypt_one_round(enc ^ blockIv, subkey1);
+			dec ^= decrypt_one_round(blockIv, subkey2);
+			data[j] = dec;
+			data[j + 1] = dec >> 8;
+		}
+	}
+}
+
 void M4Cartridge::enc_fill()
 {
-	const u8 *base = RomPtr + rom_cur_address;
 	while (buffer_actual_size < sizeof(buffer))
 	{
-		u16 enc = base[0] | (base[1] << 8);
+		if (counter == 0)
+		{
+			// Copy whole blocks from the decrypted page cache
+			// The cached page starts at pageBase + blockOffset and decryptPage reads PageSize bytes from there
+			const u32 blockOffset = rom_cur_address % 32;
+			const u32 pageOffset = (rom_cur_address - blockOffset) % DecryptCache::PageSize;
+			const u32 pageBase = rom_cur_address - blockOffset - pageOffset;
+			const u32 len = std::min<u32>(DecryptCache::PageSize - pageOffset, sizeof(buffer) - buffer_actual_size) & ~31;
+			if (len > 0 && (u64)pageBase + blockOffset + DecryptCache::PageSize <= RomSize)
+			{
+				const u8 *page = decryptCache.get((u64)(pageBase / DecryptCache::PageSize) * 32 + blockOffset);
+				memcpy(buffer + buffer_actual_size, page + pageOffset, len);
+				buffer_actual_size += len;
+				rom_cur_address += len;
+				continue;
+			}
+		}
+		// Reads past the end of the ROM return all ones, as with Cartridge::Read
+		u16 enc = 0xffff;
+		if (rom_cur_address + 2 <= RomSize)
+		{
+			const u8 *base = RomPtr + rom_cur_address;
+			enc = base[0] | (base[1] << 8);
+		}
 		u16 dec = iv;
 		iv = decrypt_one_round(enc ^ iv, subkey1);
 		dec ^= decrypt_one_round(iv, subkey2);
@@ -238,7 +301,6 @@ void M4Cartridge::enc_fill()
 		buffer[buffer_actual_size++] = dec;
 		buffer[buffer_actual_size++] = dec >> 8;
 
-		base += 2;
 		rom_cur_address += 2;
 
 		counter++;
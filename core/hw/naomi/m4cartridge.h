@@ -14,17 +14,14 @@
 
 #include "naomi_cart.h"
 #include "naomi_regs.h"
+#include "decrypt_cache.h"
 
 class M4Cartridge: public NaomiCartridge {
 public:
-	M4Cartridge(u32 size) : NaomiCartridge(size) { }
+	M4Cartridge(u32 size);
 	~M4Cartridge() override;
 
-	void Init(LoadProgress *progress = nullptr, std::vector<u8> *digest = nullptr) override
-	{
-		device_start();
-		device_reset();
-	}
+	void Init(LoadProgress *progress = nullptr, std::vector<u8> *digest = nullptr) override;
 
 	u32 ReadMem(u32 address, u32 size) override
 	{
@@ -78,6 +75,9 @@ private:
 	void enc_reset();
 	void enc_fill();
 	u16 decrypt_one_round(u16 word, u16 subkey);
+	void decryptPage(u64 key, u8 *data);
+
+	DecryptCache decryptCache;
 };
 
 #endif /* CORE_HW_NAOMI_M4CARTRIDGE_H_ */
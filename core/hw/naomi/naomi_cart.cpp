@@ -321,10 +321,9 @@ static void loadMameRom(const char *filename, LoadProgress *progress)
 				{
 					case Normal:
 						{
-							u8 *dst = (u8 *)CurrentCartridge->GetPtr(game->blobs[romid].offset, len);
-							u32 read = file->Read(dst, game->blobs[romid].length);
+							u32 read = CurrentCartridge->LoadFile(file.get(), game->blobs[romid].offset, game->blobs[romid].length);
 							if (config::GGPOEnable)
-								md5.add(dst, game->blobs[romid].length);
+								md5.add((u8 *)CurrentCartridge->GetPtr(game->blobs[romid].offset, len), game->blobs[romid].length);
 							DEBUG_LOG(NAOMI, "Mapped %s: %x bytes at %07x", game->blobs[romid].filename, read, game->blobs[romid].offset);
 						}
 						break;
@@ -501,8 +500,7 @@ static void loadDecryptedRom(const char* file, LoadProgress *progress)
 	MD5Sum md5;
 
 	// Allocate space for the rom
-	u8 *romBase = (u8 *)malloc(romSize);
-	verify(romBase != nullptr);
+	std::unique_ptr<RomMemory> romMemory(new RomMemory(romSize));
 
 	bool load_error = false;
 
@@ -522,17 +520,25 @@ static void loadDecryptedRom(const char* file, LoadProgress *progress)
 				break;
 			}
 		}
-		u8* romDest = romBase + fstart[i];
 
 		if (fp == nullptr)
 		{
 			//printf("-Reserving ram at 0x%08X, size 0x%08X\n", fstart[i], fsize[i]);
-			memset(romDest, -1, fsize[i]);
+			// RomMemory reads as 0xff until written
 		}
 		else
 		{
 			//printf("-Mapping \"%s\" at 0x%08X, size 0x%08X\n", files[i].c_str(), fstart[i], fsize[i]);
-			bool mapped = fread(romDest, 1, fsize[i], fp) == fsize[i];
+			// Files are mapped if possible so that they're only read when accessed
+			bool mapped = romMemory->mapFile(fp, fstart[i], fsize[i]);
+			// Mapping the whole rom may move it
+			u8* romDest = romMemory->data() + fstart[i];
+			if (!mapped)
+			{
+				// read() doesn't trigger the fault handler
+				romMemory->commit(fstart[i], fsize[i]);
+				mapped = fread(romDest, 1, fsize[i], fp) == fsize[i];
+			}
 			if (config::GGPOEnable)
 				md5.add(fp);
 			fclose(fp);
@@ -547,16 +553,13 @@ static void loadDecryptedRom(const char* file, LoadProgress *progress)
 	}
 
 	if (load_error)
-	{
-		free(romBase);
 		throw FlycastException("Error: Failed to load BIN/DAT file");
-	}
 	if (config::GGPOEnable)
 		md5.getDigest(settings.network.md5.game);
 
-	DEBUG_LOG(NAOMI, "Legacy ROM loaded successfully");
+	DEBUG_LOG(NAOMI, "Legacy ROM loaded successfully: %.2f MB mapped", romMemory->mappedSize() / 1024.f / 1024.f);
 
-	CurrentCartridge = new DecryptedCartridge(romBase, romSize);
+	CurrentCartridge = new DecryptedCartridge(romMemory.release());
 }
 
 void naomi_cart_LoadRom(const char* file, LoadProgress *progress)
@@ -629,17 +632,16 @@ int naomi_cart_GetPlatform(const char *path)
 		return DC_PLATFORM_NAOMI;
 }
 
-Cartridge::Cartridge(u32 size)
+Cartridge::Cartridge(u32 size) : romMemory(new RomMemory(size))
 {
-	RomPtr = (u8 *)malloc(size);
+	RomPtr = romMemory->data();
 	RomSize = size;
-	memset(RomPtr, 0xFF, RomSize);
 }
 
-Cartridge::~Cartridge()
+Cartridge::Cartridge(RomMemory *memory) : romMemory(memory)
 {
-	if (RomPtr != NULL)
-		free(RomPtr);
+	RomPtr = romMemory->data();
+	RomSize = romMemory->size();
 }
 
 bool Cartridge::Read(u32 offset, u32 size, void* dst)
@@ -667,6 +669,26 @@ bool Cartridge::Write(u32 offset, u32 size, u32 data)
 	return false;
 }
 
+u32 Cartridge::LoadFile(ArchiveFile *file, u32 offset, u32 length)
+{
+	offset &= 0x1FFFffff;
+
+	verify(offset < RomSize);
+	verify((offset + length) <= RomSize);
+
+	// Uncompressed files are mapped so that they're only read when accessed
+	FILE *fp = file->GetFile();
+	if (fp != nullptr && romMemory->mapFile(fp, offset, length))
+	{
+		// Mapping the whole rom may move it
+		RomPtr = romMemory->data();
+		return length;
+	}
+	// Archives may read with system calls, which don't trigger the fault handler
+	romMemory->commit(offset, length);
+	return file->Read(&RomPtr[offset], length);
+}
+
 void* Cartridge::GetPtr(u32 offset, u32& size)
 {
 	offset &= 0x1FFFffff;
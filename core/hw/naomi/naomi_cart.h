@@ -1,9 +1,13 @@
 #pragma once
 
 #include <algorithm>
+#include <memory>
 #include <string>
 #include "types.h"
 #include "emulator.h"
+#include "rom_memory.h"
+
+class ArchiveFile;
 
 struct RomBootID
 {
@@ -47,7 +51,8 @@ class Cartridge
 {
 public:
 	Cartridge(u32 size);
-	virtual ~Cartridge();
+	Cartridge(RomMemory *memory);
+	virtual ~Cartridge() = default;
 
 	virtual void Init(LoadProgress *progress = nullptr, std::vector<u8> *digest = nullptr) {
 		if (digest != nullptr)
@@ -59,6 +64,8 @@ public:
 	virtual bool Read(u32 offset, u32 size, void* dst);
 	virtual bool Write(u32 offset, u32 size, u32 data);
 	virtual void* GetPtr(u32 offset, u32& size);
+	// Loads a ROM file at the given offset. Returns the number of bytes loaded.
+	u32 LoadFile(ArchiveFile *file, u32 offset, u32 length);
 	virtual void* GetDmaPtr(u32 &size) = 0;
 	virtual void AdvancePtr(u32 size) = 0;
 	virtual void Serialize(Serializer& ser) const {}
@@ -70,12 +77,16 @@ public:
 protected:
 	u8* RomPtr;
 	u32 RomSize;
+
+private:
+	std::unique_ptr<RomMemory> romMemory;
 };
 
 class NaomiCartridge : public Cartridge
 {
 public:
 	NaomiCartridge(u32 size) : Cartridge(size), RomPioOffset(0), RomPioAutoIncrement(false), DmaOffset(0), DmaCount(0xffff) {}
+	NaomiCartridge(RomMemory *memory) : Cartridge(memory), RomPioOffset(0), RomPioAutoIncrement(false), DmaOffset(0), DmaCount(0xffff) {}
 
 	u32 ReadMem(u32 address, u32 size) override;
 	void WriteMem(u32 address, u32 data, u32 size) override;
@@ -100,7 +111,7 @@ protected:
 class DecryptedCartridge : public NaomiCartridge
 {
 public:
-	DecryptedCartridge(u8 *rom_ptr, u32 size) : NaomiCartridge(size) { free(RomPtr); RomPtr = rom_ptr; }
+	DecryptedCartridge(RomMemory *memory) : NaomiCartridge(memory) {}
 };
 
 class M2Cartridge : public NaomiCartridge
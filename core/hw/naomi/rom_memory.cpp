@@ -0,0 +1,220 @@
+#include "rom_memory.h"
+#include "stdclass.h"
+
+#include <algorithm>
+#include <mutex>
+
+// Mapping relies on the fault handler to fill the pages that aren't backed by a file
+#if defined(_WIN32)
+#include <windows.h>
+#include <io.h>
+#define ROM_MAPPING
+#elif (defined(__unix__) || defined(__APPLE__)) && !defined(__SWITCH__) && !defined(__vita__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ROM_MAPPING
+#endif
+
+static size_t pageSize()
+{
+#if defined(_WIN32)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwAllocationGranularity;
+#elif defined(ROM_MAPPING)
+	return sysconf(_SC_PAGESIZE);
+#else
+	return PAGE_SIZE;
+#endif
+}
+
+// Pages are filled in chunks of this size on first access
+constexpr size_t FillChunk = 64 * 1024;
+
+static std::mutex romsMutex;
+static std::vector<RomMemory *> roms;
+
+RomMemory::RomMemory(u32 size) : romSize(size)
+{
+	page = pageSize();
+	allocSize = std::max<size_t>((size + page - 1) / page * page, page);
+#if defined(_WIN32)
+	ptr = (u8 *)VirtualAlloc(nullptr, allocSize, MEM_RESERVE, PAGE_NOACCESS);
+#elif defined(ROM_MAPPING)
+	void *p = mmap(nullptr, allocSize, PROT_NONE, MAP_PRIVATE | MAP_ANON, -1, 0);
+	ptr = p == MAP_FAILED ? nullptr : (u8 *)p;
+#else
+	ptr = (u8 *)malloc(allocSize);
+#endif
+	verify(ptr != nullptr);
+#ifdef ROM_MAPPING
+	committed.resize(allocSize / page);
+	std::lock_guard<std::mutex> _(romsMutex);
+	roms.push_back(this);
+#else
+	memset(ptr, 0xff, allocSize);
+#endif
+}
+
+RomMemory::~RomMemory()
+{
+#ifdef ROM_MAPPING
+	{
+		std::lock_guard<std::mutex> _(romsMutex);
+		roms.erase(std::find(roms.begin(), roms.end(), this));
+	}
+#endif
+#if defined(_WIN32)
+	if (view != nullptr)
+		UnmapViewOfFile(view);
+	else
+		VirtualFree(ptr, 0, MEM_RELEASE);
+#elif defined(ROM_MAPPING)
+	munmap(ptr, allocSize);
+#else
+	free(ptr);
+#endif
+}
+
+void RomMemory::setCommitted(size_t offset, size_t len, bool value)
+{
+	const size_t last = std::min((offset + len + page - 1) / page, committed.size());
+	for (size_t i = offset / page; i < last; i++)
+		committed[i] = value;
+}
+
+void RomMemory::commit(size_t offset, size_t len)
+{
+#ifdef ROM_MAPPING
+	std::lock_guard<std::mutex> _(romsMutex);
+	const size_t last = std::min((offset + len + page - 1) / page, committed.size());
+	for (size_t i = offset / page; i < last; )
+	{
+		if (committed[i])
+		{
+			i++;
+			continue;
+		}
+		size_t end = i + 1;
+		while (end < last && !committed[end])
+			end++;
+		u8 *p = ptr + i * page;
+		const size_t bytes = (end - i) * page;
+#if defined(_WIN32)
+		verify(VirtualAlloc(p, bytes, MEM_COMMIT, PAGE_READWRITE) != nullptr);
+#else
+		verify(mprotect(p, bytes, PROT_READ | PROT_WRITE) == 0);
+#endif
+		memset(p, 0xff, bytes);
+		setCommitted(i * page, bytes, true);
+		i = end;
+	}
+#endif
+}
+
+bool RomMemory::pageFault(void *address)
+{
+#ifdef ROM_MAPPING
+	RomMemory *rom = nullptr;
+	size_t offset;
+	{
+		std::lock_guard<std::mutex> _(romsMutex);
+		for (RomMemory *r : roms)
+		{
+			if ((u8 *)address < r->ptr || (u8 *)address >= r->ptr + r->allocSize)
+				continue;
+			offset = (u8 *)address - r->ptr;
+			// Accessible pages don't fault for lack of a fill
+			if (!r->committed[offset / r->page])
+				rom = r;
+			break;
+		}
+	}
+	if (rom == nullptr)
+		return false;
+	const size_t chunk = std::max(FillChunk, rom->page);
+	offset = offset / chunk * chunk;
+	rom->commit(offset, std::min(chunk, rom->allocSize - offset));
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool RomMemory::mapFile(FILE *file, u32 offset, u32 len)
+{
+	if (len == 0 || (u64)offset + len > romSize)
+		return false;
+#if defined(_WIN32)
+	// Windows can't map a file over an existing allocation so the file must cover the whole ROM
+	if (view != nullptr || offset != 0 || len != romSize)
+		return false;
+	HANDLE fileHandle = (HANDLE)_get_osfhandle(_fileno(file));
+	LARGE_INTEGER fileSize;
+	if (fileHandle == INVALID_HANDLE_VALUE || !GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart < len)
+		return false;
+	HANDLE mapping = CreateFileMapping(fileHandle, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+	if (mapping == nullptr)
+		return false;
+	view = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, len);
+	// The view keeps a reference to the mapping
+	CloseHandle(mapping);
+	if (view == nullptr)
+		return false;
+	std::lock_guard<std::mutex> _(romsMutex);
+	VirtualFree(ptr, 0, MEM_RELEASE);
+	ptr = (u8 *)view;
+	mapped = len;
+	// Past the end of the view is out of bounds
+	setCommitted(0, allocSize, true);
+	return true;
+
+#elif defined(ROM_MAPPING)
+	const size_t page = pageSize();
+	if (offset % page != 0)
+		return false;
+	// Only whole pages are mapped so that the ROM data following the file isn't overwritten.
+	// The rest of the file is read.
+	const u32 mapLen = len & ~(page - 1);
+	if (mapLen == 0)
+		return false;
+	// Accessing pages past the end of the file would fault
+	struct stat st;
+	if (fstat(fileno(file), &st) != 0 || st.st_size < (off_t)len)
+		return false;
+	std::unique_lock<std::mutex> lock(romsMutex);
+	void *p = mmap(ptr + offset, mapLen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fileno(file), 0);
+	if (p == MAP_FAILED)
+	{
+		WARN_LOG(NAOMI, "ROM file mapping failed: errno %d", errno);
+		// The region may have been unmapped
+		p = mmap(ptr + offset, mapLen, PROT_NONE, MAP_PRIVATE | MAP_ANON | MAP_FIXED, -1, 0);
+		verify(p != MAP_FAILED);
+		setCommitted(offset, mapLen, false);
+		return false;
+	}
+	setCommitted(offset, mapLen, true);
+	lock.unlock();
+	if (mapLen < len)
+	{
+		// read() doesn't trigger the fault handler
+		commit(offset + mapLen, len - mapLen);
+		if (fseek(file, mapLen, SEEK_SET) != 0 || fread(ptr + offset + mapLen, 1, len - mapLen, file) != len - mapLen)
+		{
+			WARN_LOG(NAOMI, "ROM file read failed: errno %d", errno);
+			fseek(file, 0, SEEK_SET);
+			lock.lock();
+			p = mmap(ptr + offset, mapLen, PROT_NONE, MAP_PRIVATE | MAP_ANON | MAP_FIXED, -1, 0);
+			verify(p != MAP_FAILED);
+			setCommitted(offset, mapLen, false);
+			return false;
+		}
+	}
+	mapped += mapLen;
+	return true;
+
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,54 @@
+/*
+	Memory backing a Naomi/Atomiswave cartridge ROM.
+
+	The memory is reserved from the OS and reads as 0xff until written. Where mapping is available,
+	pages are made accessible and filled by the fault handler on first access (see pageFault) so that
+	the unused parts of a large ROM never become resident.
+	Uncompressed ROM files can be mapped directly in it with copy-on-write semantics: pages are
+	only read from disk when first accessed, are shared with the OS file cache, and patching them
+	doesn't modify the file. Files that can't be mapped must be read into data().
+	Mapping is available on POSIX platforms (any page-aligned offset) and on Windows (whole ROM only).
+*/
+#pragma once
+#include "types.h"
+#include <vector>
+
+class RomMemory
+{
+public:
+	RomMemory(u32 size);
+	~RomMemory();
+	RomMemory(const RomMemory&) = delete;
+	RomMemory& operator=(const RomMemory&) = delete;
+
+	u8 *data() const { return ptr; }
+	u32 size() const { return romSize; }
+	// Bytes of the ROM backed by files
+	u32 mappedSize() const { return mapped; }
+
+	// Maps the first len bytes of the file at the given ROM offset. A partial last page is read instead.
+	// Returns false if the file can't be mapped there.
+	bool mapFile(FILE *file, u32 offset, u32 len);
+	// Makes the pages covering the given range accessible, filling the new ones with 0xff.
+	// Must be called before the range is written by a system call such as read(), which fails
+	// instead of faulting.
+	void commit(size_t offset, size_t len);
+
+	// Called by the fault handler. Fills the page range containing the address if it belongs to
+	// a ROM and hasn't been accessed yet. Returns false otherwise.
+	static bool pageFault(void *address);
+
+private:
+	void setCommitted(size_t offset, size_t len, bool value);
+
+	u8 *ptr = nullptr;
+	u32 romSize;
+	size_t allocSize;
+	u32 mapped = 0;
+	size_t page;
+	// Committed pages. Empty when the memory is filled at allocation.
+	std::vector<bool> committed;
+#ifdef _WIN32
+	void *view = nullptr;
+#endif
+};
@@ -46,7 +46,7 @@ static bool rend_frame(TA_context* ctx)
 	if (!proc || (!ctx->rend.isRTT && !ctx->rend.isRenderFramebuffer))
 		// If rendering to texture, continue locking until the frame is rendered
 		re.Set();
-	rend_allow_rollback();
+	FrameProcessed(ctx);
 
 	return proc && renderer->Render();
 }
@@ -115,14 +115,21 @@ Renderer* rend_OITVulkan();
 Renderer* rend_DirectX9();
 Renderer* rend_DirectX11();
 Renderer* rend_OITDirectX11();
+Renderer* rend_softrend();
 
 static void rend_create_renderer()
 {
 #ifdef NO_REND
-	renderer	 = rend_norend();
+	if (config::RendererType == RenderType::Software)
+		renderer = rend_softrend();
+	else
+		renderer = rend_norend();
 #else
 	switch (config::RendererType)
 	{
+	case RenderType::Software:
+		renderer = rend_softrend();
+		break;
 	default:
 #ifdef USE_OPENGL
 	case RenderType::OpenGL:
@@ -179,7 +186,8 @@ void rend_term_renderer()
 
 void rend_reset()
 {
-	FinishRender(DequeueRender());
+	for (TA_context *ctx = DequeueRender(); ctx != nullptr; ctx = DequeueRender())
+		FinishRender(ctx);
 	do_swap = false;
 	render_called = false;
 	pend_rend = false;
@@ -188,6 +196,22 @@ void rend_reset()
 	fb_w_cur = 1;
 }
 
+void rend_fill_context(TA_context *ctx)
+{
+	FillBGP(ctx);
+
+	ctx->rend.isRTT = (FB_W_SOF1 & 0x1000000) != 0;
+	ctx->rend.fb_W_SOF1 = FB_W_SOF1;
+	ctx->rend.fb_W_CTRL.full = FB_W_CTRL.full;
+
+	ctx->rend.fb_X_CLIP = FB_X_CLIP;
+	ctx->rend.fb_Y_CLIP = FB_Y_CLIP;
+	ctx->rend.fb_W_LINESTRIDE = FB_W_LINESTRIDE.stride;
+
+	ctx->rend.fog_clamp_min = FOG_CLAMP_MIN;
+	ctx->rend.fog_clamp_max = FOG_CLAMP_MAX;
+}
+
 void rend_start_render(TA_context *ctx)
 {
 	render_called = true;
@@ -230,20 +254,7 @@ void rend_start_render(TA_context *ctx)
 			ctx->rend.fog_clamp_max.full = 0xffffffff;
 		}
 		else
-		{
-			FillBGP(ctx);
-
-			ctx->rend.isRTT = (FB_W_SOF1 & 0x1000000) != 0;
-			ctx->rend.fb_W_SOF1 = FB_W_SOF1;
-			ctx->rend.fb_W_CTRL.full = FB_W_CTRL.full;
-
-			ctx->rend.fb_X_CLIP = FB_X_CLIP;
-			ctx->rend.fb_Y_CLIP = FB_Y_CLIP;
-			ctx->rend.fb_W_LINESTRIDE = FB_W_LINESTRIDE.stride;
-
-			ctx->rend.fog_clamp_min = FOG_CLAMP_MIN;
-			ctx->rend.fog_clamp_max = FOG_CLAMP_MAX;
-		}
+			rend_fill_context(ctx);
 
 		if (!config::DelayFrameSwapping && !ctx->rend.isRTT)
 			ggpo::endOfFrame();
@@ -9,6 +9,8 @@ void rend_init_renderer();
 void rend_term_renderer();
 void rend_vblank();
 void rend_start_render(TA_context *ctx = nullptr);
+// Sets the background polygon, framebuffer and fog parameters of a frame from the PVR registers
+void rend_fill_context(TA_context *ctx);
 void rend_end_render();
 void rend_cancel_emu_wait();
 bool rend_single_frame(const bool& enabled);
@@ -14,6 +14,8 @@
 static u32 pvr_map32(u32 offset32);
 
 VArray2 vram;
+std::atomic<bool> vramDirtyTracking;
+std::atomic<u64> vramDirtyPages[VRAM_SIZE_MAX / PAGE_SIZE / 64];
 
 // YUV converter code
 static SQBuffer YUV_tempdata[512 / sizeof(SQBuffer)];	// 512 bytes
@@ -106,6 +108,7 @@ static INLINE void YUV_ConvertMacroBlock(const u8 *datap)
 	TA_YUV_TEX_CNT++;
 
 	YUV_Block384(datap, vram.data + YUV_dest);
+	VramMarkDirty(YUV_dest, 15 * YUV_x_size * 2 + 16 * 2);
 
 	YUV_dest+=32;
 
@@ -225,7 +228,9 @@ void DYNACALL pvr_write32p(u32 addr, T data)
 	if (vaddr >= fb_watch_addr_start && vaddr < fb_watch_addr_end)
 		fb_dirty = true;
 
-	*(T *)&vram[pvr_map32(addr)] = data;
+	u32 offset = pvr_map32(addr);
+	*(T *)&vram[offset] = data;
+	VramMarkDirty(offset, sizeof(T));
 }
 template void pvr_write32p<u8>(u32 addr, u8 data);
 template void pvr_write32p<u16>(u32 addr, u16 data);
@@ -264,6 +269,7 @@ void DYNACALL TAWriteSQ(u32 address, const SQBuffer *sqb)
 			// 64b path
 			SQBuffer *dest = (SQBuffer *)&vram[address_w & VRAM_MASK];
 			*dest = *sq;
+			VramMarkDirty(address_w, sizeof(SQBuffer));
 		}
 		else
 		{
@@ -318,7 +324,10 @@ void DYNACALL pvr_write_area4(u32 addr, T data)
 	if (access32)
 		pvr_write32p(addr, data);
 	else
+	{
 		*(T*)&vram[addr & VRAM_MASK] = data;
+		VramMarkDirty(addr, sizeof(T));
+	}
 }
 template void pvr_write_area4<u8, false>(u32 addr, u8 data);
 template void pvr_write_area4<u16, false>(u32 addr, u16 data);
@@ -3,9 +3,34 @@
 #include "stdclass.h"
 #include "hw/sh4/sh4_if.h"
 
+#include <atomic>
+
 //vram 32-64b
 extern VArray2 vram;
 
+// VRAM dirty page tracking
+// When enabled (rend.VramDirtyBitmap), the emulated VRAM writes (SH4 32-bit path, store queues,
+// DMAs, YUV converter, render to texture) mark the pages they modify. Other writes are caught
+// by a write fault, after which the page stays unprotected until the next check.
+// The texture cache checks the marked pages once per frame.
+extern std::atomic<bool> vramDirtyTracking;
+extern std::atomic<u64> vramDirtyPages[VRAM_SIZE_MAX / PAGE_SIZE / 64];
+
+static inline void VramMarkDirty(u32 offset, u32 size)
+{
+	if (!vramDirtyTracking.load(std::memory_order_relaxed) || size == 0)
+		return;
+	offset &= VRAM_MASK;
+	u32 last = std::min(offset + size, VRAM_SIZE) - 1;
+	for (u32 page = offset / PAGE_SIZE; page <= last / PAGE_SIZE; page++)
+	{
+		std::atomic<u64>& word = vramDirtyPages[page / 64];
+		u64 bit = 1ull << (page % 64);
+		if ((word.load(std::memory_order_relaxed) & bit) == 0)
+			word.fetch_or(bit, std::memory_order_release);
+	}
+}
+
 //regs
 u32 pvr_ReadReg(u32 addr);
 void pvr_WriteReg(u32 paddr, u32 data);
@@ -4,6 +4,7 @@
 */
 
 #include "pvr_sb_regs.h"
+#include "pvr_mem.h"
 #include "ta.h"
 #include "hw/holly/holly_intc.h"
 #include "hw/holly/sb.h"
@@ -37,8 +38,13 @@ static void do_pvr_dma()
 		//PVR -> System
 		WriteMemBlock_nommu_dma(src, dst, len);
 	else
+	{
 		//System -> PVR
 		WriteMemBlock_nommu_dma(dst,src,len);
+		// Writes to the 32-bit path are tracked by its handler
+		if ((dst & 0x01000000) == 0)
+			VramMarkDirty(dst, len);
+	}
 
 	DMAC_SAR(0) = src + len;
 	DMAC_CHCR(0).TE = 1;
@@ -15,6 +15,8 @@ void DYNACALL ta_vtx_data32(const SQBuffer *data);
 void ta_vtx_data(const SQBuffer *data, u32 size);
 
 bool ta_parse(TA_context *ctx);
+// Time spent building the index buffer during the last ta_parse call, in nanoseconds
+extern u64 ta_index_time;
 
 class TaTypeLut
 {
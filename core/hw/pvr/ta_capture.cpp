@@ -0,0 +1,138 @@
+#include "ta_capture.h"
+#include "ta_ctx.h"
+#include "pvr_mem.h"
+#include "Renderer_if.h"
+#include "archive/rzip.h"
+#include "cfg/option.h"
+#include "stdclass.h"
+
+#include <chrono>
+#include <future>
+#include <memory>
+
+constexpr u32 CAPTURE_MAGIC = 0x46434154;	// TACF
+constexpr u32 CAPTURE_VERSION = 1;
+// Frames between two captures
+constexpr u32 CAPTURE_INTERVAL = 60;
+
+struct CaptureHeader
+{
+	u32 magic;
+	u32 version;
+	u32 platform;
+	u32 pvrRegsSize;
+	u32 vramSize;
+	u32 passCount;
+};
+
+void tacap_Take(TA_context *ctx, TACapture& capture)
+{
+	capture.platform = settings.platform.system;
+	capture.pvrRegs.assign(pvr_regs, pvr_regs + pvr_RegSize);
+	capture.vram.assign(vram.data, vram.data + VRAM_SIZE);
+	capture.passes.clear();
+	for (; ctx != nullptr; ctx = ctx->nextContext)
+		capture.passes.emplace_back(ctx->tad.thd_root, ctx->tad.End());
+}
+
+bool tacap_Save(const std::string& path, const TACapture& capture)
+{
+	RZipFile file;
+	if (!file.Open(path, true))
+	{
+		WARN_LOG(PVR, "Can't create TA capture %s", path.c_str());
+		return false;
+	}
+	CaptureHeader header;
+	header.magic = CAPTURE_MAGIC;
+	header.version = CAPTURE_VERSION;
+	header.platform = capture.platform;
+	header.pvrRegsSize = (u32)capture.pvrRegs.size();
+	header.vramSize = (u32)capture.vram.size();
+	header.passCount = (u32)capture.passes.size();
+	bool success = file.Write(&header, sizeof(header)) == sizeof(header)
+			&& file.Write(capture.pvrRegs.data(), capture.pvrRegs.size()) == capture.pvrRegs.size()
+			&& file.Write(capture.vram.data(), capture.vram.size()) == capture.vram.size();
+	for (const std::vector<u8>& pass : capture.passes)
+	{
+		if (!success)
+			break;
+		u32 size = (u32)pass.size();
+		success = file.Write(&size, sizeof(size)) == sizeof(size)
+				&& file.Write(pass.data(), size) == size;
+	}
+	file.Close();
+	if (!success)
+		WARN_LOG(PVR, "Error writing TA capture %s", path.c_str());
+
+	return success;
+}
+
+bool tacap_Load(const std::string& path, TACapture& capture)
+{
+	RZipFile file;
+	if (!file.Open(path, false))
+	{
+		WARN_LOG(PVR, "Can't open TA capture %s", path.c_str());
+		return false;
+	}
+	CaptureHeader header;
+	if (file.Read(&header, sizeof(header)) != sizeof(header)
+			|| header.magic != CAPTURE_MAGIC || header.version != CAPTURE_VERSION
+			|| header.pvrRegsSize != pvr_RegSize || header.vramSize > 16 * 1024 * 1024
+			|| header.passCount == 0 || header.passCount > MAX_PASSES)
+	{
+		WARN_LOG(PVR, "Invalid TA capture %s", path.c_str());
+		return false;
+	}
+	capture.platform = header.platform;
+	capture.pvrRegs.resize(header.pvrRegsSize);
+	capture.vram.resize(header.vramSize);
+	capture.passes.resize(header.passCount);
+	bool success = file.Read(capture.pvrRegs.data(), header.pvrRegsSize) == header.pvrRegsSize
+			&& file.Read(capture.vram.data(), header.vramSize) == header.vramSize;
+	for (std::vector<u8>& pass : capture.passes)
+	{
+		u32 size;
+		if (!success || file.Read(&size, sizeof(size)) != sizeof(size) || size > TA_DATA_SIZE)
+		{
+			success = false;
+			break;
+		}
+		pass.resize(size);
+		success = file.Read(pass.data(), size) == size;
+	}
+	if (!success)
+		WARN_LOG(PVR, "Error reading TA capture %s", path.c_str());
+
+	return success;
+}
+
+void tacap_FrameQueued(TA_context *ctx)
+{
+	static u32 queuedFrames;
+
+	if (!config::CaptureTAFrames)
+	{
+		queuedFrames = 0;
+		return;
+	}
+	if (ctx->rend.isRenderFramebuffer || settings.platform.isNaomi2())
+		return;
+	if (queuedFrames++ % CAPTURE_INTERVAL != 0)
+		return;
+
+	// Compressing VRAM takes a while so captures are written on a worker thread.
+	// The frame is skipped if the previous one is still being written.
+	static std::future<void> pendingSave;
+	if (pendingSave.valid() && pendingSave.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		return;
+
+	std::shared_ptr<TACapture> capture = std::make_shared<TACapture>();
+	tacap_Take(ctx, *capture);
+	std::string path = get_game_save_prefix() + "_" + std::to_string(FrameCount) + ".tac";
+	pendingSave = std::async(std::launch::async, [capture, path]() {
+		if (tacap_Save(path, *capture))
+			INFO_LOG(PVR, "TA frame captured to %s", path.c_str());
+	});
+}
@@ -0,0 +1,34 @@
+/*
+	TA frame capture.
+
+	A capture holds the TA data of each render pass of a frame, along with the PVR registers
+	(including the palette and fog table) and VRAM as they were when the frame was queued for
+	rendering. This is all ta_parse and the texture cache need to rebuild the rend_context of
+	the frame, so captured frames can be replayed without running the game.
+	Naomi 2 frames aren't captured since their geometry is transformed by the Elan before
+	reaching the TA.
+*/
+#pragma once
+#include "types.h"
+
+#include <string>
+#include <vector>
+
+struct TA_context;
+
+struct TACapture
+{
+	int platform;
+	std::vector<u8> pvrRegs;
+	std::vector<u8> vram;
+	std::vector<std::vector<u8>> passes;	// TA data of each render pass
+};
+
+// Copies the TA data of a frame and the PVR state it depends on
+void tacap_Take(TA_context *ctx, TACapture& capture);
+bool tacap_Save(const std::string& path, const TACapture& capture);
+bool tacap_Load(const std::string& path, TACapture& capture);
+
+// Called when a frame is queued for rendering. Saves a frame every second if rend.CaptureTAFrames is enabled.
+// The frame data is copied and written to disk in the background.
+void tacap_FrameQueued(TA_context *ctx);
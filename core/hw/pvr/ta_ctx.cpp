@@ -1,9 +1,12 @@
 #include "ta_ctx.h"
+#include "ta_capture.h"
 #include "spg.h"
 #include "cfg/option.h"
 #include "Renderer_if.h"
 #include "serialize.h"
 
+#include <deque>
+
 extern u32 fskip;
 extern u32 FrameCount;
 static int RenderCount;
@@ -40,67 +43,143 @@ void SetCurrentTARC(u32 addr)
 	}
 }
 
-TA_context* rqueue;
+// Frames waiting to be rendered, oldest first
+static std::deque<TA_context*> rqueue;
+// Frame being rendered
+static TA_context *rcurrent;
+static std::mutex rqueue_mutex;
+static RenderQueueStats rqueue_stats;
 cResetEvent frame_finished;
 
+static u32 queuedFrames()
+{
+	return (u32)rqueue.size() + (rcurrent != nullptr ? 1 : 0);
+}
+
+// The emulator waits for each frame at end of render, so more than one frame queued
+// behind the one being rendered is never used
+static u32 maxQueuedFrames()
+{
+	return (u32)std::min(std::max(1, (int)config::RenderQueueDepth), 2);
+}
+
+static bool queueFull()
+{
+	std::lock_guard<std::mutex> _(rqueue_mutex);
+	return queuedFrames() >= maxQueuedFrames();
+}
+
 bool QueueRender(TA_context* ctx)
 {
 	verify(ctx != 0);
-	
+	tacap_FrameQueued(ctx);
+
 	bool skipFrame = settings.disableRenderer;
+	bool lowLatency = config::RenderQueuePolicy == 1 && config::ThreadedRendering;
 	if (!skipFrame)
 	{
 		RenderCount++;
 		if (RenderCount % (config::SkipFrame + 1) != 0)
 			skipFrame = true;
-		else if (config::ThreadedRendering && rqueue != nullptr
+		else if (config::ThreadedRendering && !lowLatency && queueFull()
 				&& (config::AutoSkipFrame == 0 || (config::AutoSkipFrame == 1 && SH4FastEnough)))
-			// The previous render hasn't completed yet so we wait.
+		{
+			// The render queue is full so we wait for the oldest frame to complete.
 			// If autoskipframe is enabled (normal level), we only do so if the CPU is running
 			// fast enough over the last frames
+			rqueue_stats.waits++;
 			frame_finished.Wait();
+		}
 	}
 
-	if (skipFrame || rqueue)
+	std::unique_lock<std::mutex> lock(rqueue_mutex);
+	bool full = queuedFrames() >= maxQueuedFrames();
+	if (!skipFrame && full && lowLatency)
+	{
+		// Replace the oldest frame that isn't being rendered yet, unless it renders to a texture
+		for (auto it = rqueue.begin(); it != rqueue.end(); ++it)
+			if (!(*it)->rend.isRTT)
+			{
+				TA_context *dropped = *it;
+				rqueue.erase(it);
+				lock.unlock();
+				tactx_Recycle(dropped);
+				lock.lock();
+				rqueue_stats.drops++;
+				fskip++;
+				full = false;
+				break;
+			}
+	}
+	if (skipFrame || full)
 	{
+		lock.unlock();
 		tactx_Recycle(ctx);
 		if (!settings.disableRenderer)
+		{
 			fskip++;
+			if (!skipFrame)
+				rqueue_stats.drops++;
+		}
 		return false;
 	}
 	// disable net rollbacks until the render thread has processed the frame
 	rend_disable_rollback();
 	frame_finished.Reset();
-	verify(rqueue == nullptr);
-	rqueue = ctx;
-
+	rqueue.push_back(ctx);
+	rqueue_stats.depth = queuedFrames();
+	rqueue_stats.maxDepth = std::max(rqueue_stats.maxDepth, rqueue_stats.depth);
 
 	return true;
 }
 
 TA_context* DequeueRender()
 {
-	if (rqueue != nullptr)
+	std::lock_guard<std::mutex> _(rqueue_mutex);
+	if (rcurrent == nullptr && !rqueue.empty())
+	{
+		rcurrent = rqueue.front();
+		rqueue.pop_front();
 		FrameCount++;
+	}
 
-	return rqueue;
+	return rcurrent;
 }
 
 bool rend_framePending() {
-	return rqueue != nullptr;
+	std::lock_guard<std::mutex> _(rqueue_mutex);
+	return queuedFrames() != 0;
+}
+
+void FrameProcessed(TA_context* ctx)
+{
+	std::lock_guard<std::mutex> _(rqueue_mutex);
+	// net rollbacks stay disabled while queued frames haven't been processed
+	if (rqueue.empty())
+		rend_allow_rollback();
 }
 
 void FinishRender(TA_context* ctx)
 {
 	if (ctx != nullptr)
 	{
-		verify(rqueue == ctx);
-		rqueue = nullptr;
+		{
+			std::lock_guard<std::mutex> _(rqueue_mutex);
+			verify(rcurrent == ctx);
+			rcurrent = nullptr;
+			rqueue_stats.depth = queuedFrames();
+		}
 		tactx_Recycle(ctx);
 	}
 	frame_finished.Set();
 }
 
+RenderQueueStats rend_getQueueStats()
+{
+	std::lock_guard<std::mutex> _(rqueue_mutex);
+	return rqueue_stats;
+}
+
 static std::mutex mtx_pool;
 
 static std::vector<TA_context*> ctx_pool;
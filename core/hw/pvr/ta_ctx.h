@@ -398,8 +398,19 @@ TA_context *tactx_Alloc();
 void SetCurrentTARC(u32 addr);
 bool QueueRender(TA_context* ctx);
 TA_context* DequeueRender();
+// Called by the renderer once a frame has been processed
+void FrameProcessed(TA_context* ctx);
 void FinishRender(TA_context* ctx);
 
+struct RenderQueueStats
+{
+	u32 depth;		// frames queued or being rendered
+	u32 maxDepth;
+	u32 waits;		// times the emulator waited for a free slot
+	u32 drops;		// frames dropped because the queue was full
+};
+RenderQueueStats rend_getQueueStats();
+
 //must be moved to proper header
 void FillBGP(TA_context* ctx);
 bool rend_framePending();
@@ -11,7 +11,9 @@
 #include "cfg/option.h"
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <vector>
 
 #define TACALL DYNACALL
 #ifdef NDEBUG
@@ -1138,12 +1140,10 @@ static bool is_vertex_inf(const Vertex& vtx)
 
 //
 // Create the vertex index, eliminating invalid vertices and merging strips when possible.
+// Indices are appended to the given arena and PolyParam::first is relative to it.
 //
-static void make_index(const List<PolyParam> *polys, int first, int end, bool merge, rend_context* ctx)
+static void make_index(const List<PolyParam> *polys, int first, int end, bool merge, const Vertex *vertices, std::vector<u32>& indices)
 {
-	const u32 *indices = ctx->idx.head();
-	const Vertex *vertices = ctx->verts.head();
-
 	PolyParam *last_poly = nullptr;
 	const PolyParam *end_poly = &polys->head()[end];
 	bool cullingReversed = false;
@@ -1157,17 +1157,17 @@ static void make_index(const List<PolyParam> *polys, int first, int end, bool me
 				&& poly->equivalentIgnoreCullingDirection(*last_poly))
 		{
 			const u32 last_vtx = indices[last_poly->first + last_poly->count - 1];
-			*ctx->idx.Append() = last_vtx;
+			indices.push_back(last_vtx);
 			if (poly->isp.CullMode < 2 || poly->isp.CullMode == last_poly->isp.CullMode)
 			{
 				if (cullingReversed)
-					*ctx->idx.Append() = last_vtx;
+					indices.push_back(last_vtx);
 				cullingReversed = false;
 			}
 			else
 			{
 				if (!cullingReversed)
-					*ctx->idx.Append() = last_vtx;
+					indices.push_back(last_vtx);
 				cullingReversed = true;
 			}
 			dupe_next_vtx = true;
@@ -1176,7 +1176,7 @@ static void make_index(const List<PolyParam> *polys, int first, int end, bool me
 		else
 		{
 			last_poly = poly;
-			first_index = ctx->idx.used();
+			first_index = (int)indices.size();
 			cullingReversed = false;
 		}
 		int last_good_vtx = -1;
@@ -1194,7 +1194,7 @@ static void make_index(const List<PolyParam> *polys, int first, int end, bool me
 						if (last_good_vtx >= 0)
 						{
 							verify(!dupe_next_vtx);
-							*ctx->idx.Append() = last_good_vtx;
+							indices.push_back(last_good_vtx);
 							dupe_next_vtx = true;
 						}
 						break;
@@ -1207,33 +1207,31 @@ static void make_index(const List<PolyParam> *polys, int first, int end, bool me
 				last_good_vtx = poly->first + i;
 				if (dupe_next_vtx)
 				{
-					*ctx->idx.Append() = last_good_vtx;
+					indices.push_back(last_good_vtx);
 					dupe_next_vtx = false;
 				}
-				const u32 count = ctx->idx.used() - first_index;
+				const u32 count = (u32)indices.size() - first_index;
 				if (((i ^ count) & 1) ^ cullingReversed)
-					*ctx->idx.Append() = last_good_vtx;
-				*ctx->idx.Append() = last_good_vtx;
+					indices.push_back(last_good_vtx);
+				indices.push_back(last_good_vtx);
 			}
 		}
 		if (last_poly == poly)
 		{
 			poly->first = first_index;
-			poly->count = ctx->idx.used() - first_index;
+			poly->count = (u32)indices.size() - first_index;
 		}
 		else
 		{
-			last_poly->count = ctx->idx.used() - last_poly->first;
+			last_poly->count = (u32)indices.size() - last_poly->first;
 			poly->count = 0;
 		}
 	}
 }
 
-static void fix_texture_bleeding(const List<PolyParam> *list)
+static void fix_texture_bleeding(const List<PolyParam> *list, const u32 *idx_base, Vertex *vtx_base)
 {
 	const PolyParam *pp_end = list->LastPtr(0);
-	const u32 *idx_base = vd_rc.idx.head();
-	Vertex *vtx_base = vd_rc.verts.head();
 	for (const PolyParam *pp = list->head(); pp != pp_end; pp++)
 	{
 		if (!pp->pcw.Texture || pp->count < 3)
@@ -1275,6 +1273,60 @@ static void fix_texture_bleeding(const List<PolyParam> *list)
 	}
 }
 
+u64 ta_index_time;
+
+//
+// Build the index of the opaque, punch-through and translucent lists in parallel, each one in its own arena,
+// then append them to the context index.
+// Lists don't share any vertex so they can be processed independently.
+//
+static void make_indices(rend_context& rc, bool mergeTranslucent, bool fixBleeding)
+{
+	const auto start = std::chrono::steady_clock::now();
+	static std::vector<u32> arenas[3];
+	List<PolyParam> * const lists[3] { &rc.global_param_op, &rc.global_param_pt, &rc.global_param_tr };
+
+	auto buildList = [&](int list) {
+		std::vector<u32>& indices = arenas[list];
+		indices.clear();
+		int first = 0;
+		for (const RenderPass& pass : rc.render_passes)
+		{
+			int end = list == 0 ? pass.op_count : list == 1 ? pass.pt_count : pass.tr_count;
+			make_index(lists[list], first, end, list != 2 || mergeTranslucent, rc.verts.head(), indices);
+			first = end;
+		}
+		if (fixBleeding)
+			fix_texture_bleeding(lists[list], indices.data(), rc.verts.head());
+	};
+#ifdef _OPENMP
+	const int polyCount = rc.global_param_op.used() + rc.global_param_pt.used() + rc.global_param_tr.used();
+	const int threads = std::max(1, std::min(3, (int)config::MaxThreads));
+#pragma omp parallel for num_threads(threads) schedule(dynamic) if (threads > 1 && polyCount >= 256)
+	for (int list = 0; list < 3; list++)
+		buildList(list);
+#else
+	for (int list = 0; list < 3; list++)
+		buildList(list);
+#endif
+
+	for (int list = 0; list < 3; list++)
+	{
+		const std::vector<u32>& indices = arenas[list];
+		if ((int)indices.size() > rc.idx.avail)
+		{
+			rc.idx.sig_overrun();
+			return;
+		}
+		const u32 base = rc.idx.used();
+		if (!indices.empty())
+			memcpy(rc.idx.Append((int)indices.size()), indices.data(), indices.size() * sizeof(u32));
+		for (PolyParam& pp : *lists[list])
+			pp.first += base;
+	}
+	ta_index_time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
 static bool ta_parse_vdrc(TA_context* ctx)
 {
 	ctx->rend_inuse.lock();
@@ -1285,9 +1337,6 @@ static bool ta_parse_vdrc(TA_context* ctx)
 	ta_parse_reset();
 
 	bool empty_context = true;
-	int op_poly_count = 0;
-	int pt_poly_count = 0;
-	int tr_poly_count = 0;
 
 	PolyParam *bgpp = vd_rc.global_param_op.head();
 	if (bgpp->pcw.Texture)
@@ -1328,20 +1377,12 @@ static bool ta_parse_vdrc(TA_context* ctx)
 
 		if (pass == 0 || !empty_pass)
 		{
+			// Only record the list boundaries of each pass. Indices are built once all passes are decoded.
 			RenderPass *render_pass = vd_rc.render_passes.Append();
 			render_pass->op_count = vd_rc.global_param_op.used();
-			make_index(&vd_rc.global_param_op, op_poly_count,
-					render_pass->op_count, true, &vd_rc);
-			op_poly_count = render_pass->op_count;
 			render_pass->mvo_count = vd_rc.global_param_mvo.used();
 			render_pass->pt_count = vd_rc.global_param_pt.used();
-			make_index(&vd_rc.global_param_pt, pt_poly_count,
-					render_pass->pt_count, true, &vd_rc);
-			pt_poly_count = render_pass->pt_count;
 			render_pass->tr_count = vd_rc.global_param_tr.used();
-			make_index(&vd_rc.global_param_tr, tr_poly_count,
-					render_pass->tr_count, mergeTranslucent, &vd_rc);
-			tr_poly_count = render_pass->tr_count;
 			render_pass->mvo_tr_count = vd_rc.global_param_mvo_tr.used();
 			render_pass->autosort = UsingAutoSort(pass);
 			render_pass->z_clear = ClearZBeforePass(pass);
@@ -1351,15 +1392,11 @@ static bool ta_parse_vdrc(TA_context* ctx)
 	}
 	rv = !empty_context;
 
+	if (!vd_ctx->rend.Overrun)
+		make_indices(vd_rc, mergeTranslucent, config::RenderResolution > 480);
 	bool overrun = vd_ctx->rend.Overrun;
 	if (overrun)
 		WARN_LOG(PVR, "ERROR: TA context overrun");
-	else if (config::RenderResolution > 480)
-	{
-		fix_texture_bleeding(&vd_rc.global_param_op);
-		fix_texture_bleeding(&vd_rc.global_param_pt);
-		fix_texture_bleeding(&vd_rc.global_param_tr);
-	}
 	if (rv && !overrun)
 	{
 		u32 xmin, xmax, ymin, ymax;
@@ -1412,22 +1449,12 @@ static bool ta_parse_naomi2(TA_context* ctx)
 	else
 	{
 		ctx->rend.newRenderPass();
-		int op_count = 0;
-		int pt_count = 0;
-		int tr_count = 0;
 		const bool mergeTranslucent = !config::PerStripSorting
 				|| config::RendererType == RenderType::OpenGL_OIT
 				|| config::RendererType == RenderType::DirectX11_OIT
 				|| config::RendererType == RenderType::Vulkan_OIT;
-		for (const RenderPass& pass : ctx->rend.render_passes)
-		{
-			make_index(&ctx->rend.global_param_op, op_count, pass.op_count, true, &ctx->rend);
-			make_index(&ctx->rend.global_param_pt, pt_count, pass.pt_count, true, &ctx->rend);
-			make_index(&ctx->rend.global_param_tr, tr_count, pass.tr_count, mergeTranslucent, &ctx->rend);
-			op_count = pass.op_count;
-			pt_count = pass.pt_count;
-			tr_count = pass.tr_count;
-		}
+		make_indices(ctx->rend, mergeTranslucent, false);
+		overrun = ctx->rend.Overrun;
 
 		u32 xmin, xmax, ymin, ymax;
 		getRegionTileClipping(xmin, xmax, ymin, ymax);
@@ -0,0 +1,286 @@
+/*
+	Background SH4 block decoder
+*/
+#include "bgcompiler.h"
+
+#if FEAT_SHREC != DYNAREC_NONE
+#include "blockmanager.h"
+#include "blockcache.h"
+#include "hw/sh4/sh4_core.h"
+#include "hw/sh4/sh4_interpreter.h"
+#include "hw/sh4/sh4_mem.h"
+#include "hw/sh4/modules/mmu.h"
+#include "cfg/option.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+void AnalyseBlock(RuntimeBlockInfo* blk, bool optimize = true);
+
+constexpr size_t MAX_QUEUED_BLOCKS = 256;
+constexpr size_t MAX_DECODED_BLOCKS = 4096;
+// Guest memory copied for each queued block. Longer blocks are decoded synchronously.
+constexpr u32 SNAPSHOT_PAGES = 2;
+
+// The worker only reads the guest code and page protection state copied by the emulation thread.
+// bgc_Take checks that they haven't changed since.
+struct QueuedBlock
+{
+	u64 key;
+	CodeSnapshot code;
+	// whether the block is protectable if its last page is the first or second one
+	bool protectable[SNAPSHOT_PAGES];
+};
+
+struct DecodedBlock
+{
+	u32 sh4_code_size;
+	u32 guest_cycles;
+	u32 guest_opcodes;
+	u32 BranchBlock;
+	u32 NextBlock;
+	BlockEndType BlockType;
+	bool has_fpu_op;
+	bool has_jcond;
+	bool read_only;
+	bool reads_code_pages;
+	u64 codeHash;
+	u64 pageHash;
+	std::vector<shil_opcode> oplist;
+};
+
+// Only used to run the decoder and optimizer
+struct DecoderBlock : RuntimeBlockInfo
+{
+	u32 Relink() override { return 0; }
+	void Relocate(void* dst) override { }
+	// Prevents the base destructor from updating the protected/unprotected block counts
+	~DecoderBlock() override { sh4_code_size = 0; }
+};
+
+static std::thread thread;
+static std::mutex mutex;
+static std::condition_variable cond;
+static bool running;
+static std::deque<QueuedBlock> queue;
+static std::unordered_set<u64> pending;
+static std::unordered_map<u64, DecodedBlock> decoded;
+static BackgroundCompilerStats stats;
+
+static u64 blockKey(u32 addr, u32 fpu_cfg)
+{
+	return ((u64)addr << 32) | (fpu_cfg & BLOCK_FPU_CFG_MASK);
+}
+
+static bool decodeBlock(QueuedBlock& entry, DecodedBlock& result)
+{
+	DecoderBlock block;
+	block.vaddr = block.addr = (u32)(entry.key >> 32);
+	block.fpu_cfg.full = (u32)entry.key;
+	block.sh4_code_size = 0;
+	block.guest_cycles = block.guest_opcodes = block.host_opcodes = 0;
+	block.BranchBlock = NullAddress;
+	block.NextBlock = NullAddress;
+	block.BlockType = BET_SCL_Intr;
+	block.has_fpu_op = false;
+	block.has_jcond = false;
+	block.reads_code_pages = false;
+	block.temp_block = false;
+	block.read_only = false;
+
+	try {
+		if (!dec_DecodeBlock(&block, SH4_TIMESLICE / 2, true) || entry.code.outOfRange)
+			return false;
+	} catch (...) {
+		return false;
+	}
+	u32 lastPage = ((block.addr & PAGE_MASK) + block.sh4_code_size - 1) / PAGE_SIZE;
+	if (block.sh4_code_size == 0 || lastPage >= SNAPSHOT_PAGES)
+		return false;
+	// Optimizations depend on the page protection, which is checked again when the block is used
+	block.read_only = entry.protectable[lastPage];
+	// Hash what the optimizer is going to read
+	const std::vector<u8>& pages = entry.code.data;
+	if (!bc_HashBlock(pages.data(), (u32)pages.size(), block.addr, block.sh4_code_size, block.read_only, result.codeHash, result.pageHash))
+		return false;
+	AnalyseBlock(&block);
+	if (entry.code.outOfRange)
+		return false;
+
+	result.sh4_code_size = block.sh4_code_size;
+	result.guest_cycles = block.guest_cycles;
+	result.guest_opcodes = block.guest_opcodes;
+	result.BranchBlock = block.BranchBlock;
+	result.NextBlock = block.NextBlock;
+	result.BlockType = block.BlockType;
+	result.has_fpu_op = block.has_fpu_op;
+	result.has_jcond = block.has_jcond;
+	result.read_only = block.read_only;
+	result.reads_code_pages = block.reads_code_pages;
+	result.oplist = std::move(block.oplist);
+
+	return true;
+}
+
+static void compileThread()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (running)
+	{
+		if (queue.empty())
+		{
+			cond.wait(lock);
+			continue;
+		}
+		QueuedBlock entry = std::move(queue.front());
+		queue.pop_front();
+		const u64 key = entry.key;
+		lock.unlock();
+
+		DecodedBlock result;
+		dec_SetCodeSnapshot(&entry.code);
+		bool success = decodeBlock(entry, result);
+		dec_SetCodeSnapshot(nullptr);
+
+		lock.lock();
+		if (pending.erase(key) == 0)
+			// reset while decoding
+			continue;
+		if (success && decoded.size() < MAX_DECODED_BLOCKS)
+		{
+			decoded[key] = std::move(result);
+			stats.decoded++;
+		}
+	}
+}
+
+static bool enabled()
+{
+	return config::DynarecBackgroundCompile && !mmu_enabled();
+}
+
+static void enqueue(u32 addr, u32 fpu_cfg)
+{
+	if (addr == NullAddress || !IsOnRam(addr) || bm_GetBlock(addr))
+		return;
+	u64 key = blockKey(addr, fpu_cfg);
+	if (queue.size() >= MAX_QUEUED_BLOCKS || decoded.count(key) != 0 || !pending.insert(key).second)
+		return;
+	QueuedBlock entry;
+	entry.key = key;
+	entry.code.addr = addr & ~PAGE_MASK;
+	u32 pages = std::min(SNAPSHOT_PAGES, (RAM_SIZE - (addr & RAM_MASK & ~PAGE_MASK)) / PAGE_SIZE);
+	const u8 *mem = GetMemPtr(entry.code.addr, pages * PAGE_SIZE);
+	entry.code.data.assign(mem, mem + pages * PAGE_SIZE);
+	DecoderBlock block;
+	block.addr = addr;
+	for (u32 i = 0; i < SNAPSHOT_PAGES; i++)
+	{
+		block.sh4_code_size = (i + 1) * PAGE_SIZE - (addr & PAGE_MASK);
+		entry.protectable[i] = block.IsProtectable();
+	}
+	queue.push_back(std::move(entry));
+	stats.queued++;
+}
+
+void bgc_Enqueue(const RuntimeBlockInfo* block)
+{
+	if (!enabled() || block->temp_block)
+		return;
+	{
+		std::lock_guard<std::mutex> _(mutex);
+		if (!running)
+		{
+			running = true;
+			thread = std::thread(compileThread);
+		}
+		enqueue(block->BranchBlock, block->fpu_cfg.full);
+		enqueue(block->NextBlock, block->fpu_cfg.full);
+	}
+	cond.notify_one();
+}
+
+bool bgc_Take(RuntimeBlockInfo* block)
+{
+	if (!enabled())
+		return false;
+	DecodedBlock entry;
+	{
+		std::lock_guard<std::mutex> _(mutex);
+		auto it = decoded.find(blockKey(block->addr, block->fpu_cfg.full));
+		if (it == decoded.end())
+		{
+			stats.sync++;
+			return false;
+		}
+		entry = std::move(it->second);
+		decoded.erase(it);
+	}
+	// The block must be decoded to raise the FPU disabled exception
+	if (entry.has_fpu_op && sr.FD == 1)
+	{
+		stats.sync++;
+		return false;
+	}
+	u64 codeHash, pageHash;
+	block->sh4_code_size = entry.sh4_code_size;
+	if (!bc_HashBlock(block->addr, entry.sh4_code_size, entry.read_only, codeHash, pageHash)
+			|| codeHash != entry.codeHash || pageHash != entry.pageHash
+			|| block->IsProtectable() != entry.read_only)
+	{
+		block->sh4_code_size = 0;
+		stats.stale++;
+		return false;
+	}
+	block->guest_cycles = entry.guest_cycles;
+	block->guest_opcodes = entry.guest_opcodes;
+	block->BranchBlock = entry.BranchBlock;
+	block->NextBlock = entry.NextBlock;
+	block->BlockType = entry.BlockType;
+	block->has_fpu_op = entry.has_fpu_op;
+	block->has_jcond = entry.has_jcond;
+	block->reads_code_pages = entry.reads_code_pages;
+	block->oplist = std::move(entry.oplist);
+	stats.used++;
+
+	return true;
+}
+
+void bgc_Reset()
+{
+	std::lock_guard<std::mutex> _(mutex);
+	queue.clear();
+	pending.clear();
+	decoded.clear();
+}
+
+const BackgroundCompilerStats& bgc_GetStats()
+{
+	return stats;
+}
+
+void bgc_Init()
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+void bgc_Term()
+{
+	{
+		std::lock_guard<std::mutex> _(mutex);
+		running = false;
+	}
+	cond.notify_one();
+	if (thread.joinable())
+		thread.join();
+	bgc_Reset();
+	if (stats.queued != 0)
+		INFO_LOG(DYNAREC, "Background compiler: %d queued, %d decoded, %d used, %d stale, %d decoded synchronously",
+				stats.queued, stats.decoded, stats.used, stats.stale, stats.sync);
+}
+
+#endif	// FEAT_SHREC != DYNAREC_NONE
@@ -0,0 +1,33 @@
+/*
+	Background SH4 block decoder.
+
+	When a block is compiled, its static successors are queued and decoded and optimized
+	on a worker thread. When the emulation thread later misses on one of them, only the
+	host code generation is left to do. Code emission and block registration stay on the
+	emulation thread so the code cache and block manager need no locking.
+*/
+#pragma once
+#include "types.h"
+
+struct RuntimeBlockInfo;
+
+struct BackgroundCompilerStats
+{
+	u32 queued;
+	u32 decoded;
+	u32 used;		// decoded blocks used by the emulation thread
+	u32 stale;		// decoded blocks rejected because the guest code changed
+	u32 sync;		// blocks decoded on the emulation thread
+};
+
+void bgc_Init();
+void bgc_Term();
+// Drops all queued and decoded blocks
+void bgc_Reset();
+
+// Queues the static successors of a block that aren't compiled yet
+void bgc_Enqueue(const RuntimeBlockInfo* block);
+// Fills the block decoding info and oplist if it's been decoded in the background
+bool bgc_Take(RuntimeBlockInfo* block);
+
+const BackgroundCompilerStats& bgc_GetStats();
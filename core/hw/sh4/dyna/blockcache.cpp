@@ -0,0 +1,315 @@
+/*
+	Persistent SH4 block cache.
+
+	Decoding and SSA optimization of hot blocks is redone on every boot. This cache keeps the
+	post-SSA oplist of each block on disk, per game, so that the next boot only needs to
+	validate the guest code and run the host code generator.
+*/
+#include "blockcache.h"
+
+#if FEAT_SHREC != DYNAREC_NONE
+#include "blockmanager.h"
+#include "hw/sh4/sh4_core.h"
+#include "hw/sh4/sh4_mem.h"
+#include "hw/sh4/modules/mmu.h"
+#include "cfg/option.h"
+#include "emulator.h"
+#include "stdclass.h"
+
+#include <unordered_map>
+#include <xxhash.h>
+
+constexpr u32 CACHE_MAGIC = 0x43424346;	// FCBC
+constexpr u32 CACHE_VERSION = 3;
+constexpr size_t CACHE_MAX_BLOCKS = 65536;
+
+struct CacheFileHeader
+{
+	u32 magic;
+	u32 version;
+	u32 opcodeSize;		// sizeof(shil_opcode), changes with the build
+	u32 idleSkip;
+	float downclock;
+	u32 safeMode;
+	u32 floatHack;
+	u32 traceFormation;
+	u32 blockCount;
+};
+
+struct CachedBlockInfo
+{
+	u32 addr;
+	u32 fpu_cfg;
+	u32 sh4_code_size;
+	u32 guest_cycles;
+	u32 guest_opcodes;
+	u32 BranchBlock;
+	u32 NextBlock;
+	u32 BlockType;
+	u8 has_fpu_op;
+	u8 has_jcond;
+	u8 read_only;
+	u8 reads_code_pages;
+	u32 opcodeCount;
+	u64 codeHash;		// guest code of the block
+	u64 pageHash;		// pages spanned by the block. Only for read-only blocks
+};
+
+struct CachedBlock
+{
+	CachedBlockInfo info;
+	std::vector<shil_opcode> oplist;
+};
+
+static std::unordered_map<u64, CachedBlock> blockCache;
+static BlockCacheStats stats;
+static bool cacheDirty;
+static std::string cachePath;
+
+static u64 cacheKey(u32 addr, u32 fpu_cfg)
+{
+	return ((u64)addr << 32) | (fpu_cfg & BLOCK_FPU_CFG_MASK);
+}
+
+static bool cacheEnabled()
+{
+	return config::DynarecBlockCache && !mmu_enabled() && !settings.content.gameId.empty();
+}
+
+static float downclockRatio()
+{
+#ifdef __vita__
+	return config::DynarecDownclock;
+#else
+	return 1.f;
+#endif
+}
+
+static bool floatHack()
+{
+#ifdef __vita__
+	return config::DynarecFloatHack;
+#else
+	return false;
+#endif
+}
+
+bool bc_HashBlock(const u8 *pages, u32 pagesSize, u32 addr, u32 size, bool read_only, u64& codeHash, u64& pageHash)
+{
+	if (size == 0 || !IsOnRam(addr))
+		return false;
+	u32 pagesSpanned = (((addr & PAGE_MASK) + size - 1) | PAGE_MASK) + 1;
+	if (pagesSpanned > pagesSize)
+		return false;
+	codeHash = XXH64(pages + (addr & PAGE_MASK), size, 7);
+	// The const prop and single branch target passes read memory in the block pages if the block is read-only
+	pageHash = read_only ? XXH64(pages, pagesSpanned, 7) : 0;
+
+	return true;
+}
+
+bool bc_HashBlock(u32 addr, u32 size, bool read_only, u64& codeHash, u64& pageHash)
+{
+	if (!IsOnRam(addr))
+		return false;
+	u32 pageStart = addr & RAM_MASK & ~PAGE_MASK;
+	return bc_HashBlock(&mem_b[pageStart], RAM_SIZE - pageStart, addr, size, read_only, codeHash, pageHash);
+}
+
+bool bc_Lookup(RuntimeBlockInfo* block)
+{
+	if (!cacheEnabled())
+		return false;
+	auto it = blockCache.find(cacheKey(block->addr, block->fpu_cfg.full));
+	if (it == blockCache.end())
+	{
+		stats.misses++;
+		return false;
+	}
+	const CachedBlockInfo& info = it->second.info;
+	// The block must be decoded to raise the FPU disabled exception
+	if (info.has_fpu_op && sr.FD == 1)
+	{
+		stats.misses++;
+		return false;
+	}
+	u64 codeHash, pageHash;
+	block->sh4_code_size = info.sh4_code_size;
+	if (!bc_HashBlock(info.addr, info.sh4_code_size, info.read_only, codeHash, pageHash)
+			|| codeHash != info.codeHash || pageHash != info.pageHash
+			|| block->IsProtectable() != (bool)info.read_only)
+	{
+		block->sh4_code_size = 0;
+		stats.validation_failures++;
+		blockCache.erase(it);
+		cacheDirty = true;
+		return false;
+	}
+	block->guest_cycles = info.guest_cycles;
+	block->guest_opcodes = info.guest_opcodes;
+	block->BranchBlock = info.BranchBlock;
+	block->NextBlock = info.NextBlock;
+	block->BlockType = (BlockEndType)info.BlockType;
+	block->has_fpu_op = info.has_fpu_op;
+	block->has_jcond = info.has_jcond;
+	block->reads_code_pages = info.reads_code_pages;
+	block->oplist = it->second.oplist;
+	stats.hits++;
+
+	return true;
+}
+
+void bc_Store(const RuntimeBlockInfo* block)
+{
+	if (!cacheEnabled() || block->oplist.empty())
+		return;
+	if (blockCache.size() >= CACHE_MAX_BLOCKS)
+		return;
+	CachedBlock entry;
+	CachedBlockInfo& info = entry.info;
+	memset(&info, 0, sizeof(info));
+	if (!bc_HashBlock(block->addr, block->sh4_code_size, block->read_only, info.codeHash, info.pageHash))
+		return;
+	info.addr = block->addr;
+	info.fpu_cfg = block->fpu_cfg.full & BLOCK_FPU_CFG_MASK;
+	info.sh4_code_size = block->sh4_code_size;
+	info.guest_cycles = block->guest_cycles;
+	info.guest_opcodes = block->guest_opcodes;
+	info.BranchBlock = block->BranchBlock;
+	info.NextBlock = block->NextBlock;
+	info.BlockType = block->BlockType;
+	info.has_fpu_op = block->has_fpu_op;
+	info.has_jcond = block->has_jcond;
+	info.read_only = block->read_only;
+	info.reads_code_pages = block->reads_code_pages;
+	info.opcodeCount = block->oplist.size();
+	entry.oplist = block->oplist;
+	blockCache[cacheKey(info.addr, info.fpu_cfg)] = std::move(entry);
+	stats.stored++;
+	cacheDirty = true;
+}
+
+void bc_Clear()
+{
+	blockCache.clear();
+	cacheDirty = false;
+	cachePath.clear();
+	memset(&stats, 0, sizeof(stats));
+}
+
+void bc_Load()
+{
+	bc_Clear();
+	if (!cacheEnabled())
+		return;
+	cachePath = get_game_save_prefix() + ".blkcache";
+	FILE *f = nowide::fopen(cachePath.c_str(), "rb");
+	if (f == nullptr)
+		return;
+	CacheFileHeader header;
+	if (std::fread(&header, sizeof(header), 1, f) != 1
+			|| header.magic != CACHE_MAGIC || header.version != CACHE_VERSION
+			|| header.opcodeSize != sizeof(shil_opcode)
+			|| header.idleSkip != (u32)config::DynarecIdleSkip
+			|| header.downclock != downclockRatio()
+			|| header.safeMode != (u32)config::DynarecSafeMode
+			|| header.floatHack != (u32)floatHack()
+			|| header.traceFormation != (u32)config::DynarecTraceFormation)
+	{
+		INFO_LOG(DYNAREC, "Block cache %s is stale. Ignored", cachePath.c_str());
+		std::fclose(f);
+		return;
+	}
+	for (u32 i = 0; i < header.blockCount && blockCache.size() < CACHE_MAX_BLOCKS; i++)
+	{
+		CachedBlock entry;
+		if (std::fread(&entry.info, sizeof(entry.info), 1, f) != 1
+				|| entry.info.opcodeCount == 0 || entry.info.opcodeCount > 511)
+			break;
+		entry.oplist.resize(entry.info.opcodeCount);
+		if (std::fread(entry.oplist.data(), sizeof(shil_opcode), entry.oplist.size(), f) != entry.oplist.size())
+			break;
+		u64 key = cacheKey(entry.info.addr, entry.info.fpu_cfg);
+		blockCache[key] = std::move(entry);
+	}
+	std::fclose(f);
+	stats.loaded = blockCache.size();
+	INFO_LOG(DYNAREC, "Block cache loaded from %s: %d blocks", cachePath.c_str(), stats.loaded);
+}
+
+void bc_Save()
+{
+	if (!cacheDirty || cachePath.empty())
+		return;
+	INFO_LOG(DYNAREC, "Block cache: %d hits, %d misses, %d validation failures, %d blocks stored",
+			stats.hits, stats.misses, stats.validation_failures, stats.stored);
+	FILE *f = nowide::fopen(cachePath.c_str(), "wb");
+	if (f == nullptr)
+	{
+		WARN_LOG(DYNAREC, "Can't save block cache to %s", cachePath.c_str());
+		return;
+	}
+	CacheFileHeader header;
+	header.magic = CACHE_MAGIC;
+	header.version = CACHE_VERSION;
+	header.opcodeSize = sizeof(shil_opcode);
+	header.idleSkip = config::DynarecIdleSkip;
+	header.downclock = downclockRatio();
+	header.safeMode = config::DynarecSafeMode;
+	header.floatHack = floatHack();
+	header.traceFormation = config::DynarecTraceFormation;
+	header.blockCount = blockCache.size();
+	bool success = std::fwrite(&header, sizeof(header), 1, f) == 1;
+	for (const auto& it : blockCache)
+	{
+		if (!success)
+			break;
+		const CachedBlock& entry = it.second;
+		success = std::fwrite(&entry.info, sizeof(entry.info), 1, f) == 1
+				&& std::fwrite(entry.oplist.data(), sizeof(shil_opcode), entry.oplist.size(), f) == entry.oplist.size();
+	}
+	std::fclose(f);
+	if (!success)
+	{
+		WARN_LOG(DYNAREC, "Error writing block cache %s", cachePath.c_str());
+		nowide::remove(cachePath.c_str());
+	}
+	cacheDirty = false;
+}
+
+const BlockCacheStats& bc_GetStats()
+{
+	return stats;
+}
+
+static void emuEventCallback(Event event, void *)
+{
+	switch (event)
+	{
+	case Event::Start:
+		bc_Load();
+		break;
+	case Event::Terminate:
+		bc_Save();
+		bc_Clear();
+		break;
+	default:
+		break;
+	}
+}
+
+void bc_Init()
+{
+	EventManager::listen(Event::Start, emuEventCallback);
+	EventManager::listen(Event::Terminate, emuEventCallback);
+}
+
+void bc_Term()
+{
+	EventManager::unlisten(Event::Start, emuEventCallback);
+	EventManager::unlisten(Event::Terminate, emuEventCallback);
+	bc_Save();
+	bc_Clear();
+}
+
+#endif	// FEAT_SHREC != DYNAREC_NONE
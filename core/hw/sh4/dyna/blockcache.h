@@ -0,0 +1,42 @@
+/*
+	Persistent cache of decoded and optimized SH4 blocks.
+	Entries are keyed by physical address and fpu config, and validated against
+	the current guest code (and data pages for read-only blocks) before being used.
+*/
+#pragma once
+#include "types.h"
+
+struct RuntimeBlockInfo;
+
+// fpscr bits that affect decoding: RM, DN, PR, SZ, FR
+constexpr u32 BLOCK_FPU_CFG_MASK = 0x003C0003;
+
+struct BlockCacheStats
+{
+	u32 hits;
+	u32 misses;
+	u32 validation_failures;
+	u32 stored;
+	u32 loaded;
+};
+
+void bc_Init();
+void bc_Term();
+
+// Load/save the cache file of the current game
+void bc_Load();
+void bc_Save();
+void bc_Clear();
+
+// Fills the block decoding info and oplist from the cache if a valid entry exists
+bool bc_Lookup(RuntimeBlockInfo* block);
+// Adds a freshly decoded and optimized block to the cache
+void bc_Store(const RuntimeBlockInfo* block);
+
+const BlockCacheStats& bc_GetStats();
+
+// Hashes the guest code of a block, and the memory pages it spans if read-only.
+// Returns false if the block isn't entirely in system RAM
+bool bc_HashBlock(u32 addr, u32 size, bool read_only, u64& codeHash, u64& pageHash);
+// Same as above from a copy of the memory starting at the first page of the block
+bool bc_HashBlock(const u8 *pages, u32 pagesSize, u32 addr, u32 size, bool read_only, u64& codeHash, u64& pageHash);
@@ -0,0 +1,130 @@
+/*
+	Flat index of blocks sorted by host code address.
+
+	Blocks are emitted at increasing addresses in the code cache so insertions are nearly
+	always appended. Erased entries are left as tombstones and the table is compacted when
+	they become too numerous, which keeps discards O(log n).
+*/
+#pragma once
+#include <algorithm>
+#include <vector>
+
+template<typename T>
+class CodeAddressIndex
+{
+	struct Entry
+	{
+		const void *start;
+		T value;
+		bool live;
+	};
+
+public:
+	bool empty() const {
+		return liveCount == 0;
+	}
+	size_t size() const {
+		return liveCount;
+	}
+
+	// Returns false if a live entry already exists at this address
+	bool insert(const void *start, const T& value)
+	{
+		auto it = lowerBound(start);
+		if (it != entries.end() && it->start == start)
+		{
+			if (it->live)
+				return false;
+			// Reuse the tombstone
+			it->value = value;
+			it->live = true;
+			tombstones--;
+		}
+		else
+		{
+			entries.insert(it, Entry{ start, value, true });
+		}
+		liveCount++;
+		return true;
+	}
+
+	// Removes the live entry at this exact address and returns its value
+	T erase(const void *start)
+	{
+		auto it = lowerBound(start);
+		if (it == entries.end() || it->start != start || !it->live)
+			return T();
+		T value = std::move(it->value);
+		it->value = T();
+		it->live = false;
+		liveCount--;
+		tombstones++;
+		if (tombstones > 256 && tombstones > liveCount)
+			compact();
+		return value;
+	}
+
+	// Returns the live entry at this exact address, or nullptr
+	const T *findExact(const void *start) const
+	{
+		auto it = lowerBound(start);
+		if (it == entries.end() || it->start != start || !it->live)
+			return nullptr;
+		return &it->value;
+	}
+
+	// Returns the live entry with the highest address lower or equal to ptr, or nullptr.
+	// The caller must check that the entry actually contains ptr.
+	const T *findCandidate(const void *ptr) const
+	{
+		auto it = std::upper_bound(entries.begin(), entries.end(), ptr,
+				[](const void *p, const Entry& e) { return p < e.start; });
+		while (it != entries.begin())
+		{
+			--it;
+			if (it->live)
+				return &it->value;
+		}
+		return nullptr;
+	}
+
+	void clear()
+	{
+		entries.clear();
+		liveCount = 0;
+		tombstones = 0;
+	}
+
+	template<typename F>
+	void forEach(F f) const
+	{
+		for (const Entry& e : entries)
+			if (e.live)
+				f(e.value);
+	}
+
+private:
+	typename std::vector<Entry>::iterator lowerBound(const void *start)
+	{
+		// Fast path for appends
+		if (entries.empty() || entries.back().start < start)
+			return entries.end();
+		return std::lower_bound(entries.begin(), entries.end(), start,
+				[](const Entry& e, const void *p) { return e.start < p; });
+	}
+	typename std::vector<Entry>::const_iterator lowerBound(const void *start) const
+	{
+		return const_cast<CodeAddressIndex *>(this)->lowerBound(start);
+	}
+
+	void compact()
+	{
+		entries.erase(std::remove_if(entries.begin(), entries.end(),
+				[](const Entry& e) { return !e.live; }), entries.end());
+		tombstones = 0;
+	}
+
+	std::vector<Entry> entries;
+	size_t liveCount = 0;
+	size_t tombstones = 0;
+};
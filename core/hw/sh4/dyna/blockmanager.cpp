@@ -4,15 +4,19 @@
 */
 
 #include <algorithm>
-#include <set>
-#include <map>
 #include "blockmanager.h"
+#include "blockcache.h"
+#include "blockindex.h"
 #include "ngen.h"
 
 #include "../sh4_core.h"
 #include "hw/sh4/sh4_mem.h"
 #include "hw/sh4/sh4_opcode_list.h"
 #include "hw/sh4/sh4_sched.h"
+#include "hw/sh4/modules/mmu.h"
+#include "cfg/option.h"
+
+#include <unordered_map>
 
 
 #if defined(__unix__) && defined(DYNA_OPROF)
@@ -24,20 +28,53 @@ op_agent_t          oprofHandle;
 
 
 typedef std::vector<RuntimeBlockInfoPtr> bm_List;
-typedef std::set<RuntimeBlockInfoPtr> bm_Set;
-typedef std::map<void*, RuntimeBlockInfoPtr> bm_Map;
+typedef CodeAddressIndex<RuntimeBlockInfoPtr> bm_Map;
 
-static bm_Set all_temp_blocks;
+static bm_List all_temp_blocks;
 static bm_List del_blocks;
 
 bool unprotected_pages[RAM_SIZE_MAX/PAGE_SIZE];
-static std::set<RuntimeBlockInfo*> blocks_per_page[RAM_SIZE_MAX/PAGE_SIZE];
+// Blocks are only on one or two pages so a small vector is faster than a set
+static std::vector<RuntimeBlockInfo*> blocks_per_page[RAM_SIZE_MAX/PAGE_SIZE];
 
 static bm_Map blkmap;
 // Stats
 u32 protected_blocks;
 u32 unprotected_blocks;
 
+// Sub-page SMC tracking
+// A write to a protected page only discards the blocks overlapping the written cache line.
+// The other blocks of the page are suspended and reactivated without recompiling if their code is unchanged.
+// Blocks whose const prop or single branch target optimizations read data from their pages
+// are only reactivated if the whole pages are unchanged.
+// Pages that fault too often fall back to inline block checks for a while.
+constexpr u32 SMC_LINE_SIZE = 32;
+constexpr u64 SMC_FAULT_WINDOW = SH4_MAIN_CLOCK / 10;
+constexpr u32 SMC_MAX_FAULTS = 8;
+constexpr u32 SMC_MAX_SUSPENDED = 4096;
+constexpr u64 SMC_CHECKED_DURATION = SH4_MAIN_CLOCK * 2;
+
+struct SmcPageState
+{
+	u64 window_start;
+	u64 checked_until;
+	u32 faults;
+};
+struct SuspendedBlock
+{
+	RuntimeBlockInfoPtr block;
+	u64 code_hash;
+	u64 page_hash;
+};
+static SmcPageState smc_pages[RAM_SIZE_MAX/PAGE_SIZE];
+static std::vector<u32> smc_checked_pages;
+static std::unordered_map<u32, SuspendedBlock> suspended_blocks;
+static struct {
+	u32 suspended;
+	u32 reactivated;
+	u32 checked_pages;
+} smc_stats;
+
 #define FPCA(x) ((DynarecCodeEntryPtr&)sh4rcb.fpcb[(x>>1)&FPCB_MASK])
 
 // addr must be a physical address
@@ -121,22 +158,23 @@ RuntimeBlockInfoPtr bm_GetBlock(void* dynarec_code)
 		return NULL;
 
 	void *dynarecrw = CC_RX2RW(dynarec_code);
-	// Returns a block who's code addr is bigger than dynarec_code (or end)
-	auto iter = blkmap.upper_bound(dynarecrw);
-	if (iter == blkmap.begin())
+	// Returns the block with the highest code addr lower or equal to dynarec_code
+	const RuntimeBlockInfoPtr *candidate = blkmap.findCandidate(dynarecrw);
+	if (candidate == nullptr)
 		return NULL;
-	iter--;  // Need to go back to find the potential candidate
 
 	// However it might be out of bounds, check for that
-	if (!iter->second->containsCode(dynarecrw))
+	if (!(*candidate)->containsCode(dynarecrw))
 		return NULL;
 
-	return iter->second;
+	return *candidate;
 }
 
 static void bm_CleanupDeletedBlocks()
 {
 	del_blocks.clear();
+	// Suspended blocks are deleted blocks as well
+	suspended_blocks.clear();
 }
 
 // Takes RX pointer and returns a RW pointer
@@ -157,17 +195,15 @@ RuntimeBlockInfoPtr bm_GetStaleBlock(void* dynarec_code)
 	return NULL;
 }
 
-void bm_AddBlock(RuntimeBlockInfo* blk)
+static void addBlock(const RuntimeBlockInfoPtr& block)
 {
-	RuntimeBlockInfoPtr block(blk);
 	if (block->temp_block)
-		all_temp_blocks.insert(block);
-	auto iter = blkmap.find((void*)blk->code);
-	if (iter != blkmap.end()) {
-		ERROR_LOG(DYNAREC, "DUP: %08X %p %08X %p", iter->second->addr, iter->second->code, block->addr, block->code);
+		all_temp_blocks.push_back(block);
+	if (!blkmap.insert((void*)block->code, block)) {
+		const RuntimeBlockInfoPtr *other = blkmap.findExact((void*)block->code);
+		ERROR_LOG(DYNAREC, "DUP: %08X %p %08X %p", (*other)->addr, (*other)->code, block->addr, block->code);
 		die("Duplicated block");
 	}
-	blkmap[(void*)block->code] = block;
 
 	verify((void*)bm_GetCode(block->addr) == (void*)ngen_FailedToFindBlock);
 	FPCA(block->addr) = (DynarecCodeEntryPtr)CC_RW2RX(block->code);
@@ -188,14 +224,16 @@ void bm_AddBlock(RuntimeBlockInfo* blk)
 
 }
 
-void bm_DiscardBlock(RuntimeBlockInfo* block)
+void bm_AddBlock(RuntimeBlockInfo* blk)
 {
-	// Remove from block map
-	auto it = blkmap.find((void*)block->code);
-	verify(it != blkmap.end());
-	RuntimeBlockInfoPtr block_ptr = it->second;
+	addBlock(RuntimeBlockInfoPtr(blk));
+}
 
-	blkmap.erase(it);
+static RuntimeBlockInfoPtr discardBlock(RuntimeBlockInfo* block)
+{
+	// Remove from block map
+	RuntimeBlockInfoPtr block_ptr = blkmap.erase((void*)block->code);
+	verify(block_ptr != nullptr);
 
 	block_ptr->pNextBlock = NULL;
 	block_ptr->pBranchBlock = NULL;
@@ -206,10 +244,24 @@ void bm_DiscardBlock(RuntimeBlockInfo* block)
 	FPCA(block_ptr->addr) = ngen_FailedToFindBlock;
 
 	if (block_ptr->temp_block)
-		all_temp_blocks.erase(block_ptr);
+	{
+		auto it = std::find(all_temp_blocks.begin(), all_temp_blocks.end(), block_ptr);
+		if (it != all_temp_blocks.end())
+		{
+			*it = std::move(all_temp_blocks.back());
+			all_temp_blocks.pop_back();
+		}
+	}
 
 	del_blocks.push_back(block_ptr);
 	block_ptr->Discard();
+
+	return block_ptr;
+}
+
+void bm_DiscardBlock(RuntimeBlockInfo* block)
+{
+	discardBlock(block);
 }
 
 void bm_Periodical_1s()
@@ -303,9 +355,7 @@ void bm_ResetCache()
 	ngen_ResetBlocks();
 	_vmem_bm_reset();
 
-	for (const auto& it : blkmap)
-	{
-		RuntimeBlockInfoPtr block = it.second;
+	blkmap.forEach([](const RuntimeBlockInfoPtr& block) {
 		block->relink_data = 0;
 		block->pNextBlock = NULL;
 		block->pBranchBlock = NULL;
@@ -314,7 +364,7 @@ void bm_ResetCache()
 		// Avoid circular references
 		block->Discard();
 		del_blocks.push_back(block);
-	}
+	});
 
 	blkmap.clear();
 	// blkmap includes temp blocks as well
@@ -324,6 +374,9 @@ void bm_ResetCache()
 		block_list.clear();
 
 	memset(unprotected_pages, 0, sizeof(unprotected_pages));
+	memset(smc_pages, 0, sizeof(smc_pages));
+	smc_checked_pages.clear();
+	suspended_blocks.clear();
 
 #ifdef DYNA_OPROF
 	if (oprofHandle)
@@ -355,6 +408,7 @@ void bm_ResetTempCache(bool full)
 
 void bm_Init()
 {
+	bc_Init();
 #ifdef DYNA_OPROF
 	oprofHandle=op_open_agent();
 	if (oprofHandle==0)
@@ -371,7 +425,13 @@ void bm_Term()
 	
 	oprofHandle=0;
 #endif
+	bc_Term();
 	bm_Reset();
+	suspended_blocks.clear();
+	if (smc_stats.suspended != 0 || smc_stats.checked_pages != 0)
+		INFO_LOG(DYNAREC, "SMC: %d blocks suspended, %d reactivated, %d pages switched to block checks",
+				smc_stats.suspended, smc_stats.reactivated, smc_stats.checked_pages);
+	memset(&smc_stats, 0, sizeof(smc_stats));
 }
 
 void bm_WriteBlockMap(const std::string& file)
@@ -380,13 +440,11 @@ void bm_WriteBlockMap(const std::string& file)
 	if (f)
 	{
 		INFO_LOG(DYNAREC, "Writing block map !");
-		for (auto& it : blkmap)
-		{
-			RuntimeBlockInfoPtr& block = it.second;
+		blkmap.forEach([f](const RuntimeBlockInfoPtr& block) {
 			fprintf(f, "block: %d:%08X:%p:%d:%d:%d\n", block->BlockType, block->addr, block->code, block->host_code_size, block->guest_cycles, block->guest_opcodes);
 			for(size_t j = 0; j < block->oplist.size(); j++)
 				fprintf(f,"\top: %zd:%d:%s\n", j, block->oplist[j].guest_offs, block->oplist[j].dissasm().c_str());
-		}
+		});
 		fclose(f);
 		INFO_LOG(DYNAREC, "Finished writing block map");
 	}
@@ -394,118 +452,10 @@ void bm_WriteBlockMap(const std::string& file)
 
 void sh4_jitsym(FILE* out)
 {
-	for (const auto& it : blkmap)
-	{
-		const RuntimeBlockInfoPtr& block = it.second;
+	blkmap.forEach([out](const RuntimeBlockInfoPtr& block) {
 		fprintf(out, "%p %d %08X\n", block->code, block->host_code_size, block->addr);
-	}
-}
-
-#if 0
-u32 GetLookup(RuntimeBlockInfo* elem)
-{
-	return elem->lookups;
-}
-
-bool UDgreater ( RuntimeBlockInfo* elem1, RuntimeBlockInfo* elem2 )
-{
-	return elem1->runs > elem2->runs;
-}
-
-bool UDgreater2 ( RuntimeBlockInfo* elem1, RuntimeBlockInfo* elem2 )
-{
-	return elem1->runs*elem1->host_opcodes > elem2->runs*elem2->host_opcodes;
-}
-
-bool UDgreater3 ( RuntimeBlockInfo* elem1, RuntimeBlockInfo* elem2 )
-{
-	return elem1->runs*elem1->host_opcodes/elem1->guest_cycles > elem2->runs*elem2->host_opcodes/elem2->guest_cycles;
-}
-
-void bm_PrintTopBlocks()
-{
-	double total_lups=0;
-	double total_runs=0;
-	double total_cycles=0;
-	double total_hops=0;
-	double total_sops=0;
-
-	for (size_t i=0;i<all_blocks.size();i++)
-	{
-		total_lups+=GetLookup(all_blocks[i]);
-		total_cycles+=all_blocks[i]->runs*all_blocks[i]->guest_cycles;
-		total_hops+=all_blocks[i]->runs*all_blocks[i]->host_opcodes;
-		total_sops+=all_blocks[i]->runs*all_blocks[i]->guest_opcodes;
-		total_runs+=all_blocks[i]->runs;
-	}
-
-	INFO_LOG(DYNAREC, "Total lookups:  %.0fKRuns, %.0fKLuops, Total cycles: %.0fMhz, Total Hops: %.0fMips, Total Sops: %.0fMips!",total_runs/1000,total_lups/1000,total_cycles/1000/1000,total_hops/1000/1000,total_sops/1000/1000);
-	total_hops/=100;
-	total_cycles/=100;
-	total_runs/=100;
-
-	double sel_hops=0;
-	for (size_t i=0;i<(all_blocks.size()/100);i++)
-	{
-		INFO_LOG(DYNAREC, "Block %08X: %p, r: %d (c: %d, s: %d, h: %d) (r: %.2f%%, c: %.2f%%, h: %.2f%%)",
-			all_blocks[i]->addr, all_blocks[i]->code,all_blocks[i]->runs,
-			all_blocks[i]->guest_cycles,all_blocks[i]->guest_opcodes,all_blocks[i]->host_opcodes,
-
-			all_blocks[i]->runs/total_runs,
-			all_blocks[i]->guest_cycles*all_blocks[i]->runs/total_cycles,
-			all_blocks[i]->host_opcodes*all_blocks[i]->runs/total_hops);
-		
-		sel_hops+=all_blocks[i]->host_opcodes*all_blocks[i]->runs;
-	}
-
-	INFO_LOG(DYNAREC, " >-< %.2f%% covered in top 1%% blocks",sel_hops/total_hops);
-
-	size_t i;
-	for (i=all_blocks.size()/100;sel_hops/total_hops<50;i++)
-	{
-		INFO_LOG(DYNAREC, "Block %08X: %p, r: %d (c: %d, s: %d, h: %d) (r: %.2f%%, c: %.2f%%, h: %.2f%%)",
-			all_blocks[i]->addr, all_blocks[i]->code,all_blocks[i]->runs,
-			all_blocks[i]->guest_cycles,all_blocks[i]->guest_opcodes,all_blocks[i]->host_opcodes,
-
-			all_blocks[i]->runs/total_runs,
-			all_blocks[i]->guest_cycles*all_blocks[i]->runs/total_cycles,
-			all_blocks[i]->host_opcodes*all_blocks[i]->runs/total_hops);
-		
-		sel_hops+=all_blocks[i]->host_opcodes*all_blocks[i]->runs;
-	}
-
-	INFO_LOG(DYNAREC, " >-< %.2f%% covered in top %.2f%% blocks",sel_hops/total_hops,i*100.0/all_blocks.size());
-
-}
-
-void bm_Sort()
-{
-	INFO_LOG(DYNAREC, "!!!!!!!!!!!!!!!!!!! BLK REPORT !!!!!!!!!!!!!!!!!!!!");
-
-	INFO_LOG(DYNAREC, "     ---- Blocks: Sorted based on Runs ! ----     ");
-	std::sort(all_blocks.begin(),all_blocks.end(),UDgreater);
-	bm_PrintTopBlocks();
-
-	INFO_LOG(DYNAREC, "<><><><><><><><><><><><><><><><><><><><><><><><><>");
-
-	INFO_LOG(DYNAREC, "     ---- Blocks: Sorted based on hops ! ----     ");
-	std::sort(all_blocks.begin(),all_blocks.end(),UDgreater2);
-	bm_PrintTopBlocks();
-
-	INFO_LOG(DYNAREC, "<><><><><><><><><><><><><><><><><><><><><><><><><>");
-
-	INFO_LOG(DYNAREC, "     ---- Blocks: Sorted based on wefs ! ----     ");
-	std::sort(all_blocks.begin(),all_blocks.end(),UDgreater3);
-	bm_PrintTopBlocks();
-
-	INFO_LOG(DYNAREC, "^^^^^^^^^^^^^^^^^^^ END REPORT ^^^^^^^^^^^^^^^^^^^");
-
-	for (size_t i=0;i<all_blocks.size();i++)
-	{
-		all_blocks[i]->runs=0;
-	}
+	});
 }
-#endif
 
 RuntimeBlockInfo::~RuntimeBlockInfo()
 {
@@ -550,41 +500,144 @@ void RuntimeBlockInfo::Discard()
 		for (u32 addr = this->addr & ~PAGE_MASK; addr < this->addr + this->sh4_code_size; addr += PAGE_SIZE)
 		{
 			auto& block_list = blocks_per_page[(addr & RAM_MASK) / PAGE_SIZE];
-			block_list.erase(this);
+			auto it = std::find(block_list.begin(), block_list.end(), this);
+			if (it != block_list.end())
+			{
+				*it = block_list.back();
+				block_list.pop_back();
+			}
 		}
 	}
 }
 
-void RuntimeBlockInfo::SetProtectedFlags()
+bool RuntimeBlockInfo::IsProtectable() const
 {
 #ifdef TARGET_NO_EXCEPTIONS
-	this->read_only = false;
-	return;
+	return false;
 #endif
 	// Don't write protect rom and BIOS/IP.BIN (Grandia II)
 	if (!IsOnRam(addr) || (addr & 0x1FFF0000) == 0x0c000000)
-	{
-		this->read_only = false;
-		unprotected_blocks++;
-		return;
-	}
+		return false;
 	for (u32 addr = this->addr & ~PAGE_MASK; addr < this->addr + sh4_code_size; addr += PAGE_SIZE)
 	{
 		if (unprotected_pages[(addr & RAM_MASK) / PAGE_SIZE])
-		{
-			this->read_only = false;
-			unprotected_blocks++;
-			return;
-		}
+			return false;
+	}
+	return true;
+}
+
+void RuntimeBlockInfo::SetProtectedFlags()
+{
+	this->read_only = IsProtectable();
+	if (!this->read_only)
+	{
+		unprotected_blocks++;
+		return;
 	}
-	this->read_only = true;
 	protected_blocks++;
+	AddToPages();
+}
+
+void RuntimeBlockInfo::AddToPages()
+{
 	for (u32 addr = this->addr & ~PAGE_MASK; addr < this->addr + sh4_code_size; addr += PAGE_SIZE)
 	{
 		auto& block_list = blocks_per_page[(addr & RAM_MASK) / PAGE_SIZE];
 		if (block_list.empty())
 			bm_LockPage(addr);
-		block_list.insert(this);
+		block_list.push_back(this);
+	}
+}
+
+// Returns false if the page must be unprotected and all its blocks discarded
+static bool smcWriteAccess(u32 addr)
+{
+	SmcPageState& state = smc_pages[addr / PAGE_SIZE];
+	u64 now = sh4_sched_now64();
+	if (now - state.window_start > SMC_FAULT_WINDOW)
+	{
+		state.window_start = now;
+		state.faults = 0;
+	}
+	if (++state.faults > SMC_MAX_FAULTS)
+	{
+		DEBUG_LOG(DYNAREC, "SMC: page %08x switched to block checks", addr & ~PAGE_MASK);
+		state.checked_until = now + SMC_CHECKED_DURATION;
+		smc_checked_pages.push_back(addr / PAGE_SIZE);
+		smc_stats.checked_pages++;
+		return false;
+	}
+	// Blocks are removed from the page while it's unlocked. It will be locked again
+	// when a block is compiled or reactivated on it, after the write has completed.
+	bm_UnlockPage(addr);
+	std::vector<RuntimeBlockInfo*> list_copy(blocks_per_page[addr / PAGE_SIZE]);
+	const u32 line = addr & ~(SMC_LINE_SIZE - 1);
+	for (RuntimeBlockInfo *block : list_copy)
+	{
+		u32 start = block->addr & RAM_MASK;
+		bool overwritten = start < line + SMC_LINE_SIZE && start + block->sh4_code_size > line;
+		u64 codeHash, pageHash;
+		if (overwritten || block->temp_block || suspended_blocks.size() >= SMC_MAX_SUSPENDED
+				|| !bc_HashBlock(block->addr, block->sh4_code_size, block->reads_code_pages, codeHash, pageHash))
+		{
+			bm_DiscardBlock(block);
+		}
+		else
+		{
+			suspended_blocks[block->addr] = { discardBlock(block), codeHash, pageHash };
+			smc_stats.suspended++;
+		}
+	}
+	verify(blocks_per_page[addr / PAGE_SIZE].empty());
+
+	return true;
+}
+
+RuntimeBlockInfo* bm_ReactivateBlock(u32 addr, fpscr_t fpu_cfg)
+{
+	if (suspended_blocks.empty())
+		return nullptr;
+	auto it = suspended_blocks.find(addr);
+	if (it == suspended_blocks.end())
+		return nullptr;
+	SuspendedBlock suspended = std::move(it->second);
+	suspended_blocks.erase(it);
+	RuntimeBlockInfoPtr& block = suspended.block;
+
+	u64 codeHash, pageHash;
+	if (((block->fpu_cfg.full ^ fpu_cfg.full) & BLOCK_FPU_CFG_MASK) != 0
+			|| !block->IsProtectable()
+			|| !bc_HashBlock(block->addr, block->sh4_code_size, block->reads_code_pages, codeHash, pageHash)
+			|| codeHash != suspended.code_hash || pageHash != suspended.page_hash)
+		return nullptr;
+	block->relink_data = 0;
+	addBlock(block);
+	block->AddToPages();
+	smc_stats.reactivated++;
+
+	return block.get();
+}
+
+void bm_UpdateSmcPages()
+{
+	if (smc_checked_pages.empty())
+		return;
+	u64 now = sh4_sched_now64();
+	for (size_t i = 0; i < smc_checked_pages.size(); )
+	{
+		u32 page = smc_checked_pages[i];
+		if (now >= smc_pages[page].checked_until)
+		{
+			// New blocks on this page will be protected again. Existing ones keep their inline checks.
+			unprotected_pages[page] = false;
+			smc_pages[page].faults = 0;
+			smc_checked_pages[i] = smc_checked_pages.back();
+			smc_checked_pages.pop_back();
+		}
+		else
+		{
+			i++;
+		}
 	}
 }
 
@@ -597,13 +650,14 @@ void bm_RamWriteAccess(u32 addr)
 		//die("Fatal error");
 		return;
 	}
+	if (config::DynarecSubPageSMC && !mmu_enabled() && smcWriteAccess(addr))
+		return;
 	unprotected_pages[addr / PAGE_SIZE] = true;
 	bm_UnlockPage(addr);
-	std::set<RuntimeBlockInfo*>& block_list = blocks_per_page[addr / PAGE_SIZE];
+	std::vector<RuntimeBlockInfo*>& block_list = blocks_per_page[addr / PAGE_SIZE];
 	if (!block_list.empty())
 	{
-		std::vector<RuntimeBlockInfo*> list_copy;
-		list_copy.insert(list_copy.begin(), block_list.begin(), block_list.end());
+		std::vector<RuntimeBlockInfo*> list_copy(block_list);
 		if (!list_copy.empty())
 			DEBUG_LOG(DYNAREC, "bm_RamWriteAccess write access to %08x pc %08x", addr, next_pc);
 		for (auto& block : list_copy)
@@ -687,9 +741,7 @@ void print_blocks()
 		INFO_LOG(DYNAREC, "Writing blocks to %p", f);
 	}
 
-	for (auto it : blkmap)
-	{
-		RuntimeBlockInfoPtr blk = it.second;
+	blkmap.forEach([f](const RuntimeBlockInfoPtr& blk) {
 		if (f)
 		{
 			fprintf(f,"block: %p\n",blk.get());
@@ -745,7 +797,7 @@ void print_blocks()
 		}
 
 		blk->runs=0;
-	}
+	});
 
 	if (f) fclose(f);
 }
@@ -35,6 +35,7 @@ struct RuntimeBlockInfo: RuntimeBlockInfo_Core
 	u32 guest_opcodes;
 	u32 host_opcodes;	// set by host code generator, optional
 	bool has_fpu_op;
+	bool reads_code_pages;	// optimizations used data read from the block pages
 	u32 blockcheck_failures;
 	bool temp_block;
 
@@ -70,7 +71,10 @@ struct RuntimeBlockInfo: RuntimeBlockInfo_Core
 	void RemRef(const RuntimeBlockInfoPtr& other);
 
 	void Discard();
+	bool IsProtectable() const;
 	void SetProtectedFlags();
+	// Adds a protected block to the per-page lists and locks its pages
+	void AddToPages();
 
 	bool read_only;
 };
@@ -101,6 +105,10 @@ static inline bool bm_IsRamPageProtected(u32 addr)
 	addr &= RAM_MASK;
 	return !unprotected_pages[addr / PAGE_SIZE];
 }
+// Reactivates a block suspended by a write to its page if its code didn't change
+RuntimeBlockInfo* bm_ReactivateBlock(u32 addr, fpscr_t fpu_cfg);
+// Restores the page protection of pages that stopped faulting
+void bm_UpdateSmcPages();
 void bm_LockPage(u32 addr, u32 size = PAGE_SIZE);
 void bm_UnlockPage(u32 addr, u32 size = PAGE_SIZE);
 u32 bm_getRamOffset(void *p);
@@ -19,8 +19,12 @@
 
 #define BLOCK_MAX_SH_OPS_SOFT 500
 #define BLOCK_MAX_SH_OPS_HARD 511
+// Max distance of a forward bra that is followed when forming traces
+#define TRACE_MAX_JUMP_DISTANCE 256
 
-static RuntimeBlockInfo* blk;
+// Decoder state is per-thread since blocks can be decoded by the background compiler
+static thread_local RuntimeBlockInfo* blk;
+static thread_local CodeSnapshot *codeSnapshot;
 
 static const char idle_hash[] =
        //BIOS
@@ -61,7 +65,7 @@ static inline shil_param mk_regi(int reg)
 	return mk_reg((Sh4RegType)reg);
 }
 
-static state_t state;
+static thread_local state_t state;
 
 static void Emit(shilop op,shil_param rd=shil_param(),shil_param rs1=shil_param(),shil_param rs2=shil_param(),u32 flags=0,shil_param rs3=shil_param(),shil_param rd2=shil_param())
 {
@@ -529,9 +533,57 @@ static void dec_param(DecParam p,shil_param& r1,shil_param& r2, u32 op)
 #define DIV1_KEY 0x3004
 #define ROTCL_KEY 0x4024
 
-static Sh4RegType div_som_reg1;
-static Sh4RegType div_som_reg2;
-static Sh4RegType div_som_reg3;
+static thread_local Sh4RegType div_som_reg1;
+static thread_local Sh4RegType div_som_reg2;
+static thread_local Sh4RegType div_som_reg3;
+
+void dec_SetCodeSnapshot(CodeSnapshot *snapshot)
+{
+	codeSnapshot = snapshot;
+}
+
+const u8 *dec_GetMemPtr(u32 addr, u32 size)
+{
+	if (codeSnapshot == nullptr)
+		return GetMemPtr(addr, size);
+	u32 offset = addr - codeSnapshot->addr;
+	if (offset > codeSnapshot->data.size() || size > codeSnapshot->data.size() - offset)
+	{
+		codeSnapshot->outOfRange = true;
+		return nullptr;
+	}
+	return &codeSnapshot->data[offset];
+}
+
+u16 dec_IReadMem16(u32 addr)
+{
+	if (codeSnapshot == nullptr)
+		return IReadMem16(addr);
+	const u8 *p = dec_GetMemPtr(addr, 2);
+	return p == nullptr ? 0 : *(const u16 *)p;
+}
+
+u32 dec_ReadMem(u32 addr, u32 size)
+{
+	if (codeSnapshot == nullptr)
+	{
+		switch (size)
+		{
+		case 1:
+			return ReadMem8(addr);
+		case 2:
+			return ReadMem16(addr);
+		default:
+			return ReadMem32(addr);
+		}
+	}
+	const u8 *p = dec_GetMemPtr(addr, size);
+	if (p == nullptr)
+		return 0;
+	u32 v = 0;
+	memcpy(&v, p, size);
+	return v;
+}
 
 static u32 MatchDiv32(u32 pc , Sh4RegType &reg1,Sh4RegType &reg2 , Sh4RegType &reg3)
 {
@@ -540,7 +592,7 @@ static u32 MatchDiv32(u32 pc , Sh4RegType &reg1,Sh4RegType &reg2 , Sh4RegType &r
 	u32 match=1;
 	for (int i=0;i<32;i++)
 	{
-		u16 opcode=IReadMem16(v_pc);
+		u16 opcode=dec_IReadMem16(v_pc);
 		v_pc+=2;
 		if ((opcode&MASK_N)==ROTCL_KEY)
 		{
@@ -556,7 +608,7 @@ static u32 MatchDiv32(u32 pc , Sh4RegType &reg1,Sh4RegType &reg2 , Sh4RegType &r
 			break;
 		}
 		
-		opcode=IReadMem16(v_pc);
+		opcode=dec_IReadMem16(v_pc);
 		v_pc+=2;
 		if ((opcode&MASK_N_M)==DIV1_KEY)
 		{
@@ -942,7 +994,25 @@ void dec_updateBlockCycles(RuntimeBlockInfo *block, u16 op)
 	}
 }
 
-bool dec_DecodeBlock(RuntimeBlockInfo* rbi,u32 max_cycles)
+// Can decoding continue at the target of the bra that ended the block?
+// Only short forward jumps are followed (typically over a literal pool) so that the block code
+// stays in the contiguous [vaddr, vaddr + sh4_code_size) range used for write protection and SMC checks.
+static bool dec_CanFollowJump()
+{
+	if (!config::DynarecTraceFormation || mmu_enabled())
+		return false;
+	// bra is the only static jump with a delay slot
+	if (state.BlockType != BET_StaticJump || !state.cpu.is_delayslot)
+		return false;
+	if (state.JumpAddr <= state.cpu.rpc || state.JumpAddr - state.cpu.rpc > TRACE_MAX_JUMP_DISTANCE)
+		return false;
+	// the fpu config of the target might be different
+	if (OpDesc[dec_IReadMem16(state.cpu.rpc - 2)]->SetFPSCR())
+		return false;
+	return true;
+}
+
+bool dec_DecodeBlock(RuntimeBlockInfo* rbi,u32 max_cycles,bool background)
 {
 	blk=rbi;
 	state_Setup(blk->vaddr, blk->fpu_cfg);
@@ -968,14 +1038,14 @@ bool dec_DecodeBlock(RuntimeBlockInfo* rbi,u32 max_cycles)
 				}
 				else
 				{
-					u32 op = IReadMem16(state.cpu.rpc);
+					u32 op = dec_IReadMem16(state.cpu.rpc);
 
 					blk->guest_opcodes++;
 					dec_updateBlockCycles(blk, op);
 
 					if (OpDesc[op]->IsFloatingPoint())
 					{
-						if (sr.FD == 1)
+						if (sr.FD == 1 && !background)
 						{
 							// We need to know FPSCR to compile the block, so let the exception handler run first
 							// as it may change the fp registers
@@ -1013,6 +1083,16 @@ bool dec_DecodeBlock(RuntimeBlockInfo* rbi,u32 max_cycles)
 			break;
 
 		case NDO_End:
+			if (dec_CanFollowJump())
+			{
+				state.cpu.rpc = state.JumpAddr;
+				state.cpu.is_delayslot = false;
+				state.NextOp = NDO_NextOp;
+				state.BlockType = BET_SCL_Intr;
+				state.JumpAddr = NullAddress;
+				state.NextAddr = NullAddress;
+				continue;
+			}
 			// Disabled for now since we need to know if the block is read-only,
 			// which isn't determined until after the decoding.
 			// This is a relatively rare optimization anyway
@@ -38,9 +38,23 @@ enum NextDecoderOperation
 };
 
 struct RuntimeBlockInfo;
-bool dec_DecodeBlock(RuntimeBlockInfo* rbi,u32 max_cycles);
+// background: decoding on another thread. No exception is raised.
+bool dec_DecodeBlock(RuntimeBlockInfo* rbi,u32 max_cycles,bool background = false);
 void dec_updateBlockCycles(RuntimeBlockInfo *block, u16 op);
 
+// Copy of guest memory pages taken by the emulation thread.
+// When set, the decoder and optimizer of the current thread read from it instead of guest memory.
+struct CodeSnapshot
+{
+	u32 addr = 0;			// address of the first page
+	std::vector<u8> data;
+	bool outOfRange = false;	// memory outside of the copy has been read
+};
+void dec_SetCodeSnapshot(CodeSnapshot *snapshot);
+u16 dec_IReadMem16(u32 addr);
+u32 dec_ReadMem(u32 addr, u32 size);
+const u8 *dec_GetMemPtr(u32 addr, u32 size);
+
 struct state_t
 {
 	NextDecoderOperation NextOp;
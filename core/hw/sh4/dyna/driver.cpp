@@ -13,6 +13,9 @@
 #include <cfloat>
 
 #include "blockmanager.h"
+#include "blockcache.h"
+#include "bgcompiler.h"
+#include "jitprofiler.h"
 #include "ngen.h"
 #include "decoder.h"
 
@@ -42,9 +45,34 @@ static u32 *emit_ptr;
 static u32 *emit_ptr_limit;
 
 static std::unordered_set<u32> smc_hotspots;
+// Blocks that reached the tier-up threshold and must be fully optimized
+static std::unordered_set<u32> hot_blocks;
+// Virtual addresses of the baseline blocks that reached the threshold. They are discarded
+// by the dispatcher, once they're not running anymore
+static std::vector<u32> tier_up_blocks;
+// Runs of a baseline block before it's recompiled with all optimizations
+constexpr s32 TIER_UP_RUNS = 100;
 
 static sh4_if sh4Interp;
 
+// Compiled code statistics, since the last cache clear
+static struct {
+	u32 blocks;
+	u64 guest_opcodes;
+	u64 host_code_bytes;
+} compile_stats;
+
+static void print_compile_stats()
+{
+	if (compile_stats.blocks == 0)
+		return;
+	// host_opcodes is only set by the arm backends so use the code size, which all of them set
+	INFO_LOG(DYNAREC, "recSh4: %d blocks compiled, avg %.1f guest ops per block, %.1f host code bytes per guest op", compile_stats.blocks,
+			(double)compile_stats.guest_opcodes / compile_stats.blocks,
+			compile_stats.guest_opcodes == 0 ? 0.0 : (double)compile_stats.host_code_bytes / compile_stats.guest_opcodes);
+	memset(&compile_stats, 0, sizeof(compile_stats));
+}
+
 void* emit_GetCCPtr() { return emit_ptr==0?(void*)&CodeCache[LastAddr]:(void*)emit_ptr; }
 
 static void clear_temp_cache(bool full)
@@ -57,6 +85,7 @@ static void clear_temp_cache(bool full)
 static void recSh4_ClearCache()
 {
 	INFO_LOG(DYNAREC, "recSh4:Dynarec Cache clear at %08X free space %d", next_pc, emit_FreeSpace());
+	print_compile_stats();
 	LastAddr = 0;
 	bm_ResetCache();
 	smc_hotspots.clear();
@@ -92,13 +121,27 @@ u32 emit_FreeSpace()
 		return CODE_SIZE - LastAddr;
 }
 
-void AnalyseBlock(RuntimeBlockInfo* blk);
+void AnalyseBlock(RuntimeBlockInfo* blk, bool optimize = true);
+
+static void addStagingCounter(RuntimeBlockInfo* block)
+{
+	shil_opcode op;
+	op.op = shop_staging;
+	op.Flow = 0;
+	op.flags = 0;
+	op.flags2 = 0;
+	op.rs1 = shil_param(FMT_IMM, block->vaddr);
+	op.host_offs = 0;
+	op.guest_offs = 0;
+	op.delay_slot = false;
+	block->oplist.insert(block->oplist.begin(), op);
+}
 
 const char* RuntimeBlockInfo::hash()
 {
 	XXH32_hash_t hash = 0;
 
-	u8* ptr = GetMemPtr(this->addr, this->sh4_code_size);
+	const u8* ptr = dec_GetMemPtr(this->addr, this->sh4_code_size);
 
 	if (ptr)
 	{
@@ -116,7 +159,7 @@ const char* RuntimeBlockInfo::hash()
 		hash = XXH32_digest(state);
 		XXH32_freeState(state);
 	}
-	static char block_hash[20];
+	static thread_local char block_hash[20];
 	sprintf(block_hash, ">:1:%02X:%08X", this->guest_opcodes, hash);
 
 	return block_hash;
@@ -134,6 +177,7 @@ bool RuntimeBlockInfo::Setup(u32 rpc,fpscr_t rfpu_cfg)
 	NextBlock = NullAddress;
 	BlockType = BET_SCL_Intr;
 	has_fpu_op = false;
+	reads_code_pages = false;
 	temp_block = false;
 	
 	vaddr = rpc;
@@ -152,6 +196,18 @@ bool RuntimeBlockInfo::Setup(u32 rpc,fpscr_t rfpu_cfg)
 	
 	oplist.clear();
 
+	if (bc_Lookup(this))
+	{
+		SetProtectedFlags();
+		return true;
+	}
+	if (bgc_Take(this))
+	{
+		SetProtectedFlags();
+		bc_Store(this);
+		return true;
+	}
+
 	try {
 		if (!dec_DecodeBlock(this, SH4_TIMESLICE / 2))
 			return false;
@@ -162,11 +218,38 @@ bool RuntimeBlockInfo::Setup(u32 rpc,fpscr_t rfpu_cfg)
 	}
 	SetProtectedFlags();
 
-	AnalyseBlock(this);
+	if (config::DynarecTieredCompilation && hot_blocks.count(addr) == 0)
+	{
+		// Baseline compile: skip the SSA passes and count runs
+		AnalyseBlock(this, false);
+		addStagingCounter(this);
+		staging_runs = TIER_UP_RUNS;
+	}
+	else
+	{
+		AnalyseBlock(this);
+		bc_Store(this);
+	}
 
 	return true;
 }
 
+// Discards the blocks that became hot so that they're recompiled on next lookup
+static void tierUpBlocks()
+{
+	for (u32 vaddr : tier_up_blocks)
+	{
+		RuntimeBlockInfoPtr block = bm_GetBlock(vaddr);
+		// discarded or recompiled since
+		if (!block || block->staging_runs != 0)
+			continue;
+		DEBUG_LOG(DYNAREC, "Tier-up block %08x (%08x)", vaddr, block->addr);
+		hot_blocks.insert(block->addr);
+		bm_DiscardBlock(block.get());
+	}
+	tier_up_blocks.clear();
+}
+
 DynarecCodeEntryPtr rdv_CompilePC(u32 blockcheck_failures)
 {
 	u32 pc=next_pc;
@@ -174,6 +257,14 @@ DynarecCodeEntryPtr rdv_CompilePC(u32 blockcheck_failures)
 	if (emit_FreeSpace()<16*1024 || pc==0x8c0000e0 || pc==0xac010000 || pc==0xac008300)
 		recSh4_ClearCache();
 
+	bm_UpdateSmcPages();
+	if (!mmu_enabled())
+	{
+		RuntimeBlockInfo* suspended = bm_ReactivateBlock(pc, fpscr);
+		if (suspended != nullptr)
+			return suspended->code;
+	}
+
 	RuntimeBlockInfo* rbi = ngen_AllocateBlock();
 
 	if (!rbi->Setup(pc,fpscr))
@@ -192,13 +283,18 @@ DynarecCodeEntryPtr rdv_CompilePC(u32 blockcheck_failures)
 		if (rbi->read_only)
 			INFO_LOG(DYNAREC, "WARNING: temp block %x (%x) is protected!", rbi->vaddr, rbi->addr);
 	}
-	bool do_opts = !rbi->temp_block;
-	rbi->staging_runs=do_opts?100:-100;
+	jprof_Instrument(rbi);
+	bool do_opts = !rbi->temp_block && rbi->staging_runs == 0;
 	bool block_check = !rbi->read_only;
 	ngen_Compile(rbi, block_check, (pc & 0xFFFFFF) == 0x08300 || (pc & 0xFFFFFF) == 0x10000, false, do_opts);
 	verify(rbi->code!=0);
+	compile_stats.blocks++;
+	compile_stats.guest_opcodes += rbi->guest_opcodes;
+	compile_stats.host_code_bytes += rbi->host_code_size;
 
 	bm_AddBlock(rbi);
+	bgc_Enqueue(rbi);
+	jprof_BlockCompiled(rbi);
 
 	if (emit_ptr != NULL)
 	{
@@ -218,6 +314,8 @@ DynarecCodeEntryPtr DYNACALL rdv_FailedToFindBlock_pc()
 DynarecCodeEntryPtr DYNACALL rdv_FailedToFindBlock(u32 pc)
 {
 	//DEBUG_LOG(DYNAREC, "rdv_FailedToFindBlock %08x", pc);
+	if (!tier_up_blocks.empty())
+		tierUpBlocks();
 	next_pc=pc;
 	DynarecCodeEntryPtr code = rdv_CompilePC(0);
 	if (code == NULL)
@@ -271,6 +369,14 @@ DynarecCodeEntryPtr DYNACALL rdv_BlockCheckFail(u32 addr)
 	return (DynarecCodeEntryPtr)CC_RW2RX(rdv_CompilePC(blockcheck_failures));
 }
 
+void rdv_BlockStagingRun(u32 vaddr)
+{
+	RuntimeBlockInfoPtr block = bm_GetBlock(vaddr);
+	if (!block || block->staging_runs <= 0 || --block->staging_runs > 0)
+		return;
+	tier_up_blocks.push_back(vaddr);
+}
+
 DynarecCodeEntryPtr rdv_FindOrCompile()
 {
 	DynarecCodeEntryPtr rv = bm_GetCodeByVAddr(next_pc);  // Returns exec addr
@@ -284,6 +390,9 @@ void* DYNACALL rdv_LinkBlock(u8* code,u32 dpc)
 {
 	// code is the RX addr to return after, however bm_GetBlock returns RW
 	//DEBUG_LOG(DYNAREC, "rdv_LinkBlock %p pc %08x", code, dpc);
+	if (!tier_up_blocks.empty())
+		// The exiting block may be one of them, in which case it's now stale and won't be linked
+		tierUpBlocks();
 	RuntimeBlockInfoPtr rbi = bm_GetBlock(code);
 	bool stale_block = false;
 	if (!rbi)
@@ -372,7 +481,13 @@ static void recSh4_Reset(bool hard)
 	sh4Interp.Reset(hard);
 	recSh4_ClearCache();
 	if (hard)
+	{
 		bm_Reset();
+		bgc_Reset();
+		jprof_Reset();
+		hot_blocks.clear();
+		tier_up_blocks.clear();
+	}
 }
 
 static void recSh4_Init()
@@ -381,6 +496,8 @@ static void recSh4_Init()
 	Get_Sh4Interpreter(&sh4Interp);
 	sh4Interp.Init();
 	bm_Init();
+	bgc_Init();
+	jprof_Init();
 
 	
 	if (_nvmem_enabled())
@@ -416,6 +533,9 @@ static void recSh4_Init()
 static void recSh4_Term()
 {
 	INFO_LOG(DYNAREC, "recSh4 Term");
+	print_compile_stats();
+	bgc_Term();
+	jprof_Term();
 	bm_Term();
 	sh4Interp.Term();
 }
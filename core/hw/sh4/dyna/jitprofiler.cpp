@@ -0,0 +1,336 @@
+/*
+	SH4 dynarec profiler
+*/
+#include "jitprofiler.h"
+
+#if FEAT_SHREC != DYNAREC_NONE
+#include "blockmanager.h"
+#include "ngen.h"
+#include "cfg/option.h"
+#include "emulator.h"
+#include "oslib/oslib.h"
+#include "stdclass.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __linux__
+#include <elf.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+// Blocks farther than this from the closest preceding call target aren't attributed to it
+constexpr u32 MAX_ROUTINE_SIZE = 64 * 1024;
+
+struct BlockProfile
+{
+	u32 addr;
+	u32 guest_cycles;
+	u64 runs;
+	u64 cycles;
+};
+
+static bool enabled;
+static std::vector<BlockProfile> profiles;
+static std::unordered_map<u32, u32> profileSlots;
+// Targets of static calls, used to group blocks by routine
+static std::set<u32> routines;
+
+#ifdef __linux__
+namespace jitdump
+{
+// See tools/perf/Documentation/jitdump-specification.txt in the linux kernel tree
+constexpr u32 MAGIC = 0x4A695444;
+constexpr u32 VERSION = 1;
+constexpr u32 JIT_CODE_LOAD = 0;
+
+struct FileHeader
+{
+	u32 magic;
+	u32 version;
+	u32 total_size;
+	u32 elf_mach;
+	u32 pad1;
+	u32 pid;
+	u64 timestamp;
+	u64 flags;
+};
+
+struct RecordHeader
+{
+	u32 id;
+	u32 total_size;
+	u64 timestamp;
+};
+
+struct CodeLoad
+{
+	RecordHeader header;
+	u32 pid;
+	u32 tid;
+	u64 vma;
+	u64 code_addr;
+	u64 code_size;
+	u64 code_index;
+	// followed by the null-terminated name and the code
+};
+
+static FILE *file;
+static void *marker;
+static u64 codeIndex;
+
+static u64 timestamp()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static u32 elfMachine()
+{
+#if HOST_CPU == CPU_X64
+	return EM_X86_64;
+#elif HOST_CPU == CPU_X86
+	return EM_386;
+#elif HOST_CPU == CPU_ARM64
+	return EM_AARCH64;
+#elif HOST_CPU == CPU_ARM
+	return EM_ARM;
+#else
+	return EM_NONE;
+#endif
+}
+
+static void open()
+{
+	std::string path = hostfs::getJitProfilePath("jit-" + std::to_string(getpid()) + ".dump");
+	file = fopen(path.c_str(), "wb+");
+	if (file == nullptr)
+	{
+		WARN_LOG(DYNAREC, "Can't create jitdump file %s", path.c_str());
+		return;
+	}
+	// perf record looks for an executable mapping of the file to find it
+	marker = mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ | PROT_EXEC, MAP_PRIVATE, fileno(file), 0);
+	if (marker == MAP_FAILED)
+		marker = nullptr;
+
+	FileHeader header{};
+	header.magic = MAGIC;
+	header.version = VERSION;
+	header.total_size = sizeof(header);
+	header.elf_mach = elfMachine();
+	header.pid = getpid();
+	header.timestamp = timestamp();
+	fwrite(&header, sizeof(header), 1, file);
+	fflush(file);
+	codeIndex = 0;
+	INFO_LOG(DYNAREC, "Writing jitdump to %s", path.c_str());
+}
+
+static void close()
+{
+	if (marker != nullptr)
+		munmap(marker, sysconf(_SC_PAGESIZE));
+	marker = nullptr;
+	if (file != nullptr)
+		fclose(file);
+	file = nullptr;
+}
+
+static void codeLoad(const char *name, const void *vma, const void *code, u32 size)
+{
+	if (file == nullptr)
+		return;
+	size_t nameLen = strlen(name) + 1;
+	CodeLoad record;
+	record.header.id = JIT_CODE_LOAD;
+	record.header.total_size = (u32)(sizeof(record) + nameLen + size);
+	record.header.timestamp = timestamp();
+	record.pid = getpid();
+	record.tid = (u32)syscall(SYS_gettid);
+	record.vma = record.code_addr = (u64)(uintptr_t)vma;
+	record.code_size = size;
+	record.code_index = codeIndex++;
+	fwrite(&record, sizeof(record), 1, file);
+	fwrite(name, nameLen, 1, file);
+	fwrite(code, size, 1, file);
+	fflush(file);
+}
+}
+
+static FILE *perfMap;
+
+static void openPerfMap()
+{
+	// perf only looks for /tmp/perf-<pid>.map so it must be copied there before running perf report
+	std::string path = hostfs::getJitProfilePath("perf-" + std::to_string(getpid()) + ".map");
+	perfMap = fopen(path.c_str(), "w");
+	if (perfMap == nullptr)
+		WARN_LOG(DYNAREC, "Can't create perf map %s", path.c_str());
+	else
+		INFO_LOG(DYNAREC, "Writing perf map to %s", path.c_str());
+}
+#endif
+
+static void openOutputs()
+{
+	if (enabled)
+		return;
+	enabled = true;
+#ifdef __linux__
+	openPerfMap();
+	jitdump::open();
+#endif
+}
+
+static void closeOutputs()
+{
+	if (!enabled)
+		return;
+	enabled = false;
+#ifdef __linux__
+	if (perfMap != nullptr)
+		fclose(perfMap);
+	perfMap = nullptr;
+	jitdump::close();
+#endif
+}
+
+void jprof_BlockRun(u32 slot)
+{
+	BlockProfile& profile = profiles[slot];
+	profile.runs++;
+	profile.cycles += profile.guest_cycles;
+}
+
+void jprof_Instrument(RuntimeBlockInfo* block)
+{
+	if (!config::DynarecProfiler)
+		return;
+	openOutputs();
+
+	auto it = profileSlots.find(block->addr);
+	u32 slot;
+	if (it == profileSlots.end())
+	{
+		slot = (u32)profiles.size();
+		profiles.push_back({ block->addr, 0, 0, 0 });
+		profileSlots[block->addr] = slot;
+	}
+	else
+	{
+		slot = it->second;
+	}
+	profiles[slot].guest_cycles = block->guest_cycles;
+	if (block->BlockType == BET_StaticCall)
+		routines.insert(block->BranchBlock);
+
+	shil_opcode op;
+	op.op = shop_profile;
+	op.Flow = 0;
+	op.flags = 0;
+	op.flags2 = 0;
+	op.rs1 = shil_param(FMT_IMM, slot);
+	op.host_offs = 0;
+	op.guest_offs = 0;
+	op.delay_slot = false;
+	block->oplist.insert(block->oplist.begin(), op);
+}
+
+void jprof_BlockCompiled(const RuntimeBlockInfo* block)
+{
+	if (!enabled)
+		return;
+#ifdef __linux__
+	char name[48];
+	snprintf(name, sizeof(name), "sh4_%08x%s", block->vaddr, block->temp_block ? "_temp" : "");
+	const void *vma = (const void *)CC_RW2RX(block->code);
+	if (perfMap != nullptr)
+	{
+		fprintf(perfMap, "%lx %x %s\n", (unsigned long)(uintptr_t)vma, block->host_code_size, name);
+		fflush(perfMap);
+	}
+	jitdump::codeLoad(name, vma, (const void *)block->code, block->host_code_size);
+#endif
+}
+
+static u32 routineOf(u32 addr)
+{
+	auto it = routines.upper_bound(addr);
+	if (it == routines.begin())
+		return addr;
+	--it;
+	return addr - *it < MAX_ROUTINE_SIZE ? *it : addr;
+}
+
+bool jprof_Export(const std::string& path)
+{
+	FILE *f = nowide::fopen(path.c_str(), "w");
+	if (f == nullptr)
+	{
+		WARN_LOG(DYNAREC, "Can't create profile %s", path.c_str());
+		return false;
+	}
+	std::map<u32, u64> routineCycles;
+	u64 totalCycles = 0;
+	for (const BlockProfile& profile : profiles)
+	{
+		if (profile.runs == 0)
+			continue;
+		u32 routine = routineOf(profile.addr);
+		fprintf(f, "sh4;sub_%08x;loc_%08x %llu\n", routine, profile.addr, (unsigned long long)profile.cycles);
+		routineCycles[routine] += profile.cycles;
+		totalCycles += profile.cycles;
+	}
+	fclose(f);
+	INFO_LOG(DYNAREC, "Profile written to %s", path.c_str());
+
+	if (totalCycles == 0)
+		return true;
+	std::vector<std::pair<u32, u64>> top(routineCycles.begin(), routineCycles.end());
+	std::sort(top.begin(), top.end(), [](const std::pair<u32, u64>& a, const std::pair<u32, u64>& b) {
+		return a.second > b.second;
+	});
+	for (size_t i = 0; i < top.size() && i < 10; i++)
+		INFO_LOG(DYNAREC, "Routine %08x: %.2f%% of cycles", top[i].first, top[i].second * 100.0 / totalCycles);
+
+	return true;
+}
+
+void jprof_Reset()
+{
+	for (BlockProfile& profile : profiles)
+		profile.runs = profile.cycles = 0;
+}
+
+static void emuEventCallback(Event event, void *)
+{
+	if (event == Event::Terminate && !profiles.empty())
+	{
+		jprof_Export(get_game_save_prefix() + ".sh4prof.folded");
+		jprof_Reset();
+	}
+}
+
+void jprof_Init()
+{
+	EventManager::listen(Event::Terminate, emuEventCallback);
+}
+
+void jprof_Term()
+{
+	EventManager::unlisten(Event::Terminate, emuEventCallback);
+	closeOutputs();
+	profiles.clear();
+	profileSlots.clear();
+	routines.clear();
+}
+
+#endif	// FEAT_SHREC != DYNAREC_NONE
@@ -0,0 +1,28 @@
+/*
+	SH4 dynarec profiler.
+
+	When Dynarec.Profiler is enabled, compiled blocks are instrumented with an entry counter
+	and their host code is published to Linux perf through perf-<pid>.map and
+	jit-<pid>.dump jitdump files in the data directory (use perf record -k 1 and perf inject --jit
+	for the latter, perf report reads the map from /tmp).
+	Guest hot spots are exported in collapsed stack format (flamegraph.pl input) when the
+	dynarec terminates, with blocks grouped by the routine that contains them.
+*/
+#pragma once
+#include "types.h"
+#include <string>
+
+struct RuntimeBlockInfo;
+
+void jprof_Init();
+void jprof_Term();
+// Clears the run counters
+void jprof_Reset();
+
+// Adds the entry counter to a block before it's compiled
+void jprof_Instrument(RuntimeBlockInfo* block);
+// Publishes the host code of a compiled block
+void jprof_BlockCompiled(const RuntimeBlockInfo* block);
+
+// Writes the guest hot spots in collapsed stack format, weighted by emulated cycles
+bool jprof_Export(const std::string& path);
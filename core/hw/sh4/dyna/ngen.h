@@ -79,6 +79,11 @@ DynarecCodeEntryPtr rdv_FindOrCompile();
 
 //code -> pointer to code of block, dpc -> if dynamic block, pc. if cond, 0 for next, 1 for branch
 void* DYNACALL rdv_LinkBlock(u8* code,u32 dpc);
+//Called by baseline blocks on each run with their virtual address. When the block becomes hot,
+//it's discarded the next time the dispatcher is entered so that it gets optimized
+void rdv_BlockStagingRun(u32 vaddr);
+//Called by instrumented blocks on each run when the jit profiler is enabled
+void jprof_BlockRun(u32 slot);
 
 u32 DYNACALL rdv_DoInterrupts(void* block_cpde);
 u32 DYNACALL rdv_DoInterrupts_pc(u32 pc);
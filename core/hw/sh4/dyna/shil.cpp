@@ -22,10 +22,14 @@
 
 #include "ssa.h"
 
-void AnalyseBlock(RuntimeBlockInfo* blk)
+void AnalyseBlock(RuntimeBlockInfo* blk, bool optimize)
 {
 	SSAOptimizer optim(blk);
-	optim.Optimize();
+	if (optimize)
+		optim.Optimize();
+	else
+		// Register versions are needed by the register allocator
+		optim.AddVersionPass();
 }
 
 std::string name_reg(Sh4RegType reg)
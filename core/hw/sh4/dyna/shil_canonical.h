@@ -1101,6 +1101,34 @@ shil_compile
 )
 shil_opc_end()
 
+//shop_staging -- counts the runs of a baseline block until it's recompiled
+shil_opc(staging)
+shil_canonical
+(
+void,f1,(u32 addr),
+	rdv_BlockStagingRun(addr);
+)
+shil_compile
+(
+	shil_cf_arg_u32(rs1);
+	shil_cf(f1);
+)
+shil_opc_end()
+
+//shop_profile -- counts the runs of a block when the jit profiler is enabled
+shil_opc(profile)
+shil_canonical
+(
+void,f1,(u32 slot),
+	jprof_BlockRun(slot);
+)
+shil_compile
+(
+	shil_cf_arg_u32(rs1);
+	shil_cf(f1);
+)
+shil_opc_end()
+
 SHIL_END
 
 
@@ -254,13 +254,13 @@ private:
 							switch (op.flags & 0x7f)
 							{
 							case 1:
-								v = (s32)(::s8)ReadMem8(op.rs1._imm);
+								v = (s32)(::s8)dec_ReadMem(op.rs1._imm, 1);
 								break;
 							case 2:
-								v = (s32)(::s16)ReadMem16(op.rs1._imm);
+								v = (s32)(::s16)dec_ReadMem(op.rs1._imm, 2);
 								break;
 							case 4:
-								v = ReadMem32(op.rs1._imm);
+								v = dec_ReadMem(op.rs1._imm, 4);
 								break;
 							default:
 								die("invalid size");
@@ -269,6 +269,7 @@ private:
 							}
 							ReplaceByMov32(op, v);
 							constprop_values[RegValue(op.rd)] = v;
+							block->reads_code_pages = true;
 						}
 					}
 				}
@@ -727,12 +728,12 @@ private:
 			if ((addr >> 12) < start_page || ((addr + 2) >> 12) > end_page)
 				break;
 
-			u32 op = IReadMem16(addr);
+			u32 op = dec_IReadMem16(addr);
 			// Axxx: bra <bdisp12>
 			if ((op & 0xF000) != 0xA000)
 				break;
 
-			u16 delayOp = IReadMem16(addr + 2);
+			u16 delayOp = dec_IReadMem16(addr + 2);
 			if (delayOp != 0x0000 && delayOp != 0x0009)	// nop
 				break;
 
@@ -755,8 +756,10 @@ private:
 	{
 		if (block->read_only)
 		{
-			bool updateCycles = !skipSingleBranchTarget(block->BranchBlock, true);
-			skipSingleBranchTarget(block->NextBlock, updateCycles);
+			bool branchSkipped = skipSingleBranchTarget(block->BranchBlock, true);
+			bool nextSkipped = skipSingleBranchTarget(block->NextBlock, !branchSkipped);
+			if (branchSkipped || nextSkipped)
+				block->reads_code_pages = true;
 		}
 	}
 
@@ -63,11 +63,13 @@ void DMAC_Ch2St()
 			{
 				u32 newLen = RAM_SIZE - (src & RAM_MASK);
 				WriteMemBlock_nommu_dma(dst, src, newLen);
+				VramMarkDirty(dst, newLen);
 				len -= newLen;
 				src += newLen;
 				dst += newLen;
 			}
 			WriteMemBlock_nommu_dma(dst, src, len);
+			VramMarkDirty(dst, len);
 			src += len;
 			dst += len;
 		}
@@ -23,43 +23,136 @@ u64 sh4_sched_ffb;
 std::vector<sched_list> sch_list;
 int sh4_sched_next_id = -1;
 
+/*
+	Pending callbacks are kept in a binary min-heap ordered by absolute 64-bit deadline,
+	then by id so that ties are resolved like the original linear scan.
+	sch_list stays the reference for the savestate format, the heap is rebuilt from it
+	when it's modified directly.
+*/
+static std::vector<int> sched_heap;
+static std::vector<int> heap_pos;		// index of each id in sched_heap, or -1
+static std::vector<u64> deadlines;
+
 static u32 sh4_sched_now();
 
-static u32 sh4_sched_remaining(const sched_list& sched, u32 reference)
+static bool heap_less(int id1, int id2)
 {
-	if (sched.end != -1)
-		return sched.end - reference;
-	else
-		return -1;
+	return deadlines[id1] < deadlines[id2] || (deadlines[id1] == deadlines[id2] && id1 < id2);
 }
 
-void sh4_sched_ffts()
+static void heap_set(size_t pos, int id)
 {
-	u32 diff = -1;
-	int slot = -1;
+	sched_heap[pos] = id;
+	heap_pos[id] = pos;
+}
 
-	u32 now = sh4_sched_now();
-	for (const sched_list& sched : sch_list)
+static void heap_sift_up(size_t pos)
+{
+	int id = sched_heap[pos];
+	while (pos > 0)
 	{
-		u32 remaining = sh4_sched_remaining(sched, now);
-		if (remaining < diff)
-		{
-			slot = &sched - &sch_list[0];
-			diff = remaining;
-		}
+		size_t parent = (pos - 1) / 2;
+		if (!heap_less(id, sched_heap[parent]))
+			break;
+		heap_set(pos, sched_heap[parent]);
+		pos = parent;
 	}
+	heap_set(pos, id);
+}
 
-	sh4_sched_ffb -= Sh4cntx.sh4_sched_next;
+static void heap_sift_down(size_t pos)
+{
+	int id = sched_heap[pos];
+	size_t size = sched_heap.size();
+	for (;;)
+	{
+		size_t child = pos * 2 + 1;
+		if (child >= size)
+			break;
+		if (child + 1 < size && heap_less(sched_heap[child + 1], sched_heap[child]))
+			child++;
+		if (!heap_less(sched_heap[child], id))
+			break;
+		heap_set(pos, sched_heap[child]);
+		pos = child;
+	}
+	heap_set(pos, id);
+}
+
+static void heap_remove(int id)
+{
+	int pos = heap_pos[id];
+	if (pos == -1)
+		return;
+	heap_pos[id] = -1;
+	int last = sched_heap.back();
+	sched_heap.pop_back();
+	if (last == id)
+		return;
+	heap_set(pos, last);
+	heap_sift_down(pos);
+	heap_sift_up(heap_pos[last]);
+}
 
-	sh4_sched_next_id = slot;
-	if (slot != -1)
-		Sh4cntx.sh4_sched_next = diff;
+// Inserts or moves a callback according to its end time
+static void heap_update(int id)
+{
+	const sched_list& sched = sch_list[id];
+	if (sched.end == -1 || sched.cb == nullptr)
+	{
+		heap_remove(id);
+		return;
+	}
+	// The deadline is derived from the 32-bit end time to keep its wrapping behavior
+	deadlines[id] = sh4_sched_now64() + (u32)(sched.end - sh4_sched_now());
+	int pos = heap_pos[id];
+	if (pos == -1)
+	{
+		sched_heap.push_back(id);
+		heap_pos[id] = sched_heap.size() - 1;
+		heap_sift_up(sched_heap.size() - 1);
+	}
 	else
+	{
+		heap_sift_down(pos);
+		heap_sift_up(heap_pos[id]);
+	}
+}
+
+void sh4_sched_rebuild()
+{
+	sched_heap.clear();
+	heap_pos.assign(sch_list.size(), -1);
+	deadlines.resize(sch_list.size());
+	for (size_t id = 0; id < sch_list.size(); id++)
+		heap_update(id);
+}
+
+static void sh4_sched_update_next()
+{
+	u32 now = sh4_sched_now();
+	sh4_sched_ffb -= Sh4cntx.sh4_sched_next;
+
+	if (sched_heap.empty())
+	{
+		sh4_sched_next_id = -1;
 		Sh4cntx.sh4_sched_next = SH4_MAIN_CLOCK;
+	}
+	else
+	{
+		sh4_sched_next_id = sched_heap[0];
+		Sh4cntx.sh4_sched_next = (u32)(sch_list[sh4_sched_next_id].end - now);
+	}
 
 	sh4_sched_ffb += Sh4cntx.sh4_sched_next;
 }
 
+void sh4_sched_ffts()
+{
+	sh4_sched_rebuild();
+	sh4_sched_update_next();
+}
+
 int sh4_sched_register(int tag, sh4_sched_callback* ssc)
 {
 	sched_list t{ ssc, tag, -1, -1};
@@ -71,6 +164,8 @@ int sh4_sched_register(int tag, sh4_sched_callback* ssc)
 		}
 
 	sch_list.push_back(t);
+	heap_pos.push_back(-1);
+	deadlines.push_back(0);
 
 	return sch_list.size() - 1;
 }
@@ -80,14 +175,19 @@ void sh4_sched_unregister(int id)
 	if (id == -1)
 		return;
 	verify(id < (int)sch_list.size());
+	heap_remove(id);
 	if (id == (int)sch_list.size() - 1)
+	{
 		sch_list.resize(sch_list.size() - 1);
+		heap_pos.resize(sch_list.size());
+		deadlines.resize(sch_list.size());
+	}
 	else
 	{
 		sch_list[id].cb = nullptr;
 		sch_list[id].end = -1;
 	}
-	sh4_sched_ffts();
+	sh4_sched_update_next();
 }
 
 /*
@@ -123,8 +223,9 @@ void sh4_sched_request(int id, int cycles)
 		if (sched.end == -1)
 			sched.end++;
 	}
+	heap_update(id);
 
-	sh4_sched_ffts();
+	sh4_sched_update_next();
 }
 
 /* Returns how much time has passed for this callback */
@@ -140,17 +241,43 @@ static int sh4_sched_elapsed(sched_list& sched)
 		return -1;
 }
 
-static void handle_cb(sched_list& sched)
+static void handle_cb(int id)
 {
+	sched_list& sched = sch_list[id];
 	int remain = sched.end - sched.start;
 	int elapsd = sh4_sched_elapsed(sched);
 	int jitter = elapsd - remain;
 
 	sched.end = -1;
+	heap_remove(id);
 	int re_sch = sched.cb(sched.tag, remain, jitter);
 
 	if (re_sch > 0)
-		sh4_sched_request(&sched - &sch_list[0], std::max(0, re_sch - jitter));
+		sh4_sched_request(id, std::max(0, re_sch - jitter));
+}
+
+// Returns the lowest id greater than minId among the callbacks due at the given time.
+// Due callbacks form a subtree at the top of the heap.
+static int sh4_sched_next_due(u64 now, int minId)
+{
+	static std::vector<size_t> stack;
+	int found = -1;
+	stack.clear();
+	if (!sched_heap.empty())
+		stack.push_back(0);
+	while (!stack.empty())
+	{
+		size_t pos = stack.back();
+		stack.pop_back();
+		int id = sched_heap[pos];
+		if (deadlines[id] > now)
+			continue;
+		if (id > minId && (found == -1 || id < found))
+			found = id;
+		for (size_t child = pos * 2 + 1; child <= pos * 2 + 2 && child < sched_heap.size(); child++)
+			stack.push_back(child);
+	}
+	return found;
 }
 
 void sh4_sched_tick(int cycles)
@@ -158,18 +285,17 @@ void sh4_sched_tick(int cycles)
 	if (Sh4cntx.sh4_sched_next >= 0)
 		return;
 
-	u32 fztime = sh4_sched_now() - cycles;
 	if (sh4_sched_next_id != -1)
 	{
-		for (sched_list& sched : sch_list)
+		// Callbacks are handled in id order, like the original linear scan
+		u64 now = sh4_sched_now64();
+		for (int id = sh4_sched_next_due(now, -1); id != -1; id = sh4_sched_next_due(now, id))
 		{
-			int remaining = sh4_sched_remaining(sched, fztime);
-			verify(remaining >= 0 || remaining == -1);
-			if (remaining >= 0 && remaining <= (int)cycles)
-				handle_cb(sched);
+			verify((int)(sch_list[id].end - (sh4_sched_now() - cycles)) >= 0);
+			handle_cb(id);
 		}
 	}
-	sh4_sched_ffts();
+	sh4_sched_update_next();
 }
 
 void sh4_sched_reset(bool hard)
@@ -180,6 +306,8 @@ void sh4_sched_reset(bool hard)
 		sh4_sched_next_id = -1;
 		for (sched_list& sched : sch_list)
 			sched.start = sched.end = -1;
+		sched_heap.clear();
+		heap_pos.assign(sch_list.size(), -1);
 		Sh4cntx.sh4_sched_next = 0;
 	}
 }
@@ -42,6 +42,10 @@ void sh4_sched_request(int id, int cycles);
 void sh4_sched_tick(int cycles);
 
 void sh4_sched_ffts();
+/*
+	Rebuilds the event queue after sch_list has been modified directly (savestates)
+*/
+void sh4_sched_rebuild();
 void sh4_sched_reset(bool hard);
 
 struct sched_list
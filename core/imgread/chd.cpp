@@ -1,7 +1,9 @@
 #include "common.h"
+#include "hunkcache.h"
 #include "stdclass.h"
 
 #include <libchdr/chd.h>
+#include <memory>
 
 struct CHDDisc : Disc
 {
@@ -12,18 +14,20 @@ struct CHDDisc : Disc
 
 	chd_file *chd = nullptr;
 	FILE *fp = nullptr;
-	u8* hunk_mem = nullptr;
-	u32 old_hunk = 0;
 
 	u32 hunkbytes = 0;
+	u32 totalhunks = 0;
 	u32 sph = 0;
 
+	// decompressed hunks, shared by all tracks
+	std::unique_ptr<HunkCache> cache;
+
 	void tryOpen(const char* file);
 
 	~CHDDisc()
 	{
-		delete[] hunk_mem;
-
+		// stops prefetching
+		cache.reset();
 		if (chd)
 			chd_close(chd);
 		if (fp)
@@ -50,16 +54,10 @@ struct CHDTrack : TrackFile
 	{
 		u32 fad_offs = FAD + Offset;
 		u32 hunk=(fad_offs)/disc->sph;
-		if (disc->old_hunk!=hunk)
-		{
-			if (chd_read(disc->chd,hunk,disc->hunk_mem) != CHDERR_NONE)
-				return false;
-			disc->old_hunk = hunk;
-		}
-
 		u32 hunk_ofs = fad_offs%disc->sph;
 
-		memcpy(dst, disc->hunk_mem + hunk_ofs * (2352+96), fmt);
+		if (!disc->cache->read(hunk, hunk_ofs * (2352+96), dst, fmt))
+			return false;
 
 		if (swap_bytes)
 		{
@@ -127,13 +125,15 @@ void CHDDisc::tryOpen(const char* file)
 	const chd_header* head = chd_get_header(chd);
 
 	hunkbytes = head->hunkbytes;
-	hunk_mem = new u8[hunkbytes];
-	old_hunk=0xFFFFFFF;
+	totalhunks = head->totalhunks;
 
 	sph = hunkbytes/(2352+96);
 
 	if (hunkbytes % (2352 + 96) != 0)
 		throw FlycastException(std::string("Invalid hunkbytes for CHD file ") + file);
+	cache.reset(new HunkCache(hunkbytes, totalhunks, [this](u32 hunk, u8 *data) {
+		return chd_read(chd, hunk, data) == CHDERR_NONE;
+	}));
 
 	u32 tag;
 	u8 flags;
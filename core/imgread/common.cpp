@@ -1,4 +1,5 @@
 #include "common.h"
+#include "readahead.h"
 #include "hw/gdrom/gdromv3.h"
 #include "cfg/option.h"
 #include "stdclass.h"
@@ -24,17 +25,18 @@ constexpr Disc* (*drivers[])(const char* path, std::vector<u8> *digest)
 };
 
 u8 q_subchannel[96];
+static SectorReader sectorReader;
 
-static bool convertSector(u8* in_buff , u8* out_buff , int from , int to,int sector)
+static bool convertSector(u8* in_buff , u8* out_buff , int from , int to,int sector, u8 *subcode)
 {
 	//get subchannel data, if any
 	if (from == 2448)
 	{
-		memcpy(q_subchannel, in_buff + 2352, 96);
+		memcpy(subcode, in_buff + 2352, 96);
 		from -= 96;
 	}
 	else
-		memset(q_subchannel, 0, sizeof(q_subchannel));
+		memset(subcode, 0, 96);
 
 	//if no conversion
 	if (to == from)
@@ -114,6 +116,7 @@ static bool loadDisk(const std::string& path)
 			MD5Sum().add(digest)
 					.getDigest(settings.network.md5.game);
 		INFO_LOG(GDROM, "gdrom: Opened image \"%s\"", path.c_str());
+		sectorReader.open(disc, get_file_extension(path));
 	}
 	else
 	{
@@ -172,6 +175,7 @@ bool DiscSwap(const std::string& path)
 
 void TermDrive()
 {
+	sectorReader.close();
 	delete disc;
 	disc = NULL;
 }
@@ -203,8 +207,12 @@ static u32 CreateTrackInfo_se(u32 ctrl, u32 addr, u32 tracknum)
 
 void libGDR_ReadSector(u8 *buff, u32 startSector, u32 sectorCount, u32 sectorSize)
 {
-	if (disc != nullptr)
-		disc->ReadSectors(startSector, sectorCount, buff, sectorSize);
+	sectorReader.read(buff, startSector, sectorCount, sectorSize, q_subchannel);
+}
+
+void libGDR_ReadAhead(u32 startSector, u32 sectorCount, u32 sectorSize)
+{
+	sectorReader.readAhead(startSector, sectorCount, sectorSize);
 }
 
 void libGDR_GetToc(u32* to, DiskArea area)
@@ -280,8 +288,10 @@ DiscType GuessDiscType(bool m1, bool m2, bool da)
 		return CdRom;
 }
 
-void Disc::ReadSectors(u32 FAD, u32 count, u8* dst, u32 fmt, LoadProgress *progress)
+void Disc::ReadSectors(u32 FAD, u32 count, u8* dst, u32 fmt, LoadProgress *progress, u8 *subcode)
 {
+	if (subcode == nullptr)
+		subcode = q_subchannel;
 	u8 temp[2448];
 	SectorFormat secfmt;
 	SubcodeFormat subfmt;
@@ -295,12 +305,12 @@ void Disc::ReadSectors(u32 FAD, u32 count, u8* dst, u32 fmt, LoadProgress *progr
 			progress->label = "Loading...";
 			progress->progress = (float)i / count;
 		}
-		if (ReadSector(FAD,temp,&secfmt,q_subchannel,&subfmt))
+		if (ReadSector(FAD,temp,&secfmt,subcode,&subfmt))
 		{
 			//TODO: Proper sector conversions
 			if (secfmt==SECFMT_2352)
 			{
-				convertSector(temp,dst,2352,fmt,FAD);
+				convertSector(temp,dst,2352,fmt,FAD,subcode);
 			}
 			else if (fmt == 2048 && secfmt==SECFMT_2336_MODE2)
 				memcpy(dst,temp+8,2048);
@@ -316,7 +326,7 @@ void Disc::ReadSectors(u32 FAD, u32 count, u8* dst, u32 fmt, LoadProgress *progr
 			else if (fmt==2048 && secfmt==SECFMT_2448_MODE2)
 			{
 				// Pier Solar and the Great Architects
-				convertSector(temp, dst, 2448, fmt, FAD);
+				convertSector(temp, dst, 2448, fmt, FAD, subcode);
 			}
 			else
 			{
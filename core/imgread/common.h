@@ -118,7 +118,8 @@ struct Disc
 		return false;
 	}
 
-	void ReadSectors(u32 FAD, u32 count, u8 *dst, u32 fmt, LoadProgress *progress = nullptr);
+	// Subcodes are written to subcode if not null, or to q_subchannel
+	void ReadSectors(u32 FAD, u32 count, u8 *dst, u32 fmt, LoadProgress *progress = nullptr, u8 *subcode = nullptr);
 
 	virtual ~Disc() 
 	{
@@ -221,6 +222,8 @@ DiscType GuessDiscType(bool m1, bool m2, bool da);
 
 //IO
 void libGDR_ReadSector(u8 * buff,u32 StartSector,u32 SectorCount,u32 secsz);
+// Starts reading the sectors of a read command in the background
+void libGDR_ReadAhead(u32 startSector, u32 sectorCount, u32 sectorSize);
 void libGDR_ReadSubChannel(u8 * buff, u32 len);
 void libGDR_GetToc(u32 *toc, DiskArea area);
 u32 libGDR_GetDiscType();
@@ -0,0 +1,148 @@
+#include "hunkcache.h"
+
+#include <algorithm>
+#include <chrono>
+
+HunkCache::HunkCache(u32 hunkBytes, u32 totalHunks, Decompressor decompressor, bool prefetch)
+	: hunkBytes(hunkBytes), totalHunks(totalHunks), decompressor(decompressor), prefetchEnabled(prefetch)
+{
+	maxHunks = std::max(CacheSize / hunkBytes, PrefetchHunks * 2);
+}
+
+HunkCache::~HunkCache()
+{
+	stopPrefetch();
+	if (hits + misses > 0)
+		INFO_LOG(GDROM, "Hunk cache: %.1f%% hits, %u hunks decompressed (%u prefetched) in %.1f ms",
+				100.0 * hits / (hits + misses), decompressed, prefetched, decompressNanos / 1e6);
+}
+
+std::unique_ptr<u8[]> HunkCache::decompress(u32 hunk)
+{
+	std::unique_ptr<u8[]> data(new u8[hunkBytes]);
+	std::lock_guard<std::mutex> _(decompressMutex);
+	auto start = std::chrono::steady_clock::now();
+	if (!decompressor(hunk, data.get()))
+		return nullptr;
+	decompressNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	decompressed++;
+	return data;
+}
+
+// cacheMutex must be held
+void HunkCache::addHunk(u32 hunk, std::unique_ptr<u8[]>&& data)
+{
+	if (hunks.count(hunk) != 0)
+		return;
+	if (hunks.size() >= maxHunks)
+	{
+		hunks.erase(lru.back());
+		lru.pop_back();
+	}
+	lru.push_front(hunk);
+	Hunk& h = hunks[hunk];
+	h.data = std::move(data);
+	h.lruPos = lru.begin();
+}
+
+bool HunkCache::read(u32 hunk, u32 offset, u8 *dst, u32 size)
+{
+	std::unique_lock<std::mutex> lock(cacheMutex);
+	if (hunk != lastHunk)
+		startPrefetch(hunk);
+	auto it = hunks.find(hunk);
+	if (it == hunks.end())
+	{
+		misses++;
+		lock.unlock();
+		std::unique_ptr<u8[]> data = decompress(hunk);
+		if (data == nullptr)
+			return false;
+		lock.lock();
+		addHunk(hunk, std::move(data));
+		it = hunks.find(hunk);
+	}
+	else
+	{
+		hits++;
+		lru.splice(lru.begin(), lru, it->second.lruPos);
+	}
+	memcpy(dst, it->second.data.get() + offset, size);
+
+	return true;
+}
+
+// When reading sequentially, decompress the hunks following the one being read in the current direction.
+// cacheMutex must be held
+void HunkCache::startPrefetch(u32 hunk)
+{
+	const bool sequential = hunk == lastHunk + 1 || hunk == lastHunk - 1;
+	if (sequential)
+		direction = hunk < lastHunk ? -1 : 1;
+	lastHunk = hunk;
+	if (!prefetchEnabled)
+		return;
+	if (!sequential)
+	{
+		// Random access: cancel pending prefetches
+		prefetchCount = 0;
+		return;
+	}
+	prefetchNext = hunk + direction;
+	prefetchCount = PrefetchHunks;
+	if (!prefetchThread.joinable())
+		prefetchThread = std::thread(&HunkCache::prefetchLoop, this);
+	prefetchCond.notify_one();
+}
+
+void HunkCache::prefetchLoop()
+{
+	std::unique_lock<std::mutex> lock(cacheMutex);
+	for (;;)
+	{
+		prefetchCond.wait(lock, [this]() { return prefetchStop || prefetchCount > 0; });
+		if (prefetchStop)
+			break;
+		u32 hunk = prefetchNext;
+		prefetchNext += direction;
+		prefetchCount--;
+		if (hunk >= totalHunks || hunks.count(hunk) != 0)
+			continue;
+		lock.unlock();
+		std::unique_ptr<u8[]> data = decompress(hunk);
+		lock.lock();
+		if (data == nullptr)
+			prefetchCount = 0;
+		else if (hunks.count(hunk) == 0)
+		{
+			addHunk(hunk, std::move(data));
+			prefetched++;
+		}
+	}
+}
+
+void HunkCache::stopPrefetch()
+{
+	if (prefetchThread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> _(cacheMutex);
+			prefetchStop = true;
+		}
+		prefetchCond.notify_one();
+		prefetchThread.join();
+	}
+}
+
+HunkCacheStats HunkCache::getStats()
+{
+	std::lock_guard<std::mutex> _(cacheMutex);
+	std::lock_guard<std::mutex> __(decompressMutex);
+	HunkCacheStats stats;
+	stats.hits = hits;
+	stats.misses = misses;
+	stats.decompressed = decompressed;
+	stats.prefetched = prefetched;
+	stats.decompressSeconds = decompressNanos / 1e9;
+	return stats;
+}
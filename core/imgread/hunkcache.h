@@ -0,0 +1,85 @@
+/*
+	Cache of decompressed disc image hunks.
+
+	Decompressed hunks are kept in a bounded LRU cache. When hunks are read sequentially in either
+	direction, a background thread decompresses the following ones in that direction. A jump to a
+	non-adjacent hunk cancels the pending prefetches.
+	The decompressor is never called concurrently, and never with the cache lock held.
+*/
+#pragma once
+#include "types.h"
+
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+struct HunkCacheStats
+{
+	u64 hits;
+	u64 misses;
+	u32 decompressed;
+	u32 prefetched;
+	double decompressSeconds;
+};
+
+class HunkCache
+{
+public:
+	// size of the decompressed hunk cache
+	static constexpr u32 CacheSize = 8 * 1024 * 1024;
+	// hunks decompressed ahead of the last one read
+	static constexpr u32 PrefetchHunks = 16;
+	using Decompressor = std::function<bool(u32 hunk, u8 *data)>;
+
+	// Prefetching only helps if it runs in parallel with the emulator so it's disabled on single-core hosts by default
+	HunkCache(u32 hunkBytes, u32 totalHunks, Decompressor decompressor,
+			bool prefetch = std::thread::hardware_concurrency() > 1);
+	~HunkCache();
+
+	bool read(u32 hunk, u32 offset, u8 *dst, u32 size);
+
+	HunkCacheStats getStats();
+
+private:
+	struct Hunk
+	{
+		std::unique_ptr<u8[]> data;
+		std::list<u32>::iterator lruPos;
+	};
+	std::unique_ptr<u8[]> decompress(u32 hunk);
+	void addHunk(u32 hunk, std::unique_ptr<u8[]>&& data);
+	void startPrefetch(u32 hunk);
+	void prefetchLoop();
+	void stopPrefetch();
+
+	const u32 hunkBytes;
+	const u32 totalHunks;
+	Decompressor decompressor;
+	// Serializes decompressor calls
+	std::mutex decompressMutex;
+
+	// Guards the cache and the prefetch state
+	std::mutex cacheMutex;
+	std::unordered_map<u32, Hunk> hunks;
+	std::list<u32> lru;		// most recently used first
+	u32 maxHunks;
+	u32 lastHunk = ~0u;
+	int direction = 1;
+
+	const bool prefetchEnabled;
+	std::thread prefetchThread;
+	std::condition_variable prefetchCond;
+	u32 prefetchNext = 0;
+	u32 prefetchCount = 0;
+	bool prefetchStop = false;
+
+	u64 hits = 0;
+	u64 misses = 0;
+	u32 decompressed = 0;
+	u32 prefetched = 0;
+	u64 decompressNanos = 0;
+};
@@ -0,0 +1,183 @@
+#include "readahead.h"
+#include "common.h"
+
+#include <chrono>
+
+constexpr u32 SectorReader::Capacity;
+constexpr u32 SectorReader::Batch;
+
+static u64 getTimeNanos()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void SectorReader::Histogram::add(u64 nanos)
+{
+	u64 us = nanos / 1000;
+	int bucket = 0;
+	while (bucket < Buckets - 1 && us >= (16ull << bucket))
+		bucket++;
+	counts[bucket]++;
+}
+
+void SectorReader::Histogram::log(const std::string& format) const
+{
+	std::string s;
+	for (int i = 0; i < Buckets; i++)
+	{
+		if (counts[i] == 0)
+			continue;
+		char bucket[64];
+		if (i == Buckets - 1)
+			snprintf(bucket, sizeof(bucket), " >=%llums:%llu", (16ull << (i - 1)) / 1000, (unsigned long long)counts[i]);
+		else if ((16ull << i) >= 1000)
+			snprintf(bucket, sizeof(bucket), " <%llums:%llu", (16ull << i) / 1000, (unsigned long long)counts[i]);
+		else
+			snprintf(bucket, sizeof(bucket), " <%lluus:%llu", 16ull << i, (unsigned long long)counts[i]);
+		s += bucket;
+	}
+	INFO_LOG(GDROM, "%s sector read latency:%s", format.c_str(), s.c_str());
+}
+
+void SectorReader::open(Disc *disc, const std::string& format)
+{
+	close();
+	this->disc = disc;
+	this->format = format;
+	ring.resize(Capacity * 2352);
+	ringSubcode.resize(Capacity * 96);
+}
+
+void SectorReader::close()
+{
+	stopThread();
+	if (disc == nullptr)
+		return;
+	{
+		std::lock_guard<std::mutex> _(statsMutex);
+		auto it = histograms.find(format);
+		if (it != histograms.end())
+			it->second.log(format);
+	}
+	if (ringSectors > 0)
+		INFO_LOG(GDROM, "Read-ahead: %llu sectors, waited %llu times for %.1f ms", (unsigned long long)ringSectors,
+				(unsigned long long)stalls, stallNanos / 1e6);
+	ringSectors = 0;
+	stalls = 0;
+	stallNanos = 0;
+	disc = nullptr;
+}
+
+void SectorReader::stopThread()
+{
+	{
+		std::lock_guard<std::mutex> _(ringMutex);
+		stopping = true;
+		generation++;
+		ready = 0;
+		pending = 0;
+	}
+	ioCond.notify_one();
+	if (ioThread.joinable())
+		ioThread.join();
+	stopping = false;
+}
+
+void SectorReader::readAhead(u32 fad, u32 count, u32 sectorSize)
+{
+	if (disc == nullptr)
+		return;
+	std::lock_guard<std::mutex> _(ringMutex);
+	generation++;
+	nextFad = fad;
+	readIndex = 0;
+	ready = 0;
+	if (sectorSize > 2352)
+	{
+		pending = 0;
+		return;
+	}
+	this->sectorSize = sectorSize;
+	pending = count;
+	if (!ioThread.joinable())
+		ioThread = std::thread(&SectorReader::ioLoop, this);
+	ioCond.notify_one();
+}
+
+void SectorReader::read(u8 *dst, u32 fad, u32 count, u32 sectorSize, u8 *subcode)
+{
+	if (disc == nullptr)
+		return;
+	std::unique_lock<std::mutex> lock(ringMutex);
+	if (count == 0 || sectorSize != this->sectorSize || fad != nextFad || count > ready + pending)
+	{
+		// Not read ahead
+		lock.unlock();
+		for (u32 i = 0; i < count; i++)
+			readDisc(dst + i * sectorSize, fad + i, 1, sectorSize, subcode);
+		return;
+	}
+	while (count > 0)
+	{
+		if (ready == 0)
+		{
+			// The host is behind
+			u64 start = getTimeNanos();
+			readyCond.wait(lock, [this]() { return ready > 0; });
+			stalls++;
+			stallNanos += getTimeNanos() - start;
+		}
+		u32 n = std::min(std::min(count, ready), Capacity - readIndex);
+		memcpy(dst, &ring[readIndex * sectorSize], n * sectorSize);
+		memcpy(subcode, &ringSubcode[(readIndex + n - 1) * 96], 96);
+		dst += n * sectorSize;
+		count -= n;
+		readIndex = (readIndex + n) % Capacity;
+		ready -= n;
+		nextFad += n;
+		ringSectors += n;
+		ioCond.notify_one();
+	}
+}
+
+void SectorReader::ioLoop()
+{
+	std::unique_lock<std::mutex> lock(ringMutex);
+	for (;;)
+	{
+		ioCond.wait(lock, [this]() { return stopping || (pending > 0 && ready < Capacity); });
+		if (stopping)
+			break;
+		// The consumer keeps readIndex + ready constant
+		const u32 gen = generation;
+		const u32 writeIndex = (readIndex + ready) % Capacity;
+		const u32 fad = nextFad + ready;
+		const u32 size = sectorSize;
+		const u32 count = std::min(std::min(pending, Batch), std::min(Capacity - ready, Capacity - writeIndex));
+		lock.unlock();
+		readDisc(&ring[writeIndex * size], fad, count, size, &ringSubcode[writeIndex * 96]);
+		lock.lock();
+		if (gen == generation)
+		{
+			ready += count;
+			pending -= count;
+			readyCond.notify_one();
+		}
+	}
+}
+
+// Subcodes are stored per sector
+void SectorReader::readDisc(u8 *dst, u32 fad, u32 count, u32 sectorSize, u8 *subcode)
+{
+	for (u32 i = 0; i < count; i++)
+	{
+		u64 start = getTimeNanos();
+		{
+			std::lock_guard<std::mutex> _(discMutex);
+			disc->ReadSectors(fad + i, 1, dst + i * sectorSize, sectorSize, nullptr, subcode + i * 96);
+		}
+		u64 nanos = getTimeNanos() - start;
+		std::lock_guard<std::mutex> _(statsMutex);
+		histograms[format].add(nanos);
+	}
+}
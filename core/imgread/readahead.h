@@ -0,0 +1,80 @@
+/*
+	Asynchronous GD-ROM sector reader.
+
+	When the GD-ROM starts a read command, the requested sectors are read from the disc image
+	by an I/O thread into a ring buffer. The GD-ROM scheduler callback then only copies sectors
+	from the ring, and waits for the I/O thread if it falls behind.
+	Other reads, such as CDDA, are done synchronously. All disc accesses are serialized.
+	The latency of host sector reads is recorded per image format.
+*/
+#pragma once
+#include "types.h"
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Disc;
+
+class SectorReader
+{
+public:
+	~SectorReader() { stopThread(); }
+
+	void open(Disc *disc, const std::string& format);
+	void close();
+
+	// Starts reading the given sectors in the background
+	void readAhead(u32 fad, u32 count, u32 sectorSize);
+	// Reads the given sectors, from the ring buffer if they've been requested by readAhead.
+	// The subcodes of the last sector are written to subcode.
+	void read(u8 *dst, u32 fad, u32 count, u32 sectorSize, u8 *subcode);
+
+private:
+	static constexpr u32 Capacity = 256;	// sectors
+	static constexpr u32 Batch = 16;		// sectors read at once by the I/O thread
+
+	struct Histogram
+	{
+		// sector read latency, bucket i: < 2^(i+4) us
+		static constexpr int Buckets = 14;
+		u64 counts[Buckets] {};
+
+		void add(u64 nanos);
+		void log(const std::string& format) const;
+	};
+
+	void readDisc(u8 *dst, u32 fad, u32 count, u32 sectorSize, u8 *subcode);
+	void ioLoop();
+	void stopThread();
+
+	Disc *disc = nullptr;
+	std::string format;
+	// Serializes disc accesses
+	std::mutex discMutex;
+
+	// Read-ahead state, guarded by ringMutex
+	std::mutex ringMutex;
+	std::condition_variable ioCond;		// signals the I/O thread
+	std::condition_variable readyCond;	// signals the emulator
+	std::thread ioThread;
+	bool stopping = false;
+	u32 generation = 0;
+	u32 sectorSize = 0;
+	u32 nextFad = 0;		// first sector in the ring
+	u32 readIndex = 0;		// ring index of nextFad
+	u32 ready = 0;			// sectors available in the ring
+	u32 pending = 0;		// sectors left to read into the ring
+	std::vector<u8> ring;
+	std::vector<u8> ringSubcode;
+
+	// Stats
+	std::mutex statsMutex;
+	std::map<std::string, Histogram> histograms;
+	u64 stalls = 0;
+	u64 stallNanos = 0;
+	u64 ringSectors = 0;
+};
@@ -21,6 +21,7 @@
 #include "rend/TexCache.h"
 #include "hw/mem/_vmem.h"
 #include "hw/mem/mem_watch.h"
+#include "hw/naomi/rom_memory.h"
 
 #ifdef __SWITCH__
 #include <ucontext.h>
@@ -54,6 +55,9 @@ void fault_handler(int sn, siginfo_t * si, void *segfault_ctx)
 	// FPCB jump table protection
 	if (BM_LockedWrite((u8*)si->si_addr))
 		return;
+	// cartridge ROM filled on first access
+	if (RomMemory::pageFault(si->si_addr))
+		return;
 
 #if FEAT_SHREC == DYNAREC_JIT
 	// fast mem access rewriting
@@ -126,6 +126,16 @@ std::string getShaderCachePath(const std::string& filename)
 	return get_writable_data_path(filename);
 }
 
+std::string getNaomiDimmCachePath(const std::string& filename)
+{
+	return get_writable_data_path(filename);
+}
+
+std::string getJitProfilePath(const std::string& filename)
+{
+	return get_writable_data_path(filename);
+}
+
 std::string getTextureLoadPath(const std::string& gameId)
 {
 	if (gameId.length() > 0)
@@ -45,6 +45,8 @@ namespace hostfs
 	std::string getTextureDumpPath();
 
 	std::string getShaderCachePath(const std::string& filename);
+	std::string getNaomiDimmCachePath(const std::string& filename);
+	std::string getJitProfilePath(const std::string& filename);
 
 	std::string getBiosFontPath();
 }
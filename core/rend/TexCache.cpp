@@ -1,11 +1,14 @@
 #include "TexCache.h"
 #include "CustomTexture.h"
+#include "TexConvSimd.h"
+#include "TexDecodePool.h"
 #include "deps/xbrz/xbrz.h"
 #include "hw/pvr/pvr_mem.h"
 #include "hw/mem/_vmem.h"
 #include "hw/sh4/modules/mmu.h"
 
 #include <algorithm>
+#include <chrono>
 #include <mutex>
 #include <xxhash.h>
 
@@ -13,7 +16,7 @@
 #include <omp.h>
 #endif
 
-u8* vq_codebook;
+thread_local u8* vq_codebook;
 u32 palette_index;
 bool KillTex=false;
 u32 palette16_ram[1024];
@@ -173,6 +176,8 @@ void forcePaletteUpdate()
 
 
 static std::vector<vram_block*> VramLocks[VRAM_SIZE_MAX / PAGE_SIZE];
+// Dirty bitmap mode: pages unprotected by a write fault since the last check
+static bool VramFaultedPages[VRAM_SIZE_MAX / PAGE_SIZE];
 
 //List functions
 //
@@ -213,6 +218,20 @@ void vramlock_list_add(vram_block* block)
  
 std::mutex vramlist_lock;
 
+static struct {
+	std::atomic<u64> faults;
+	std::atomic<u64> faultTime;
+	std::atomic<u64> dirtyPages;
+	std::atomic<u64> hashChecks;
+	std::atomic<u64> invalidations;
+	std::atomic<u64> checkTime;
+} vramStats;
+
+static u64 getTimeNs(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
 bool VramLockedWriteOffset(size_t offset)
 {
 	if (offset >= VRAM_SIZE)
@@ -220,31 +239,126 @@ bool VramLockedWriteOffset(size_t offset)
 
 	size_t addr_hash = offset / PAGE_SIZE;
 	std::vector<vram_block *>& list = VramLocks[addr_hash];
+	auto start = std::chrono::steady_clock::now();
 
 	{
 		std::lock_guard<std::mutex> lockguard(vramlist_lock);
 
-		for (auto& lock : list)
+		if (vramDirtyTracking)
+		{
+			// The textures are checked and the page protected again by VramCheckDirtyPages
+			VramMarkDirty((u32)offset, 1);
+			VramFaultedPages[addr_hash] = true;
+		}
+		else
 		{
-			if (lock != nullptr)
+			for (auto& lock : list)
 			{
-				lock->texture->invalidate();
-
 				if (lock != nullptr)
 				{
-					ERROR_LOG(PVR, "Error : pvr is supposed to remove lock");
-					die("Invalid state");
+					lock->texture->invalidate();
+
+					if (lock != nullptr)
+					{
+						ERROR_LOG(PVR, "Error : pvr is supposed to remove lock");
+						die("Invalid state");
+					}
 				}
 			}
+			list.clear();
 		}
-		list.clear();
 
 		_vmem_unprotect_vram((u32)(offset & ~PAGE_MASK), PAGE_SIZE);
 	}
+	vramStats.faults++;
+	vramStats.faultTime += getTimeNs(start);
 
 	return true;
 }
 
+static u32 vramCheckPass;
+
+// Invalidates the texture if its data has changed
+static void checkVramBlock(vram_block *block)
+{
+	if (block->checkPass == vramCheckPass)
+		return;
+	block->checkPass = vramCheckPass;
+	vramStats.hashChecks++;
+	if (XXH64(&vram[block->start], block->end - block->start + 1, 0) != block->hash)
+	{
+		vramStats.invalidations++;
+		// This deletes the block
+		block->texture->invalidate();
+	}
+}
+
+void VramCheckDirtyPages()
+{
+	const u32 pages = VRAM_SIZE / PAGE_SIZE;
+	bool bitmap = config::VramDirtyBitmap;
+	if (bitmap != vramDirtyTracking)
+	{
+		// Textures are locked again with the new method
+		std::lock_guard<std::mutex> lock(vramlist_lock);
+		vramDirtyTracking = bitmap;
+		for (u32 page = 0; page < pages; page++)
+		{
+			std::vector<vram_block *>& list = VramLocks[page];
+			if (list.empty())
+				continue;
+			for (vram_block *block : list)
+				if (block != nullptr)
+					block->texture->invalidate();
+			list.clear();
+			_vmem_unprotect_vram(page * PAGE_SIZE, PAGE_SIZE);
+		}
+		for (auto& word : vramDirtyPages)
+			word = 0;
+		memset(VramFaultedPages, 0, sizeof(VramFaultedPages));
+		INFO_LOG(PVR, "VRAM write tracking: %s", bitmap ? "dirty bitmap" : "page protection");
+		return;
+	}
+	if (!bitmap)
+		return;
+
+	auto start = std::chrono::steady_clock::now();
+	std::lock_guard<std::mutex> lock(vramlist_lock);
+	vramCheckPass++;
+	for (u32 i = 0; i < (pages + 63) / 64; i++)
+	{
+		u64 bits = vramDirtyPages[i].exchange(0, std::memory_order_acq_rel);
+		for (u32 page = i * 64; bits != 0; page++, bits >>= 1)
+		{
+			if ((bits & 1) == 0)
+				continue;
+			vramStats.dirtyPages++;
+			// Blocks are set to null when their texture is invalidated
+			std::vector<vram_block *>& list = VramLocks[page];
+			for (vram_block *& block : list)
+				if (block != nullptr)
+					checkVramBlock(block);
+			// Writes that don't go through a handler, such as dynarec stores to the 64-bit area,
+			// fault again once the page is protected
+			if (VramFaultedPages[page])
+			{
+				VramFaultedPages[page] = false;
+				if (std::any_of(list.begin(), list.end(), [](vram_block *block) { return block != nullptr; }))
+					_vmem_protect_vram(page * PAGE_SIZE, PAGE_SIZE);
+			}
+		}
+	}
+	vramStats.checkTime += getTimeNs(start);
+}
+
+VramTrackingStats vramTrackingGetStats()
+{
+	return {
+		vramStats.faults, vramStats.faultTime,
+		vramStats.dirtyPages, vramStats.hashChecks, vramStats.invalidations, vramStats.checkTime
+	};
+}
+
 bool VramLockedWrite(u8* address)
 {
 	u32 offset = _vmem_get_vram_offset(address);
@@ -318,7 +432,7 @@ struct PvrTexInfo
 };
 
 #define TEX_CONV_TABLE \
-const PvrTexInfo pvrTexInfo[8] = \
+PvrTexInfo pvrTexInfo[8] = \
 {	/* name     bpp Final format			   Planar		Twiddled	 VQ				Planar(32b)    Twiddled(32b)  VQ (32b)      Palette (8b)	*/	\
 	{"1555", 	16,	TextureType::_5551,        tex1555_PL,  tex1555_TW,  tex1555_VQ,    tex1555_PL32,  tex1555_TW32,  tex1555_VQ32, nullptr },			\
 	{"565", 	16, TextureType::_565,         tex565_PL,   tex565_TW,   tex565_VQ,     tex565_PL32,   tex565_TW32,   tex565_VQ32,  nullptr },	    	\
@@ -339,6 +453,28 @@ namespace directx {
 #undef TEX_CONV_TABLE
 static const PvrTexInfo *pvrTexInfo = opengl::pvrTexInfo;
 
+// Replaces the twiddled and VQ decoders by the SIMD ones supported by the cpu
+static void UseSimdDecoders(PvrTexInfo *table, const TexConvDecoders *decoders)
+{
+	for (int i = Pixel1555; i <= PixelPal8; i++)
+	{
+		table[i].TW = decoders[i].TW;
+		table[i].VQ = decoders[i].VQ;
+		table[i].TW32 = decoders[i].TW32;
+		table[i].VQ32 = decoders[i].VQ32;
+		table[i].TW8 = decoders[i].TW8;
+	}
+}
+
+static void SelectTexConvDecoders()
+{
+	TexConvIsa isa = texconv_BestIsa();
+	UseSimdDecoders(opengl::pvrTexInfo, texconv_Decoders(isa, false));
+	UseSimdDecoders(directx::pvrTexInfo, texconv_Decoders(isa, true));
+}
+
+static OnLoad stcd(&SelectTexConvDecoders);
+
 static const u32 VQMipPoint[11] =
 {
 	0x00000,//1
@@ -430,6 +566,8 @@ void BaseTextureCacheData::protectVRam()
 	block->end = end;
 	block->start = sa_tex;
 	block->texture = this;
+	if (vramDirtyTracking)
+		block->hash = XXH64(&vram[sa_tex], end - sa_tex + 1, 0);
 
 	{
 		std::lock_guard<std::mutex> lock(vramlist_lock);
@@ -459,6 +597,11 @@ bool BaseTextureCacheData::Delete()
 		return false;
 
 	unprotectVRam();
+	if (decodeJob != nullptr)
+	{
+		decodeJob->cancelled = true;
+		decodeJob.reset();
+	}
 
 	free(custom_image_data);
 	custom_image_data = nullptr;
@@ -568,104 +711,20 @@ void BaseTextureCacheData::ComputeHash()
 	texture_hash ^= tcw.full & tcwMask;
 }
 
-void BaseTextureCacheData::Update()
+void TextureDecodeJob::decode(u8 *texData)
 {
-	//texture state tracking stuff
-	Updates++;
-	dirty = 0;
-	gpuPalette = false;
-	tex_type = tex->type;
-
-	bool has_alpha = false;
-	if (IsPaletted())
-	{
-		if (IsGpuHandledPaletted(tsp, tcw))
-		{
-			tex_type = TextureType::_8;
-			gpuPalette = true;
-		}
-		else
-		{
-			tex_type = PAL_TYPE[PAL_RAM_CTRL&3];
-			if (tex_type != TextureType::_565)
-				has_alpha = true;
-		}
-
-		// Get the palette hash to check for future updates
-		// TODO get rid of ::palette_index and ::vq_codebook
-		if (tcw.PixelFmt == PixelPal4)
-		{
-			palette_hash = pal_hash_16[tcw.PalSelect];
-			::palette_index = tcw.PalSelect << 4;
-		}
-		else
-		{
-			palette_hash = pal_hash_256[tcw.PalSelect >> 4];
-			::palette_index = (tcw.PalSelect >> 4) << 8;
-		}
-	}
-
 	if (tcw.VQ_Comp)
-		::vq_codebook = &vram[sa_tex];    // might be used if VQ tex
-
-	//texture conversion work
-	u32 stride = width;
+		::vq_codebook = texData;    // might be used if VQ tex
+	dataWidth = width;
+	dataHeight = height;
 
-	if (tcw.StrideSel && tcw.ScanOrder && (tex->PL || tex->PL32))
-		stride = (TEXT_CONTROL & 31) * 32;
-
-	u32 original_h = height;
-	if (sa_tex > VRAM_SIZE || size == 0 || sa + size > VRAM_SIZE)
+	if (texconv32 != NULL && need32bit)
 	{
-		if (sa < VRAM_SIZE && sa + size > VRAM_SIZE && tcw.ScanOrder && stride > 0)
-		{
-			// Shenmue Space Harrier mini-arcade loads a texture that goes beyond the end of VRAM
-			// but only uses the top portion of it
-			height = (VRAM_SIZE - sa) * 8 / stride / tex->bpp;
-			size = stride * height * tex->bpp/8;
-		}
-		else
-		{
-			WARN_LOG(RENDERER, "Warning: invalid texture. Address %08X %08X size %d", sa_tex, sa, size);
-			return;
-		}
-	}
-	if (config::CustomTextures)
-		custom_texture.LoadCustomTextureAsync(this);
-
-	void *temp_tex_buffer = NULL;
-	u32 upscaled_w = width;
-	u32 upscaled_h = height;
-
-	PixelBuffer<u16> pb16;
-	PixelBuffer<u32> pb32;
-	PixelBuffer<u8> pb8;
-
-	// Figure out if we really need to use a 32-bit pixel buffer
-	bool textureUpscaling = config::TextureUpscale > 1
-			// Don't process textures that are too big
-			&& (int)(width * height) <= config::MaxFilteredTextureSize * config::MaxFilteredTextureSize
-			// Don't process YUV textures
-			&& tcw.PixelFmt != PixelYUV;
-	bool need_32bit_buffer = true;
-	if (!textureUpscaling
-		&& (!IsPaletted() || tex_type != TextureType::_8888)
-		&& texconv != NULL
-		&& !Force32BitTexture(tex_type))
-		need_32bit_buffer = false;
-	// TODO avoid upscaling/depost. textures that change too often
-#ifdef __vita__
-	bool mipmapped = false;
-#else
-	bool mipmapped = IsMipmapped() && !config::DumpTextures;
-#endif
-	if (texconv32 != NULL && need_32bit_buffer)
-	{
-		if (textureUpscaling)
+		if (upscale > 1)
 			// don't use mipmaps if upscaling
 			mipmapped = false;
 		// Force the texture type since that's the only 32-bit one we know
-		tex_type = TextureType::_8888;
+		texType = TextureType::_8888;
 
 		if (mipmapped)
 		{
@@ -676,49 +735,49 @@ void BaseTextureCacheData::Update()
 				u32 vram_addr;
 				if (tcw.VQ_Comp)
 				{
-					vram_addr = sa_tex + VQMipPoint[i];
+					vram_addr = VQMipPoint[i];
 					if (i == 0)
 					{
 						PixelBuffer<u32> pb0;
 						pb0.init(2, 2 ,false);
-						texconv32(&pb0, (u8*)&vram[vram_addr], 2, 2);
+						texconv32(&pb0, &texData[vram_addr], 2, 2);
 						*pb32.data() = *pb0.data(1, 1);
 						continue;
 					}
 				}
 				else
-					vram_addr = sa_tex + OtherMipPoint[i] * tex->bpp / 8;
+					vram_addr = OtherMipPoint[i] * tex->bpp / 8;
 				if (tcw.PixelFmt == PixelYUV && i == 0)
 					// Special case for YUV at 1x1 LoD
-					pvrTexInfo[Pixel565].TW32(&pb32, &vram[vram_addr], 1, 1);
+					pvrTexInfo[Pixel565].TW32(&pb32, &texData[vram_addr], 1, 1);
 				else
-					texconv32(&pb32, &vram[vram_addr], 1 << i, 1 << i);
+					texconv32(&pb32, &texData[vram_addr], 1 << i, 1 << i);
 			}
 			pb32.set_mipmap(0);
 		}
 		else
 		{
 			pb32.init(width, height);
-			texconv32(&pb32, (u8*)&vram[sa], stride, height);
+			texconv32(&pb32, &texData[offset], stride, height);
 
 			// xBRZ scaling
-			if (textureUpscaling)
+			if (upscale > 1)
 			{
 				PixelBuffer<u32> tmp_buf;
-				tmp_buf.init(width * config::TextureUpscale, height * config::TextureUpscale);
+				tmp_buf.init(width * upscale, height * upscale);
 
 				if (tcw.PixelFmt == Pixel1555 || tcw.PixelFmt == Pixel4444)
 					// Alpha channel formats. Palettes with alpha are already handled
-					has_alpha = true;
-				UpscalexBRZ(config::TextureUpscale, pb32.data(), tmp_buf.data(), width, height, has_alpha);
+					hasAlpha = true;
+				UpscalexBRZ(upscale, pb32.data(), tmp_buf.data(), width, height, hasAlpha);
 				pb32.steal_data(tmp_buf);
-				upscaled_w *= config::TextureUpscale;
-				upscaled_h *= config::TextureUpscale;
+				dataWidth *= upscale;
+				dataHeight *= upscale;
 			}
 		}
-		temp_tex_buffer = pb32.data();
+		data = (u8 *)pb32.data();
 	}
-	else if (texconv8 != NULL && tex_type == TextureType::_8)
+	else if (texconv8 != NULL && texType == TextureType::_8)
 	{
 		if (mipmapped)
 		{
@@ -727,17 +786,17 @@ void BaseTextureCacheData::Update()
 			for (u32 i = 0; i <= tsp.TexU + 3u; i++)
 			{
 				pb8.set_mipmap(i);
-				u32 vram_addr = sa_tex + OtherMipPoint[i] * tex->bpp / 8;
-				texconv8(&pb8, &vram[vram_addr], 1 << i, 1 << i);
+				u32 vram_addr = OtherMipPoint[i] * tex->bpp / 8;
+				texconv8(&pb8, &texData[vram_addr], 1 << i, 1 << i);
 			}
 			pb8.set_mipmap(0);
 		}
 		else
 		{
 			pb8.init(width, height);
-			texconv8(&pb8, &vram[sa], stride, height);
+			texconv8(&pb8, &texData[offset], stride, height);
 		}
-		temp_tex_buffer = pb8.data();
+		data = pb8.data();
 	}
 	else if (texconv != NULL)
 	{
@@ -750,28 +809,28 @@ void BaseTextureCacheData::Update()
 				u32 vram_addr;
 				if (tcw.VQ_Comp)
 				{
-					vram_addr = sa_tex + VQMipPoint[i];
+					vram_addr = VQMipPoint[i];
 					if (i == 0)
 					{
 						PixelBuffer<u16> pb0;
 						pb0.init(2, 2 ,false);
-						texconv(&pb0, (u8*)&vram[vram_addr], 2, 2);
+						texconv(&pb0, &texData[vram_addr], 2, 2);
 						*pb16.data() = *pb0.data(1, 1);
 						continue;
 					}
 				}
 				else
-					vram_addr = sa_tex + OtherMipPoint[i] * tex->bpp / 8;
-				texconv(&pb16, (u8*)&vram[vram_addr], 1 << i, 1 << i);
+					vram_addr = OtherMipPoint[i] * tex->bpp / 8;
+				texconv(&pb16, &texData[vram_addr], 1 << i, 1 << i);
 			}
 			pb16.set_mipmap(0);
 		}
 		else
 		{
 			pb16.init(width, height);
-			texconv(&pb16,(u8*)&vram[sa],stride,height);
+			texconv(&pb16, &texData[offset], stride, height);
 		}
-		temp_tex_buffer = pb16.data();
+		data = (u8 *)pb16.data();
 	}
 	else
 	{
@@ -779,37 +838,243 @@ void BaseTextureCacheData::Update()
 		WARN_LOG(RENDERER, "UNHANDLED TEXTURE");
 		pb16.init(width, height);
 		memset(pb16.data(), 0x80, width * height * 2);
-		temp_tex_buffer = pb16.data();
+		data = (u8 *)pb16.data();
 		mipmapped = false;
 	}
+}
+
+// Smaller textures are always decoded synchronously
+constexpr u32 AsyncDecodeMinPixels = 128 * 128;
+
+void BaseTextureCacheData::Update()
+{
+	//texture state tracking stuff
+	Updates++;
+	dirty = 0;
+	gpuPalette = false;
+	tex_type = tex->type;
+	if (decodeJob != nullptr)
+	{
+		// A newer version of the texture is needed
+		decodeJob->cancelled = true;
+		decodeJob.reset();
+	}
+
+	bool has_alpha = false;
+	if (IsPaletted())
+	{
+		if (IsGpuHandledPaletted(tsp, tcw))
+		{
+			tex_type = TextureType::_8;
+			gpuPalette = true;
+		}
+		else
+		{
+			tex_type = PAL_TYPE[PAL_RAM_CTRL&3];
+			if (tex_type != TextureType::_565)
+				has_alpha = true;
+		}
+
+		// Get the palette hash to check for future updates
+		// TODO get rid of ::palette_index and ::vq_codebook
+		if (tcw.PixelFmt == PixelPal4)
+		{
+			palette_hash = pal_hash_16[tcw.PalSelect];
+			::palette_index = tcw.PalSelect << 4;
+		}
+		else
+		{
+			palette_hash = pal_hash_256[tcw.PalSelect >> 4];
+			::palette_index = (tcw.PalSelect >> 4) << 8;
+		}
+	}
+
+	//texture conversion work
+	u32 stride = width;
+
+	if (tcw.StrideSel && tcw.ScanOrder && (tex->PL || tex->PL32))
+		stride = (TEXT_CONTROL & 31) * 32;
+
+	u32 original_h = height;
+	if (sa_tex > VRAM_SIZE || size == 0 || sa + size > VRAM_SIZE)
+	{
+		if (sa < VRAM_SIZE && sa + size > VRAM_SIZE && tcw.ScanOrder && stride > 0)
+		{
+			// Shenmue Space Harrier mini-arcade loads a texture that goes beyond the end of VRAM
+			// but only uses the top portion of it
+			height = (VRAM_SIZE - sa) * 8 / stride / tex->bpp;
+			size = stride * height * tex->bpp/8;
+		}
+		else
+		{
+			WARN_LOG(RENDERER, "Warning: invalid texture. Address %08X %08X size %d", sa_tex, sa, size);
+			return;
+		}
+	}
+	if (config::CustomTextures)
+		custom_texture.LoadCustomTextureAsync(this);
+
+	std::shared_ptr<TextureDecodeJob> job = std::make_shared<TextureDecodeJob>();
+	job->tsp = tsp;
+	job->tcw = tcw;
+	job->tex = tex;
+	job->texconv = texconv;
+	job->texconv32 = texconv32;
+	job->texconv8 = texconv8;
+	job->texType = tex_type;
+	job->width = width;
+	job->height = height;
+	job->stride = stride;
+	job->offset = sa - sa_tex;
+	job->hasAlpha = has_alpha;
+
+	// Figure out if we really need to use a 32-bit pixel buffer
+	bool textureUpscaling = config::TextureUpscale > 1
+			// Don't process textures that are too big
+			&& (int)(width * height) <= config::MaxFilteredTextureSize * config::MaxFilteredTextureSize
+			// Don't process YUV textures
+			&& tcw.PixelFmt != PixelYUV;
+	job->upscale = textureUpscaling ? config::TextureUpscale : 1;
+	job->need32bit = true;
+	if (!textureUpscaling
+		&& (!IsPaletted() || tex_type != TextureType::_8888)
+		&& texconv != NULL
+		&& !Force32BitTexture(tex_type))
+		job->need32bit = false;
+	// TODO avoid upscaling/depost. textures that change too often
+#ifdef __vita__
+	job->mipmapped = false;
+#else
+	job->mipmapped = IsMipmapped() && !config::DumpTextures;
+#endif
+
+	// VQ indices take one byte per 2x2 block so they may extend beyond the locked area
+	u32 dataSize = tcw.VQ_Comp ? job->offset + 256 * 8 + width * height / 4 : job->offset + size;
+	if (config::TextureContentCacheSize == 0)
+		// Release the cached textures if the cache has been disabled
+		textureContentCache.Clear();
+	else if (!config::DumpTextures && sa_tex + dataSize <= VRAM_SIZE)
+	{
+		TextureContentKey& key = job->contentKey;
+		key.dataHash = XXH64(&vram[sa_tex], dataSize, 0);
+		key.decoders[0] = (const void *)texconv;
+		key.decoders[1] = (const void *)texconv32;
+		key.decoders[2] = (const void *)texconv8;
+		key.width = width;
+		key.height = height;
+		key.stride = stride;
+		key.offset = job->offset;
+		key.paletteHash = IsPaletted() && !gpuPalette ? palette_hash : 0;
+		key.upscale = job->upscale;
+		key.texType = (int)job->texType;
+		key.need32bit = job->need32bit;
+		key.mipmapped = job->mipmapped;
+		job->cacheable = true;
+
+		std::shared_ptr<TextureDecodeJob> cached = textureContentCache.Find(key);
+		if (cached != nullptr)
+		{
+			// Same content already decoded at another address or before being overwritten
+			height = original_h;
+			protectVRam();
+			tex_type = cached->texType;
+			upload(cached->dataWidth, cached->dataHeight, cached->data, cached->mipmapped);
+			PrintTextureName();
+			return;
+		}
+	}
+	// Paletted textures are decoded with the current palette so they aren't decoded asynchronously
+	if (config::AsyncTextureDecode && !IsPaletted() && !config::DumpTextures
+			&& (u32)width * height >= AsyncDecodeMinPixels
+			&& sa_tex + dataSize <= VRAM_SIZE)
+	{
+		job->snapshot.assign(&vram[sa_tex], &vram[sa_tex] + dataSize);
+		job->frame = FrameCount;
+		decodeJob = job;
+		textureDecodePool.Enqueue(job);
+
+		height = original_h;
+		protectVRam();
+		if (Updates == 1)
+		{
+			// Draw a placeholder until the texture is decoded
+			u32 placeholder[8 * 8];
+			std::fill(std::begin(placeholder), std::end(placeholder), 0xff808080);
+			tex_type = TextureType::_8888;
+			upload(8, 8, (u8 *)placeholder, false);
+		}
+		return;
+	}
+	job->decode(&vram[sa_tex]);
 	// Restore the original texture height if it was constrained to VRAM limits above
 	height = original_h;
 
 	//lock the texture to detect changes in it
 	protectVRam();
 
-	UploadToGPU(upscaled_w, upscaled_h, (u8*)temp_tex_buffer, IsMipmapped(), mipmapped);
+	tex_type = job->texType;
+	upload(job->dataWidth, job->dataHeight, job->data, job->mipmapped);
+	if (job->cacheable)
+		textureContentCache.Add(job->contentKey, job);
 	if (config::DumpTextures)
 	{
 		ComputeHash();
-		custom_texture.DumpTexture(texture_hash, upscaled_w, upscaled_h, tex_type, temp_tex_buffer);
+		custom_texture.DumpTexture(texture_hash, job->dataWidth, job->dataHeight, tex_type, job->data);
 		NOTICE_LOG(RENDERER, "Dumped texture %x.png. Old hash %x", texture_hash, old_texture_hash);
 	}
 	PrintTextureName();
 }
 
+void BaseTextureCacheData::upload(int width, int height, u8 *data, bool mipmapsIncluded)
+{
+	bool mipmapped = IsMipmapped();
+	UploadToGPU(width, height, data, mipmapped, mipmapsIncluded);
+	u32 bpp = tex_type == TextureType::_8888 ? 4 : tex_type == TextureType::_8 ? 1 : 2;
+	gpuSize = width * height * bpp;
+	if (mipmapped)
+		gpuSize = gpuSize * 4 / 3;
+}
+
 void BaseTextureCacheData::CheckCustomTexture()
 {
 	if (IsCustomTextureAvailable())
 	{
 		tex_type = TextureType::_8888;
 		gpuPalette = false;
-		UploadToGPU(custom_width, custom_height, custom_image_data, IsMipmapped(), false);
+		upload(custom_width, custom_height, custom_image_data, false);
 		free(custom_image_data);
 		custom_image_data = nullptr;
 	}
 }
 
+void BaseTextureCacheData::CheckAsyncDecode()
+{
+	if (decodeJob == nullptr)
+		return;
+	std::shared_ptr<TextureDecodeJob> job = std::move(decodeJob);
+	textureDecodePool.Wait(*job);
+	tex_type = job->texType;
+	upload(job->dataWidth, job->dataHeight, job->data, job->mipmapped);
+	if (job->cacheable)
+		textureContentCache.Add(job->contentKey, job);
+	PrintTextureName();
+}
+
+static std::mutex statsMutex;
+static TextureCacheStats textureCacheStats;
+
+TextureCacheStats textureCacheGetStats()
+{
+	std::lock_guard<std::mutex> _(statsMutex);
+	return textureCacheStats;
+}
+
+void textureCacheSetStats(const TextureCacheStats& stats)
+{
+	std::lock_guard<std::mutex> _(statsMutex);
+	textureCacheStats = stats;
+}
+
 void BaseTextureCacheData::SetDirectXColorOrder(bool enabled) {
 	pvrTexInfo = enabled ? directx::pvrTexInfo : opengl::pvrTexInfo;
 }
@@ -952,6 +1217,7 @@ void WriteTextureToVRam(u32 width, u32 height, u8 *data, u16 *dst, FB_W_CTRL_typ
 	const u8 fb_alpha_threshold = fb_w_ctrl.fb_alpha_threshold;
 
 	u8 *p = data;
+	const u32 offset = (u32)((u8 *)dst - &vram[0]);
 
 	for (u32 l = 0; l < height; l++) {
 		switch(fb_w_ctrl.fb_packmode)
@@ -983,6 +1249,7 @@ void WriteTextureToVRam(u32 width, u32 height, u8 *data, u16 *dst, FB_W_CTRL_typ
 		}
 		dst += padding;
 	}
+	VramMarkDirty(offset, (width + padding) * 2 * height);
 }
 template void WriteTextureToVRam<0, 1, 2, 3>(u32 width, u32 height, u8 *data, u16 *dst, FB_W_CTRL_type fb_w_ctrl, u32 linestride);
 template void WriteTextureToVRam<2, 1, 0, 3>(u32 width, u32 height, u8 *data, u16 *dst, FB_W_CTRL_type fb_w_ctrl, u32 linestride);
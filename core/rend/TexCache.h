@@ -2,14 +2,17 @@
 #include "oslib/oslib.h"
 #include "hw/pvr/Renderer_if.h"
 #include "cfg/option.h"
+#include "TexContentCache.h"
 
 #include <algorithm>
 #include <array>
 #include <atomic>
 #include <memory>
 #include <unordered_map>
+#include <vector>
 
-extern u8* vq_codebook;
+// Set by the thread decoding a VQ texture
+extern thread_local u8* vq_codebook;
 extern u32 palette_index;
 extern u32 palette16_ram[1024];
 extern u32 palette32_ram[1024];
@@ -439,6 +442,7 @@ void texture_TW(PixelBuffer<typename PixelConvertor::unpacked_type>* pb,u8* p_in
 template<class PixelConvertor>
 void texture_VQ(PixelBuffer<typename PixelConvertor::unpacked_type>* pb,u8* p_in,u32 Width,u32 Height)
 {
+	u8 *codebook = vq_codebook;
 	p_in += 256 * 4 * 2;	// Skip VQ codebook
 	pb->amove(0, 0);
 
@@ -451,7 +455,7 @@ void texture_VQ(PixelBuffer<typename PixelConvertor::unpacked_type>* pb,u8* p_in
 		for (u32 x = 0; x < Width; x += PixelConvertor::xpp)
 		{
 			u8 p = p_in[twop(x, y, bcx, bcy) / divider];
-			PixelConvertor::Convert(pb, &vq_codebook[p * 8]);
+			PixelConvertor::Convert(pb, &codebook[p * 8]);
 
 			pb->rmovex(PixelConvertor::xpp);
 		}
@@ -560,16 +564,71 @@ struct vram_block
 	u32 end;
 
 	BaseTextureCacheData *texture;
+	u64 hash = 0;			// hash of the data, only used with the VRAM dirty bitmap
+	u32 checkPass = 0;		// last time the hash was checked
 };
 
 bool VramLockedWriteOffset(size_t offset);
 bool VramLockedWrite(u8* address);
+// Invalidates the textures whose data has been modified according to the VRAM dirty bitmap
+// and switches between page protection and dirty bitmap if needed. Called once per frame.
+void VramCheckDirtyPages();
+
+struct VramTrackingStats
+{
+	u64 faults;			// write faults on protected VRAM pages
+	u64 faultTime;		// time spent handling write faults in ns
+	u64 dirtyPages;		// pages marked in the dirty bitmap
+	u64 hashChecks;		// texture data hash comparisons
+	u64 invalidations;	// textures invalidated after a hash comparison
+	u64 checkTime;		// time spent checking dirty pages and hashes in ns
+};
+VramTrackingStats vramTrackingGetStats();
 
 void UpscalexBRZ(int factor, u32* source, u32* dest, int width, int height, bool has_alpha);
 
 struct PvrTexInfo;
 enum class TextureType { _565, _5551, _4444, _8888, _8 };
 
+// Parameters and result of a texture decoding
+struct TextureDecodeJob
+{
+	enum State { Queued, Running, Done };
+
+	TSP tsp;
+	TCW tcw;
+	const PvrTexInfo *tex;
+	TexConvFP texconv;
+	TexConvFP32 texconv32;
+	TexConvFP8 texconv8;
+	TextureType texType;
+	u32 width;
+	u32 height;
+	u32 stride;
+	u32 offset;					// offset of the max level mipmap in the texture data
+	int upscale;				// xBRZ factor
+	bool need32bit;
+	bool hasAlpha;
+	bool mipmapped;				// true if mipmaps are decoded
+	std::vector<u8> snapshot;	// copy of the texture data if decoded asynchronously
+	u32 frame = 0;				// frame at which the asynchronous decoding was requested
+	bool cacheable = false;		// added to the content cache once decoded
+	TextureContentKey contentKey;
+
+	// Decoded texture
+	u8 *data = nullptr;
+	u32 dataWidth = 0;
+	u32 dataHeight = 0;
+	PixelBuffer<u16> pb16;
+	PixelBuffer<u32> pb32;
+	PixelBuffer<u8> pb8;
+
+	std::atomic_int state { Queued };
+	std::atomic_bool cancelled { false };
+
+	void decode(u8 *texData);
+};
+
 class BaseTextureCacheData
 {
 protected:
@@ -601,6 +660,9 @@ public:
 		custom_height = other.custom_height;
 		custom_load_in_progress = 0;
 		gpuPalette = other.gpuPalette;
+		std::swap(decodeJob, other.decodeJob);
+		lastUsed = other.lastUsed;
+		gpuSize = other.gpuSize;
 	}
 
 	TSP tsp;        	//dreamcast texture parameters
@@ -633,6 +695,9 @@ public:
 	u32 custom_height;
 	std::atomic_int custom_load_in_progress;
 	bool gpuPalette;
+	std::shared_ptr<TextureDecodeJob> decodeJob;	// pending asynchronous decoding
+	u32 lastUsed = 0;			// last frame the texture was used
+	u32 gpuSize = 0;			// size in bytes of the uploaded texture, including mipmaps
 
 	void PrintTextureName();
 	virtual std::string GetId() = 0;
@@ -667,11 +732,21 @@ public:
 		return custom_load_in_progress == 0 && custom_image_data != NULL;
 	}
 
+	// True if the texture being decoded asynchronously must be uploaded now:
+	// either it's ready or it has been stale for too long
+	bool IsAsyncDecodeReady()
+	{
+		return decodeJob != nullptr
+				&& (decodeJob->state == TextureDecodeJob::Done
+						|| FrameCount - decodeJob->frame >= (u32)config::TextureMaxStaleFrames);
+	}
+
 	void ComputeHash();
 	void Update();
 	virtual void UploadToGPU(int width, int height, u8 *temp_tex_buffer, bool mipmapped, bool mipmapsIncluded = false) = 0;
 	virtual bool Force32BitTexture(TextureType type) const { return false; }
 	void CheckCustomTexture();
+	void CheckAsyncDecode();
 	//true if : dirty or paletted texture and hashes don't match
 	bool NeedsUpdate();
 	virtual bool Delete();
@@ -693,8 +768,20 @@ public:
 				&& !tcw.VQ_Comp;
 	}
 	static void SetDirectXColorOrder(bool enabled);
+
+private:
+	void upload(int width, int height, u8 *data, bool mipmapsIncluded = false);
 };
 
+struct TextureCacheStats
+{
+	u32 entries;
+	u64 bytes;			// size of the cached textures
+	u64 evictions;		// textures evicted to stay within the memory budget
+};
+TextureCacheStats textureCacheGetStats();
+void textureCacheSetStats(const TextureCacheStats& stats);
+
 template<typename Texture>
 class BaseTextureCache
 {
@@ -726,6 +813,7 @@ public:
 		{
 			texture = &cache.emplace(std::make_pair(key, Texture(tsp, tcw))).first->second;
 		}
+		texture->lastUsed = FrameCount;
 
 		return texture;
 	}
@@ -754,26 +842,51 @@ public:
 		return getTextureCacheData(tsp, tcw);
 	}
 
-	void CollectCleanup()
+	// Deletes textures that haven't been updated for a while, and the least recently used ones
+	// if the cache exceeds its memory budget. The deleter returns false if the texture can't be deleted yet.
+	template<typename Deleter>
+	void CollectCleanup(Deleter deleter)
 	{
+		VramCheckDirtyPages();
 		std::vector<u64> list;
 
 		u32 TargetFrame = std::max((u32)120, FrameCount) - 120;
+		u64 bytes = 0;
 
 		for (const auto& pair : cache)
 		{
-			if (pair.second.dirty && pair.second.dirty < TargetFrame)
+			bytes += pair.second.gpuSize;
+			if (list.size() < 6 && pair.second.dirty && pair.second.dirty < TargetFrame)
 				list.push_back(pair.first);
-
-			if (list.size() > 5)
-				break;
 		}
 
 		for (u64 id : list)
+			deleteTexture(cache.find(id), deleter, bytes);
+
+		const u64 budget = (u64)config::TextureCacheBudget * 1024 * 1024;
+		if (budget != 0 && bytes > budget)
 		{
-			if (cache.find(id)->second.Delete())
-				cache.erase(id);
+			// Textures used by the last frame are kept to avoid thrashing
+			std::vector<std::pair<u32, u64>> lru;
+			for (const auto& pair : cache)
+				if (pair.second.lastUsed + 1 < FrameCount)
+					lru.emplace_back(pair.second.lastUsed, pair.first);
+			std::sort(lru.begin(), lru.end());
+
+			for (const auto& entry : lru)
+			{
+				if (bytes <= budget)
+					break;
+				if (deleteTexture(cache.find(entry.second), deleter, bytes))
+					evictions++;
+			}
 		}
+		textureCacheSetStats({ (u32)cache.size(), bytes, evictions });
+	}
+
+	void CollectCleanup()
+	{
+		CollectCleanup([](Texture& texture) { return texture.Delete(); });
 	}
 
 	void Clear()
@@ -782,12 +895,26 @@ public:
 			pair.second.Delete();
 
 		cache.clear();
+		textureContentCache.Clear();
+		textureCacheSetStats({ 0, 0, evictions });
 		KillTex = false;
 		INFO_LOG(RENDERER, "Texture cache cleared");
 	}
 
 protected:
+	template<typename Deleter>
+	bool deleteTexture(TexCacheIter it, Deleter& deleter, u64& bytes)
+	{
+		u32 size = it->second.gpuSize;
+		if (!deleter(it->second))
+			return false;
+		cache.erase(it);
+		bytes -= size;
+		return true;
+	}
+
 	std::unordered_map<u64, Texture> cache;
+	u64 evictions = 0;
 	// Only use TexU and TexV from TSP in the cache key
 	//     TexV : 7, TexU : 7
 	const TSP TSPTextureCacheMask = { { 7, 7 } };
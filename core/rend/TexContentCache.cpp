@@ -0,0 +1,87 @@
+#include "TexContentCache.h"
+#include "TexCache.h"
+
+TextureContentCache textureContentCache;
+
+bool TextureContentKey::operator==(const TextureContentKey& other) const
+{
+	return dataHash == other.dataHash
+			&& decoders[0] == other.decoders[0]
+			&& decoders[1] == other.decoders[1]
+			&& decoders[2] == other.decoders[2]
+			&& width == other.width
+			&& height == other.height
+			&& stride == other.stride
+			&& offset == other.offset
+			&& paletteHash == other.paletteHash
+			&& upscale == other.upscale
+			&& texType == other.texType
+			&& need32bit == other.need32bit
+			&& mipmapped == other.mipmapped;
+}
+
+std::shared_ptr<TextureDecodeJob> TextureContentCache::Find(const TextureContentKey& key)
+{
+	// The size limit may have been lowered
+	trim((size_t)config::TextureContentCacheSize * 1024 * 1024);
+	auto it = entries.find(key);
+	if (it == entries.end())
+	{
+		stats.misses++;
+		return nullptr;
+	}
+	stats.hits++;
+	lru.splice(lru.begin(), lru, it->second.lru);
+
+	return it->second.job;
+}
+
+void TextureContentCache::Add(const TextureContentKey& key, const std::shared_ptr<TextureDecodeJob>& job)
+{
+	size_t maxBytes = (size_t)config::TextureContentCacheSize * 1024 * 1024;
+	u32 bpp = job->texType == TextureType::_8888 ? 4 : job->texType == TextureType::_8 ? 1 : 2;
+	size_t bytes = job->dataWidth * job->dataHeight * bpp;
+	if (job->mipmapped)
+		bytes = bytes * 4 / 3;
+	if (bytes > maxBytes)
+		return;
+	// Only the decoded texture is kept
+	std::vector<u8>().swap(job->snapshot);
+
+	auto it = entries.find(key);
+	if (it != entries.end())
+	{
+		stats.bytes -= it->second.bytes;
+		lru.erase(it->second.lru);
+		entries.erase(it);
+	}
+	trim(maxBytes - bytes);
+	lru.push_front(key);
+	entries.emplace(key, Entry{ job, bytes, lru.begin() });
+	stats.bytes += bytes;
+	stats.entries = (u32)entries.size();
+}
+
+void TextureContentCache::trim(size_t maxBytes)
+{
+	while (stats.bytes > maxBytes)
+	{
+		auto it = entries.find(lru.back());
+		stats.bytes -= it->second.bytes;
+		entries.erase(it);
+		lru.pop_back();
+		stats.evictions++;
+	}
+	stats.entries = (u32)entries.size();
+}
+
+void TextureContentCache::Clear()
+{
+	if (stats.hits + stats.misses != 0)
+		INFO_LOG(RENDERER, "Texture content cache: %.1f%% hits (%llu hits, %llu misses, %llu evictions), %u textures, %zu KB",
+				stats.hitRate() * 100.f, (unsigned long long)stats.hits, (unsigned long long)stats.misses,
+				(unsigned long long)stats.evictions, stats.entries, stats.bytes / 1024);
+	entries.clear();
+	lru.clear();
+	stats = {};
+}
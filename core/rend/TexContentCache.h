@@ -0,0 +1,79 @@
+/*
+	Content-addressed cache of decoded textures.
+
+	Texture cache entries are keyed by their VRAM address and format, so a texture copied to
+	several addresses, or invalidated and written again with the same data, is decoded again.
+	This second-level cache keeps recently decoded textures indexed by a hash of their VRAM data
+	and by everything else their decoding depends on. A texture update that finds its content here
+	uploads the cached pixels instead of decoding them. GPU textures aren't shared.
+	The cache size is limited to rend.TextureContentCacheSize MB and the least recently used
+	textures are evicted first.
+*/
+#pragma once
+#include "types.h"
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+struct TextureDecodeJob;
+
+struct TextureContentKey
+{
+	u64 dataHash;
+	const void *decoders[3];	// 16-bit, 32-bit and 8-bit decoders
+	u32 width;
+	u32 height;
+	u32 stride;
+	u32 offset;
+	u32 paletteHash;
+	int upscale;
+	int texType;
+	bool need32bit;
+	bool mipmapped;
+
+	bool operator==(const TextureContentKey& other) const;
+};
+
+struct TextureContentCacheStats
+{
+	u64 hits;
+	u64 misses;
+	u64 evictions;
+	u32 entries;
+	size_t bytes;
+
+	float hitRate() const {
+		return hits + misses == 0 ? 0.f : (float)hits / (hits + misses);
+	}
+};
+
+class TextureContentCache
+{
+public:
+	// Returns the decoded texture or nullptr
+	std::shared_ptr<TextureDecodeJob> Find(const TextureContentKey& key);
+	// Adds a decoded texture and evicts the least recently used ones if needed
+	void Add(const TextureContentKey& key, const std::shared_ptr<TextureDecodeJob>& job);
+	void Clear();
+	const TextureContentCacheStats& getStats() const { return stats; }
+
+private:
+	struct KeyHash {
+		size_t operator()(const TextureContentKey& key) const { return (size_t)key.dataHash; }
+	};
+	using LruList = std::list<TextureContentKey>;
+	struct Entry
+	{
+		std::shared_ptr<TextureDecodeJob> job;
+		size_t bytes;
+		LruList::iterator lru;
+	};
+	void trim(size_t maxBytes);
+
+	std::unordered_map<TextureContentKey, Entry, KeyHash> entries;
+	LruList lru;		// most recently used first
+	TextureContentCacheStats stats {};
+};
+
+extern TextureContentCache textureContentCache;
@@ -0,0 +1,893 @@
+#include "TexConvSimd.h"
+
+#include <cstring>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEXCONV_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__)
+// Selected at runtime
+#define TEXCONV_AVX2
+#define AVX2_FUNC __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define TEXCONV_NEON
+#include <arm_neon.h>
+#endif
+
+namespace scalar {
+
+// Describes the texel format and the scalar convertor of each decoder
+
+template<typename Convertor_, u32 Bpp>
+struct Format
+{
+	using Convertor = Convertor_;
+	using unpacked_type = typename Convertor::unpacked_type;
+	static constexpr u32 bpp = Bpp;
+};
+
+using Nop = Format<ConvertTwiddle<UnpackerNop<u16>>, 16>;
+using Argb1555 = Format<ConvertTwiddle<Unpacker1555>, 16>;
+using Argb4444 = Format<ConvertTwiddle<Unpacker4444>, 16>;
+template<typename Packer>
+using Rgb565_32 = Format<ConvertTwiddle<Unpacker565_32<Packer>>, 16>;
+template<typename Packer>
+using Argb1555_32 = Format<ConvertTwiddle<Unpacker1555_32<Packer>>, 16>;
+template<typename Packer>
+using Argb4444_32 = Format<ConvertTwiddle<Unpacker4444_32<Packer>>, 16>;
+template<typename Packer>
+using Yuv = Format<ConvertTwiddleYUV<Packer>, 16>;
+template<typename Pixel, u32 Bpp>
+using Pal = Format<typename std::conditional<Bpp == 4,
+		ConvertTwiddlePal4<typename std::conditional<sizeof(Pixel) == 1, UnpackerNop<u8>, UnpackerPalToRgb<Pixel>>::type>,
+		ConvertTwiddlePal8<typename std::conditional<sizeof(Pixel) == 1, UnpackerNop<u8>, UnpackerPalToRgb<Pixel>>::type>>::type, Bpp>;
+
+template<typename Format>
+void twiddled(PixelBuffer<typename Format::unpacked_type> *pb, u8 *p_in, u32 width, u32 height)
+{
+	texture_TW<typename Format::Convertor>(pb, p_in, width, height);
+}
+
+template<typename Format>
+void vq(PixelBuffer<typename Format::unpacked_type> *pb, u8 *p_in, u32 width, u32 height)
+{
+	texture_VQ<typename Format::Convertor>(pb, p_in, width, height);
+}
+
+}
+
+// A row of 4 palette indices
+static inline void storeRow(u32 indices, u8 *dst)
+{
+	memcpy(dst, &indices, sizeof(indices));
+}
+
+static inline void storeRow(u32 indices, u16 *dst)
+{
+	const u32 *pal = &palette16_ram[palette_index];
+	dst[0] = pal[indices & 0xff];
+	dst[1] = pal[(indices >> 8) & 0xff];
+	dst[2] = pal[(indices >> 16) & 0xff];
+	dst[3] = pal[indices >> 24];
+}
+
+static inline void storeRow(u32 indices, u32 *dst)
+{
+	const u32 *pal = &palette32_ram[palette_index];
+	dst[0] = pal[indices & 0xff];
+	dst[1] = pal[(indices >> 8) & 0xff];
+	dst[2] = pal[(indices >> 16) & 0xff];
+	dst[3] = pal[indices >> 24];
+}
+
+// Decodes the texture by 4x4 tiles. Smaller textures use the scalar decoder.
+template<typename Format>
+void texture_TW_tiles(PixelBuffer<typename Format::unpacked_type> *pb, u8 *p_in, u32 width, u32 height)
+{
+	if (width < 4 || height < 4)
+	{
+		scalar::twiddled<Format>(pb, p_in, width, height);
+		return;
+	}
+	const u32 bcx = bitscanrev(width);
+	const u32 bcy = bitscanrev(height);
+	const u32 stride = (u32)(pb->data(0, 1) - pb->data());
+
+	for (u32 y = 0; y < height; y += 4)
+		for (u32 x = 0; x < width; x += 4)
+			Format::tile(&p_in[twop(x, y, bcx, bcy) * Format::bpp / 8], pb->data(x, y), stride);
+}
+
+template<typename Format>
+void texture_VQ_tiles(PixelBuffer<typename Format::unpacked_type> *pb, u8 *p_in, u32 width, u32 height)
+{
+	if (width < 4 || height < 4)
+	{
+		scalar::vq<Format>(pb, p_in, width, height);
+		return;
+	}
+	const u8 *codebook = vq_codebook;
+	p_in += 256 * 4 * 2;	// Skip VQ codebook
+	const u32 bcx = bitscanrev(width);
+	const u32 bcy = bitscanrev(height);
+	const u32 stride = (u32)(pb->data(0, 1) - pb->data());
+
+	// A codebook entry is 64 bits
+	for (u32 y = 0; y < height; y += 4)
+		for (u32 x = 0; x < width; x += 4)
+			Format::vqTile(codebook, &p_in[twop(x, y, bcx, bcy) * Format::bpp / 64], pb->data(x, y), stride);
+}
+
+#ifdef TEXCONV_SSE2
+namespace sse2 {
+
+// [e0 o0 e1 o1 e2 o2 e3 o3] -> [e0 e1 e2 e3 o0 o1 o2 o3]
+static inline __m128i deinterleave(__m128i v)
+{
+	v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 1, 2, 0));
+	v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(3, 1, 2, 0));
+	return _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+// 16 texels of 8 bits in twiddled order to 4 rows
+static inline __m128i tileRows8(__m128i v)
+{
+	__m128i even = _mm_and_si128(v, _mm_set1_epi16(0xff));
+	__m128i odd = _mm_srli_epi16(v, 8);
+	return deinterleave(_mm_packus_epi16(even, odd));
+}
+
+// 16 texels of 4 bits (64 bits) in twiddled order to 4 rows of 8-bit texels
+static inline __m128i tileRows4(__m128i v)
+{
+	const __m128i mask = _mm_set1_epi8(0xf);
+	__m128i even = _mm_and_si128(v, mask);
+	__m128i odd = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+	return deinterleave(_mm_unpacklo_epi64(even, odd));
+}
+
+static inline __m128i loadEntry(const u8 *codebook, u8 index)
+{
+	return _mm_loadl_epi64((const __m128i *)&codebook[index * 8]);
+}
+
+// Two rows of 16-bit pixels
+static inline void storeRows(__m128i rows, u16 *dst, u32 stride)
+{
+	_mm_storel_epi64((__m128i *)dst, rows);
+	_mm_storeh_pd((double *)(dst + stride), _mm_castsi128_pd(rows));
+}
+
+// Two rows of 32-bit pixels, given their low and high 16 bits
+static inline void storeRows(__m128i lo, __m128i hi, u32 *dst, u32 stride)
+{
+	_mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi16(lo, hi));
+	_mm_storeu_si128((__m128i *)(dst + stride), _mm_unpackhi_epi16(lo, hi));
+}
+
+static inline void pack(RGBAPacker, __m128i r, __m128i g, __m128i b, __m128i a, u32 *dst, u32 stride)
+{
+	storeRows(_mm_or_si128(r, _mm_slli_epi16(g, 8)), _mm_or_si128(b, _mm_slli_epi16(a, 8)), dst, stride);
+}
+
+static inline void pack(BGRAPacker, __m128i r, __m128i g, __m128i b, __m128i a, u32 *dst, u32 stride)
+{
+	storeRows(_mm_or_si128(b, _mm_slli_epi16(g, 8)), _mm_or_si128(r, _mm_slli_epi16(a, 8)), dst, stride);
+}
+
+// (v >> shift) & mask
+template<int Shift>
+static inline __m128i field(__m128i v, int mask)
+{
+	return _mm_and_si128(_mm_srli_epi16(v, Shift), _mm_set1_epi16(mask));
+}
+
+// Signed division rounding toward zero like C
+template<int Shift>
+static inline __m128i divide(__m128i v)
+{
+	__m128i bias = _mm_and_si128(_mm_srai_epi16(v, 15), _mm_set1_epi16((1 << Shift) - 1));
+	return _mm_srai_epi16(_mm_add_epi16(v, bias), Shift);
+}
+
+static inline __m128i clamp255(__m128i v)
+{
+	return _mm_max_epi16(_mm_min_epi16(v, _mm_set1_epi16(255)), _mm_setzero_si128());
+}
+
+// Formats with 16-bit texels convert two rows at a time
+template<typename Derived, typename Base>
+struct Texel16 : Base
+{
+	static void tile(const u8 *src, typename Base::unpacked_type *dst, u32 stride)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i *)src);
+		__m128i b = _mm_loadu_si128((const __m128i *)(src + 16));
+		Derived::convert(deinterleave(_mm_unpacklo_epi64(a, b)), dst, stride);
+		Derived::convert(deinterleave(_mm_unpackhi_epi64(a, b)), dst + stride * 2, stride);
+	}
+
+	// The 4 entries of a tile are 2x2 blocks in twiddled order
+	static void vqTile(const u8 *codebook, const u8 *indices, typename Base::unpacked_type *dst, u32 stride)
+	{
+		__m128i a = _mm_unpacklo_epi64(loadEntry(codebook, indices[0]), loadEntry(codebook, indices[1]));
+		__m128i b = _mm_unpacklo_epi64(loadEntry(codebook, indices[2]), loadEntry(codebook, indices[3]));
+		Derived::convert(deinterleave(_mm_unpacklo_epi64(a, b)), dst, stride);
+		Derived::convert(deinterleave(_mm_unpackhi_epi64(a, b)), dst + stride * 2, stride);
+	}
+};
+
+struct Nop : Texel16<Nop, scalar::Nop>
+{
+	static void convert(__m128i w, u16 *dst, u32 stride) {
+		storeRows(w, dst, stride);
+	}
+};
+
+// ARGB1555 to RGBA5551
+struct Argb1555 : Texel16<Argb1555, scalar::Argb1555>
+{
+	static void convert(__m128i w, u16 *dst, u32 stride) {
+		storeRows(_mm_or_si128(_mm_slli_epi16(w, 1), _mm_srli_epi16(w, 15)), dst, stride);
+	}
+};
+
+// ARGB4444 to RGBA4444
+struct Argb4444 : Texel16<Argb4444, scalar::Argb4444>
+{
+	static void convert(__m128i w, u16 *dst, u32 stride) {
+		storeRows(_mm_or_si128(_mm_slli_epi16(w, 4), _mm_srli_epi16(w, 12)), dst, stride);
+	}
+};
+
+template<typename Packer>
+struct Rgb565_32 : Texel16<Rgb565_32<Packer>, scalar::Rgb565_32<Packer>>
+{
+	static void convert(__m128i w, u32 *dst, u32 stride)
+	{
+		__m128i r = _mm_or_si128(field<8>(w, 0xf8), _mm_srli_epi16(w, 13));
+		__m128i g = _mm_or_si128(field<3>(w, 0xfc), field<9>(w, 3));
+		__m128i b = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(w, 3), _mm_set1_epi16(0xf8)), field<2>(w, 7));
+		pack(Packer(), r, g, b, _mm_set1_epi16(0xff), dst, stride);
+	}
+};
+
+template<typename Packer>
+struct Argb1555_32 : Texel16<Argb1555_32<Packer>, scalar::Argb1555_32<Packer>>
+{
+	static void convert(__m128i w, u32 *dst, u32 stride)
+	{
+		__m128i r = _mm_or_si128(field<7>(w, 0xf8), field<12>(w, 7));
+		__m128i g = _mm_or_si128(field<2>(w, 0xf8), field<7>(w, 7));
+		__m128i b = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(w, 3), _mm_set1_epi16(0xf8)), field<2>(w, 7));
+		__m128i a = _mm_and_si128(_mm_srai_epi16(w, 15), _mm_set1_epi16(0xff));
+		pack(Packer(), r, g, b, a, dst, stride);
+	}
+};
+
+template<typename Packer>
+struct Argb4444_32 : Texel16<Argb4444_32<Packer>, scalar::Argb4444_32<Packer>>
+{
+	static void convert(__m128i w, u32 *dst, u32 stride)
+	{
+		__m128i r = _mm_or_si128(field<4>(w, 0xf0), field<8>(w, 0xf));
+		__m128i g = _mm_or_si128(_mm_and_si128(w, _mm_set1_epi16(0xf0)), field<4>(w, 0xf));
+		__m128i b = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(w, 4), _mm_set1_epi16(0xf0)), _mm_and_si128(w, _mm_set1_epi16(0xf)));
+		__m128i a = _mm_or_si128(field<8>(w, 0xf0), _mm_srli_epi16(w, 12));
+		pack(Packer(), r, g, b, a, dst, stride);
+	}
+};
+
+// Pixel pairs share U (low byte of the even texel) and V (low byte of the odd texel)
+template<typename Packer>
+struct Yuv : Texel16<Yuv<Packer>, scalar::Yuv<Packer>>
+{
+	static void convert(__m128i w, u32 *dst, u32 stride)
+	{
+		__m128i y = _mm_srli_epi16(w, 8);
+		__m128i c = _mm_and_si128(w, _mm_set1_epi16(0xff));
+		__m128i u = _mm_and_si128(c, _mm_set1_epi32(0xffff));
+		__m128i v = _mm_srli_epi32(c, 16);
+		u = _mm_sub_epi16(_mm_or_si128(u, _mm_slli_epi32(u, 16)), _mm_set1_epi16(128));
+		v = _mm_sub_epi16(_mm_or_si128(v, _mm_slli_epi32(v, 16)), _mm_set1_epi16(128));
+
+		__m128i r = _mm_add_epi16(y, divide<3>(_mm_mullo_epi16(v, _mm_set1_epi16(11))));
+		__m128i g = _mm_sub_epi16(y, divide<5>(_mm_add_epi16(_mm_mullo_epi16(u, _mm_set1_epi16(11)),
+				_mm_mullo_epi16(v, _mm_set1_epi16(22)))));
+		__m128i b = _mm_add_epi16(y, divide<6>(_mm_mullo_epi16(u, _mm_set1_epi16(110))));
+		pack(Packer(), clamp255(r), clamp255(g), clamp255(b), _mm_set1_epi16(0xff), dst, stride);
+	}
+};
+
+template<typename Pixel, u32 Bpp>
+struct Pal : scalar::Pal<Pixel, Bpp>
+{
+	static void tile(const u8 *src, Pixel *dst, u32 stride)
+	{
+		if (Bpp == 4)
+			store(tileRows4(_mm_loadl_epi64((const __m128i *)src)), dst, stride);
+		else
+			store(tileRows8(_mm_loadu_si128((const __m128i *)src)), dst, stride);
+	}
+
+	// A pal4 entry is a 4x4 block, a pal8 entry is a 2x4 block
+	static void vqTile(const u8 *codebook, const u8 *indices, Pixel *dst, u32 stride)
+	{
+		if (Bpp == 4)
+			store(tileRows4(loadEntry(codebook, indices[0])), dst, stride);
+		else
+			store(tileRows8(_mm_unpacklo_epi64(loadEntry(codebook, indices[0]), loadEntry(codebook, indices[1]))), dst, stride);
+	}
+
+	static void store(__m128i v, Pixel *dst, u32 stride)
+	{
+		storeRow(_mm_extract_epi16(v, 0) | (_mm_extract_epi16(v, 1) << 16), dst);
+		storeRow(_mm_extract_epi16(v, 2) | (_mm_extract_epi16(v, 3) << 16), dst + stride);
+		storeRow(_mm_extract_epi16(v, 4) | (_mm_extract_epi16(v, 5) << 16), dst + stride * 2);
+		storeRow(_mm_extract_epi16(v, 6) | (_mm_extract_epi16(v, 7) << 16), dst + stride * 3);
+	}
+};
+
+}
+#endif
+
+#ifdef TEXCONV_AVX2
+namespace avx2 {
+
+// 16 texels of 16 bits in twiddled order to [rows 0-1 | rows 2-3]
+AVX2_FUNC static inline __m256i tileRows(__m256i v)
+{
+	const __m256i deinterleave = _mm256_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15,
+			0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15);
+	return _mm256_shuffle_epi8(_mm256_permute4x64_epi64(v, _MM_SHUFFLE(3, 1, 2, 0)), deinterleave);
+}
+
+AVX2_FUNC static inline void storeRows(__m256i rows, u16 *dst, u32 stride)
+{
+	sse2::storeRows(_mm256_castsi256_si128(rows), dst, stride);
+	sse2::storeRows(_mm256_extracti128_si256(rows, 1), dst + stride * 2, stride);
+}
+
+AVX2_FUNC static inline void storeRows(__m256i lo, __m256i hi, u32 *dst, u32 stride)
+{
+	__m256i rows02 = _mm256_unpacklo_epi16(lo, hi);
+	__m256i rows13 = _mm256_unpackhi_epi16(lo, hi);
+	_mm_storeu_si128((__m128i *)dst, _mm256_castsi256_si128(rows02));
+	_mm_storeu_si128((__m128i *)(dst + stride), _mm256_castsi256_si128(rows13));
+	_mm_storeu_si128((__m128i *)(dst + stride * 2), _mm256_extracti128_si256(rows02, 1));
+	_mm_storeu_si128((__m128i *)(dst + stride * 3), _mm256_extracti128_si256(rows13, 1));
+}
+
+AVX2_FUNC static inline void pack(RGBAPacker, __m256i r, __m256i g, __m256i b, __m256i a, u32 *dst, u32 stride)
+{
+	storeRows(_mm256_or_si256(r, _mm256_slli_epi16(g, 8)), _mm256_or_si256(b, _mm256_slli_epi16(a, 8)), dst, stride);
+}
+
+AVX2_FUNC static inline void pack(BGRAPacker, __m256i r, __m256i g, __m256i b, __m256i a, u32 *dst, u32 stride)
+{
+	storeRows(_mm256_or_si256(b, _mm256_slli_epi16(g, 8)), _mm256_or_si256(r, _mm256_slli_epi16(a, 8)), dst, stride);
+}
+
+template<int Shift>
+AVX2_FUNC static inline __m256i field(__m256i v, int mask)
+{
+	return _mm256_and_si256(_mm256_srli_epi16(v, Shift), _mm256_set1_epi16(mask));
+}
+
+template<int Shift>
+AVX2_FUNC static inline __m256i divide(__m256i v)
+{
+	__m256i bias = _mm256_and_si256(_mm256_srai_epi16(v, 15), _mm256_set1_epi16((1 << Shift) - 1));
+	return _mm256_srai_epi16(_mm256_add_epi16(v, bias), Shift);
+}
+
+AVX2_FUNC static inline __m256i clamp255(__m256i v)
+{
+	return _mm256_max_epi16(_mm256_min_epi16(v, _mm256_set1_epi16(255)), _mm256_setzero_si256());
+}
+
+// Formats with 16-bit texels convert the whole tile at once
+template<typename Derived, typename Base>
+struct Texel16 : Base
+{
+	AVX2_FUNC static void tile(const u8 *src, typename Base::unpacked_type *dst, u32 stride)
+	{
+		Derived::convert(tileRows(_mm256_loadu_si256((const __m256i *)src)), dst, stride);
+	}
+
+	AVX2_FUNC static void vqTile(const u8 *codebook, const u8 *indices, typename Base::unpacked_type *dst, u32 stride)
+	{
+		__m128i a = _mm_unpacklo_epi64(sse2::loadEntry(codebook, indices[0]), sse2::loadEntry(codebook, indices[1]));
+		__m128i b = _mm_unpacklo_epi64(sse2::loadEntry(codebook, indices[2]), sse2::loadEntry(codebook, indices[3]));
+		Derived::convert(tileRows(_mm256_inserti128_si256(_mm256_castsi128_si256(a), b, 1)), dst, stride);
+	}
+};
+
+struct Nop : Texel16<Nop, scalar::Nop>
+{
+	AVX2_FUNC static void convert(__m256i w, u16 *dst, u32 stride) {
+		storeRows(w, dst, stride);
+	}
+};
+
+struct Argb1555 : Texel16<Argb1555, scalar::Argb1555>
+{
+	AVX2_FUNC static void convert(__m256i w, u16 *dst, u32 stride) {
+		storeRows(_mm256_or_si256(_mm256_slli_epi16(w, 1), _mm256_srli_epi16(w, 15)), dst, stride);
+	}
+};
+
+struct Argb4444 : Texel16<Argb4444, scalar::Argb4444>
+{
+	AVX2_FUNC static void convert(__m256i w, u16 *dst, u32 stride) {
+		storeRows(_mm256_or_si256(_mm256_slli_epi16(w, 4), _mm256_srli_epi16(w, 12)), dst, stride);
+	}
+};
+
+template<typename Packer>
+struct Rgb565_32 : Texel16<Rgb565_32<Packer>, scalar::Rgb565_32<Packer>>
+{
+	AVX2_FUNC static void convert(__m256i w, u32 *dst, u32 stride)
+	{
+		__m256i r = _mm256_or_si256(field<8>(w, 0xf8), _mm256_srli_epi16(w, 13));
+		__m256i g = _mm256_or_si256(field<3>(w, 0xfc), field<9>(w, 3));
+		__m256i b = _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi16(w, 3), _mm256_set1_epi16(0xf8)), field<2>(w, 7));
+		pack(Packer(), r, g, b, _mm256_set1_epi16(0xff), dst, stride);
+	}
+};
+
+template<typename Packer>
+struct Argb1555_32 : Texel16<Argb1555_32<Packer>, scalar::Argb1555_32<Packer>>
+{
+	AVX2_FUNC static void convert(__m256i w, u32 *dst, u32 stride)
+	{
+		__m256i r = _mm256_or_si256(field<7>(w, 0xf8), field<12>(w, 7));
+		__m256i g = _mm256_or_si256(field<2>(w, 0xf8), field<7>(w, 7));
+		__m256i b = _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi16(w, 3), _mm256_set1_epi16(0xf8)), field<2>(w, 7));
+		__m256i a = _mm256_and_si256(_mm256_srai_epi16(w, 15), _mm256_set1_epi16(0xff));
+		pack(Packer(), r, g, b, a, dst, stride);
+	}
+};
+
+template<typename Packer>
+struct Argb4444_32 : Texel16<Argb4444_32<Packer>, scalar::Argb4444_32<Packer>>
+{
+	AVX2_FUNC static void convert(__m256i w, u32 *dst, u32 stride)
+	{
+		__m256i r = _mm256_or_si256(field<4>(w, 0xf0), field<8>(w, 0xf));
+		__m256i g = _mm256_or_si256(_mm256_and_si256(w, _mm256_set1_epi16(0xf0)), field<4>(w, 0xf));
+		__m256i b = _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi16(w, 4), _mm256_set1_epi16(0xf0)),
+				_mm256_and_si256(w, _mm256_set1_epi16(0xf)));
+		__m256i a = _mm256_or_si256(field<8>(w, 0xf0), _mm256_srli_epi16(w, 12));
+		pack(Packer(), r, g, b, a, dst, stride);
+	}
+};
+
+template<typename Packer>
+struct Yuv : Texel16<Yuv<Packer>, scalar::Yuv<Packer>>
+{
+	AVX2_FUNC static void convert(__m256i w, u32 *dst, u32 stride)
+	{
+		__m256i y = _mm256_srli_epi16(w, 8);
+		__m256i c = _mm256_and_si256(w, _mm256_set1_epi16(0xff));
+		__m256i u = _mm256_and_si256(c, _mm256_set1_epi32(0xffff));
+		__m256i v = _mm256_srli_epi32(c, 16);
+		u = _mm256_sub_epi16(_mm256_or_si256(u, _mm256_slli_epi32(u, 16)), _mm256_set1_epi16(128));
+		v = _mm256_sub_epi16(_mm256_or_si256(v, _mm256_slli_epi32(v, 16)), _mm256_set1_epi16(128));
+
+		__m256i r = _mm256_add_epi16(y, divide<3>(_mm256_mullo_epi16(v, _mm256_set1_epi16(11))));
+		__m256i g = _mm256_sub_epi16(y, divide<5>(_mm256_add_epi16(_mm256_mullo_epi16(u, _mm256_set1_epi16(11)),
+				_mm256_mullo_epi16(v, _mm256_set1_epi16(22)))));
+		__m256i b = _mm256_add_epi16(y, divide<6>(_mm256_mullo_epi16(u, _mm256_set1_epi16(110))));
+		pack(Packer(), clamp255(r), clamp255(g), clamp255(b), _mm256_set1_epi16(0xff), dst, stride);
+	}
+};
+
+// Palette lookups use gathers
+AVX2_FUNC static inline void storeIndices(__m128i indices, u8 *dst, u32 stride)
+{
+	sse2::Pal<u8, 8>::store(indices, dst, stride);
+}
+
+AVX2_FUNC static inline void storeIndices(__m128i indices, u16 *dst, u32 stride)
+{
+	const int *pal = (const int *)&palette16_ram[palette_index];
+	const __m256i mask = _mm256_set1_epi32(0xffff);
+	__m256i rows01 = _mm256_and_si256(_mm256_i32gather_epi32(pal, _mm256_cvtepu8_epi32(indices), 4), mask);
+	__m256i rows23 = _mm256_and_si256(_mm256_i32gather_epi32(pal, _mm256_cvtepu8_epi32(_mm_srli_si128(indices, 8)), 4), mask);
+	// [row 0, row 2 | row 1, row 3]
+	__m256i rows = _mm256_packus_epi32(rows01, rows23);
+	__m128i rows02 = _mm256_castsi256_si128(rows);
+	__m128i rows13 = _mm256_extracti128_si256(rows, 1);
+	_mm_storel_epi64((__m128i *)dst, rows02);
+	_mm_storel_epi64((__m128i *)(dst + stride), rows13);
+	_mm_storeh_pd((double *)(dst + stride * 2), _mm_castsi128_pd(rows02));
+	_mm_storeh_pd((double *)(dst + stride * 3), _mm_castsi128_pd(rows13));
+}
+
+AVX2_FUNC static inline void storeIndices(__m128i indices, u32 *dst, u32 stride)
+{
+	const int *pal = (const int *)&palette32_ram[palette_index];
+	__m256i rows01 = _mm256_i32gather_epi32(pal, _mm256_cvtepu8_epi32(indices), 4);
+	__m256i rows23 = _mm256_i32gather_epi32(pal, _mm256_cvtepu8_epi32(_mm_srli_si128(indices, 8)), 4);
+	_mm_storeu_si128((__m128i *)dst, _mm256_castsi256_si128(rows01));
+	_mm_storeu_si128((__m128i *)(dst + stride), _mm256_extracti128_si256(rows01, 1));
+	_mm_storeu_si128((__m128i *)(dst + stride * 2), _mm256_castsi256_si128(rows23));
+	_mm_storeu_si128((__m128i *)(dst + stride * 3), _mm256_extracti128_si256(rows23, 1));
+}
+
+template<typename Pixel, u32 Bpp>
+struct Pal : scalar::Pal<Pixel, Bpp>
+{
+	AVX2_FUNC static void tile(const u8 *src, Pixel *dst, u32 stride)
+	{
+		if (Bpp == 4)
+			storeIndices(sse2::tileRows4(_mm_loadl_epi64((const __m128i *)src)), dst, stride);
+		else
+			storeIndices(sse2::tileRows8(_mm_loadu_si128((const __m128i *)src)), dst, stride);
+	}
+
+	AVX2_FUNC static void vqTile(const u8 *codebook, const u8 *indices, Pixel *dst, u32 stride)
+	{
+		if (Bpp == 4)
+			storeIndices(sse2::tileRows4(sse2::loadEntry(codebook, indices[0])), dst, stride);
+		else
+			storeIndices(sse2::tileRows8(_mm_unpacklo_epi64(sse2::loadEntry(codebook, indices[0]), sse2::loadEntry(codebook, indices[1]))),
+					dst, stride);
+	}
+};
+
+// The tile loops must be compiled for AVX2 too so that the tiles are inlined
+template<typename Format>
+AVX2_FUNC void texture_TW_tiles(PixelBuffer<typename Format::unpacked_type> *pb, u8 *p_in, u32 width, u32 height)
+{
+	if (width < 4 || height < 4)
+	{
+		scalar::twiddled<Format>(pb, p_in, width, height);
+		return;
+	}
+	const u32 bcx = bitscanrev(width);
+	const u32 bcy = bitscanrev(height);
+	const u32 stride = (u32)(pb->data(0, 1) - pb->data());
+
+	for (u32 y = 0; y < height; y += 4)
+		for (u32 x = 0; x < width; x += 4)
+			Format::tile(&p_in[twop(x, y, bcx, bcy) * Format::bpp / 8], pb->data(x, y), stride);
+}
+
+template<typename Format>
+AVX2_FUNC void texture_VQ_tiles(PixelBuffer<typename Format::unpacked_type> *pb, u8 *p_in, u32 width, u32 height)
+{
+	if (width < 4 || height < 4)
+	{
+		scalar::vq<Format>(pb, p_in, width, height);
+		return;
+	}
+	const u8 *codebook = vq_codebook;
+	p_in += 256 * 4 * 2;	// Skip VQ codebook
+	const u32 bcx = bitscanrev(width);
+	const u32 bcy = bitscanrev(height);
+	const u32 stride = (u32)(pb->data(0, 1) - pb->data());
+
+	for (u32 y = 0; y < height; y += 4)
+		for (u32 x = 0; x < width; x += 4)
+			Format::vqTile(codebook, &p_in[twop(x, y, bcx, bcy) * Format::bpp / 64], pb->data(x, y), stride);
+}
+
+}
+#endif
+
+#ifdef TEXCONV_NEON
+namespace neon {
+
+// Even and odd texels to [rows 0-1] and [rows 2-3]
+static inline uint16x8x2_t tileRows(uint16x8_t even, uint16x8_t odd)
+{
+	uint32x4x2_t rows = vuzpq_u32(vreinterpretq_u32_u16(even), vreinterpretq_u32_u16(odd));
+	uint16x8x2_t result;
+	result.val[0] = vreinterpretq_u16_u32(rows.val[0]);
+	result.val[1] = vreinterpretq_u16_u32(rows.val[1]);
+	return result;
+}
+
+// Even and odd 8-bit texels to 4 rows
+static inline uint8x16_t tileRows8(uint8x8_t even, uint8x8_t odd)
+{
+	uint16x4x2_t rows = vuzp_u16(vreinterpret_u16_u8(even), vreinterpret_u16_u8(odd));
+	return vcombine_u8(vreinterpret_u8_u16(rows.val[0]), vreinterpret_u8_u16(rows.val[1]));
+}
+
+static inline uint16x4_t loadEntry(const u8 *codebook, u8 index)
+{
+	return vld1_u16((const u16 *)&codebook[index * 8]);
+}
+
+static inline void storeRows(uint16x8_t rows, u16 *dst, u32 stride)
+{
+	vst1_u16(dst, vget_low_u16(rows));
+	vst1_u16(dst + stride, vget_high_u16(rows));
+}
+
+static inline void storeRows(uint16x8_t lo, uint16x8_t hi, u32 *dst, u32 stride)
+{
+	uint16x8x2_t pixels = vzipq_u16(lo, hi);
+	vst1q_u16((u16 *)dst, pixels.val[0]);
+	vst1q_u16((u16 *)(dst + stride), pixels.val[1]);
+}
+
+static inline void pack(RGBAPacker, uint16x8_t r, uint16x8_t g, uint16x8_t b, uint16x8_t a, u32 *dst, u32 stride)
+{
+	storeRows(vorrq_u16(r, vshlq_n_u16(g, 8)), vorrq_u16(b, vshlq_n_u16(a, 8)), dst, stride);
+}
+
+static inline void pack(BGRAPacker, uint16x8_t r, uint16x8_t g, uint16x8_t b, uint16x8_t a, u32 *dst, u32 stride)
+{
+	storeRows(vorrq_u16(b, vshlq_n_u16(g, 8)), vorrq_u16(r, vshlq_n_u16(a, 8)), dst, stride);
+}
+
+template<int Shift>
+static inline uint16x8_t field(uint16x8_t v, u16 mask)
+{
+	return vandq_u16(vshrq_n_u16(v, Shift), vdupq_n_u16(mask));
+}
+
+template<int Shift>
+static inline int16x8_t divide(int16x8_t v)
+{
+	int16x8_t bias = vandq_s16(vshrq_n_s16(v, 15), vdupq_n_s16((1 << Shift) - 1));
+	return vshrq_n_s16(vaddq_s16(v, bias), Shift);
+}
+
+static inline uint16x8_t clamp255(int16x8_t v)
+{
+	return vreinterpretq_u16_s16(vmaxq_s16(vminq_s16(v, vdupq_n_s16(255)), vdupq_n_s16(0)));
+}
+
+template<typename Derived, typename Base>
+struct Texel16 : Base
+{
+	static void tile(const u8 *src, typename Base::unpacked_type *dst, u32 stride)
+	{
+		uint16x8x2_t texels = vld2q_u16((const u16 *)src);
+		uint16x8x2_t rows = tileRows(texels.val[0], texels.val[1]);
+		Derived::convert(rows.val[0], dst, stride);
+		Derived::convert(rows.val[1], dst + stride * 2, stride);
+	}
+
+	static void vqTile(const u8 *codebook, const u8 *indices, typename Base::unpacked_type *dst, u32 stride)
+	{
+		uint16x8_t a = vcombine_u16(loadEntry(codebook, indices[0]), loadEntry(codebook, indices[1]));
+		uint16x8_t b = vcombine_u16(loadEntry(codebook, indices[2]), loadEntry(codebook, indices[3]));
+		uint16x8x2_t texels = vuzpq_u16(a, b);
+		uint16x8x2_t rows = tileRows(texels.val[0], texels.val[1]);
+		Derived::convert(rows.val[0], dst, stride);
+		Derived::convert(rows.val[1], dst + stride * 2, stride);
+	}
+};
+
+struct Nop : Texel16<Nop, scalar::Nop>
+{
+	static void convert(uint16x8_t w, u16 *dst, u32 stride) {
+		storeRows(w, dst, stride);
+	}
+};
+
+struct Argb1555 : Texel16<Argb1555, scalar::Argb1555>
+{
+	static void convert(uint16x8_t w, u16 *dst, u32 stride) {
+		storeRows(vorrq_u16(vshlq_n_u16(w, 1), vshrq_n_u16(w, 15)), dst, stride);
+	}
+};
+
+struct Argb4444 : Texel16<Argb4444, scalar::Argb4444>
+{
+	static void convert(uint16x8_t w, u16 *dst, u32 stride) {
+		storeRows(vorrq_u16(vshlq_n_u16(w, 4), vshrq_n_u16(w, 12)), dst, stride);
+	}
+};
+
+template<typename Packer>
+struct Rgb565_32 : Texel16<Rgb565_32<Packer>, scalar::Rgb565_32<Packer>>
+{
+	static void convert(uint16x8_t w, u32 *dst, u32 stride)
+	{
+		uint16x8_t r = vorrq_u16(field<8>(w, 0xf8), vshrq_n_u16(w, 13));
+		uint16x8_t g = vorrq_u16(field<3>(w, 0xfc), field<9>(w, 3));
+		uint16x8_t b = vorrq_u16(vandq_u16(vshlq_n_u16(w, 3), vdupq_n_u16(0xf8)), field<2>(w, 7));
+		pack(Packer(), r, g, b, vdupq_n_u16(0xff), dst, stride);
+	}
+};
+
+template<typename Packer>
+struct Argb1555_32 : Texel16<Argb1555_32<Packer>, scalar::Argb1555_32<Packer>>
+{
+	static void convert(uint16x8_t w, u32 *dst, u32 stride)
+	{
+		uint16x8_t r = vorrq_u16(field<7>(w, 0xf8), field<12>(w, 7));
+		uint16x8_t g = vorrq_u16(field<2>(w, 0xf8), field<7>(w, 7));
+		uint16x8_t b = vorrq_u16(vandq_u16(vshlq_n_u16(w, 3), vdupq_n_u16(0xf8)), field<2>(w, 7));
+		uint16x8_t a = vandq_u16(vreinterpretq_u16_s16(vshrq_n_s16(vreinterpretq_s16_u16(w), 15)), vdupq_n_u16(0xff));
+		pack(Packer(), r, g, b, a, dst, stride);
+	}
+};
+
+template<typename Packer>
+struct Argb4444_32 : Texel16<Argb4444_32<Packer>, scalar::Argb4444_32<Packer>>
+{
+	static void convert(uint16x8_t w, u32 *dst, u32 stride)
+	{
+		uint16x8_t r = vorrq_u16(field<4>(w, 0xf0), field<8>(w, 0xf));
+		uint16x8_t g = vorrq_u16(vandq_u16(w, vdupq_n_u16(0xf0)), field<4>(w, 0xf));
+		uint16x8_t b = vorrq_u16(vandq_u16(vshlq_n_u16(w, 4), vdupq_n_u16(0xf0)), vandq_u16(w, vdupq_n_u16(0xf)));
+		uint16x8_t a = vorrq_u16(field<8>(w, 0xf0), vshrq_n_u16(w, 12));
+		pack(Packer(), r, g, b, a, dst, stride);
+	}
+};
+
+template<typename Packer>
+struct Yuv : Texel16<Yuv<Packer>, scalar::Yuv<Packer>>
+{
+	static void convert(uint16x8_t w, u32 *dst, u32 stride)
+	{
+		int16x8_t y = vreinterpretq_s16_u16(vshrq_n_u16(w, 8));
+		uint16x8_t c = vandq_u16(w, vdupq_n_u16(0xff));
+		// [c0 c0 c2 c2 ...] and [c1 c1 c3 c3 ...]
+		uint16x8x2_t uv = vtrnq_u16(c, c);
+		int16x8_t u = vsubq_s16(vreinterpretq_s16_u16(uv.val[0]), vdupq_n_s16(128));
+		int16x8_t v = vsubq_s16(vreinterpretq_s16_u16(uv.val[1]), vdupq_n_s16(128));
+
+		int16x8_t r = vaddq_s16(y, divide<3>(vmulq_n_s16(v, 11)));
+		int16x8_t g = vsubq_s16(y, divide<5>(vaddq_s16(vmulq_n_s16(u, 11), vmulq_n_s16(v, 22))));
+		int16x8_t b = vaddq_s16(y, divide<6>(vmulq_n_s16(u, 110)));
+		pack(Packer(), clamp255(r), clamp255(g), clamp255(b), vdupq_n_u16(0xff), dst, stride);
+	}
+};
+
+template<typename Pixel, u32 Bpp>
+struct Pal : scalar::Pal<Pixel, Bpp>
+{
+	static void tile(const u8 *src, Pixel *dst, u32 stride)
+	{
+		if (Bpp == 4)
+		{
+			uint8x8_t v = vld1_u8(src);
+			store(tileRows8(vand_u8(v, vdup_n_u8(0xf)), vshr_n_u8(v, 4)), dst, stride);
+		}
+		else
+		{
+			uint8x8x2_t texels = vld2_u8(src);
+			store(tileRows8(texels.val[0], texels.val[1]), dst, stride);
+		}
+	}
+
+	static void vqTile(const u8 *codebook, const u8 *indices, Pixel *dst, u32 stride)
+	{
+		if (Bpp == 4)
+			tile(&codebook[indices[0] * 8], dst, stride);
+		else
+		{
+			uint8x8x2_t texels = vuzp_u8(vld1_u8(&codebook[indices[0] * 8]), vld1_u8(&codebook[indices[1] * 8]));
+			store(tileRows8(texels.val[0], texels.val[1]), dst, stride);
+		}
+	}
+
+	static void store(uint8x16_t v, Pixel *dst, u32 stride)
+	{
+		uint32x4_t rows = vreinterpretq_u32_u8(v);
+		storeRow(vgetq_lane_u32(rows, 0), dst);
+		storeRow(vgetq_lane_u32(rows, 1), dst + stride);
+		storeRow(vgetq_lane_u32(rows, 2), dst + stride * 2);
+		storeRow(vgetq_lane_u32(rows, 3), dst + stride * 3);
+	}
+};
+
+}
+#endif
+
+#define DECODER_TABLE(Packer, Argb1555, Argb4444) \
+{ \
+	/* Twiddled                  VQ                                Twiddled (32b)                         VQ (32b)                               Palette (8b) */ \
+	{ TW<Argb1555>,              VQ<Argb1555>,                     TW<Argb1555_32<Packer>>,               VQ<Argb1555_32<Packer>>,               nullptr }, \
+	{ TW<Nop>,                   VQ<Nop>,                          TW<Rgb565_32<Packer>>,                 VQ<Rgb565_32<Packer>>,                 nullptr }, \
+	{ TW<Argb4444>,              VQ<Argb4444>,                     TW<Argb4444_32<Packer>>,               VQ<Argb4444_32<Packer>>,               nullptr }, \
+	{ nullptr,                   nullptr,                          TW<Yuv<Packer>>,                       VQ<Yuv<Packer>>,                       nullptr }, \
+	{ TW<Argb4444>,              VQ<Argb4444>,                     TW<Argb4444_32<Packer>>,               VQ<Argb4444_32<Packer>>,               nullptr }, \
+	{ TW<Pal<u16, 4>>,           VQ<Pal<u16, 4>>,                  TW<Pal<u32, 4>>,                       VQ<Pal<u32, 4>>,                       TW<Pal<u8, 4>> }, \
+	{ TW<Pal<u16, 8>>,           VQ<Pal<u16, 8>>,                  TW<Pal<u32, 8>>,                       VQ<Pal<u32, 8>>,                       TW<Pal<u8, 8>> }, \
+}
+
+#define DECODER_TABLES \
+const TexConvDecoders openglDecoders[] = DECODER_TABLE(RGBAPacker, Argb1555, Argb4444); \
+const TexConvDecoders directxDecoders[] = DECODER_TABLE(BGRAPacker, Nop, Nop);
+
+namespace scalar {
+	template<typename Format>
+	constexpr void (*TW)(PixelBuffer<typename Format::unpacked_type> *, u8 *, u32, u32) = twiddled<Format>;
+	template<typename Format>
+	constexpr void (*VQ)(PixelBuffer<typename Format::unpacked_type> *, u8 *, u32, u32) = vq<Format>;
+	DECODER_TABLES
+}
+#ifdef TEXCONV_SSE2
+namespace sse2 {
+	template<typename Format>
+	constexpr void (*TW)(PixelBuffer<typename Format::unpacked_type> *, u8 *, u32, u32) = texture_TW_tiles<Format>;
+	template<typename Format>
+	constexpr void (*VQ)(PixelBuffer<typename Format::unpacked_type> *, u8 *, u32, u32) = texture_VQ_tiles<Format>;
+	DECODER_TABLES
+}
+#endif
+#ifdef TEXCONV_AVX2
+namespace avx2 {
+	template<typename Format>
+	constexpr void (*TW)(PixelBuffer<typename Format::unpacked_type> *, u8 *, u32, u32) = texture_TW_tiles<Format>;
+	template<typename Format>
+	constexpr void (*VQ)(PixelBuffer<typename Format::unpacked_type> *, u8 *, u32, u32) = texture_VQ_tiles<Format>;
+	DECODER_TABLES
+}
+#endif
+#ifdef TEXCONV_NEON
+namespace neon {
+	template<typename Format>
+	constexpr void (*TW)(PixelBuffer<typename Format::unpacked_type> *, u8 *, u32, u32) = texture_TW_tiles<Format>;
+	template<typename Format>
+	constexpr void (*VQ)(PixelBuffer<typename Format::unpacked_type> *, u8 *, u32, u32) = texture_VQ_tiles<Format>;
+	DECODER_TABLES
+}
+#endif
+#undef DECODER_TABLES
+#undef DECODER_TABLE
+
+TexConvIsa texconv_BestIsa()
+{
+#ifdef TEXCONV_AVX2
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return TexConvIsa::AVX2;
+#endif
+#if defined(TEXCONV_SSE2)
+	return TexConvIsa::SSE2;
+#elif defined(TEXCONV_NEON)
+	return TexConvIsa::NEON;
+#else
+	return TexConvIsa::None;
+#endif
+}
+
+const char *texconv_IsaName(TexConvIsa isa)
+{
+	switch (isa)
+	{
+	case TexConvIsa::SSE2: return "SSE2";
+	case TexConvIsa::AVX2: return "AVX2";
+	case TexConvIsa::NEON: return "NEON";
+	default: return "scalar";
+	}
+}
+
+const TexConvDecoders *texconv_Decoders(TexConvIsa isa, bool directX)
+{
+	switch (isa)
+	{
+	case TexConvIsa::None:
+		return directX ? scalar::directxDecoders : scalar::openglDecoders;
+#ifdef TEXCONV_SSE2
+	case TexConvIsa::SSE2:
+		return directX ? sse2::directxDecoders : sse2::openglDecoders;
+#endif
+#ifdef TEXCONV_AVX2
+	case TexConvIsa::AVX2:
+		if (texconv_BestIsa() != TexConvIsa::AVX2)
+			return nullptr;
+		return directX ? avx2::directxDecoders : avx2::openglDecoders;
+#endif
+#ifdef TEXCONV_NEON
+	case TexConvIsa::NEON:
+		return directX ? neon::directxDecoders : neon::openglDecoders;
+#endif
+	default:
+		return nullptr;
+	}
+}
@@ -0,0 +1,31 @@
+/*
+	SIMD decoders of twiddled and VQ textures.
+
+	Textures are decoded by 4x4 tiles: when both dimensions are at least 4, the 16 texels of a tile
+	are consecutive in memory, and so are the VQ indices of a tile. The tile is loaded in a vector,
+	reordered into rows and converted. The output is identical to the scalar templates of TexCache.h,
+	which are still used for textures smaller than 4x4.
+*/
+#pragma once
+#include "TexCache.h"
+
+enum class TexConvIsa { None, SSE2, AVX2, NEON };
+
+struct TexConvDecoders
+{
+	// Conversion to 16 bpp
+	TexConvFP TW;
+	TexConvFP VQ;
+	// Conversion to 32 bpp
+	TexConvFP32 TW32;
+	TexConvFP32 VQ32;
+	// Conversion to 8 bpp (palette)
+	TexConvFP8 TW8;
+};
+
+// Returns the fastest instruction set supported by the cpu
+TexConvIsa texconv_BestIsa();
+const char *texconv_IsaName(TexConvIsa isa);
+// Returns the decoders of each pixel format (Pixel1555 to PixelPal8) for the given instruction set,
+// or nullptr if it isn't supported. TexConvIsa::None returns the scalar templates.
+const TexConvDecoders *texconv_Decoders(TexConvIsa isa, bool directX);
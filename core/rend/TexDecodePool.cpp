@@ -0,0 +1,89 @@
+#include "TexDecodePool.h"
+
+TextureDecodePool textureDecodePool;
+
+void TextureDecodePool::Init()
+{
+	int threads = std::min((int)std::thread::hardware_concurrency() - 1, (int)config::MaxThreads);
+	threads = std::max(threads, 1);
+	running = true;
+	for (int i = 0; i < threads; i++)
+		workers.emplace_back(&TextureDecodePool::WorkerThread, this);
+	INFO_LOG(RENDERER, "Texture decode pool started with %d threads", threads);
+}
+
+void TextureDecodePool::Term()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!running)
+			return;
+		running = false;
+		queue.clear();
+	}
+	queueCond.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+	workers.clear();
+}
+
+void TextureDecodePool::Enqueue(const std::shared_ptr<TextureDecodeJob>& job)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!running)
+			Init();
+		queue.push_back(job);
+	}
+	queueCond.notify_one();
+}
+
+bool TextureDecodePool::Start(TextureDecodeJob& job)
+{
+	int state = TextureDecodeJob::Queued;
+	return !job.cancelled && job.state.compare_exchange_strong(state, TextureDecodeJob::Running);
+}
+
+void TextureDecodePool::Finish(TextureDecodeJob& job)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job.state = TextureDecodeJob::Done;
+	}
+	doneCond.notify_all();
+}
+
+void TextureDecodePool::Wait(TextureDecodeJob& job)
+{
+	if (Start(job))
+	{
+		// The job stays in the queue but workers will skip it
+		job.decode(job.snapshot.data());
+		job.state = TextureDecodeJob::Done;
+		return;
+	}
+	std::unique_lock<std::mutex> lock(mutex);
+	doneCond.wait(lock, [&job]() { return job.state == TextureDecodeJob::Done; });
+}
+
+void TextureDecodePool::WorkerThread()
+{
+	while (true)
+	{
+		std::shared_ptr<TextureDecodeJob> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			queueCond.wait(lock, [this]() { return !running || !queue.empty(); });
+			if (!running)
+				break;
+			job = std::move(queue.front());
+			queue.pop_front();
+		}
+		// Cancelled jobs and jobs taken by the render thread are skipped
+		if (Start(*job))
+		{
+			job->decode(job->snapshot.data());
+			Finish(*job);
+		}
+	}
+}
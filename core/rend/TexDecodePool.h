@@ -0,0 +1,42 @@
+/*
+	Asynchronous texture decoding.
+
+	When rend.AsyncTextureDecode is enabled, large non-paletted textures that need an update
+	take a copy of their VRAM data and queue it to a pool of worker threads. The renderer keeps
+	drawing the previous version of the texture (or a placeholder for new textures) until the
+	decoded texture is ready. It's uploaded at the next lookup of the texture, or when it has been
+	stale for rend.TextureMaxStaleFrames frames, in which case the renderer waits for it.
+*/
+#pragma once
+#include "TexCache.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TextureDecodePool
+{
+public:
+	~TextureDecodePool() { Term(); }
+	void Enqueue(const std::shared_ptr<TextureDecodeJob>& job);
+	// Waits until the job is decoded. Decodes it on the calling thread if no worker has picked it up yet.
+	void Wait(TextureDecodeJob& job);
+	void Term();
+
+private:
+	void Init();
+	void WorkerThread();
+	static bool Start(TextureDecodeJob& job);
+	void Finish(TextureDecodeJob& job);
+
+	std::vector<std::thread> workers;
+	std::deque<std::shared_ptr<TextureDecodeJob>> queue;
+	std::mutex mutex;
+	std::condition_variable queueCond;
+	std::condition_variable doneCond;
+	bool running = false;
+};
+
+extern TextureDecodePool textureDecodePool;
@@ -294,6 +294,12 @@ BaseTextureCacheData *DX11Renderer::GetTexture(TSP tsp, TCW tcw)
 			// FIXME textureView
 			tf->loadCustomTexture();
 		}
+		else if (tf->IsAsyncDecodeReady())
+		{
+			texCache.DeleteLater(tf->texture);
+			tf->texture.reset();
+			tf->CheckAsyncDecode();
+		}
 	}
 	return tf;
 }
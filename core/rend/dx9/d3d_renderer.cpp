@@ -229,6 +229,12 @@ BaseTextureCacheData *D3DRenderer::GetTexture(TSP tsp, TCW tcw)
 			tf->texture.reset();
 			tf->loadCustomTexture();
 		}
+		else if (tf->IsAsyncDecodeReady())
+		{
+			texCache.DeleteLater(tf->texture);
+			tf->texture.reset();
+			tf->CheckAsyncDecode();
+		}
 	}
 	return tf;
 }
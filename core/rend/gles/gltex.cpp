@@ -79,7 +79,10 @@ void TextureCacheData::UploadToGPU(int width, int height, u8 *temp_tex_buffer, b
 				internalFormat = 0;
 				break;
 			}
-			if (Updates == 1)
+			// The texture may have been created with a placeholder
+			GLint immutable = GL_FALSE;
+			glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_IMMUTABLE_FORMAT, &immutable);
+			if (!immutable)
 			{
 				glTexStorage2D(GL_TEXTURE_2D, mipmapLevels, internalFormat, width, height);
 				glCheck();
@@ -396,6 +399,8 @@ BaseTextureCacheData *gl_GetTexture(TSP tsp, TCW tcw)
 			tf->texID = glcache.GenTexture();
 			tf->CheckCustomTexture();
 		}
+		else if (tf->IsAsyncDecodeReady())
+			tf->CheckAsyncDecode();
 		TexCacheHits++;
 	}
 
@@ -24,6 +24,7 @@
 #include "hw/maple/maple_if.h"
 #include "hw/maple/maple_devs.h"
 #include "hw/naomi/naomi_cart.h"
+#include "hw/pvr/ta_ctx.h"
 #include "imgui/imgui.h"
 #include "imgui/roboto_medium.h"
 #include "network/net_handshake.h"
@@ -44,6 +45,7 @@
 #include "lua/lua.h"
 #include "gui_chat.h"
 #include "imgui_driver.h"
+#include "rend/TexCache.h"
 
 #ifdef __vita__
 #include <vitasdk.h>
@@ -1918,6 +1920,14 @@ static void gui_display_settings()
 		    			"Stretch the screen horizontally");
 		    	OptionArrowButtons("Frame Skipping", config::SkipFrame, 0, 6,
 		    			"Number of frames to skip between two actually rendered frames");
+		    	OptionArrowButtons("Render Queue Depth", config::RenderQueueDepth, 1, 2,
+		    			"Maximum number of frames queued or being rendered in multi-threaded mode");
+		    	ImGui::Text("Render Queue:");
+		    	ImGui::Columns(2, "rqueuepolicy", false);
+		    	OptionRadioButton("Throughput", config::RenderQueuePolicy, 0, "Wait for the GPU when the render queue is full");
+            	ImGui::NextColumn();
+		    	OptionRadioButton("Latency", config::RenderQueuePolicy, 1, "Drop frames when the render queue is full");
+		    	ImGui::Columns(1, nullptr, false);
 		    }
 			if (perPixel)
 			{
@@ -1989,6 +1999,17 @@ static void gui_display_settings()
 #endif
 		    	OptionCheckbox("Load Custom Textures", config::CustomTextures,
 		    			"Load custom/high-res textures from data/textures/<game id>");
+		    	OptionCheckbox("Asynchronous Texture Decoding", config::AsyncTextureDecode,
+		    			"Decode large textures on worker threads. Their previous content is drawn until they're ready");
+		    	OptionArrowButtons("Max Stale Frames", config::TextureMaxStaleFrames, 1, 8,
+		    			"Maximum number of frames a texture can be drawn with its previous content while being decoded");
+		    	OptionSlider("Texture Content Cache", config::TextureContentCacheSize, 0, 256,
+		    			"Memory in MB used to keep decoded textures and reuse them when the same content is found again. 0 to disable");
+		    	OptionSlider("Texture Memory Budget", config::TextureCacheBudget, 0, 1024,
+		    			"Maximum GPU memory in MB used by textures. The least recently used textures are evicted first. 0 for no limit");
+		    	OptionCheckbox("VRAM Dirty Bitmap", config::VramDirtyBitmap,
+		    			"Detect texture changes by tracking VRAM writes and comparing texture data. "
+		    			"Memory protection faults at most once per page and frame. Faster for games streaming textures");
 		    }
 			ImGui::PopStyleVar();
 			ImGui::EndTabItem();
@@ -2014,6 +2035,8 @@ static void gui_display_settings()
 			ImGui::PushStyleVar(ImGuiStyleVar_FramePadding, normal_padding);
 			OptionCheckbox("Enable DSP", config::DSPEnabled,
 					"Enable the Dreamcast Digital Sound Processor. Only recommended on fast platforms");
+			OptionCheckbox("Threaded Audio", config::ThreadedAudio,
+					"Run the sound CPU and sound generation on a separate thread. Disabled during netplay");
 			if (OptionSlider("Volume Level", config::AudioVolume, 0, 100, "Adjust the emulator's audio level"))
 			{
 				config::AudioVolume.calcDbPower();
@@ -2139,6 +2162,16 @@ static void gui_display_settings()
 		    	ImGui::Spacing();
 		    	header("Dynarec Options");
 		    	OptionCheckbox("Idle Skip", config::DynarecIdleSkip, "Skip wait loops. Recommended");
+		    	OptionCheckbox("Persistent Block Cache", config::DynarecBlockCache,
+		    			"Save decoded and optimized code blocks on disk to speed up the next boot of the game");
+		    	OptionCheckbox("Tiered Compilation", config::DynarecTieredCompilation,
+		    			"Compile new code quickly first and optimize it once it runs often. Reduces stuttering when new code is loaded");
+		    	OptionCheckbox("Trace Formation", config::DynarecTraceFormation,
+		    			"Continue compiling code blocks across short forward branches to build longer blocks");
+		    	OptionCheckbox("Background Compilation", config::DynarecBackgroundCompile,
+		    			"Decode and optimize the code blocks likely to run next on another thread");
+		    	OptionCheckbox("Fine-grained SMC Tracking", config::DynarecSubPageSMC,
+		    			"Only discard the code blocks that are overwritten when a game writes to a code page");
 #ifdef __vita__
 				OptionCheckbox("Float Ops Gamehack", config::DynarecFloatHack, "Enables a gamehack that makes most float operations clock free");
 				OptionCheckbox("Use Neon SIMD", config::DynarecUseNeon, "Enables usage of NEON SIMD processor inside Dynarec");
@@ -2240,6 +2273,8 @@ static void gui_display_settings()
 #endif
 	            OptionCheckbox("Dump Textures", config::DumpTextures,
 	            		"Dump all textures into data/texdump/<game id>");
+	            OptionCheckbox("Capture TA Frames", config::CaptureTAFrames,
+	            		"Save one rendered frame per second into data/<game>_<frame>.tac for offline replay");
 
 	            bool logToFile = cfgLoadBool("log", "LogToFile", false);
 	            bool newLogToFile = logToFile;
@@ -2738,6 +2773,12 @@ void gui_display_ui()
 static float LastFPSTime;
 static int lastFrameCount = 0;
 static float fps = -1;
+static RenderQueueStats lastQueueStats;
+static u32 queueWaits;
+static u32 queueDrops;
+static VramTrackingStats lastVramStats;
+static u32 vramEvents;
+static float vramTime;
 
 static std::string getFPSNotification()
 {
@@ -2748,10 +2789,27 @@ static std::string getFPSNotification()
 			fps = (MainFrameCount - lastFrameCount) / (now - LastFPSTime);
 			LastFPSTime = now;
 			lastFrameCount = MainFrameCount;
+			RenderQueueStats queueStats = rend_getQueueStats();
+			queueWaits = queueStats.waits - lastQueueStats.waits;
+			queueDrops = queueStats.drops - lastQueueStats.drops;
+			lastQueueStats = queueStats;
+			// VRAM write faults or dirty pages per second, and time spent handling them
+			VramTrackingStats vramStats = vramTrackingGetStats();
+			vramEvents = (u32)(vramStats.faults + vramStats.dirtyPages - lastVramStats.faults - lastVramStats.dirtyPages);
+			vramTime = (vramStats.faultTime + vramStats.checkTime - lastVramStats.faultTime - lastVramStats.checkTime) / 1000000.f;
+			lastVramStats = vramStats;
 		}
 		if (fps >= 0.f && fps < 9999.f) {
-			char text[32];
-			snprintf(text, sizeof(text), "F:%.1f%s", fps, settings.input.fastForwardMode ? " >>" : "");
+			char text[96];
+			int len;
+			if (config::ThreadedRendering)
+				len = snprintf(text, sizeof(text), "F:%.1f Q:%d W:%d D:%d", fps, rend_getQueueStats().depth, queueWaits, queueDrops);
+			else
+				len = snprintf(text, sizeof(text), "F:%.1f", fps);
+			// Texture cache: textures, size in MB and evictions
+			TextureCacheStats texStats = textureCacheGetStats();
+			snprintf(text + len, sizeof(text) - len, " T:%u/%.1fM E:%llu V:%u/%.1fms%s", texStats.entries, texStats.bytes / 1048576.0,
+					(unsigned long long)texStats.evictions, vramEvents, vramTime, settings.input.fastForwardMode ? " >>" : "");
 
 			return std::string(text);
 		}
@@ -25,5 +25,3 @@ struct norend : Renderer
 
 
 Renderer* rend_norend() { return new norend(); }
-
-u32 GetTexture(TSP tsp,TCW tcw) { return 0; }
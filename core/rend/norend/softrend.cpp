@@ -0,0 +1,1050 @@
+#include "softrend.h"
+#include "hw/pvr/ta.h"
+#include "hw/pvr/pvr_mem.h"
+#include "rend/tileclip.h"
+#include "cfg/option.h"
+#include "emulator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOFTREND_SSE2
+#include <emmintrin.h>
+#endif
+
+constexpr int SoftRenderer::TileSize;
+
+namespace {
+
+enum VolumeMode { VolumeXor, VolumeOr, VolumeInclusion, VolumeExclusion };
+
+inline u32 convert16(u16 p, TextureType type)
+{
+	u32 r, g, b, a;
+	switch (type)
+	{
+	case TextureType::_565:
+		r = p >> 11;
+		g = (p >> 5) & 0x3f;
+		b = p & 0x1f;
+		return RGBAPacker::pack((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2), 0xff);
+	case TextureType::_5551:
+		r = p >> 11;
+		g = (p >> 6) & 0x1f;
+		b = (p >> 1) & 0x1f;
+		return RGBAPacker::pack((r << 3) | (r >> 2), (g << 3) | (g >> 2), (b << 3) | (b >> 2), (p & 1) ? 0xff : 0);
+	case TextureType::_4444:
+	default:
+		r = p >> 12;
+		g = (p >> 8) & 0xf;
+		b = (p >> 4) & 0xf;
+		a = p & 0xf;
+		return RGBAPacker::pack(r * 17, g * 17, b * 17, a * 17);
+	}
+}
+
+inline void unpackColor(u32 c, float *rgba)
+{
+	for (int i = 0; i < 4; i++)
+		rgba[i] = ((c >> (i * 8)) & 0xff) / 255.f;
+}
+
+inline u32 toByte(float f)
+{
+	return (u32)(std::min(std::max(f, 0.f), 1.f) * 255.f + 0.5f);
+}
+
+inline u32 packColor(const float *rgba)
+{
+	return toByte(rgba[0]) | (toByte(rgba[1]) << 8) | (toByte(rgba[2]) << 16) | (toByte(rgba[3]) << 24);
+}
+
+inline int wrapCoord(int c, int size, bool clamp, bool mirror)
+{
+	if (clamp)
+		return std::min(std::max(c, 0), size - 1);
+	if (mirror)
+	{
+		int period = size * 2;
+		c %= period;
+		if (c < 0)
+			c += period;
+		return c < size ? c : period - 1 - c;
+	}
+	c %= size;
+	return c < 0 ? c + size : c;
+}
+
+inline bool depthTest(int func, float z, float depth)
+{
+	switch (func)
+	{
+	case 0: return false;
+	case 1: return z < depth;
+	case 2: return z == depth;
+	case 3: return z <= depth;
+	case 4: return z > depth;
+	case 5: return z != depth;
+	case 6: return z >= depth;
+	default: return true;
+	}
+}
+
+// Blend factors. Other color is the destination color for the source factor and vice versa.
+inline void blendFactor(int mode, const float *src, const float *dst, const float *other, float *factor)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		switch (mode)
+		{
+		case 0: factor[i] = 0.f; break;
+		case 1: factor[i] = 1.f; break;
+		case 2: factor[i] = other[i]; break;
+		case 3: factor[i] = 1.f - other[i]; break;
+		case 4: factor[i] = src[3]; break;
+		case 5: factor[i] = 1.f - src[3]; break;
+		case 6: factor[i] = dst[3]; break;
+		default: factor[i] = 1.f - dst[3]; break;
+		}
+	}
+}
+
+// Returns a bit for each of the 4 pixels starting at x that are inside the triangle
+inline u32 coverage(const float *edgeA, const float *edgeB, const float *edgeC, u32 topLeft, int x, float py)
+{
+#ifdef SOFTREND_SSE2
+	const __m128 px = _mm_add_ps(_mm_set1_ps((float)x + 0.5f), _mm_set_ps(3.f, 2.f, 1.f, 0.f));
+	const __m128 zero = _mm_setzero_ps();
+	__m128 inside = _mm_cmpeq_ps(zero, zero);
+	for (int e = 0; e < 3; e++)
+	{
+		__m128 v = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edgeA[e]), px), _mm_set1_ps(edgeB[e] * py + edgeC[e]));
+		inside = _mm_and_ps(inside, (topLeft & (1 << e)) ? _mm_cmpge_ps(v, zero) : _mm_cmpgt_ps(v, zero));
+	}
+	return (u32)_mm_movemask_ps(inside);
+#else
+	u32 mask = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		const float px = (float)x + 0.5f + (float)i;
+		bool inside = true;
+		for (int e = 0; e < 3; e++)
+		{
+			float v = edgeA[e] * px + (edgeB[e] * py + edgeC[e]);
+			inside = inside && ((topLeft & (1 << e)) ? v >= 0.f : v > 0.f);
+		}
+		mask |= (u32)inside << i;
+	}
+	return mask;
+#endif
+}
+
+// Sets the edge functions of a triangle so that they are positive inside. Returns the top-left edges.
+template<typename T>
+u32 setupEdges(T& tri, const float *x, const float *y, bool negative)
+{
+	const float sign = negative ? -1.f : 1.f;
+	u32 topLeft = 0;
+	for (int e = 0; e < 3; e++)
+	{
+		int n = e == 2 ? 0 : e + 1;
+		tri.edgeA[e] = (y[e] - y[n]) * sign;
+		tri.edgeB[e] = (x[n] - x[e]) * sign;
+		tri.edgeC[e] = (x[e] * y[n] - x[n] * y[e]) * sign;
+		if (tri.edgeA[e] > 0.f || (tri.edgeA[e] == 0.f && tri.edgeB[e] > 0.f))
+			topLeft |= 1 << e;
+	}
+	tri.edgeA[3] = tri.edgeB[3] = tri.edgeC[3] = 0.f;
+	return topLeft;
+}
+
+// Pixels whose center is inside [min, max], clamped to the render area
+inline bool pixelRange(float min, float max, int clipMin, int clipMax, int& first, int& last)
+{
+	float f = std::min(std::max(std::ceil(min - 0.5f), (float)clipMin), (float)clipMax + 1.f);
+	float l = std::min(std::max(std::floor(max - 0.5f), (float)clipMin - 1.f), (float)clipMax);
+	if (!(f <= l))
+		return false;
+	first = (int)f;
+	last = (int)l;
+	return true;
+}
+
+}
+
+void SoftTexture::UploadToGPU(int width, int height, u8 *temp_tex_buffer, bool mipmapped, bool mipmapsIncluded)
+{
+	texWidth = width;
+	texHeight = height;
+	levels = 1;
+	size_t count = (size_t)width * height;
+	if (mipmapsIncluded)
+	{
+		while ((1 << levels) <= width)
+			levels++;
+		count = ((1u << (2 * levels)) - 1) / 3;
+	}
+	texels.resize(count);
+	switch (tex_type)
+	{
+	case TextureType::_8888:
+		memcpy(texels.data(), temp_tex_buffer, count * sizeof(u32));
+		break;
+	case TextureType::_8:
+		std::copy(temp_tex_buffer, temp_tex_buffer + count, texels.begin());
+		break;
+	default:
+		// 16-bit placeholders
+		for (size_t i = 0; i < count; i++)
+			texels[i] = convert16(((const u16 *)temp_tex_buffer)[i], tex_type);
+		break;
+	}
+}
+
+bool SoftTexture::Delete()
+{
+	std::vector<u32>().swap(texels);
+	return BaseTextureCacheData::Delete();
+}
+
+bool SoftRenderer::Init()
+{
+	INFO_LOG(RENDERER, "Software renderer initialized");
+	return true;
+}
+
+void SoftRenderer::Term()
+{
+	stopWorkers();
+	textureCache.Clear();
+	std::vector<u32>().swap(frame);
+	frameWidth = frameHeight = 0;
+}
+
+void SoftRenderer::SetThreads(int threads)
+{
+	stopWorkers();
+	this->threads = threads;
+}
+
+bool SoftRenderer::Process(TA_context* ctx)
+{
+	if (KillTex)
+		textureCache.Clear();
+	textureCache.CollectCleanup();
+
+	if (ctx->rend.isRenderFramebuffer)
+		return true;
+	return ta_parse(ctx);
+}
+
+BaseTextureCacheData *SoftRenderer::GetTexture(TSP tsp, TCW tcw)
+{
+	SoftTexture *texture = textureCache.getTextureCacheData(tsp, tcw);
+	if (texture->NeedsUpdate())
+		texture->Update();
+	else if (texture->IsCustomTextureAvailable())
+		texture->CheckCustomTexture();
+	else if (texture->IsAsyncDecodeReady())
+		texture->CheckAsyncDecode();
+
+	return texture;
+}
+
+u32 SoftRenderer::addState(const PolyParam& pp, u32 listType, bool sorted, bool depthOnly)
+{
+	PolyState s {};
+	if (pp.pcw.Texture && pp.texture != nullptr && !((const SoftTexture *)pp.texture)->texels.empty())
+		s.texture = (const SoftTexture *)pp.texture;
+	if (s.texture != nullptr && s.texture->tex_type == TextureType::_8)
+	{
+		if (pp.tcw.PixelFmt == PixelPal4)
+			s.palette = &palette32_ram[pp.tcw.PalSelect << 4];
+		else
+			s.palette = &palette32_ram[(pp.tcw.PalSelect >> 4) << 8];
+	}
+	s.trilinearAlpha = 1.f;
+	if (pp.pcw.Texture && pp.tsp.FilterMode > 1 && listType != ListType_Punch_Through && pp.tcw.MipMapped == 1)
+	{
+		s.trilinearAlpha = 0.25f * (pp.tsp.MipMapD & 0x3);
+		if (pp.tsp.FilterMode == 2)
+			// Trilinear pass A
+			s.trilinearAlpha = 1.f - s.trilinearAlpha;
+	}
+	s.lodBias = D_Adjust_LoD_Bias[pp.tsp.MipMapD];
+
+	s.clipMode = (u8)TileClipping::Off;
+	const u32 clipmode = pp.tileclip >> 28;
+	if (config::Clipping && clipmode >= 2 && !depthOnly)
+	{
+		s.clip[0] = (pp.tileclip & 63) * 32;
+		s.clip[1] = ((pp.tileclip >> 12) & 31) * 32;
+		s.clip[2] = ((pp.tileclip >> 6) & 63) * 32 + 32;
+		s.clip[3] = ((pp.tileclip >> 17) & 31) * 32 + 32;
+		if (s.clip[0] > 0 || s.clip[1] > 0 || s.clip[2] < 640 || s.clip[3] < 480)
+			s.clipMode = (u8)((clipmode & 1) ? TileClipping::Inside : TileClipping::Outside);
+	}
+
+	s.shadInstr = pp.tsp.ShadInstr;
+	s.fogCtrl = config::Fog ? pp.tsp.FogCtrl : 2;
+	if (depthOnly || sorted || listType == ListType_Punch_Through)
+		s.depthFunc = 6;	// >=
+	else
+		s.depthFunc = pp.isp.DepthMode;
+	s.srcBlend = pp.tsp.SrcInstr;
+	s.dstBlend = pp.tsp.DstInstr;
+	s.stencil = pp.pcw.Shadow ? 0x80 : 0;
+	s.gouraud = pp.pcw.Gouraud;
+	s.useAlpha = pp.tsp.UseAlpha;
+	s.ignoreTexA = pp.tsp.IgnoreTexA;
+	s.offset = pp.pcw.Offset;
+	s.bumpMap = pp.tcw.PixelFmt == PixelBumpMap;
+	s.colorClamp = pp.tsp.ColorClamp && (pvrrc.fog_clamp_min.full != 0 || pvrrc.fog_clamp_max.full != 0xffffffff);
+	s.alphaTest = listType == ListType_Punch_Through;
+	s.blend = !depthOnly && listType != ListType_Opaque;
+	// Z Write Disable seems to be ignored for punch-through
+	s.depthWrite = depthOnly || listType == ListType_Punch_Through || (!sorted && !pp.isp.ZWriteDis);
+	s.colorWrite = !depthOnly;
+	if (config::TextureFiltering == 0)
+		s.nearest = pp.tsp.FilterMode == 0 || s.palette != nullptr;
+	else
+		s.nearest = config::TextureFiltering == 1 || s.palette != nullptr;
+	s.clampU = pp.tsp.ClampU;
+	s.clampV = pp.tsp.ClampV;
+	s.flipU = pp.tsp.FlipU;
+	s.flipV = pp.tsp.FlipV;
+
+	states.push_back(s);
+	return (u32)states.size() - 1;
+}
+
+void SoftRenderer::addTriangle(const Vertex& v0, const Vertex& v1, const Vertex& v2, u32 state, int cullMode)
+{
+	const float dx1 = v1.x - v0.x;
+	const float dy1 = v1.y - v0.y;
+	const float dx2 = v2.x - v0.x;
+	const float dy2 = v2.y - v0.y;
+	const float det = dx1 * dy2 - dx2 * dy1;
+	if (det == 0.f || !std::isfinite(det))
+		return;
+	// Cull if negative or positive. Small triangles aren't culled.
+	if ((cullMode == 2 && det < 0.f) || (cullMode == 3 && det > 0.f))
+		return;
+
+	const float x[3] { v0.x, v1.x, v2.x };
+	const float y[3] { v0.y, v1.y, v2.y };
+	int minX, maxX, minY, maxY;
+	if (!pixelRange(std::min({ x[0], x[1], x[2] }), std::max({ x[0], x[1], x[2] }), clipX0, clipX1, minX, maxX)
+			|| !pixelRange(std::min({ y[0], y[1], y[2] }), std::max({ y[0], y[1], y[2] }), clipY0, clipY1, minY, maxY))
+		return;
+
+	triangles.emplace_back();
+	Triangle& tri = triangles.back();
+	tri.minX = minX;
+	tri.maxX = maxX;
+	tri.minY = minY;
+	tri.maxY = maxY;
+	tri.state = state;
+	tri.topLeft = setupEdges(tri, x, y, det < 0.f);
+
+	// Attribute values at each vertex. Flat-shaded triangles use the color of the last vertex.
+	const bool gouraud = states[state].gouraud;
+	const Vertex *vtx[3] { &v0, &v1, &v2 };
+	alignas(16) float f[3][Attributes];
+	for (int i = 0; i < 3; i++)
+	{
+		const float z = vtx[i]->z;
+		f[i][0] = z;
+		f[i][1] = vtx[i]->u * z;
+		f[i][2] = vtx[i]->v * z;
+		const Vertex& colorVtx = gouraud ? *vtx[i] : v2;
+		const float scale = gouraud ? z / 255.f : 1.f / 255.f;
+		for (int j = 0; j < 4; j++)
+		{
+			f[i][3 + j] = colorVtx.col[j] * scale;
+			f[i][7 + j] = colorVtx.spc[j] * scale;
+		}
+		f[i][11] = 0.f;
+	}
+
+	// Attribute planes
+	const float invDet = 1.f / det;
+#ifdef SOFTREND_SSE2
+	const __m128 vdx1 = _mm_set1_ps(dx1);
+	const __m128 vdy1 = _mm_set1_ps(dy1);
+	const __m128 vdx2 = _mm_set1_ps(dx2);
+	const __m128 vdy2 = _mm_set1_ps(dy2);
+	const __m128 vinvDet = _mm_set1_ps(invDet);
+	const __m128 vx0 = _mm_set1_ps(v0.x);
+	const __m128 vy0 = _mm_set1_ps(v0.y);
+	for (int i = 0; i < Attributes; i += 4)
+	{
+		const __m128 f0 = _mm_load_ps(&f[0][i]);
+		const __m128 d1 = _mm_sub_ps(_mm_load_ps(&f[1][i]), f0);
+		const __m128 d2 = _mm_sub_ps(_mm_load_ps(&f[2][i]), f0);
+		const __m128 a = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(d1, vdy2), _mm_mul_ps(d2, vdy1)), vinvDet);
+		const __m128 b = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(d2, vdx1), _mm_mul_ps(d1, vdx2)), vinvDet);
+		const __m128 c = _mm_sub_ps(_mm_sub_ps(f0, _mm_mul_ps(a, vx0)), _mm_mul_ps(b, vy0));
+		_mm_storeu_ps(&tri.a[i], a);
+		_mm_storeu_ps(&tri.b[i], b);
+		_mm_storeu_ps(&tri.c[i], c);
+	}
+#else
+	for (int i = 0; i < Attributes; i++)
+	{
+		const float d1 = f[1][i] - f[0][i];
+		const float d2 = f[2][i] - f[0][i];
+		tri.a[i] = (d1 * dy2 - d2 * dy1) * invDet;
+		tri.b[i] = (d2 * dx1 - d1 * dx2) * invDet;
+		tri.c[i] = f[0][i] - tri.a[i] * v0.x - tri.b[i] * v0.y;
+	}
+#endif
+}
+
+void SoftRenderer::addStrips(const List<PolyParam>& list, u32 first, u32 count, u32 listType, bool sorted)
+{
+	const u32 *indices = pvrrc.idx.head();
+	const Vertex *verts = pvrrc.verts.head();
+	for (const PolyParam *pp = list.head() + first; pp < list.head() + first + count; pp++)
+	{
+		if (pp->count < 3 || pp->isNaomi2())
+			continue;
+		if ((listType == ListType_Opaque || (listType == ListType_Translucent && !sorted))
+				&& pp->isp.DepthMode == 0)
+			// depthFunc = never
+			continue;
+		const u32 state = addState(*pp, listType, sorted);
+		for (u32 i = 0; i + 2 < pp->count; i++)
+		{
+			const u32 *idx = &indices[pp->first + i];
+			// Odd triangles of a strip have the opposite winding
+			if (i & 1)
+				addTriangle(verts[idx[1]], verts[idx[0]], verts[idx[2]], state, pp->isp.CullMode);
+			else
+				addTriangle(verts[idx[0]], verts[idx[1]], verts[idx[2]], state, pp->isp.CullMode);
+		}
+	}
+}
+
+void SoftRenderer::addSortedTriangles(u32 first, u32 count, bool multipass)
+{
+	GenSorted(first, count, sortedParams, sortedIndices);
+	const Vertex *verts = pvrrc.verts.head();
+	for (int depthOnly = 0; depthOnly < 2; depthOnly++)
+	{
+		for (const SortTrigDrawParam& param : sortedParams)
+		{
+			const PolyParam& pp = *param.ppid;
+			if (param.count <= 2 || pp.isNaomi2() || (depthOnly && pp.isp.ZWriteDis))
+				continue;
+			const u32 state = addState(pp, ListType_Translucent, true, depthOnly);
+			for (u32 i = param.first; i + 2 < param.first + param.count; i += 3)
+				addTriangle(verts[sortedIndices[i]], verts[sortedIndices[i + 1]], verts[sortedIndices[i + 2]], state, pp.isp.CullMode);
+		}
+		// Write to the depth buffer for the next render pass (Cosmic Smash)
+		if (!multipass || !config::TranslucentPolygonDepthMask)
+			break;
+	}
+}
+
+void SoftRenderer::setup()
+{
+	states.clear();
+	triangles.clear();
+	volumeTriangles.clear();
+	passes.clear();
+	modifierVolumes = config::ModifierVolumes;
+
+	clipX0 = pvrrc.fb_X_CLIP.min;
+	clipX1 = std::min<int>(pvrrc.fb_X_CLIP.max, frameWidth - 1);
+	clipY0 = pvrrc.fb_Y_CLIP.min;
+	clipY1 = std::min<int>(pvrrc.fb_Y_CLIP.max, frameHeight - 1);
+
+	fogDensity = FOG_DENSITY.get() * config::ExtraDepthScale;
+	FOG_COL_RAM.getRGBColor(fogColRam);
+	FOG_COL_VERT.getRGBColor(fogColVert);
+	pvrrc.fog_clamp_min.getRGBAColor(fogClampMin);
+	pvrrc.fog_clamp_max.getRGBAColor(fogClampMax);
+	for (int i = 0; i < 128; i++)
+	{
+		fogTable[i][0] = (FOG_TABLE[i] & 0xff) / 255.f;
+		fogTable[i][1] = ((FOG_TABLE[i] >> 8) & 0xff) / 255.f;
+	}
+	ptAlphaRef = (PT_ALPHA_REF & 0xff) / 255.f;
+	shadowScale = FPU_SHAD_SCALE.scale_factor / 256.f;
+
+	RenderPass previous {};
+	const u32 passCount = pvrrc.render_passes.used();
+	for (u32 i = 0; i < passCount; i++)
+	{
+		const RenderPass& current = pvrrc.render_passes.head()[i];
+		Pass pass;
+		pass.opaque = (u32)triangles.size();
+		pass.zClear = current.z_clear;
+		pass.mvoFirst = previous.mvo_count;
+		pass.mvoCount = current.mvo_count - previous.mvo_count;
+
+		addStrips(pvrrc.global_param_op, previous.op_count, current.op_count - previous.op_count, ListType_Opaque, false);
+		addStrips(pvrrc.global_param_pt, previous.pt_count, current.pt_count - previous.pt_count, ListType_Punch_Through, false);
+		pass.translucent = (u32)triangles.size();
+		const u32 trCount = current.tr_count - previous.tr_count;
+		if (current.autosort && !config::PerStripSorting)
+			addSortedTriangles(previous.tr_count, trCount, i < passCount - 1);
+		else if (current.autosort)
+		{
+			SortPParams(previous.tr_count, trCount);
+			addStrips(pvrrc.global_param_tr, previous.tr_count, trCount, ListType_Translucent, true);
+		}
+		else
+			addStrips(pvrrc.global_param_tr, previous.tr_count, trCount, ListType_Translucent, false);
+		pass.end = (u32)triangles.size();
+		passes.push_back(pass);
+		previous = current;
+	}
+
+	// Modifier volumes
+	if (modifierVolumes)
+	{
+		volumeTriangles.resize(pvrrc.modtrig.used());
+		for (const ModifierVolumeParam& param : pvrrc.global_param_mvo)
+		{
+			for (u32 i = param.first; i < std::min<u32>(param.first + param.count, (u32)volumeTriangles.size()); i++)
+			{
+				const ModTriangle& mt = pvrrc.modtrig.head()[i];
+				VolumeTriangle& tri = volumeTriangles[i];
+				tri.valid = false;
+				const float x[3] { mt.x0, mt.x1, mt.x2 };
+				const float y[3] { mt.y0, mt.y1, mt.y2 };
+				const float dx1 = x[1] - x[0], dy1 = y[1] - y[0];
+				const float dx2 = x[2] - x[0], dy2 = y[2] - y[0];
+				const float det = dx1 * dy2 - dx2 * dy1;
+				if (param.isNaomi2() || det == 0.f || !std::isfinite(det)
+						|| !pixelRange(std::min({ x[0], x[1], x[2] }), std::max({ x[0], x[1], x[2] }), clipX0, clipX1, tri.minX, tri.maxX)
+						|| !pixelRange(std::min({ y[0], y[1], y[2] }), std::max({ y[0], y[1], y[2] }), clipY0, clipY1, tri.minY, tri.maxY))
+					continue;
+				tri.valid = true;
+				tri.negative = det < 0.f;
+				tri.topLeft = setupEdges(tri, x, y, tri.negative);
+				const float d1 = mt.z1 - mt.z0;
+				const float d2 = mt.z2 - mt.z0;
+				tri.za = (d1 * dy2 - d2 * dy1) / det;
+				tri.zb = (d2 * dx1 - d1 * dx2) / det;
+				tri.zc = mt.z0 - tri.za * x[0] - tri.zb * y[0];
+			}
+		}
+	}
+
+	// Binning
+	bins.resize(tileRows);
+	for (std::vector<u32>& bin : bins)
+		bin.clear();
+	for (u32 i = 0; i < triangles.size(); i++)
+		for (int row = triangles[i].minY / TileSize; row <= triangles[i].maxY / TileSize; row++)
+			bins[row].push_back(i);
+}
+
+void SoftRenderer::drawTriangle(Tile& tile, const Triangle& tri)
+{
+	const int x0 = std::max(tri.minX, tile.x);
+	const int x1 = std::min(tri.maxX, tile.x + TileSize - 1);
+	const int y0 = std::max(tri.minY, tile.y);
+	const int y1 = std::min(tri.maxY, tile.y + TileSize - 1);
+	if (x0 > x1 || y0 > y1)
+		return;
+	const PolyState& s = states[tri.state];
+	const SoftTexture *texture = s.texture;
+
+	for (int y = y0; y <= y1; y++)
+	{
+		const float py = (float)y + 0.5f;
+		for (int x = x0; x <= x1; x += 4)
+		{
+			u32 mask = coverage(tri.edgeA, tri.edgeB, tri.edgeC, tri.topLeft, x, py);
+			if (x1 - x < 3)
+				mask &= (1 << (x1 - x + 1)) - 1;
+			for (int i = 0; mask != 0; i++, mask >>= 1)
+			{
+				if ((mask & 1) == 0)
+					continue;
+				const int px = x + i;
+				if (s.clipMode != (u8)TileClipping::Off)
+				{
+					bool inside = px >= s.clip[0] && y >= s.clip[1] && px < s.clip[2] && y < s.clip[3];
+					if (inside == (s.clipMode == (u8)TileClipping::Inside))
+						continue;
+				}
+				const int idx = (y - tile.y) * TileSize + px - tile.x;
+				const float fx = (float)px + 0.5f;
+				const float z = tri.a[0] * fx + tri.b[0] * py + tri.c[0];
+				if (!depthTest(s.depthFunc, z, tile.depth[idx]))
+					continue;
+				if (!s.colorWrite)
+				{
+					tile.depth[idx] = z;
+					continue;
+				}
+
+				alignas(16) float attr[Attributes];
+#ifdef SOFTREND_SSE2
+				const __m128 vx = _mm_set1_ps(fx);
+				const __m128 vy = _mm_set1_ps(py);
+				for (int j = 0; j < Attributes; j += 4)
+					_mm_store_ps(&attr[j], _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&tri.a[j]), vx),
+							_mm_mul_ps(_mm_loadu_ps(&tri.b[j]), vy)), _mm_loadu_ps(&tri.c[j])));
+#else
+				for (int j = 0; j < Attributes; j++)
+					attr[j] = tri.a[j] * fx + tri.b[j] * py + tri.c[j];
+#endif
+				const float w = z > 0.f ? 1.f / z : 0.f;
+				const float colorScale = s.gouraud ? w : 1.f;
+				float color[4];
+				float offset[4];
+				for (int j = 0; j < 4; j++)
+				{
+					color[j] = attr[3 + j] * colorScale;
+					offset[j] = attr[7 + j] * colorScale;
+				}
+				if (!s.useAlpha)
+					color[3] = 1.f;
+
+				// Fog table lookup
+				float fog = 0.f;
+				if (s.fogCtrl == 0 || s.fogCtrl == 3)
+				{
+					float fogZ = fogDensity * z;
+					fogZ = fogZ >= 1.f ? std::min(fogZ, 255.9999f) : 1.f;
+					int exp;
+					const float m = std::frexp(fogZ, &exp) * 32.f - 16.f;
+					const int fogIdx = std::min((int)m + (exp - 1) * 16, 127);
+					const float frac = m - std::floor(m);
+					fog = fogTable[fogIdx][1] * (1.f - frac) + fogTable[fogIdx][0] * frac;
+				}
+				if (s.fogCtrl == 3)
+				{
+					color[0] = fogColRam[0];
+					color[1] = fogColRam[1];
+					color[2] = fogColRam[2];
+					color[3] = fog;
+				}
+
+				if (texture != nullptr)
+				{
+					float u = attr[1] * w;
+					float v = attr[2] * w;
+					u32 lod = 0;
+					if (texture->levels > 1)
+					{
+						const float dudx = (tri.a[1] - u * tri.a[0]) * w;
+						const float dvdx = (tri.a[2] - v * tri.a[0]) * w;
+						const float dudy = (tri.b[1] - u * tri.b[0]) * w;
+						const float dvdy = (tri.b[2] - v * tri.b[0]) * w;
+						const float rho2 = std::max(dudx * dudx + dvdx * dvdx, dudy * dudy + dvdy * dvdy)
+								* (float)texture->texWidth * (float)texture->texWidth;
+						const float l = 0.5f * std::log2(rho2) + s.lodBias + 0.5f;
+						if (l >= 1.f)
+							lod = std::min((u32)l, texture->levels - 1);
+					}
+					const int width = std::max(texture->texWidth >> lod, 1u);
+					const int height = std::max(texture->texHeight >> lod, 1u);
+					const u32 *texels = texture->level(lod);
+					float fu = u * width;
+					float fv = v * height;
+					if (!(std::abs(fu) < 16777216.f))
+						fu = 0.f;
+					if (!(std::abs(fv) < 16777216.f))
+						fv = 0.f;
+
+					auto fetch = [&](int tx, int ty, float *rgba) {
+						tx = wrapCoord(tx, width, s.clampU, s.flipU);
+						ty = wrapCoord(ty, height, s.clampV, s.flipV);
+						u32 texel = texels[ty * width + tx];
+						if (s.palette != nullptr)
+							texel = s.palette[texel];
+						unpackColor(texel, rgba);
+					};
+					float texcol[4];
+					if (s.nearest)
+						fetch((int)std::floor(fu), (int)std::floor(fv), texcol);
+					else
+					{
+						fu -= 0.5f;
+						fv -= 0.5f;
+						const float bx = std::floor(fu);
+						const float by = std::floor(fv);
+						const float ax = fu - bx;
+						const float ay = fv - by;
+						float t00[4], t10[4], t01[4], t11[4];
+						fetch((int)bx, (int)by, t00);
+						fetch((int)bx + 1, (int)by, t10);
+						fetch((int)bx, (int)by + 1, t01);
+						fetch((int)bx + 1, (int)by + 1, t11);
+						for (int j = 0; j < 4; j++)
+							texcol[j] = (t00[j] * (1.f - ax) + t10[j] * ax) * (1.f - ay)
+									+ (t01[j] * (1.f - ax) + t11[j] * ax) * ay;
+					}
+
+					if (s.bumpMap)
+					{
+						constexpr float PI = 3.1415926f;
+						const float bs = PI / 2.f * (texcol[3] * 15.f * 16.f + texcol[0] * 15.f) / 255.f;
+						const float br = 2.f * PI * (texcol[1] * 15.f * 16.f + texcol[2] * 15.f) / 255.f;
+						texcol[3] = std::min(std::max(offset[3] + offset[0] * std::sin(bs)
+								+ offset[1] * std::cos(bs) * std::cos(br - 2.f * PI * offset[2]), 0.f), 1.f);
+						texcol[0] = texcol[1] = texcol[2] = 1.f;
+					}
+					else
+					{
+						if (s.ignoreTexA)
+							texcol[3] = 1.f;
+						if (s.alphaTest)
+						{
+							if (ptAlphaRef > texcol[3])
+								continue;
+							texcol[3] = 1.f;
+						}
+					}
+					switch (s.shadInstr)
+					{
+					case 0:	// Decal
+						std::copy(texcol, texcol + 4, color);
+						break;
+					case 1:	// Modulate
+						for (int j = 0; j < 3; j++)
+							color[j] *= texcol[j];
+						color[3] = texcol[3];
+						break;
+					case 2:	// Decal alpha
+						for (int j = 0; j < 3; j++)
+							color[j] = color[j] * (1.f - texcol[3]) + texcol[j] * texcol[3];
+						break;
+					case 3:	// Modulate alpha
+						for (int j = 0; j < 4; j++)
+							color[j] *= texcol[j];
+						break;
+					}
+					if (s.offset && !s.bumpMap)
+						for (int j = 0; j < 3; j++)
+							color[j] += offset[j];
+				}
+
+				if (s.colorClamp)
+					for (int j = 0; j < 4; j++)
+						color[j] = std::min(std::max(color[j], fogClampMin[j]), fogClampMax[j]);
+				if (s.fogCtrl == 0)
+					for (int j = 0; j < 3; j++)
+						color[j] = color[j] * (1.f - fog) + fogColRam[j] * fog;
+				else if (s.fogCtrl == 1 && s.offset && !s.bumpMap)
+					for (int j = 0; j < 3; j++)
+						color[j] = color[j] * (1.f - offset[3]) + fogColVert[j] * offset[3];
+				for (int j = 0; j < 4; j++)
+					color[j] = std::min(std::max(color[j] * s.trilinearAlpha, 0.f), 1.f);
+
+				if (s.blend)
+				{
+					float dst[4];
+					unpackColor(tile.color[idx], dst);
+					float srcFactor[4];
+					float dstFactor[4];
+					blendFactor(s.srcBlend, color, dst, dst, srcFactor);
+					blendFactor(s.dstBlend, color, dst, color, dstFactor);
+					for (int j = 0; j < 4; j++)
+						color[j] = color[j] * srcFactor[j] + dst[j] * dstFactor[j];
+				}
+				tile.color[idx] = packColor(color);
+				if (s.depthWrite)
+					tile.depth[idx] = z;
+				tile.stencil[idx] = s.stencil;
+			}
+		}
+	}
+}
+
+template<int Mode>
+void SoftRenderer::drawVolumeTriangle(Tile& tile, const VolumeTriangle& tri, int cullMode)
+{
+	if (!tri.valid || (cullMode == 2 && tri.negative) || (cullMode == 3 && !tri.negative))
+		return;
+	const int x0 = std::max(tri.minX, tile.x);
+	const int x1 = std::min(tri.maxX, tile.x + TileSize - 1);
+	const int y0 = std::max(tri.minY, tile.y);
+	const int y1 = std::min(tri.maxY, tile.y + TileSize - 1);
+
+	for (int y = y0; y <= y1; y++)
+	{
+		const float py = (float)y + 0.5f;
+		for (int x = x0; x <= x1; x += 4)
+		{
+			u32 mask = coverage(tri.edgeA, tri.edgeB, tri.edgeC, tri.topLeft, x, py);
+			if (x1 - x < 3)
+				mask &= (1 << (x1 - x + 1)) - 1;
+			for (int i = 0; mask != 0; i++, mask >>= 1)
+			{
+				if ((mask & 1) == 0)
+					continue;
+				const int idx = (y - tile.y) * TileSize + x + i - tile.x;
+				u8& stencil = tile.stencil[idx];
+				if (Mode == VolumeXor || Mode == VolumeOr)
+				{
+					// Only the parts of the volume in front of the polygons count
+					const float z = tri.za * ((float)(x + i) + 0.5f) + tri.zb * py + tri.zc;
+					if (!(z > tile.depth[idx]))
+						continue;
+					if (Mode == VolumeXor)
+						stencil ^= 2;
+					else
+						stencil |= 2;
+				}
+				else if (Mode == VolumeInclusion)
+					stencil = (stencil & ~3) | ((stencil & 3) != 0 ? 1 : 0);
+				else
+					stencil = (stencil & ~3) | ((stencil & 3) == 1 ? 1 : 0);
+			}
+		}
+	}
+}
+
+void SoftRenderer::drawVolumes(Tile& tile, const Pass& pass)
+{
+	if (pass.mvoCount == 0 || volumeTriangles.empty())
+		return;
+
+	// Bit 1 of the stencil is the state of the current volume and bit 0 is the summary result
+	const ModifierVolumeParam *params = &pvrrc.global_param_mvo.head()[pass.mvoFirst];
+	int modBase = -1;
+	for (u32 i = 0; i < pass.mvoCount; i++)
+	{
+		const ModifierVolumeParam& param = params[i];
+		if (param.count == 0)
+			continue;
+		const u32 mode = param.isp.DepthMode;
+		if (modBase == -1)
+			modBase = param.first;
+		const u32 end = std::min<u32>(param.first + param.count, (u32)volumeTriangles.size());
+		for (u32 t = param.first; t < end; t++)
+		{
+			if (!param.isp.VolumeLast && mode > 0)
+				// Open volume or quad
+				drawVolumeTriangle<VolumeOr>(tile, volumeTriangles[t], param.isp.CullMode);
+			else
+				// Closed volume
+				drawVolumeTriangle<VolumeXor>(tile, volumeTriangles[t], param.isp.CullMode);
+		}
+		if (mode == 1 || mode == 2)
+		{
+			// Sum the area
+			for (u32 t = modBase; t < end; t++)
+			{
+				if (mode == 1)
+					drawVolumeTriangle<VolumeInclusion>(tile, volumeTriangles[t], param.isp.CullMode);
+				else
+					drawVolumeTriangle<VolumeExclusion>(tile, volumeTriangles[t], param.isp.CullMode);
+			}
+			modBase = -1;
+		}
+	}
+
+	// Shade the pixels of shadowed polygons inside a volume
+	const float alpha = 1.f - shadowScale;
+	for (int i = 0; i < TileSize * TileSize; i++)
+	{
+		if ((tile.stencil[i] & 0x81) == 0x81)
+		{
+			float color[4];
+			unpackColor(tile.color[i], color);
+			for (int j = 0; j < 3; j++)
+				color[j] *= shadowScale;
+			color[3] = alpha * alpha + color[3] * shadowScale;
+			tile.color[i] = packColor(color);
+		}
+		tile.stencil[i] &= ~3;
+	}
+}
+
+void SoftRenderer::renderTile(Tile& tile, const std::vector<u32>& bin)
+{
+	std::fill(std::begin(tile.color), std::end(tile.color), 0);
+	std::fill(std::begin(tile.depth), std::end(tile.depth), 0.f);
+	std::fill(std::begin(tile.stencil), std::end(tile.stencil), 0);
+
+	size_t next = 0;
+	for (size_t i = 0; i < passes.size(); i++)
+	{
+		const Pass& pass = passes[i];
+		if (i > 0 && pass.zClear)
+			std::fill(std::begin(tile.depth), std::end(tile.depth), 0.f);
+		// Opaque and punch-through
+		for (; next < bin.size() && bin[next] < pass.translucent; next++)
+			drawTriangle(tile, triangles[bin[next]]);
+		if (modifierVolumes)
+			drawVolumes(tile, pass);
+		// Translucent
+		for (; next < bin.size() && bin[next] < pass.end; next++)
+			drawTriangle(tile, triangles[bin[next]]);
+	}
+	writeTile(tile);
+}
+
+void SoftRenderer::writeTile(const Tile& tile)
+{
+	const int width = std::min<int>(TileSize, frameWidth - tile.x);
+	const int height = std::min<int>(TileSize, frameHeight - tile.y);
+	for (int y = 0; y < height; y++)
+		memcpy(&frame[(tile.y + y) * frameWidth + tile.x], &tile.color[y * TileSize], width * sizeof(u32));
+}
+
+void SoftRenderer::renderRows()
+{
+	std::unique_ptr<Tile> tile(new Tile());
+	for (int row = nextRow++; row < tileRows; row = nextRow++)
+	{
+		tile->y = row * TileSize;
+		if (tile->y > clipY1 || tile->y + TileSize <= clipY0)
+			continue;
+		for (int col = 0; col < tileCols; col++)
+		{
+			tile->x = col * TileSize;
+			if (tile->x > clipX1 || tile->x + TileSize <= clipX0)
+				continue;
+			renderTile(*tile, bins[row]);
+		}
+	}
+}
+
+void SoftRenderer::startWorkers()
+{
+	int count = threads > 0 ? threads : (int)std::thread::hardware_concurrency();
+	running = true;
+	// The rendering thread is one of them
+	for (int i = 1; i < count; i++)
+		workers.emplace_back(&SoftRenderer::workerThread, this, frameId);
+	INFO_LOG(RENDERER, "Software renderer using %d threads", std::max(count, 1));
+}
+
+void SoftRenderer::stopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!running)
+			return;
+		running = false;
+	}
+	startCond.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+	workers.clear();
+}
+
+void SoftRenderer::workerThread(u32 startFrame)
+{
+	u32 lastFrame = startFrame;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			startCond.wait(lock, [this, lastFrame]() { return !running || frameId != lastFrame; });
+			if (!running)
+				break;
+			lastFrame = frameId;
+		}
+		renderRows();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			activeWorkers--;
+		}
+		doneCond.notify_one();
+	}
+}
+
+void SoftRenderer::renderFramebuffer()
+{
+	if (FB_R_SIZE.fb_x_size == 0 || FB_R_SIZE.fb_y_size == 0)
+		return;
+
+	PixelBuffer<u32> pb;
+	int width;
+	int height;
+	ReadFramebuffer(pb, width, height);
+	frameWidth = width;
+	frameHeight = height;
+	frame.assign(pb.data(), pb.data() + width * height);
+}
+
+void SoftRenderer::writeToVram()
+{
+	u32 linestride = pvrrc.fb_W_LINESTRIDE * 8;
+	if (linestride == 0)
+		linestride = frameWidth * 2;
+	const u32 address = pvrrc.fb_W_SOF1 & VRAM_MASK;
+	if (address + std::max(linestride, frameWidth * 2) * frameHeight > VRAM_SIZE)
+	{
+		WARN_LOG(RENDERER, "Render to texture out of vram: address %x size %dx%d", address, frameWidth, frameHeight);
+		return;
+	}
+	WriteTextureToVRam(frameWidth, frameHeight, (u8 *)frame.data(), (u16 *)&vram[address], pvrrc.fb_W_CTRL, linestride);
+}
+
+bool SoftRenderer::Render()
+{
+	if (pvrrc.isRenderFramebuffer)
+	{
+		renderFramebuffer();
+		return true;
+	}
+	const bool isRtt = pvrrc.isRTT;
+	frameWidth = pvrrc.getFramebufferWidth();
+	frameHeight = pvrrc.getFramebufferHeight();
+	if (!isRtt && (FB_R_CTRL.fb_enable == 0 || VO_CONTROL.blank_video == 1))
+	{
+		// Video output disabled
+		frame.assign(frameWidth * frameHeight, RGBAPacker::pack(VO_BORDER_COL._red, VO_BORDER_COL._green, VO_BORDER_COL._blue, 0xff));
+		return true;
+	}
+	frame.assign(frameWidth * frameHeight, 0);
+	tileCols = (frameWidth + TileSize - 1) / TileSize;
+	tileRows = (frameHeight + TileSize - 1) / TileSize;
+	setup();
+
+	// Tile rows are rendered by the workers and this thread
+	if (!running)
+		startWorkers();
+	nextRow = 0;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		frameId++;
+		activeWorkers = (int)workers.size();
+	}
+	startCond.notify_all();
+	renderRows();
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		doneCond.wait(lock, [this]() { return activeWorkers == 0; });
+	}
+
+	if (isRtt)
+		writeToVram();
+
+	return !isRtt;
+}
+
+bool SoftRenderer::Present()
+{
+#ifdef TEST_AUTOMATION
+	extern bool do_screenshot;
+
+	if (do_screenshot && !frame.empty())
+	{
+		std::vector<u32> img(frame);
+		for (u32& pixel : img)
+			pixel |= 0xff000000;
+		dump_screenshot((u8 *)img.data(), frameWidth, frameHeight, true, frameWidth * 4, false);
+		dc_exit();
+		flycast_term();
+		exit(0);
+	}
+#endif
+	return true;
+}
+
+Renderer* rend_softrend() { return new SoftRenderer(); }
@@ -0,0 +1,211 @@
+/*
+	Headless software reference renderer.
+
+	The frame is rasterized on the cpu the way the PowerVR2 does it: the render area is split into
+	32x32 tiles and each tile goes through the render passes in order, opaque then punch-through
+	polygons, modifier volumes and translucent polygons, using a tile-local color, depth and stencil
+	buffer. Triangle edges and attribute planes are set up once per frame, with SIMD when available,
+	and binned by tile row. Tile rows are then rendered in parallel by a pool of worker threads.
+
+	Shading follows the Open GL renderer so that the output of both can be compared. Naomi 2
+	polygons aren't rendered. The frame is kept in memory at the native resolution and written back
+	to vram when rendering to a texture.
+	It's selected with pvr.rend = 7 and doesn't need a gpu, which makes it suitable for automated
+	tests and golden-image comparisons. TEST_AUTOMATION builds dump its screenshots with dump_screenshot.
+*/
+#pragma once
+#include "hw/pvr/Renderer_if.h"
+#include "rend/TexCache.h"
+#include "rend/sorter.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Keeps the texels in memory, converted to RGBA8 or as palette indices
+class SoftTexture final : public BaseTextureCacheData
+{
+public:
+	SoftTexture(TSP tsp, TCW tcw) : BaseTextureCacheData(tsp, tcw) {}
+	SoftTexture(SoftTexture&& other) : BaseTextureCacheData(std::move(other)),
+			texWidth(other.texWidth), texHeight(other.texHeight), levels(other.levels), texels(std::move(other.texels)) {}
+
+	std::string GetId() override { return std::to_string(sa_tex); }
+	void UploadToGPU(int width, int height, u8 *temp_tex_buffer, bool mipmapped, bool mipmapsIncluded = false) override;
+	// Only textures using the gpu palette aren't converted to 32 bits
+	bool Force32BitTexture(TextureType type) const override { return type != TextureType::_8; }
+	bool Delete() override;
+
+	// Returns the texels of the given mipmap level (0 is the largest)
+	const u32 *level(u32 lod) const {
+		return &texels[((1u << (2 * (levels - 1 - lod))) - 1) / 3];
+	}
+
+	u32 texWidth = 0;
+	u32 texHeight = 0;
+	u32 levels = 0;
+	std::vector<u32> texels;	// smallest mipmap first
+};
+
+class SoftRenderer final : public Renderer
+{
+public:
+	~SoftRenderer() override { Term(); }
+
+	bool Init() override;
+	void Resize(int w, int h) override {}
+	void Term() override;
+	bool Process(TA_context* ctx) override;
+	bool Render() override;
+	bool Present() override;
+	BaseTextureCacheData *GetTexture(TSP tsp, TCW tcw) override;
+
+	// Number of threads rendering tile rows, including the calling thread. 0 uses all the cpu cores.
+	void SetThreads(int threads);
+	// Last rendered frame in RGBA8, top row first
+	const std::vector<u32>& GetFrame(u32& width, u32& height) const {
+		width = frameWidth;
+		height = frameHeight;
+		return frame;
+	}
+
+private:
+	static constexpr int TileSize = 32;
+
+	// Render state of a polygon, resolved from its parameters and the global options
+	struct PolyState
+	{
+		const SoftTexture *texture;
+		const u32 *palette;		// textures using the gpu palette
+		float trilinearAlpha;
+		float lodBias;
+		int clip[4];			// tile clipping area: x, y, end x, end y
+		u8 clipMode;			// TileClipping
+		u8 shadInstr;
+		u8 fogCtrl;
+		u8 depthFunc;
+		u8 srcBlend;
+		u8 dstBlend;
+		u8 stencil;
+		bool gouraud;
+		bool useAlpha;
+		bool ignoreTexA;
+		bool offset;
+		bool bumpMap;
+		bool colorClamp;
+		bool alphaTest;
+		bool blend;
+		bool depthWrite;
+		bool colorWrite;
+		bool nearest;
+		bool clampU;
+		bool clampV;
+		bool flipU;
+		bool flipV;
+	};
+
+	// Attributes are interpolated as planes: a * x + b * y + c
+	// 0: z (1/w), 1-2: u/w and v/w, 3-6: base color, 7-10: offset color (divided by w if gouraud)
+	static constexpr int Attributes = 12;
+	struct Triangle
+	{
+		alignas(16) float edgeA[4];	// edge functions, positive inside
+		alignas(16) float edgeB[4];
+		alignas(16) float edgeC[4];
+		alignas(16) float a[Attributes];
+		alignas(16) float b[Attributes];
+		alignas(16) float c[Attributes];
+		int minX, minY, maxX, maxY;
+		u32 state;
+		u32 topLeft;				// top-left fill rule, one bit per edge
+	};
+
+	struct VolumeTriangle
+	{
+		alignas(16) float edgeA[4];
+		alignas(16) float edgeB[4];
+		alignas(16) float edgeC[4];
+		float za, zb, zc;
+		int minX, minY, maxX, maxY;
+		u32 topLeft;
+		bool negative;				// orientation, for culling
+		bool valid;
+	};
+
+	// Triangle ranges of a render pass
+	struct Pass
+	{
+		u32 opaque;		// first opaque triangle
+		u32 translucent;	// first translucent triangle
+		u32 end;
+		u32 mvoFirst;
+		u32 mvoCount;
+		bool zClear;
+	};
+
+	struct Tile
+	{
+		u32 color[TileSize * TileSize];
+		float depth[TileSize * TileSize];
+		u8 stencil[TileSize * TileSize];
+		int x, y;
+	};
+
+	u32 addState(const PolyParam& pp, u32 listType, bool sorted, bool depthOnly = false);
+	void addTriangle(const Vertex& v0, const Vertex& v1, const Vertex& v2, u32 state, int cullMode);
+	void addStrips(const List<PolyParam>& list, u32 first, u32 count, u32 listType, bool sorted);
+	void addSortedTriangles(u32 first, u32 count, bool multipass);
+	void setup();
+	void renderRows();
+	void renderTile(Tile& tile, const std::vector<u32>& bin);
+	void drawTriangle(Tile& tile, const Triangle& tri);
+	void drawVolumes(Tile& tile, const Pass& pass);
+	template<int Mode>
+	void drawVolumeTriangle(Tile& tile, const VolumeTriangle& tri, int cullMode);
+	void writeTile(const Tile& tile);
+	void renderFramebuffer();
+	void writeToVram();
+	void startWorkers();
+	void stopWorkers();
+	void workerThread(u32 startFrame);
+
+	BaseTextureCache<SoftTexture> textureCache;
+
+	std::vector<PolyState> states;
+	std::vector<Triangle> triangles;
+	std::vector<VolumeTriangle> volumeTriangles;
+	std::vector<Pass> passes;
+	std::vector<std::vector<u32>> bins;		// triangles of each tile row
+	std::vector<SortTrigDrawParam> sortedParams;
+	std::vector<u32> sortedIndices;
+	bool modifierVolumes = false;
+	int clipX0 = 0, clipY0 = 0, clipX1 = 0, clipY1 = 0;	// render area, inclusive
+	float fogDensity = 0;
+	float fogColRam[3] {};
+	float fogColVert[3] {};
+	float fogClampMin[4] {};
+	float fogClampMax[4] {};
+	float fogTable[128][2] {};
+	float ptAlphaRef = 0;
+	float shadowScale = 1;
+
+	std::vector<u32> frame;
+	u32 frameWidth = 0;
+	u32 frameHeight = 0;
+	int tileRows = 0;
+	int tileCols = 0;
+
+	int threads = 0;
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable startCond;
+	std::condition_variable doneCond;
+	std::atomic<int> nextRow;
+	u32 frameId = 0;
+	int activeWorkers = 0;
+	bool running = false;
+};
+
+Renderer* rend_softrend();
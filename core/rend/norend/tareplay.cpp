@@ -0,0 +1,241 @@
+#include "tareplay.h"
+#include "hw/pvr/ta.h"
+#include "hw/pvr/ta_ctx.h"
+#include "hw/pvr/ta_capture.h"
+#include "hw/pvr/pvr_mem.h"
+#include "hw/pvr/Renderer_if.h"
+#include "rend/TexCache.h"
+#include "rend/sorter.h"
+
+#include <xxhash.h>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsedUs(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+// Keeps a hash of the converted texture instead of uploading it
+class ReplayTexture final : public BaseTextureCacheData
+{
+public:
+	ReplayTexture(TSP tsp, TCW tcw) : BaseTextureCacheData(tsp, tcw) {}
+	ReplayTexture(ReplayTexture&& other) : BaseTextureCacheData(std::move(other)), hash(other.hash) {}
+
+	std::string GetId() override { return std::to_string(sa_tex); }
+
+	void UploadToGPU(int width, int height, u8 *temp_tex_buffer, bool mipmapped, bool mipmapsIncluded = false) override
+	{
+		u32 bpp = tex_type == TextureType::_8888 ? 4 : tex_type == TextureType::_8 ? 1 : 2;
+		hash = XXH64(temp_tex_buffer, width * height * bpp, 0);
+	}
+
+	u64 hash = 0;
+};
+
+struct ReplayRenderer final : public Renderer
+{
+	bool Init() override { return true; }
+	void Resize(int w, int h) override {}
+	void Term() override { textureCache.Clear(); }
+	bool Process(TA_context* ctx) override { return ta_parse(ctx); }
+	bool Render() override { return false; }
+
+	BaseTextureCacheData *GetTexture(TSP tsp, TCW tcw) override
+	{
+		ReplayTexture *texture = textureCache.getTextureCacheData(tsp, tcw);
+		if (texture->NeedsUpdate())
+		{
+			Clock::time_point start = Clock::now();
+			texture->Update();
+			textureTime += elapsedUs(start);
+			textures++;
+			textureHash = XXH64(&texture->hash, sizeof(texture->hash), textureHash);
+		}
+		return texture;
+	}
+
+	BaseTextureCache<ReplayTexture> textureCache;
+	double textureTime = 0;
+	u32 textures = 0;
+	u64 textureHash = 0;
+};
+
+static ReplayRenderer replayRenderer;
+static std::vector<std::unique_ptr<TA_context>> contexts;
+
+template<typename T>
+static void hash(XXH64_state_t *state, const T& value)
+{
+	XXH64_update(state, &value, sizeof(value));
+}
+
+static void hashPolys(XXH64_state_t *state, const List<PolyParam>& list)
+{
+	for (const PolyParam& pp : list)
+	{
+		hash(state, pp.first);
+		hash(state, pp.count);
+		hash(state, pp.tsp.full);
+		hash(state, pp.tcw.full);
+		hash(state, pp.pcw.full);
+		hash(state, pp.isp.full);
+		hash(state, pp.tileclip);
+		hash(state, pp.tsp1.full);
+		hash(state, pp.tcw1.full);
+		hash(state, pp.texture != nullptr);
+	}
+}
+
+static void hashModVols(XXH64_state_t *state, const List<ModifierVolumeParam>& list)
+{
+	for (const ModifierVolumeParam& mvp : list)
+	{
+		hash(state, mvp.first);
+		hash(state, mvp.count);
+		hash(state, mvp.isp.full);
+	}
+}
+
+static u64 hashRendContext(const rend_context& rc)
+{
+	XXH64_state_t *state = XXH64_createState();
+	XXH64_reset(state, 0);
+	XXH64_update(state, rc.verts.head(), rc.verts.bytes());
+	XXH64_update(state, rc.idx.head(), rc.idx.bytes());
+	XXH64_update(state, rc.modtrig.head(), rc.modtrig.bytes());
+	hashPolys(state, rc.global_param_op);
+	hashPolys(state, rc.global_param_pt);
+	hashPolys(state, rc.global_param_tr);
+	hashModVols(state, rc.global_param_mvo);
+	hashModVols(state, rc.global_param_mvo_tr);
+	for (const RenderPass& pass : rc.render_passes)
+	{
+		hash(state, pass.autosort);
+		hash(state, pass.z_clear);
+		hash(state, pass.op_count);
+		hash(state, pass.mvo_count);
+		hash(state, pass.pt_count);
+		hash(state, pass.tr_count);
+		hash(state, pass.mvo_tr_count);
+	}
+	hash(state, rc.fb_X_CLIP.full);
+	hash(state, rc.fb_Y_CLIP.full);
+	u64 digest = XXH64_digest(state);
+	XXH64_freeState(state);
+
+	return digest;
+}
+
+// Sorts the auto-sorted translucent lists like the renderers do, per triangle then per strip
+static u64 sortTranslucentLists(const rend_context& rc, double& sortTime)
+{
+	static std::vector<SortTrigDrawParam> pidx_sort;
+	static std::vector<u32> vidx_sort;
+
+	XXH64_state_t *state = XXH64_createState();
+	XXH64_reset(state, 0);
+	sortTime = 0;
+	u32 previousTrCount = 0;
+	for (const RenderPass& pass : rc.render_passes)
+	{
+		if (pass.autosort)
+		{
+			int first = previousTrCount;
+			int count = pass.tr_count - previousTrCount;
+			Clock::time_point start = Clock::now();
+			GenSorted(first, count, pidx_sort, vidx_sort);
+			SortPParams(first, count);
+			sortTime += elapsedUs(start);
+
+			for (const SortTrigDrawParam& param : pidx_sort)
+			{
+				hash(state, (u32)(param.ppid - rc.global_param_tr.head()));
+				hash(state, param.first);
+				hash(state, param.count);
+			}
+			XXH64_update(state, vidx_sort.data(), vidx_sort.size() * sizeof(u32));
+			for (int i = first; i < first + count; i++)
+				hash(state, rc.global_param_tr.head()[i].first);
+		}
+		previousTrCount = pass.tr_count;
+	}
+	u64 digest = XXH64_digest(state);
+	XXH64_freeState(state);
+
+	return digest;
+}
+
+bool tarep_Replay(const TACapture& capture, TAReplayStats& stats)
+{
+	if (capture.passes.empty() || capture.passes.size() > MAX_PASSES || capture.pvrRegs.size() != pvr_RegSize)
+		return false;
+	for (const std::vector<u8>& data : capture.passes)
+		if (data.size() > TA_DATA_SIZE)
+			return false;
+
+	// Textures write-protect vram so they must be released before it's restored
+	replayRenderer.textureCache.Clear();
+	memcpy(pvr_regs, capture.pvrRegs.data(), pvr_RegSize);
+	memcpy(vram.data, capture.vram.data(), std::min<size_t>(VRAM_SIZE, capture.vram.size()));
+	forcePaletteUpdate();
+	palette_update();
+
+	while (contexts.size() < capture.passes.size())
+	{
+		contexts.emplace_back(new TA_context());
+		contexts.back()->Alloc();
+	}
+	for (size_t i = 0; i < capture.passes.size(); i++)
+	{
+		TA_context *ctx = contexts[i].get();
+		ctx->Reset();
+		memcpy(ctx->tad.thd_root, capture.passes[i].data(), capture.passes[i].size());
+		ctx->tad.thd_data = ctx->tad.thd_root + capture.passes[i].size();
+		if (i > 0)
+			contexts[i - 1]->nextContext = ctx;
+	}
+	TA_context *ctx = contexts[0].get();
+	rend_context& rc = ctx->rend;
+	// Vertex attributes that aren't used by a polygon aren't written so clear them to get a stable hash
+	memset(rc.verts.head(), 0, rc.verts.size * sizeof(Vertex));
+	rend_fill_context(ctx);
+
+	Renderer *savedRenderer = renderer;
+	TA_context *savedContext = _pvrrc;
+	renderer = &replayRenderer;
+	_pvrrc = ctx;
+	replayRenderer.textureTime = 0;
+	replayRenderer.textures = 0;
+	replayRenderer.textureHash = 0;
+
+	Clock::time_point start = Clock::now();
+	bool success = ta_parse(ctx);
+	stats.parseTime = elapsedUs(start);
+	stats.indexTime = ta_index_time / 1000.0;
+	stats.textureTime = replayRenderer.textureTime;
+	stats.textures = replayRenderer.textures;
+	stats.textureHash = replayRenderer.textureHash;
+	if (success)
+	{
+		stats.vertices = rc.verts.used();
+		stats.indices = rc.idx.used();
+		stats.polys = rc.global_param_op.used() + rc.global_param_pt.used() + rc.global_param_tr.used();
+		stats.rendHash = hashRendContext(rc);
+		stats.sortHash = sortTranslucentLists(rc, stats.sortTime);
+	}
+	renderer = savedRenderer;
+	_pvrrc = savedContext;
+
+	return success;
+}
+
+void tarep_Term()
+{
+	replayRenderer.textureCache.Clear();
+	contexts.clear();
+}
@@ -0,0 +1,35 @@
+/*
+	Headless replay of captured TA frames.
+
+	The PVR state of a capture is restored and the frame goes through the renderer-independent
+	part of the pipeline: ta_parse (including index building and texture conversion), then
+	per-strip and per-triangle sorting of the auto-sorted translucent lists.
+	Each stage is timed and its output hashed so that optimizations can be checked against
+	a corpus of captured frames without a GPU.
+*/
+#pragma once
+#include "types.h"
+
+struct TACapture;
+
+struct TAReplayStats
+{
+	// in microseconds
+	double parseTime;		// ta_parse, including index building and texture conversion
+	double indexTime;
+	double textureTime;
+	double sortTime;		// SortPParams and GenSorted
+
+	u32 vertices;
+	u32 indices;
+	u32 polys;
+	u32 textures;			// textures converted
+
+	u64 rendHash;			// vertices, indices and polygon parameters of the parsed frame
+	u64 sortHash;			// sorted strips and triangles
+	u64 textureHash;		// converted texture data
+};
+
+bool tarep_Replay(const TACapture& capture, TAReplayStats& stats);
+// Frees the contexts and textures used by the replays
+void tarep_Term();
@@ -16,6 +16,7 @@
  */
 #include "sorter.h"
 #include "hw/pvr/Renderer_if.h"
+#include "cfg/option.h"
 #include <algorithm>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -48,6 +49,112 @@ static float getProjectedZ(const Vertex *v, const float *mat)
 	return -1 / (mat[2] * v->x + mat[1 * 4 + 2] * v->y + mat[2 * 4 + 2] * v->z + mat[3 * 4 + 2]);
 }
 
+// Shorter lists are sorted with std::stable_sort
+constexpr int RADIX_SORT_MIN_COUNT = 64;
+// Minimum number of triangles to extract the sort keys on several threads
+constexpr u32 PARALLEL_MIN_TRIANGLES = 16384;
+
+static bool comparisonSort;
+
+void setComparisonSort(bool enabled)
+{
+	comparisonSort = enabled;
+}
+
+static bool isNaN(float f)
+{
+	u32 bits;
+	memcpy(&bits, &f, sizeof(bits));
+	return (bits & 0x7fffffff) > 0x7f800000;
+}
+
+// Maps a float to an unsigned integer with the same ordering.
+// -0 and +0 compare equal. NaNs aren't ordered so they must be handled by the caller.
+static u32 floatSortKey(float f)
+{
+	u32 bits;
+	memcpy(&bits, &f, sizeof(bits));
+	if (bits == 0x80000000)
+		bits = 0;
+	// flip all the bits of negative numbers and the sign bit of positive ones
+	return bits ^ ((u32)((s32)bits >> 31) | 0x80000000);
+}
+
+// Stable LSD radix sort on 8-bit digits. The keys are clobbered and order receives the sorted item indexes.
+static void radixSort(std::vector<u32>& keys, std::vector<u32>& order)
+{
+	static std::vector<u32> tmpKeys;
+	static std::vector<u32> tmpOrder;
+
+	const u32 count = (u32)keys.size();
+	tmpKeys.resize(count);
+	tmpOrder.resize(count);
+	order.resize(count);
+	for (u32 i = 0; i < count; i++)
+		order[i] = i;
+
+	u32 histograms[4][256] {};
+	for (u32 key : keys)
+	{
+		histograms[0][key & 0xff]++;
+		histograms[1][(key >> 8) & 0xff]++;
+		histograms[2][(key >> 16) & 0xff]++;
+		histograms[3][key >> 24]++;
+	}
+	u32 *srcKeys = keys.data();
+	u32 *srcOrder = order.data();
+	u32 *dstKeys = tmpKeys.data();
+	u32 *dstOrder = tmpOrder.data();
+	for (int digit = 0; digit < 4; digit++)
+	{
+		const int shift = digit * 8;
+		u32 *offsets = histograms[digit];
+		// nothing to do if all keys have the same digit
+		if (offsets[(srcKeys[0] >> shift) & 0xff] == count)
+			continue;
+		u32 offset = 0;
+		for (int i = 0; i < 256; i++)
+		{
+			u32 n = offsets[i];
+			offsets[i] = offset;
+			offset += n;
+		}
+		for (u32 i = 0; i < count; i++)
+		{
+			u32 pos = offsets[(srcKeys[i] >> shift) & 0xff]++;
+			dstKeys[pos] = srcKeys[i];
+			dstOrder[pos] = srcOrder[i];
+		}
+		std::swap(srcKeys, dstKeys);
+		std::swap(srcOrder, dstOrder);
+	}
+	if (srcOrder != order.data())
+		memcpy(order.data(), srcOrder, count * sizeof(u32));
+}
+
+static bool radixSortPolys(PolyParam *polys, int count)
+{
+	static std::vector<u32> keys;
+	static std::vector<u32> order;
+	static std::vector<PolyParam> sorted;
+
+	keys.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		if (isNaN(polys[i].zvZ))
+			return false;
+		keys[i] = floatSortKey(polys[i].zvZ);
+	}
+	radixSort(keys, order);
+
+	sorted.resize(count);
+	for (int i = 0; i < count; i++)
+		sorted[i] = polys[order[i]];
+	std::copy(sorted.begin(), sorted.end(), polys);
+
+	return true;
+}
+
 void SortPParams(int first, int count)
 {
 	if (pvrrc.verts.used() == 0 || count <= 1)
@@ -115,7 +222,9 @@ void SortPParams(int first, int count)
 		pp++;
 	}
 
-	std::stable_sort(pvrrc.global_param_tr.head() + first, pvrrc.global_param_tr.head() + first + count);
+	PolyParam *polys = pvrrc.global_param_tr.head() + first;
+	if (comparisonSort || count < RADIX_SORT_MIN_COUNT || !radixSortPolys(polys, count))
+		std::stable_sort(polys, polys + count);
 }
 
 const static Vertex *vtx_sort_base;
@@ -127,47 +236,11 @@ static void fill_id(u32 *d, const Vertex *v0, const Vertex *v1, const Vertex *v2
 	d[2] = (u32)(v2 - vb);
 }
 
-void GenSorted(int first, int count, std::vector<SortTrigDrawParam>& pidx_sort, std::vector<u32>& vidx_sort)
+static void stableSortTriangles(const PolyParam *pp_base, const PolyParam *pp, const PolyParam *pp_end,
+		const Vertex *vtx_base, const u32 *idx_base, int vtx_count, std::vector<IndexTrig>& lst)
 {
-	u32 tess_gen=0;
-
-	pidx_sort.clear();
-
-	if (pvrrc.verts.used() == 0 || count == 0)
-		return;
-
-	const Vertex * const vtx_base = pvrrc.verts.head();
-	const u32 * const idx_base = pvrrc.idx.head();
-
-	const PolyParam * const pp_base = &pvrrc.global_param_tr.head()[first];
-	const PolyParam *pp = pp_base;
-	const PolyParam * const pp_end = pp + count;
-	while (pp->count == 0 && pp < pp_end)
-		pp++;
-	if (pp == pp_end)
-		return;
-
-	vtx_sort_base=vtx_base;
-
-	static u32 vtx_cnt;
-
-	int vtx_count = pvrrc.verts.used() - idx_base[pp->first];
-	if ((u32)vtx_count > vtx_cnt)
-		vtx_cnt = vtx_count;
-
-#if PRINT_SORT_STATS
-	printf("TVTX: %d || %d\n",vtx_cnt,vtx_count);
-#endif
-
-	if (vtx_count<=0)
-		return;
-
-	//make lists of all triangles, with their pid and vid
-	static std::vector<IndexTrig> lst;
-
 	lst.resize(vtx_count*4);
 
-
 	int pfsti=0;
 
 	while (pp != pp_end)
@@ -220,12 +293,141 @@ void GenSorted(int first, int count, std::vector<SortTrigDrawParam>& pidx_sort,
 		pp++;
 	}
 
-	u32 aused=pfsti;
-
-	lst.resize(aused);
+	lst.resize(pfsti);
 
 	//sort them
 	std::stable_sort(lst.begin(),lst.end());
+}
+
+//
+// Same result as stableSortTriangles, but each strip is first gathered into a z array
+// so that the triangle keys are computed by a vectorizable loop. Keys are extracted on several
+// threads for large lists then radix sorted.
+// Returns false if the list is too short or has NaN depths, which can't be ordered consistently.
+//
+static bool radixSortTriangles(const PolyParam *pp_base, const PolyParam *pp_first, const PolyParam *pp_end,
+		const Vertex *vtx_base, const u32 *idx_base, std::vector<IndexTrig>& lst)
+{
+	static std::vector<u32> vtxOffsets;
+	static std::vector<u32> triOffsets;
+	static std::vector<float> stripZ;
+	static std::vector<IndexTrig> triangles;
+	static std::vector<u32> keys;
+	static std::vector<u32> order;
+
+	const int polyCount = (int)(pp_end - pp_first);
+	vtxOffsets.resize(polyCount);
+	triOffsets.resize(polyCount);
+	u32 vtxCount = 0;
+	u32 triCount = 0;
+	for (int i = 0; i < polyCount; i++)
+	{
+		vtxOffsets[i] = vtxCount;
+		triOffsets[i] = triCount;
+		if (pp_first[i].count > 2)
+		{
+			vtxCount += pp_first[i].count;
+			triCount += pp_first[i].count - 2;
+		}
+	}
+	if (triCount < (u32)RADIX_SORT_MIN_COUNT)
+		return false;
+	stripZ.resize(vtxCount);
+	triangles.resize(triCount);
+	keys.resize(triCount);
+
+	auto extractKeys = [&](int i) {
+		const PolyParam *pp = pp_first + i;
+		if (pp->count <= 2)
+			return;
+		const u32 *idx = idx_base + pp->first;
+		float *z = &stripZ[vtxOffsets[i]];
+		if (pp->isNaomi2())
+			for (u32 j = 0; j < pp->count; j++)
+				z[j] = getProjectedZ(vtx_base + idx[j], pp->mvMatrix);
+		else
+			for (u32 j = 0; j < pp->count; j++)
+				z[j] = vtx_base[idx[j]].z;
+
+		const u32 count = pp->count - 2;
+		IndexTrig *tri = &triangles[triOffsets[i]];
+		const u16 pid = (u16)(pp - pp_base);
+		for (u32 j = 0; j < count; j++)
+		{
+			// the first two vertices of odd triangles are swapped
+			const u32 flip = j & 1;
+			tri[j].id[0] = idx[j + flip];
+			tri[j].id[1] = idx[j + 1 - flip];
+			tri[j].id[2] = idx[j + 2];
+			tri[j].pid = pid;
+		}
+		u32 *key = &keys[triOffsets[i]];
+		for (u32 j = 0; j < count; j++)
+			key[j] = floatSortKey(std::min(std::min(z[j], z[j + 1]), z[j + 2]));
+	};
+#ifdef _OPENMP
+	const int threads = std::max(1, (int)config::MaxThreads);
+#pragma omp parallel for num_threads(threads) schedule(dynamic, 64) if (threads > 1 && triCount >= PARALLEL_MIN_TRIANGLES)
+	for (int i = 0; i < polyCount; i++)
+		extractKeys(i);
+#else
+	for (int i = 0; i < polyCount; i++)
+		extractKeys(i);
+#endif
+	bool nan = false;
+	for (float z : stripZ)
+		nan |= isNaN(z);
+	if (nan)
+		return false;
+
+	radixSort(keys, order);
+	lst.resize(triCount);
+	for (u32 i = 0; i < triCount; i++)
+		lst[i] = triangles[order[i]];
+
+	return true;
+}
+
+void GenSorted(int first, int count, std::vector<SortTrigDrawParam>& pidx_sort, std::vector<u32>& vidx_sort)
+{
+	u32 tess_gen=0;
+
+	pidx_sort.clear();
+
+	if (pvrrc.verts.used() == 0 || count == 0)
+		return;
+
+	const Vertex * const vtx_base = pvrrc.verts.head();
+	const u32 * const idx_base = pvrrc.idx.head();
+
+	const PolyParam * const pp_base = &pvrrc.global_param_tr.head()[first];
+	const PolyParam *pp = pp_base;
+	const PolyParam * const pp_end = pp + count;
+	while (pp->count == 0 && pp < pp_end)
+		pp++;
+	if (pp == pp_end)
+		return;
+
+	vtx_sort_base=vtx_base;
+
+	static u32 vtx_cnt;
+
+	int vtx_count = pvrrc.verts.used() - idx_base[pp->first];
+	if ((u32)vtx_count > vtx_cnt)
+		vtx_cnt = vtx_count;
+
+#if PRINT_SORT_STATS
+	printf("TVTX: %d || %d\n",vtx_cnt,vtx_count);
+#endif
+
+	if (vtx_count<=0)
+		return;
+
+	//make a sorted list of all triangles, with their pid and vid
+	static std::vector<IndexTrig> lst;
+	if (comparisonSort || !radixSortTriangles(pp_base, pp, pp_end, vtx_base, idx_base, lst))
+		stableSortTriangles(pp_base, pp, pp_end, vtx_base, idx_base, vtx_count, lst);
+	const u32 aused = (u32)lst.size();
 
 	//Merge pids/draw cmds if two different pids are actually equal
 	for (u32 k = 1; k < aused; k++)
@@ -32,5 +32,7 @@ struct SortTrigDrawParam
 
 // Sort based on min-z of each triangle
 void GenSorted(int first, int count, std::vector<SortTrigDrawParam>& pidx_sort, std::vector<u32>& vidx_sort);
+// Use std::stable_sort instead of radix sorting. Both give the same result.
+void setComparisonSort(bool enabled);
 // Use the first vertex as provoking vertex for flat-shaded triangles
 void setFirstProvokingVertex(rend_context& rendContext);
@@ -108,6 +108,12 @@ public:
 			tf->SetCommandBuffer(texCommandBuffer);
 			tf->CheckCustomTexture();
 		}
+		else if (tf->IsAsyncDecodeReady())
+		{
+			textureCache.DestroyLater(tf);
+			tf->SetCommandBuffer(texCommandBuffer);
+			tf->CheckAsyncDecode();
+		}
 		tf->SetCommandBuffer(nullptr);
 		textureCache.SetInFlight(tf);
 
@@ -3,6 +3,7 @@
 #include "types.h"
 #include "hw/aica/dsp.h"
 #include "hw/aica/aica.h"
+#include "hw/aica/aica_if.h"
 #include "hw/aica/sgc_if.h"
 #include "hw/arm7/arm7.h"
 #include "hw/holly/sb.h"
@@ -155,6 +156,7 @@ static const std::array<int, 11> getSchedulerIds() {
 
 void dc_serialize(Serializer& ser)
 {
+	aica_threadSync();
 	ser << aica_interr;
 	ser << aica_reg_L;
 	ser << e68k_out;
@@ -495,6 +497,7 @@ static void dc_deserialize_libretro(Deserializer& deser)
 	deser >> sch_list[modem_sched].tag;
     deser >> sch_list[modem_sched].start;
     deser >> sch_list[modem_sched].end;
+	sh4_sched_rebuild();
 
 	deser >> SCIF_SCFSR2;
 	if (deser.version() < Deserializer::V9_LIBRETRO)
@@ -590,6 +593,7 @@ static void dc_deserialize_libretro(Deserializer& deser)
 
 void dc_deserialize(Deserializer& deser)
 {
+	aica_threadSync();
 	if (deser.version() >= Deserializer::V5_LIBRETRO && deser.version() <= Deserializer::VLAST_LIBRETRO)
 	{
 		dc_deserialize_libretro(deser);
@@ -771,6 +775,8 @@ void dc_deserialize(Deserializer& deser)
 	}
 	if (deser.version() < Deserializer::V19)
 		sh4_sched_ffts();
+	else
+		sh4_sched_rebuild();
 	ModemDeserialize(deser);
 
 	deser >> SCIF_SCFSR2;
@@ -20,6 +20,7 @@
 #include "rend/TexCache.h"
 #include "hw/mem/_vmem.h"
 #include "hw/mem/mem_watch.h"
+#include "hw/naomi/rom_memory.h"
 #include <windows.h>
 
 static PVOID vectoredHandler;
@@ -91,6 +92,9 @@ static LONG WINAPI exceptionHandler(EXCEPTION_POINTERS *ep)
 	// FPCB jump table protection
 	if (BM_LockedWrite(address))
 		return EXCEPTION_CONTINUE_EXECUTION;
+	// cartridge ROM filled on first access
+	if (RomMemory::pageFault(address))
+		return EXCEPTION_CONTINUE_EXECUTION;
 
 	host_context_t context;
 	readContext(ep, context);
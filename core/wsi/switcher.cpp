@@ -68,7 +68,8 @@ void initRenderApi(void *window, void *display)
 	}
 #endif
 #ifdef USE_OPENGL
-	if (!isOpenGL(config::RendererType))
+	// The software renderer uses the Open GL context for the UI only
+	if (!isOpenGL(config::RendererType) && config::RendererType != RenderType::Software)
 		config::RendererType = RenderType::OpenGL;
 	theGLContext.setWindow(window, display);
 	if (theGLContext.init())
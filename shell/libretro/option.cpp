@@ -25,6 +25,12 @@ namespace config {
 
 Option<bool> DynarecEnabled("", true);
 Option<bool> DynarecIdleSkip("", true);
+Option<bool> DynarecBlockCache("");
+Option<bool> DynarecTieredCompilation("");
+Option<bool> DynarecTraceFormation("");
+Option<bool> DynarecBackgroundCompile("");
+Option<bool> DynarecProfiler("");
+Option<bool> DynarecSubPageSMC("");
 
 // General
 
@@ -38,10 +44,13 @@ Option<bool> AutoLoadState("");
 Option<bool> AutoSaveState("");
 Option<int> SavestateSlot("");
 Option<bool> ForceFreePlay(CORE_OPTION_NAME "_force_freeplay", true);
+Option<bool> NaomiDimmCache("");
+Option<bool> CartDecryptWarmUp("");
 
 // Sound
 
 Option<bool> DSPEnabled(CORE_OPTION_NAME "_enable_dsp", false);
+Option<bool> ThreadedAudio("");
 #if HOST_CPU == CPU_ARM
 Option<int> AudioBufferSize("", 5644);	// 128 ms
 #else
@@ -66,6 +75,12 @@ IntOption MaxFilteredTextureSize(CORE_OPTION_NAME "_texupscale_max_filtered_text
 Option<float> ExtraDepthScale("", 1.f);
 Option<bool> CustomTextures(CORE_OPTION_NAME "_custom_textures");
 Option<bool> DumpTextures(CORE_OPTION_NAME "_dump_textures");
+Option<bool> CaptureTAFrames("");
+Option<bool> AsyncTextureDecode("");
+Option<int> TextureMaxStaleFrames("", 2);
+Option<int> TextureContentCacheSize("", 0);
+Option<int> TextureCacheBudget("");
+Option<bool> VramDirtyBitmap("");
 Option<int> ScreenStretching("", 100);
 Option<bool> Fog(CORE_OPTION_NAME "_fog", true);
 Option<bool> FloatVMUs("");
@@ -82,6 +97,8 @@ std::array<Option<int>, 4> CrosshairColor {
 Option<int> SkipFrame(CORE_OPTION_NAME "_frame_skipping");
 Option<int> MaxThreads("", 3);
 Option<int> AutoSkipFrame(CORE_OPTION_NAME "_auto_skip_frame", 0);
+Option<int> RenderQueueDepth("", 2);
+Option<int> RenderQueuePolicy("", 0);
 Option<int> RenderResolution("", 480);
 Option<bool> VSync("", true);
 Option<bool> ThreadedRendering(CORE_OPTION_NAME "_threaded_rendering", true);
@@ -112,6 +112,16 @@ std::string getShaderCachePath(const std::string& filename)
 	return std::string(game_dir_no_slash) + std::string(path_default_slash()) + filename;
 }
 
+std::string getNaomiDimmCachePath(const std::string& filename)
+{
+	return std::string(game_dir_no_slash) + std::string(path_default_slash()) + filename;
+}
+
+std::string getJitProfilePath(const std::string& filename)
+{
+	return std::string(game_dir_no_slash) + std::string(path_default_slash()) + filename;
+}
+
 std::string getTextureLoadPath(const std::string& gameId)
 {
 	return std::string(retro_get_system_directory()) + "/dc/textures/"
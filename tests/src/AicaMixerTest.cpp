@@ -0,0 +1,251 @@
+#include "gtest/gtest.h"
+#include "types.h"
+#include "hw/mem/_vmem.h"
+#include "hw/aica/aica.h"
+#include "hw/aica/aica_if.h"
+#include "hw/aica/aica_mem.h"
+#include "hw/aica/sgc_if.h"
+#include "hw/aica/dsp.h"
+#include "hw/gdrom/gdromv3.h"
+#include "hw/sh4/sh4_if.h"
+#include "hw/sh4/sh4_interpreter.h"
+#include "hw/sh4/sh4_sched.h"
+#include "imgread/common.h"
+#include "oslib/audiostream.h"
+#include "cfg/option.h"
+#include "emulator.h"
+
+#include <cstdio>
+#include <random>
+
+namespace {
+
+std::vector<u32> output;
+
+u32 capturePush(const void *data, u32 frames, bool wait)
+{
+	const u32 *samples = (const u32 *)data;
+	output.insert(output.end(), samples, samples + frames);
+	return 1;
+}
+
+audiobackend_t captureBackend = {
+	"aicamixertest", "AICA mixer test",
+	[]() {},
+	&capturePush,
+	[]() {},
+	nullptr
+};
+bool captureRegistered = RegisterAudioBackend(&captureBackend);
+
+struct RegWrite
+{
+	u32 batch;
+	u32 channel;
+	u32 reg;
+	u16 value;
+};
+
+// Register writes of a game playing random notes, in the order they're issued by the sound driver
+std::vector<RegWrite> recordRegisterStream(u32 batches, u32 seed)
+{
+	std::mt19937 gen(seed);
+	std::vector<RegWrite> stream;
+	for (u32 batch = 0; batch < batches; batch += 1 + gen() % 8)
+	{
+		u32 channel = gen() % 64;
+		if (gen() % 4 == 0)
+		{
+			// key off
+			stream.push_back({ batch, channel, 0x00, (u16)(gen() % 2 == 0 ? 0x8000 : 0) });
+			continue;
+		}
+		u32 pcms = gen() % 4;
+		u32 lea = 0x100 + gen() % 0x1000;
+		stream.push_back({ batch, channel, 0x04, (u16)((pcms == 0 ? 0x1000 : 0x4000) + (gen() % 0x100) * 2) });
+		stream.push_back({ batch, channel, 0x08, (u16)(gen() % lea) });
+		stream.push_back({ batch, channel, 0x0C, (u16)lea });
+		stream.push_back({ batch, channel, 0x10, (u16)(gen() & 0xffdf) });						// AR, D1R, D2R
+		stream.push_back({ batch, channel, 0x14, (u16)(gen() & 0x7fff) });						// RR, DL, KRS, LPSLNK
+		stream.push_back({ batch, channel, 0x18, (u16)(gen() & 0x7bff) });						// FNS, OCT
+		stream.push_back({ batch, channel, 0x1C, (u16)(gen() & 0xffff) });						// LFO
+		stream.push_back({ batch, channel, 0x20, (u16)(gen() & 0xff) });						// ISEL, IMXL
+		stream.push_back({ batch, channel, 0x24, (u16)(gen() & 0x0f1f) });						// DISDL, DIPAN
+		stream.push_back({ batch, channel, 0x28, (u16)((gen() & 0xff3f) | (gen() % 8 == 0 ? 0x40 : 0)) });	// TL, Q, LPOFF, VOFF
+		for (u32 reg = 0x2C; reg <= 0x3C; reg += 4)
+			stream.push_back({ batch, channel, reg, (u16)(gen() & 0x1fff) });					// FLV0-4
+		stream.push_back({ batch, channel, 0x40, (u16)(gen() & 0x1f1f) });						// FAR, FD1R
+		stream.push_back({ batch, channel, 0x44, (u16)(gen() & 0x1f1f) });						// FD2R, FRR
+		// key on, LPCTL, PCMS, SA
+		stream.push_back({ batch, channel, 0x00, (u16)(0xC000 | (gen() % 2) << 9 | pcms << 7) });
+	}
+	return stream;
+}
+
+}
+
+class AicaMixerTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		if (!_vmem_reserve())
+			die("_vmem_reserve failed");
+		emu.init();
+		config::AudioBackend.override("aicamixertest");
+		InitAudio();
+	}
+	void TearDown() override {
+		TermAudio();
+		config::DSPEnabled.override(false);
+		config::ThreadedAudio.override(false);
+	}
+
+	std::vector<u32> run(const std::vector<RegWrite>& stream, u32 batches, bool batched, std::vector<s32>& mixs)
+	{
+		dc_reset(true);
+		std::mt19937 gen(1);
+		for (u32 i = 0; i < 0x80000; i++)
+			aica_ram[i] = (u8)(gen() >> 8);
+		CommonData->MVOL = 0x9;
+		// Reset the LFOs
+		for (u32 channel = 0; channel < 64; channel++)
+		{
+			*(u16 *)&aica_reg[channel * 0x80 + 0x1C] = 0x8000;
+			WriteChannelReg(channel, 0x1C, 2);
+		}
+		output.clear();
+		mixs.clear();
+
+		auto it = stream.begin();
+		for (u32 batch = 0; batch < batches; batch++)
+		{
+			for (; it != stream.end() && it->batch == batch; ++it)
+			{
+				*(u16 *)&aica_reg[it->channel * 0x80 + it->reg] = it->value;
+				WriteChannelReg(it->channel, it->reg, 2);
+			}
+			if (batched)
+				AICA_Sample32();
+			else
+				for (int i = 0; i < 32; i++)
+					AICA_Sample();
+			mixs.insert(mixs.end(), std::begin(dsp::state.MIXS), std::end(dsp::state.MIXS));
+		}
+		return output;
+	}
+
+	void checkBitExact(u32 seed)
+	{
+		constexpr u32 Batches = 16 * 256;
+		std::vector<RegWrite> stream = recordRegisterStream(Batches, seed);
+
+		std::vector<s32> scalarMixs;
+		std::vector<u32> scalar = run(stream, Batches, false, scalarMixs);
+		std::vector<s32> batchedMixs;
+		std::vector<u32> batched = run(stream, Batches, true, batchedMixs);
+
+		ASSERT_EQ(Batches * 32, scalar.size());
+		ASSERT_EQ(scalar.size(), batched.size());
+		size_t nonZero = 0;
+		for (size_t i = 0; i < scalar.size(); i++)
+		{
+			ASSERT_EQ(scalar[i], batched[i]) << "sample " << i;
+			if (scalar[i] != 0)
+				nonZero++;
+		}
+		ASSERT_GT(nonZero, scalar.size() / 2);
+		ASSERT_EQ(scalarMixs, batchedMixs);
+	}
+
+	// Plays the CDDA track from the start until the given number of samples is output
+	std::vector<u32> playCdda(u32 samples, bool threaded, u32& endFad)
+	{
+		config::ThreadedAudio.override(threaded);
+		dc_reset(true);
+		CommonData->MVOL = 0xf;
+		// EXTS volume and pan
+		*(u16 *)&aica_reg[0x2000 + 16 * 4] = 0x0f00 | 0x1f;
+		*(u16 *)&aica_reg[0x2000 + 17 * 4] = 0x0f00 | 0x0f;
+		cdda.StartAddr.FAD = cdda.CurrAddr.FAD = CddaStartFad;
+		cdda.EndAddr.FAD = CddaStartFad + CddaSectors;
+		cdda.repeats = 0;
+		cdda.status = cdda_t::Playing;
+		output.clear();
+
+		while (true)
+		{
+			Sh4cntx.sh4_sched_next -= SH4_TIMESLICE;
+			if (Sh4cntx.sh4_sched_next < 0)
+			{
+				sh4_sched_tick(SH4_TIMESLICE);
+				aica_threadSync();
+				if (output.size() >= samples)
+					break;
+			}
+		}
+		endFad = cdda.CurrAddr.FAD;
+		output.resize(samples);
+		return output;
+	}
+
+	// The audio track pregap is skipped
+	static constexpr u32 CddaStartFad = 150 + 150;
+	static constexpr u32 CddaSectors = 8;
+};
+
+TEST_F(AicaMixerTest, BitExact)
+{
+	checkBitExact(42);
+}
+
+TEST_F(AicaMixerTest, BitExactDSP)
+{
+	config::DSPEnabled.override(true);
+	checkBitExact(1234);
+}
+
+TEST_F(AicaMixerTest, ThreadedCdda)
+{
+	const std::string dir = ::testing::TempDir();
+	const std::string binPath = dir + "aicamixertest.bin";
+	const std::string cuePath = dir + "aicamixertest.cue";
+	FILE *f = fopen(binPath.c_str(), "wb");
+	ASSERT_NE(nullptr, f);
+	std::vector<s16> pregap(150 * 2352 / 2);
+	fwrite(pregap.data(), sizeof(s16), pregap.size(), f);
+	std::mt19937 gen(7);
+	for (u32 i = 0; i < CddaSectors * 2352 / 2; i++)
+	{
+		s16 sample = (s16)(gen() >> 16) / 4;
+		fwrite(&sample, sizeof(sample), 1, f);
+	}
+	fclose(f);
+	f = fopen(cuePath.c_str(), "w");
+	ASSERT_NE(nullptr, f);
+	fprintf(f, "REM SESSION 01\nFILE \"aicamixertest.bin\" BINARY\n  TRACK 01 AUDIO\n    INDEX 01 00:00:00\n");
+	fclose(f);
+	ASSERT_TRUE(InitDrive(cuePath));
+
+	// Plays the first samples of the last sector
+	const u32 samples = (CddaSectors - 1) * 588 + 32;
+	u32 endFad, threadedEndFad;
+	std::vector<u32> lockstep = playCdda(samples, false, endFad);
+	std::vector<u32> threaded = playCdda(samples, true, threadedEndFad);
+	// Stops the AICA thread
+	config::ThreadedAudio.override(false);
+	dc_reset(true);
+
+	TermDrive();
+	remove(cuePath.c_str());
+	remove(binPath.c_str());
+
+	ASSERT_EQ(CddaStartFad + CddaSectors, endFad);
+	ASSERT_EQ(endFad, threadedEndFad);
+	size_t nonZero = 0;
+	for (size_t i = 0; i < samples; i++)
+	{
+		ASSERT_EQ(lockstep[i], threaded[i]) << "sample " << i;
+		if (lockstep[i] != 0)
+			nonZero++;
+	}
+	ASSERT_GT(nonZero, samples / 2);
+}
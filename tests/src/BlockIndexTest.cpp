@@ -0,0 +1,232 @@
+#include "gtest/gtest.h"
+#include "types.h"
+#include "hw/sh4/dyna/blockindex.h"
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <random>
+
+namespace {
+
+struct TestBlock
+{
+	u8 *code;
+	u32 size;
+
+	bool containsCode(const void *ptr) const {
+		return (u32)((const u8 *)ptr - code) < size;
+	}
+};
+using TestBlockPtr = std::shared_ptr<TestBlock>;
+
+enum class TraceOp { Add, Discard, Lookup, Reset };
+struct TraceEntry
+{
+	TraceOp op;
+	u32 offset;
+	u32 size;
+};
+
+// Mimics the dynarec: blocks are emitted sequentially in the code cache,
+// host pc lookups are far more frequent than discards, and the cache is reset when full.
+std::vector<TraceEntry> makeTrace(size_t length, u32 seed)
+{
+	std::mt19937 gen(seed);
+	std::vector<TraceEntry> trace;
+	std::vector<std::pair<u32, u32>> live;
+	u32 next = 0;
+	constexpr u32 CacheSize = 4 * 1024 * 1024;
+	while (trace.size() < length)
+	{
+		u32 r = gen() % 100;
+		if (r < 10 || live.empty())
+		{
+			u32 size = 16 + (gen() % 512) * 4;
+			if (next + size > CacheSize)
+			{
+				trace.push_back({ TraceOp::Reset, 0, 0 });
+				live.clear();
+				next = 0;
+			}
+			trace.push_back({ TraceOp::Add, next, size });
+			live.emplace_back(next, size);
+			next += size;
+		}
+		else if (r < 13)
+		{
+			size_t i = gen() % live.size();
+			trace.push_back({ TraceOp::Discard, live[i].first, live[i].second });
+			live[i] = live.back();
+			live.pop_back();
+		}
+		else
+		{
+			const auto& blk = live[gen() % live.size()];
+			trace.push_back({ TraceOp::Lookup, blk.first + (u32)(gen() % (blk.second + 64)), 0 });
+		}
+	}
+	return trace;
+}
+
+class ReferenceMap
+{
+public:
+	bool insert(const void *start, const TestBlockPtr& block) {
+		return map.emplace((void *)start, block).second;
+	}
+	void erase(const void *start) {
+		map.erase((void *)start);
+	}
+	TestBlockPtr find(const void *ptr) const
+	{
+		auto it = map.upper_bound((void *)ptr);
+		if (it == map.begin())
+			return nullptr;
+		--it;
+		return it->second->containsCode(ptr) ? it->second : nullptr;
+	}
+	void clear() {
+		map.clear();
+	}
+
+private:
+	std::map<void *, TestBlockPtr> map;
+};
+
+class FlatIndex
+{
+public:
+	bool insert(const void *start, const TestBlockPtr& block) {
+		return index.insert(start, block);
+	}
+	void erase(const void *start) {
+		index.erase(start);
+	}
+	TestBlockPtr find(const void *ptr) const
+	{
+		const TestBlockPtr *candidate = index.findCandidate(ptr);
+		if (candidate == nullptr || !(*candidate)->containsCode(ptr))
+			return nullptr;
+		return *candidate;
+	}
+	void clear() {
+		index.clear();
+	}
+
+private:
+	CodeAddressIndex<TestBlockPtr> index;
+};
+
+template<typename Index>
+u64 replay(Index& index, const std::vector<TraceEntry>& trace, u8 *codeBase, std::vector<u32> *results)
+{
+	u64 found = 0;
+	for (const TraceEntry& e : trace)
+	{
+		switch (e.op)
+		{
+		case TraceOp::Add:
+			index.insert(codeBase + e.offset, std::make_shared<TestBlock>(TestBlock{ codeBase + e.offset, e.size }));
+			break;
+		case TraceOp::Discard:
+			index.erase(codeBase + e.offset);
+			break;
+		case TraceOp::Lookup:
+			{
+				TestBlockPtr block = index.find(codeBase + e.offset);
+				if (results != nullptr)
+					results->push_back(block == nullptr ? ~0u : (u32)(block->code - codeBase));
+				found += block != nullptr;
+			}
+			break;
+		case TraceOp::Reset:
+			index.clear();
+			break;
+		}
+	}
+	return found;
+}
+
+}
+
+class BlockIndexTest : public ::testing::Test {
+};
+
+TEST_F(BlockIndexTest, Basic)
+{
+	u8 code[256];
+	CodeAddressIndex<TestBlockPtr> index;
+	ASSERT_TRUE(index.empty());
+	TestBlockPtr b1 = std::make_shared<TestBlock>(TestBlock{ &code[0], 16 });
+	TestBlockPtr b2 = std::make_shared<TestBlock>(TestBlock{ &code[16], 32 });
+	TestBlockPtr b3 = std::make_shared<TestBlock>(TestBlock{ &code[128], 8 });
+	ASSERT_TRUE(index.insert(b2->code, b2));
+	ASSERT_TRUE(index.insert(b3->code, b3));
+	ASSERT_TRUE(index.insert(b1->code, b1));
+	ASSERT_FALSE(index.insert(b1->code, b3));
+	ASSERT_EQ(3u, index.size());
+
+	ASSERT_EQ(b1, *index.findCandidate(&code[15]));
+	ASSERT_EQ(b2, *index.findCandidate(&code[16]));
+	ASSERT_EQ(b2, *index.findCandidate(&code[100]));
+	ASSERT_EQ(b3, *index.findCandidate(&code[200]));
+	ASSERT_EQ(b2, *index.findExact(&code[16]));
+	ASSERT_EQ(nullptr, index.findExact(&code[17]));
+
+	ASSERT_EQ(b2, index.erase(&code[16]));
+	ASSERT_EQ(nullptr, index.erase(&code[16]));
+	ASSERT_EQ(2u, index.size());
+	// the nearest live block is returned, the caller checks that it contains the pointer
+	ASSERT_EQ(b1, *index.findCandidate(&code[20]));
+	ASSERT_EQ(nullptr, index.findExact(&code[16]));
+
+	// reuse the tombstone
+	ASSERT_TRUE(index.insert(b2->code, b2));
+	ASSERT_EQ(b2, *index.findCandidate(&code[20]));
+
+	int count = 0;
+	index.forEach([&count](const TestBlockPtr&) { count++; });
+	ASSERT_EQ(3, count);
+
+	index.clear();
+	ASSERT_TRUE(index.empty());
+	ASSERT_EQ(nullptr, index.findCandidate(&code[20]));
+}
+
+TEST_F(BlockIndexTest, MatchesReference)
+{
+	std::vector<u8> codeCache(4 * 1024 * 1024 + 4096);
+	std::vector<TraceEntry> trace = makeTrace(200000, 1234);
+
+	ReferenceMap refMap;
+	std::vector<u32> refResults;
+	replay(refMap, trace, codeCache.data(), &refResults);
+
+	FlatIndex flatIndex;
+	std::vector<u32> flatResults;
+	replay(flatIndex, trace, codeCache.data(), &flatResults);
+
+	ASSERT_EQ(refResults, flatResults);
+}
+
+TEST_F(BlockIndexTest, DISABLED_Benchmark)
+{
+	std::vector<u8> codeCache(4 * 1024 * 1024 + 4096);
+	std::vector<TraceEntry> trace = makeTrace(2000000, 5678);
+
+	auto start = std::chrono::steady_clock::now();
+	ReferenceMap refMap;
+	u64 refFound = replay(refMap, trace, codeCache.data(), nullptr);
+	auto refTime = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+	FlatIndex flatIndex;
+	u64 flatFound = replay(flatIndex, trace, codeCache.data(), nullptr);
+	auto flatTime = std::chrono::steady_clock::now() - start;
+
+	ASSERT_EQ(refFound, flatFound);
+	printf("Block index trace replay (%zd ops): std::map %.1f ms, flat index %.1f ms\n", trace.size(),
+			std::chrono::duration<double, std::milli>(refTime).count(),
+			std::chrono::duration<double, std::milli>(flatTime).count());
+}
@@ -0,0 +1,117 @@
+#include "gtest/gtest.h"
+#include "types.h"
+#include "hw/naomi/decrypt_cache.h"
+#include "hw/naomi/m4cartridge.h"
+#include "oslib/oslib.h"
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+void fillPage(u64 key, u8 *data)
+{
+	for (u32 i = 0; i < DecryptCache::PageSize; i++)
+		data[i] = (u8)(key * 7 + i);
+}
+
+M4Cartridge *createM4Cart(const u8 *rom, u32 romSize, u32 cartSize)
+{
+	// Cartridge ROM pages are filled on first access
+	os_InstallFaultHandler();
+	M4Cartridge *cart = new M4Cartridge(cartSize);
+	u32 size = cartSize;
+	u8 *p = (u8 *)cart->GetPtr(0, size);
+	memset(p, 0xff, cartSize);
+	memcpy(p, rom, romSize);
+	u8 *keyData = (u8 *)malloc(2048);
+	for (int i = 0; i < 2048; i++)
+		keyData[i] = (u8)(i * 13 + 5);
+	cart->SetKeyData(keyData);
+	cart->SetKey(0x5504);
+	cart->Init();
+	// Enable decryption
+	cart->WriteMem(NAOMI_ROM_OFFSETH_addr, 0x4000, 2);
+	return cart;
+}
+
+void m4Dma(M4Cartridge *cart, u32 offset, u8 *dst, u32 len)
+{
+	cart->WriteMem(NAOMI_DMA_OFFSETH_addr, offset >> 16, 2);
+	cart->WriteMem(NAOMI_DMA_OFFSETL_addr, offset & 0xffff, 2);
+	u32 size = len;
+	const u8 *p = (const u8 *)cart->GetDmaPtr(size);
+	ASSERT_GE(size, len);
+	memcpy(dst, p, len);
+}
+
+}
+
+TEST(DecryptCacheTest, Lru)
+{
+	int decrypted = 0;
+	DecryptCache cache([&decrypted](u64 key, u8 *data) {
+		decrypted++;
+		fillPage(key, data);
+	}, 2);
+
+	ASSERT_EQ(1 * 7, cache.get(1)[0]);
+	ASSERT_EQ(2 * 7 + 5, cache.get(2)[5]);
+	ASSERT_EQ(2, decrypted);
+	cache.get(1);
+	ASSERT_EQ(2, decrypted);
+	// Evicts page 2
+	ASSERT_EQ(3 * 7, cache.get(3)[0]);
+	cache.get(1);
+	ASSERT_EQ(3, decrypted);
+	cache.get(2);
+	ASSERT_EQ(4, decrypted);
+
+	DecryptCacheStats stats = cache.getStats();
+	ASSERT_EQ(2u, stats.hits);
+	ASSERT_EQ(4u, stats.misses);
+	ASSERT_EQ(4u * DecryptCache::PageSize, stats.bytesDecrypted);
+
+	cache.clear();
+	cache.get(2);
+	ASSERT_EQ(5, decrypted);
+}
+
+TEST(DecryptCacheTest, WarmUp)
+{
+	DecryptCache cache(fillPage, 8);
+	std::vector<u64> keys;
+	for (u64 key = 0; key < 16; key++)
+		keys.push_back(key);
+	cache.warmUp(keys);
+	cache.waitWarmUp();
+
+	// Only the first pages are decrypted, until the cache is full
+	for (u64 key = 0; key < 8; key++)
+		ASSERT_EQ((u8)(key * 7 + 1), cache.get(key)[1]);
+	DecryptCacheStats stats = cache.getStats();
+	ASSERT_EQ(8u, stats.hits);
+	ASSERT_EQ(0u, stats.misses);
+	ASSERT_EQ(8u * DecryptCache::PageSize, stats.bytesDecrypted);
+}
+
+TEST(DecryptCacheTest, M4LastPageUnaligned)
+{
+	const u32 romSize = 4 * DecryptCache::PageSize;
+	std::vector<u8> rom(romSize);
+	for (u32 i = 0; i < romSize; i++)
+		rom[i] = (u8)((i * 2654435761u) >> 24);
+	// The ROM ends at the last page: blocks starting at an unaligned offset can't use the page cache
+	M4Cartridge *cart = createM4Cart(rom.data(), romSize, romSize);
+	// Same ROM followed by a blank page: the whole last page comes from the page cache
+	M4Cartridge *refCart = createM4Cart(rom.data(), romSize, romSize + DecryptCache::PageSize);
+
+	const u32 offset = romSize - DecryptCache::PageSize + 6;
+	std::vector<u8> data(DecryptCache::PageSize);
+	std::vector<u8> refData(DecryptCache::PageSize);
+	m4Dma(cart, offset, data.data(), (u32)data.size());
+	m4Dma(refCart, offset, refData.data(), (u32)refData.size());
+	ASSERT_EQ(0, memcmp(refData.data(), data.data(), data.size()));
+
+	delete cart;
+	delete refCart;
+}
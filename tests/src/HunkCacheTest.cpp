@@ -0,0 +1,156 @@
+#include "gtest/gtest.h"
+#include "types.h"
+#include "imgread/hunkcache.h"
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class HunkCacheTest : public ::testing::Test {
+protected:
+	static constexpr u32 HunkBytes = 8 * (2352 + 96);
+	static constexpr u32 TotalHunks = 1000;
+
+	HunkCache::Decompressor decompressor()
+	{
+		return [this](u32 hunk, u8 *data) {
+			std::lock_guard<std::mutex> _(mutex);
+			calls[hunk]++;
+			if (hunk == badHunk)
+				return false;
+			for (u32 i = 0; i < HunkBytes; i++)
+				data[i] = hunkByte(hunk, i);
+			return true;
+		};
+	}
+
+	static u8 hunkByte(u32 hunk, u32 i) {
+		return (u8)(hunk * 31 + i * 7 + (i >> 8));
+	}
+
+	void checkRead(HunkCache& cache, u32 hunk, u32 offset, u32 size)
+	{
+		std::vector<u8> buf(size);
+		ASSERT_TRUE(cache.read(hunk, offset, buf.data(), size));
+		for (u32 i = 0; i < size; i++)
+			ASSERT_EQ(hunkByte(hunk, offset + i), buf[i]) << "hunk " << hunk << " offset " << offset + i;
+	}
+
+	int callCount(u32 hunk)
+	{
+		std::lock_guard<std::mutex> _(mutex);
+		auto it = calls.find(hunk);
+		return it == calls.end() ? 0 : it->second;
+	}
+
+	void waitPrefetched(HunkCache& cache, u32 count)
+	{
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+		while (cache.getStats().prefetched < count && std::chrono::steady_clock::now() < deadline)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		ASSERT_EQ(count, cache.getStats().prefetched);
+	}
+
+	std::mutex mutex;
+	std::map<u32, int> calls;
+	u32 badHunk = ~0u;
+};
+
+TEST_F(HunkCacheTest, Read)
+{
+	HunkCache cache(HunkBytes, TotalHunks, decompressor(), false);
+	checkRead(cache, 5, 0, 2352);
+	checkRead(cache, 5, 3 * (2352 + 96), 2048);
+	checkRead(cache, 700, 7 * (2352 + 96), 2352);
+	checkRead(cache, 5, 2352 + 96, 2336);
+
+	HunkCacheStats stats = cache.getStats();
+	ASSERT_EQ(2u, stats.misses);
+	ASSERT_EQ(2u, stats.hits);
+	ASSERT_EQ(2u, stats.decompressed);
+	ASSERT_EQ(1, callCount(5));
+	ASSERT_EQ(1, callCount(700));
+}
+
+TEST_F(HunkCacheTest, Lru)
+{
+	HunkCache cache(HunkBytes, TotalHunks, decompressor(), false);
+	const u32 maxHunks = HunkCache::CacheSize / HunkBytes;
+	// Non-adjacent hunks
+	for (u32 i = 0; i < maxHunks; i++)
+		checkRead(cache, i * 2, 0, 16);
+	// Hunk 0 becomes the most recently used
+	checkRead(cache, 0, 0, 16);
+	ASSERT_EQ(1, callCount(0));
+	// Evicts hunk 2
+	checkRead(cache, maxHunks * 2, 0, 16);
+	checkRead(cache, 0, 0, 16);
+	ASSERT_EQ(1, callCount(0));
+	checkRead(cache, 2, 0, 16);
+	ASSERT_EQ(2, callCount(2));
+}
+
+TEST_F(HunkCacheTest, DecompressionError)
+{
+	HunkCache cache(HunkBytes, TotalHunks, decompressor(), false);
+	badHunk = 3;
+	u8 buf[16];
+	ASSERT_FALSE(cache.read(3, 0, buf, sizeof(buf)));
+	// Failures aren't cached
+	ASSERT_FALSE(cache.read(3, 0, buf, sizeof(buf)));
+	ASSERT_EQ(2, callCount(3));
+	checkRead(cache, 4, 0, 16);
+}
+
+TEST_F(HunkCacheTest, PrefetchForward)
+{
+	HunkCache cache(HunkBytes, TotalHunks, decompressor(), true);
+	checkRead(cache, 10, 0, 16);
+	checkRead(cache, 11, 0, 16);
+	waitPrefetched(cache, HunkCache::PrefetchHunks);
+	for (u32 hunk = 12; hunk < 12 + HunkCache::PrefetchHunks; hunk++)
+		ASSERT_EQ(1, callCount(hunk)) << "hunk " << hunk;
+	ASSERT_EQ(0, callCount(12 + HunkCache::PrefetchHunks));
+	ASSERT_EQ(0, callCount(9));
+
+	u64 misses = cache.getStats().misses;
+	for (u32 hunk = 12; hunk < 20; hunk++)
+		checkRead(cache, hunk, 0, 16);
+	ASSERT_EQ(misses, cache.getStats().misses);
+}
+
+TEST_F(HunkCacheTest, PrefetchBackward)
+{
+	HunkCache cache(HunkBytes, TotalHunks, decompressor(), true);
+	checkRead(cache, 50, 0, 16);
+	checkRead(cache, 49, 0, 16);
+	waitPrefetched(cache, HunkCache::PrefetchHunks);
+	for (u32 hunk = 48; hunk > 48 - HunkCache::PrefetchHunks; hunk--)
+		ASSERT_EQ(1, callCount(hunk)) << "hunk " << hunk;
+	ASSERT_EQ(0, callCount(51));
+}
+
+TEST_F(HunkCacheTest, PrefetchStopsAtLastHunk)
+{
+	HunkCache cache(HunkBytes, TotalHunks, decompressor(), true);
+	checkRead(cache, TotalHunks - 3, 0, 16);
+	checkRead(cache, TotalHunks - 2, 0, 16);
+	waitPrefetched(cache, 1);
+	// Let the remaining prefetch requests run out
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	ASSERT_EQ(1u, cache.getStats().prefetched);
+	ASSERT_EQ(0, callCount(TotalHunks));
+}
+
+TEST_F(HunkCacheTest, NoPrefetch)
+{
+	HunkCache cache(HunkBytes, TotalHunks, decompressor(), false);
+	for (u32 hunk = 0; hunk < 8; hunk++)
+		checkRead(cache, hunk, 0, 16);
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	HunkCacheStats stats = cache.getStats();
+	ASSERT_EQ(0u, stats.prefetched);
+	ASSERT_EQ(8u, stats.decompressed);
+	ASSERT_EQ(0, callCount(8));
+}
@@ -0,0 +1,140 @@
+#include "gtest/gtest.h"
+#include "types.h"
+#include "hw/naomi/rom_memory.h"
+#include "hw/naomi/naomi_cart.h"
+#include "archive/archive.h"
+#include "oslib/directory.h"
+#include "oslib/oslib.h"
+#include <cstdio>
+#include <memory>
+#include <vector>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+class RomMemoryTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		// Pages are filled by the fault handler on first access
+		os_InstallFaultHandler();
+	}
+
+	void writeFile(const std::string& path, u32 len)
+	{
+		FILE *f = fopen(path.c_str(), "wb");
+		ASSERT_NE(nullptr, f);
+		for (u32 i = 0; i < len; i++)
+			fputc(fileByte(i), f);
+		fclose(f);
+	}
+
+	static u8 fileByte(u32 i) {
+		return (u8)(i * 7 + (i >> 12));
+	}
+};
+
+TEST_F(RomMemoryTest, LazyFill)
+{
+	const u32 size = 64 * 1024 * 1024;
+	RomMemory rom(size);
+	u8 *p = rom.data();
+	ASSERT_EQ(0xff, p[0]);
+	ASSERT_EQ(0xff, p[size / 2 + 123]);
+	ASSERT_EQ(0xff, p[size - 1]);
+	p[size / 2] = 0x12;
+	ASSERT_EQ(0x12, p[size / 2]);
+	ASSERT_EQ(0xff, p[size / 2 + 1]);
+
+#ifdef __linux__
+	// Only the accessed chunks are resident
+	const size_t page = sysconf(_SC_PAGESIZE);
+	std::vector<unsigned char> vec(size / page);
+	ASSERT_EQ(0, mincore(p, size, vec.data()));
+	size_t resident = 0;
+	for (unsigned char c : vec)
+		resident += c & 1;
+	ASSERT_LE(resident * page, 3u * 64 * 1024);
+#endif
+}
+
+TEST_F(RomMemoryTest, MapFile)
+{
+	const std::string path = ::testing::TempDir() + "romemorytest.bin";
+	const u32 len = 0x30000 + 100;
+	writeFile(path, len);
+	FILE *f = fopen(path.c_str(), "rb");
+	ASSERT_NE(nullptr, f);
+
+	const u32 offset = 0x10000;
+	RomMemory rom(0x100000);
+	ASSERT_TRUE(rom.mapFile(f, offset, len));
+	fclose(f);
+	ASSERT_EQ(0x30000u, rom.mappedSize());
+	const u8 *p = rom.data();
+	for (u32 i = 0; i < len; i++)
+		ASSERT_EQ(fileByte(i), p[offset + i]) << "offset " << i;
+	ASSERT_EQ(0xff, p[offset - 1]);
+	ASSERT_EQ(0xff, p[offset + len]);
+	ASSERT_EQ(0xff, p[rom.size() - 1]);
+
+	// Patching the rom doesn't modify the file
+	rom.data()[offset] = ~fileByte(0);
+	f = fopen(path.c_str(), "rb");
+	ASSERT_NE(nullptr, f);
+	ASSERT_EQ(fileByte(0), fgetc(f));
+	fclose(f);
+	remove(path.c_str());
+}
+
+TEST_F(RomMemoryTest, Commit)
+{
+	const std::string path = ::testing::TempDir() + "romemorytest.bin";
+	const u32 len = 0x20000;
+	writeFile(path, len);
+	FILE *f = fopen(path.c_str(), "rb");
+	ASSERT_NE(nullptr, f);
+
+	RomMemory rom(0x100000);
+	const u32 offset = 0x8010;
+	// read() fails on pages that haven't been filled yet
+	rom.commit(offset, len);
+	ASSERT_EQ(len, fread(rom.data() + offset, 1, len, f));
+	fclose(f);
+	remove(path.c_str());
+	const u8 *p = rom.data();
+	for (u32 i = 0; i < len; i++)
+		ASSERT_EQ(fileByte(i), p[offset + i]) << "offset " << i;
+	ASSERT_EQ(0xff, p[offset - 1]);
+	ASSERT_EQ(0xff, p[offset + len]);
+}
+
+TEST_F(RomMemoryTest, LoadFromFolder)
+{
+	// Uncompressed set next to where the zip would be
+	const std::string dir = ::testing::TempDir() + "romemorytest";
+	flycast::mkdir(dir.c_str(), 0755);
+	const std::string path = dir + "/mpr-00000.ic8";
+	const u32 len = 0x40000;
+	writeFile(path, len);
+
+	std::unique_ptr<Archive> archive(OpenArchive((dir + ".zip").c_str()));
+	ASSERT_NE(nullptr, archive);
+	ASSERT_EQ(nullptr, archive->OpenFile("missing.ic9"));
+	std::unique_ptr<ArchiveFile> file(archive->OpenFile("mpr-00000.ic8"));
+	ASSERT_NE(nullptr, file);
+	ASSERT_NE(nullptr, file->GetFile());
+
+	M2Cartridge cart(0x200000);
+	ASSERT_EQ(len, cart.LoadFile(file.get(), 0x100000, len));
+	file.reset();
+	remove(path.c_str());
+	remove(dir.c_str());
+
+	u32 size = 0x200000;
+	const u8 *p = (const u8 *)cart.GetPtr(0, size);
+	for (u32 i = 0; i < len; i++)
+		ASSERT_EQ(fileByte(i), p[0x100000 + i]) << "offset " << i;
+	ASSERT_EQ(0xff, p[0]);
+	ASSERT_EQ(0xff, p[0x100000 + len]);
+}
@@ -0,0 +1,148 @@
+#include "gtest/gtest.h"
+#include "types.h"
+#include "imgread/common.h"
+#include "imgread/readahead.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace {
+
+u8 sectorByte(u32 fad, u32 i) {
+	return (u8)(fad * 13 + i * 3 + (i >> 8));
+}
+
+u8 subcodeByte(u32 fad, u32 i) {
+	return (u8)(fad * 5 + i);
+}
+
+// Mode 2 sectors with subcodes
+struct TestTrackFile : TrackFile
+{
+	std::atomic<u32> reads { 0 };
+
+	bool Read(u32 FAD, u8 *dst, SectorFormat *sector_type, u8 *subcode, SubcodeFormat *subcode_type) override
+	{
+		memset(dst, 0, 0x18);
+		dst[15] = 2;
+		for (u32 i = 0; i < 2048; i++)
+			dst[0x18 + i] = sectorByte(FAD, i);
+		for (u32 i = 0; i < 96; i++)
+			dst[2352 + i] = subcodeByte(FAD, i);
+		*sector_type = SECFMT_2448_MODE2;
+		reads++;
+		return true;
+	}
+};
+
+struct TestDisc : Disc
+{
+	TestTrackFile *file;
+
+	TestDisc()
+	{
+		file = new TestTrackFile();
+		Track track;
+		track.StartFAD = 150;
+		track.EndFAD = 150 + 2000;
+		track.file = file;
+		tracks.push_back(track);
+		EndFAD = track.EndFAD;
+		type = GdRom;
+	}
+};
+
+}
+
+class SectorReaderTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		reader.open(&disc, "test");
+	}
+	void TearDown() override {
+		reader.close();
+	}
+
+	// Reads count sectors in chunks of the given sizes and checks them
+	void checkRead(u32 fad, u32 count, const std::vector<u32>& chunks)
+	{
+		size_t chunk = 0;
+		while (count > 0)
+		{
+			u32 n = std::min(count, chunks[chunk++ % chunks.size()]);
+			std::vector<u8> buf(n * 2048);
+			u8 subcode[96];
+			reader.read(buf.data(), fad, n, 2048, subcode);
+			for (u32 s = 0; s < n; s++)
+				for (u32 i = 0; i < 2048; i++)
+					ASSERT_EQ(sectorByte(fad + s, i), buf[s * 2048 + i]) << "FAD " << fad + s << " offset " << i;
+			// Subcodes of the last sector read
+			for (u32 i = 0; i < 96; i++)
+				ASSERT_EQ(subcodeByte(fad + n - 1, i), subcode[i]) << "FAD " << fad + n - 1;
+			fad += n;
+			count -= n;
+		}
+	}
+
+	void waitReads(u32 count)
+	{
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+		while (disc.file->reads < count && std::chrono::steady_clock::now() < deadline)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	TestDisc disc;
+	SectorReader reader;
+};
+
+TEST_F(SectorReaderTest, SyncRead)
+{
+	checkRead(200, 10, { 3 });
+}
+
+TEST_F(SectorReaderTest, ReadAhead)
+{
+	// More than the ring capacity
+	reader.readAhead(300, 600, 2048);
+	checkRead(300, 600, { 1, 7, 32, 16, 100 });
+	ASSERT_EQ(600u, disc.file->reads.load());
+}
+
+TEST_F(SectorReaderTest, ReadsInBackground)
+{
+	reader.readAhead(400, 64, 2048);
+	// The I/O thread reads the sectors before they're requested
+	waitReads(64);
+	ASSERT_EQ(64u, disc.file->reads.load());
+	checkRead(400, 64, { 32 });
+	ASSERT_EQ(64u, disc.file->reads.load());
+}
+
+TEST_F(SectorReaderTest, InterleavedSyncRead)
+{
+	reader.readAhead(500, 100, 2048);
+	checkRead(500, 20, { 10 });
+	// CDDA-like read elsewhere on the disc
+	checkRead(1500, 2, { 2 });
+	checkRead(520, 80, { 10 });
+}
+
+TEST_F(SectorReaderTest, NewCommand)
+{
+	reader.readAhead(600, 200, 2048);
+	checkRead(600, 30, { 15 });
+	// Aborts the previous command
+	reader.readAhead(1000, 50, 2048);
+	checkRead(1000, 50, { 5, 20 });
+	// Past the end of the command
+	checkRead(1050, 5, { 5 });
+}
+
+TEST_F(SectorReaderTest, Reopen)
+{
+	reader.readAhead(700, 100, 2048);
+	checkRead(700, 10, { 10 });
+	reader.open(&disc, "test");
+	checkRead(710, 10, { 10 });
+}
@@ -0,0 +1,264 @@
+#include "gtest/gtest.h"
+#include "types.h"
+#include "hw/mem/_vmem.h"
+#include "hw/sh4/sh4_if.h"
+#include "hw/sh4/sh4_interpreter.h"
+#include "hw/sh4/sh4_sched.h"
+#include "emulator.h"
+
+#include <chrono>
+#include <random>
+
+namespace {
+
+// The original linear scan scheduler, used as reference
+class RefScheduler
+{
+public:
+	int registerCb(int tag, sh4_sched_callback *cb) {
+		list.push_back({ cb, tag, -1, -1 });
+		return list.size() - 1;
+	}
+	void request(int id, int cycles)
+	{
+		sched_list& sched = list[id];
+		sched.start = now();
+		if (cycles == -1)
+			sched.end = -1;
+		else
+		{
+			sched.end = sched.start + cycles;
+			if (sched.end == -1)
+				sched.end++;
+		}
+		ffts();
+	}
+	void tick(int cycles)
+	{
+		if (next >= 0)
+			return;
+		u32 fztime = now() - cycles;
+		if (nextId != -1)
+		{
+			for (size_t i = 0; i < list.size(); i++)
+			{
+				int remaining = remainingTime(list[i], fztime);
+				if (remaining >= 0 && remaining <= cycles)
+					handle(i);
+			}
+		}
+		ffts();
+	}
+	u64 now64() const {
+		return ffb - next;
+	}
+
+	int next = 0;
+
+private:
+	u32 now() const {
+		return ffb - next;
+	}
+	static u32 remainingTime(const sched_list& sched, u32 reference) {
+		return sched.end != -1 ? sched.end - reference : -1;
+	}
+	void ffts()
+	{
+		u32 diff = -1;
+		int slot = -1;
+		for (size_t i = 0; i < list.size(); i++)
+		{
+			u32 remaining = remainingTime(list[i], now());
+			if (remaining < diff)
+			{
+				slot = i;
+				diff = remaining;
+			}
+		}
+		ffb -= next;
+		nextId = slot;
+		next = slot != -1 ? diff : SH4_MAIN_CLOCK;
+		ffb += next;
+	}
+	void handle(int id)
+	{
+		sched_list& sched = list[id];
+		int remain = sched.end - sched.start;
+		int elapsed = now() - sched.start;
+		sched.start = now();
+		int jitter = elapsed - remain;
+		sched.end = -1;
+		int reSch = sched.cb(sched.tag, remain, jitter);
+		if (reSch > 0)
+			request(id, std::max(0, reSch - jitter));
+	}
+
+	std::vector<sched_list> list;
+	u64 ffb = 0;
+	int nextId = -1;
+};
+
+struct Event
+{
+	u64 time;
+	int tag;
+	int cycles;
+	int jitter;
+};
+
+// Drives either the real scheduler or the reference one with the same callbacks
+struct Harness
+{
+	RefScheduler *ref = nullptr;
+	std::vector<int> ids;
+	std::vector<Event> events;
+	std::mt19937 gen;
+	bool record = true;
+
+	static Harness *current;
+
+	u64 now() {
+		return ref != nullptr ? ref->now64() : sh4_sched_now64();
+	}
+	void request(int index, int cycles)
+	{
+		if (ref != nullptr)
+			ref->request(ids[index], cycles);
+		else
+			sh4_sched_request(ids[index], cycles);
+	}
+	void step()
+	{
+		int& next = ref != nullptr ? ref->next : p_sh4rcb->cntx.sh4_sched_next;
+		next -= SH4_TIMESLICE;
+		if (next < 0)
+		{
+			if (ref != nullptr)
+				ref->tick(SH4_TIMESLICE);
+			else
+				sh4_sched_tick(SH4_TIMESLICE);
+		}
+	}
+
+	static int callback(int tag, int cycles, int jitter)
+	{
+		Harness& h = *current;
+		if (h.record)
+			h.events.push_back({ h.now(), tag, cycles, jitter });
+		u32 r = h.gen() % 100;
+		// occasionally reschedule another callback, possibly in the same tick
+		if (r < 5)
+			h.request(h.gen() % h.ids.size(), h.gen() % 3 == 0 ? 0 : h.gen() % 20000);
+		// stop
+		if (r < 8)
+			return 0;
+		// periodic, like SPG, TMU or AICA
+		if (tag < 4)
+			return 448 * (tag + 1) + (r & 1) * 16;
+		return 1 + h.gen() % 100000;
+	}
+};
+Harness *Harness::current;
+
+void runScenario(Harness& h, int callbacks, int steps, u32 seed)
+{
+	Harness::current = &h;
+	h.gen.seed(seed);
+	for (int i = 0; i < callbacks; i++)
+		h.ids.push_back(h.ref != nullptr ? h.ref->registerCb(i, &Harness::callback)
+				: sh4_sched_register(i, &Harness::callback));
+	for (int i = 0; i < callbacks; i++)
+		h.request(i, h.gen() % 10000);
+	for (int i = 0; i < steps; i++)
+	{
+		// register writes rescheduling a callback
+		if (h.gen() % 16 == 0)
+		{
+			int index = h.gen() % callbacks;
+			u32 r = h.gen() % 10;
+			h.request(index, r == 0 ? -1 : r == 1 ? 0 : (int)(h.gen() % 50000));
+		}
+		h.step();
+	}
+}
+
+}
+
+class Sh4SchedTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		if (!_vmem_reserve())
+			die("_vmem_reserve failed");
+		emu.init();
+		dc_reset(true);
+		// Disable the callbacks registered by the emulator
+		sh4_sched_reset(true);
+	}
+	void TearDown() override {
+		for (int id : ids)
+			sh4_sched_unregister(id);
+	}
+
+	std::vector<int> ids;
+};
+
+TEST_F(Sh4SchedTest, MatchesReference)
+{
+	RefScheduler refSched;
+	Harness ref;
+	ref.ref = &refSched;
+	runScenario(ref, 24, 200000, 42);
+
+	Harness real;
+	u64 start = sh4_sched_now64();
+	runScenario(real, 24, 200000, 42);
+	ids = real.ids;
+
+	ASSERT_GT(ref.events.size(), 10000u);
+	ASSERT_EQ(ref.events.size(), real.events.size());
+	for (size_t i = 0; i < ref.events.size(); i++)
+	{
+		ASSERT_EQ(ref.events[i].time, real.events[i].time - start) << "event " << i;
+		ASSERT_EQ(ref.events[i].tag, real.events[i].tag) << "event " << i;
+		ASSERT_EQ(ref.events[i].cycles, real.events[i].cycles) << "event " << i;
+		ASSERT_EQ(ref.events[i].jitter, real.events[i].jitter) << "event " << i;
+	}
+}
+
+TEST_F(Sh4SchedTest, DISABLED_Benchmark)
+{
+	constexpr int Callbacks = 24;
+	constexpr int Steps = 2000000;
+
+	RefScheduler refSched;
+	Harness ref;
+	ref.ref = &refSched;
+	ref.record = false;
+	auto t0 = std::chrono::steady_clock::now();
+	runScenario(ref, Callbacks, Steps, 1234);
+	auto refTime = std::chrono::steady_clock::now() - t0;
+
+	Harness real;
+	real.record = false;
+	t0 = std::chrono::steady_clock::now();
+	runScenario(real, Callbacks, Steps, 1234);
+	auto heapTime = std::chrono::steady_clock::now() - t0;
+	ids = real.ids;
+
+	// Request cost alone
+	t0 = std::chrono::steady_clock::now();
+	for (int i = 0; i < Steps; i++)
+		refSched.request(ref.ids[i % Callbacks], 1000 + (int)((u32)i * 7919u % 100000));
+	auto refRequest = std::chrono::steady_clock::now() - t0;
+	t0 = std::chrono::steady_clock::now();
+	for (int i = 0; i < Steps; i++)
+		sh4_sched_request(real.ids[i % Callbacks], 1000 + (int)((u32)i * 7919u % 100000));
+	auto heapRequest = std::chrono::steady_clock::now() - t0;
+
+	printf("sh4_sched, %d callbacks: timeslice+dispatch %.1f ns linear, %.1f ns heap; request %.1f ns linear, %.1f ns heap\n",
+			Callbacks,
+			std::chrono::duration<double, std::nano>(refTime).count() / Steps,
+			std::chrono::duration<double, std::nano>(heapTime).count() / Steps,
+			std::chrono::duration<double, std::nano>(refRequest).count() / Steps,
+			std::chrono::duration<double, std::nano>(heapRequest).count() / Steps);
+}
@@ -0,0 +1,221 @@
+#include "gtest/gtest.h"
+#include "types.h"
+#include "hw/mem/_vmem.h"
+#include "hw/pvr/ta_ctx.h"
+#include "hw/pvr/pvr_regs.h"
+#include "hw/pvr/pvr_mem.h"
+#include "rend/norend/softrend.h"
+#include "emulator.h"
+
+#include <random>
+
+namespace {
+
+void setVertex(Vertex *vtx, float x, float y, float z, u32 color)
+{
+	memset(vtx, 0, sizeof(Vertex));
+	vtx->x = x;
+	vtx->y = y;
+	vtx->z = z;
+	memcpy(vtx->col, &color, sizeof(color));
+}
+
+// Adds a flat-shaded triangle strip to the given list
+PolyParam *addStrip(rend_context& rc, List<PolyParam>& list, const float (*xy)[2], u32 count, float z, u32 color)
+{
+	PolyParam *pp = list.Append();
+	pp->init();
+	pp->isp.DepthMode = 6;	// >=
+	pp->tsp.SrcInstr = 1;
+	pp->tsp.UseAlpha = 1;
+	pp->first = rc.idx.used();
+	pp->count = count;
+	for (u32 i = 0; i < count; i++)
+	{
+		setVertex(rc.verts.Append(), xy[i][0], xy[i][1], z, color);
+		*rc.idx.Append() = rc.verts.used() - 1;
+	}
+	return pp;
+}
+
+PolyParam *addRect(rend_context& rc, List<PolyParam>& list, float x0, float y0, float x1, float y1, float z, u32 color)
+{
+	const float xy[4][2] { { x0, y0 }, { x1, y0 }, { x0, y1 }, { x1, y1 } };
+	return addStrip(rc, list, xy, 4, z, color);
+}
+
+void addPass(rend_context& rc)
+{
+	RenderPass *pass = rc.render_passes.Append();
+	memset(pass, 0, sizeof(RenderPass));
+	pass->op_count = rc.global_param_op.used();
+	pass->pt_count = rc.global_param_pt.used();
+	pass->tr_count = rc.global_param_tr.used();
+	pass->mvo_count = rc.global_param_mvo.used();
+}
+
+constexpr u32 Red = 0xff0000ff;
+constexpr u32 Green = 0xff00ff00;
+constexpr u32 Blue = 0xffff0000;
+
+}
+
+class SoftRendTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		if (!_vmem_reserve())
+			die("_vmem_reserve failed");
+		emu.init();
+		dc_reset(true);
+		ctx = tactx_Alloc();
+		_pvrrc = ctx;
+		rend_context& rc = ctx->rend;
+		rc.Clear();
+		rc.isRTT = false;
+		rc.fb_X_CLIP.min = 0;
+		rc.fb_X_CLIP.max = 639;
+		rc.fb_Y_CLIP.min = 0;
+		rc.fb_Y_CLIP.max = 479;
+		rc.fb_W_LINESTRIDE = 0;
+		rc.fog_clamp_min.full = 0;
+		rc.fog_clamp_max.full = 0xffffffff;
+		FB_R_CTRL.fb_enable = 1;
+		VO_CONTROL.blank_video = 0;
+		config::Fog.override(false);
+		renderer.SetThreads(2);
+	}
+	void TearDown() override {
+		renderer.Term();
+		_pvrrc = nullptr;
+		delete ctx;
+		config::Fog.override(true);
+	}
+
+	u32 pixel(u32 x, u32 y)
+	{
+		u32 width, height;
+		const std::vector<u32>& frame = renderer.GetFrame(width, height);
+		return frame[y * width + x];
+	}
+
+	TA_context *ctx = nullptr;
+	SoftRenderer renderer;
+};
+
+TEST_F(SoftRendTest, DepthOrder)
+{
+	rend_context& rc = ctx->rend;
+	addRect(rc, rc.global_param_op, 100.f, 100.f, 300.f, 300.f, 0.5f, Red);
+	// Further away
+	addRect(rc, rc.global_param_op, 200.f, 200.f, 400.f, 400.f, 0.25f, Green);
+	addPass(rc);
+	ASSERT_TRUE(renderer.Render());
+
+	u32 width, height;
+	ASSERT_EQ(640u * 480, renderer.GetFrame(width, height).size());
+	ASSERT_EQ(640u, width);
+	ASSERT_EQ(480u, height);
+	ASSERT_EQ(0u, pixel(50, 50));
+	ASSERT_EQ(Red, pixel(100, 100));
+	ASSERT_EQ(Red, pixel(250, 250));
+	ASSERT_EQ(Red, pixel(299, 299));
+	ASSERT_EQ(Green, pixel(300, 300));
+	ASSERT_EQ(Green, pixel(399, 250));
+	ASSERT_EQ(0u, pixel(400, 250));
+}
+
+TEST_F(SoftRendTest, TranslucentBlending)
+{
+	rend_context& rc = ctx->rend;
+	addRect(rc, rc.global_param_op, 0.f, 0.f, 640.f, 480.f, 0.1f, Blue);
+	PolyParam *pp = addRect(rc, rc.global_param_tr, 0.f, 0.f, 320.f, 480.f, 0.5f, 0x80ffffff);
+	pp->tsp.SrcInstr = 4;	// src alpha
+	pp->tsp.DstInstr = 5;	// 1 - src alpha
+	addPass(rc);
+	ASSERT_TRUE(renderer.Render());
+
+	const u32 color = pixel(10, 10);
+	ASSERT_NEAR(128, (int)(color & 0xff), 1);
+	ASSERT_NEAR(128, (int)((color >> 8) & 0xff), 1);
+	ASSERT_EQ(255u, (color >> 16) & 0xff);
+	ASSERT_EQ(Blue, pixel(330, 10));
+}
+
+TEST_F(SoftRendTest, ModifierVolume)
+{
+	rend_context& rc = ctx->rend;
+	PolyParam *pp = addRect(rc, rc.global_param_op, 0.f, 0.f, 640.f, 480.f, 0.5f, 0xffc0c0c0);
+	pp->pcw.Shadow = 1;
+	// Volume covering the left half, in front of the polygon
+	const float xy[6][2] { { 0.f, 0.f }, { 320.f, 0.f }, { 0.f, 480.f }, { 320.f, 0.f }, { 320.f, 480.f }, { 0.f, 480.f } };
+	for (int i = 0; i < 6; i += 3)
+	{
+		ModTriangle *mt = rc.modtrig.Append();
+		mt->x0 = xy[i][0];
+		mt->y0 = xy[i][1];
+		mt->x1 = xy[i + 1][0];
+		mt->y1 = xy[i + 1][1];
+		mt->x2 = xy[i + 2][0];
+		mt->y2 = xy[i + 2][1];
+		mt->z0 = mt->z1 = mt->z2 = 1.f;
+	}
+	ModifierVolumeParam *param = rc.global_param_mvo.Append();
+	param->init();
+	param->count = 2;
+	param->isp.DepthMode = 1;
+	param->isp.VolumeLast = 1;
+	addPass(rc);
+	FPU_SHAD_SCALE.scale_factor = 128;
+	ASSERT_TRUE(renderer.Render());
+
+	ASSERT_NEAR(0x60, (int)(pixel(10, 10) & 0xff), 1);
+	ASSERT_EQ(0xc0u, pixel(330, 10) & 0xff);
+}
+
+TEST_F(SoftRendTest, RenderToTexture)
+{
+	rend_context& rc = ctx->rend;
+	rc.isRTT = true;
+	rc.fb_X_CLIP.max = 63;
+	rc.fb_Y_CLIP.max = 63;
+	rc.fb_W_SOF1 = 0x200000;
+	rc.fb_W_CTRL.full = 0;
+	rc.fb_W_CTRL.fb_packmode = 1;	// 565
+	addRect(rc, rc.global_param_op, 0.f, 0.f, 32.f, 64.f, 0.5f, Red);
+	addPass(rc);
+	ASSERT_FALSE(renderer.Render());
+
+	const u16 *texture = (const u16 *)&vram[0x200000];
+	ASSERT_EQ(0xf800, texture[0]);
+	ASSERT_EQ(0xf800, texture[63 * 64 + 31]);
+	ASSERT_EQ(0, texture[63 * 64 + 32]);
+}
+
+TEST_F(SoftRendTest, Threads)
+{
+	rend_context& rc = ctx->rend;
+	std::mt19937 gen(42);
+	for (int i = 0; i < 500; i++)
+	{
+		const float xy[3][2] {
+			{ (float)(gen() % 640), (float)(gen() % 480) },
+			{ (float)(gen() % 640), (float)(gen() % 480) },
+			{ (float)(gen() % 640), (float)(gen() % 480) },
+		};
+		PolyParam *pp = addStrip(rc, i % 4 == 0 ? rc.global_param_tr : rc.global_param_op, xy, 3,
+				1.f / (1.f + gen() % 1000), gen() | 0x80000000);
+		pp->tsp.DstInstr = i % 4 == 0 ? 5 : 0;
+		pp->tsp.SrcInstr = i % 4 == 0 ? 4 : 1;
+	}
+	addPass(rc);
+	ctx->rend.render_passes.head()->autosort = true;
+
+	renderer.SetThreads(1);
+	renderer.Render();
+	u32 width, height;
+	std::vector<u32> reference = renderer.GetFrame(width, height);
+
+	renderer.SetThreads(4);
+	renderer.Render();
+	ASSERT_EQ(reference, renderer.GetFrame(width, height));
+}
@@ -0,0 +1,162 @@
+#include "gtest/gtest.h"
+#include "types.h"
+#include "hw/mem/_vmem.h"
+#include "hw/pvr/ta_ctx.h"
+#include "hw/pvr/Renderer_if.h"
+#include "rend/sorter.h"
+#include "emulator.h"
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+namespace {
+
+// getProjectedZ only uses the third column. Gives depths of both signs.
+const float naomi2Matrix[16] {
+	1.f, 0.f, 0.001f, 0.f,
+	0.f, 1.f, -0.001f, 0.f,
+	0.f, 0.f, 1.f, 0.f,
+	0.f, 0.f, -0.5f, 1.f
+};
+
+// Translucent strips with many equal depths, a few empty strips and some Naomi 2 polygons
+void makeList(rend_context& rc, int polys, u32 seed)
+{
+	std::mt19937 gen(seed);
+	rc.Clear();
+	for (int i = 0; i < polys; i++)
+	{
+		PolyParam *pp = rc.global_param_tr.Append();
+		pp->init();
+		// consecutive equivalent polygons are merged
+		pp->tsp.full = gen() % 4;
+		pp->isp.CullMode = gen() % 4;
+		if (gen() % 8 == 0)
+			pp->mvMatrix = pp->projMatrix = naomi2Matrix;
+		pp->first = rc.idx.used();
+		pp->count = gen() % 16 == 0 ? gen() % 3 : 3 + gen() % 20;
+		for (u32 j = 0; j < pp->count; j++)
+		{
+			Vertex *vtx = rc.verts.Append();
+			memset(vtx, 0, sizeof(Vertex));
+			vtx->x = (float)(gen() % 640);
+			vtx->y = (float)(gen() % 480);
+			u32 r = gen() % 8;
+			vtx->z = r == 0 ? 0.f : r == 1 ? -0.f : r == 2 ? 1.f : 1.f / (1.f + gen() % 100000);
+			*rc.idx.Append() = rc.verts.used() - 1;
+		}
+	}
+	RenderPass *pass = rc.render_passes.Append();
+	memset(pass, 0, sizeof(RenderPass));
+	pass->autosort = true;
+	pass->tr_count = rc.global_param_tr.used();
+	ASSERT_FALSE(rc.Overrun);
+}
+
+struct SortResult
+{
+	std::vector<std::array<u32, 3>> draws;
+	std::vector<u32> indices;
+	std::vector<u32> polys;
+
+	bool operator==(const SortResult& other) const {
+		return draws == other.draws && indices == other.indices && polys == other.polys;
+	}
+};
+
+SortResult sort(rend_context& rc, bool comparisonSort)
+{
+	setComparisonSort(comparisonSort);
+	SortResult result;
+	std::vector<SortTrigDrawParam> params;
+	GenSorted(0, rc.global_param_tr.used(), params, result.indices);
+	for (const SortTrigDrawParam& param : params)
+		result.draws.push_back({ (u32)(param.ppid - rc.global_param_tr.head()), param.first, param.count });
+
+	std::vector<PolyParam> saved(rc.global_param_tr.begin(), rc.global_param_tr.end());
+	SortPParams(0, rc.global_param_tr.used());
+	for (const PolyParam& pp : rc.global_param_tr)
+	{
+		result.polys.push_back(pp.first);
+		u32 zvZ;
+		memcpy(&zvZ, &pp.zvZ, sizeof(zvZ));
+		result.polys.push_back(zvZ);
+	}
+	std::copy(saved.begin(), saved.end(), rc.global_param_tr.head());
+
+	return result;
+}
+
+}
+
+class SorterTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		if (!_vmem_reserve())
+			die("_vmem_reserve failed");
+		emu.init();
+		dc_reset(true);
+		ctx = tactx_Alloc();
+		_pvrrc = ctx;
+	}
+	void TearDown() override {
+		_pvrrc = nullptr;
+		delete ctx;
+		setComparisonSort(false);
+	}
+
+	TA_context *ctx = nullptr;
+};
+
+TEST_F(SorterTest, SameAsComparisonSort)
+{
+	for (int polys : { 5, 20, 100, 1000, 5000 })
+		for (u32 seed = 0; seed < 10; seed++)
+		{
+			makeList(ctx->rend, polys, seed);
+			SortResult reference = sort(ctx->rend, true);
+			ASSERT_FALSE(reference.indices.empty());
+			ASSERT_TRUE(reference == sort(ctx->rend, false)) << polys << " polys, seed " << seed;
+		}
+}
+
+TEST_F(SorterTest, NaNDepth)
+{
+	makeList(ctx->rend, 1000, 42);
+	ctx->rend.verts.head()[ctx->rend.idx.head()[100]].z = NAN;
+	SortResult reference = sort(ctx->rend, true);
+	ASSERT_TRUE(reference == sort(ctx->rend, false));
+}
+
+TEST_F(SorterTest, DISABLED_Benchmark)
+{
+	constexpr int Iterations = 50;
+	makeList(ctx->rend, 5000, 1234);
+	rend_context& rc = ctx->rend;
+	std::vector<SortTrigDrawParam> params;
+	std::vector<u32> indices;
+	std::vector<PolyParam> saved(rc.global_param_tr.begin(), rc.global_param_tr.end());
+
+	for (bool comparisonSort : { true, false })
+	{
+		setComparisonSort(comparisonSort);
+		auto t0 = std::chrono::steady_clock::now();
+		for (int i = 0; i < Iterations; i++)
+			GenSorted(0, rc.global_param_tr.used(), params, indices);
+		auto genSorted = std::chrono::steady_clock::now() - t0;
+		std::chrono::steady_clock::duration sortPParams{};
+		for (int i = 0; i < Iterations; i++)
+		{
+			std::copy(saved.begin(), saved.end(), rc.global_param_tr.head());
+			t0 = std::chrono::steady_clock::now();
+			SortPParams(0, rc.global_param_tr.used());
+			sortPParams += std::chrono::steady_clock::now() - t0;
+		}
+		printf("%s sort, %d triangles: GenSorted %.1f us, SortPParams %.1f us\n", comparisonSort ? "stable" : "radix",
+				(int)indices.size() / 3,
+				std::chrono::duration<double, std::micro>(genSorted).count() / Iterations,
+				std::chrono::duration<double, std::micro>(sortPParams).count() / Iterations);
+	}
+}
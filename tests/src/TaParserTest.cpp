@@ -0,0 +1,161 @@
+#include "gtest/gtest.h"
+#include "types.h"
+#include "hw/mem/_vmem.h"
+#include "hw/pvr/ta.h"
+#include "hw/pvr/ta_ctx.h"
+#include "cfg/option.h"
+#include "emulator.h"
+
+#include <chrono>
+#include <cmath>
+#include <random>
+
+namespace {
+
+constexpr u32 ParaType_EndOfList = 0;
+constexpr u32 ParaType_PolyOrVol = 4;
+constexpr u32 ParaType_Vertex = 7;
+
+void addEntry(TA_context *ctx, const u32 (&entry)[8])
+{
+	memcpy(ctx->tad.thd_data, entry, sizeof(entry));
+	ctx->tad.thd_data += sizeof(entry);
+}
+
+// Adds non-textured, packed color strips to a list
+void addList(TA_context *ctx, u32 listType, int strips, std::mt19937& gen)
+{
+	for (int i = 0; i < strips; i++)
+	{
+		PCW pcw{};
+		pcw.ParaType = ParaType_PolyOrVol;
+		pcw.ListType = listType;
+		pcw.Gouraud = 1;
+		ISP_TSP isp{};
+		isp.DepthMode = 6;
+		// consecutive equivalent strips are merged
+		isp.CullMode = gen() % 4 == 0 ? 3 : 0;
+		TSP tsp{};
+		tsp.SrcInstr = 1;
+		tsp.DstInstr = listType == ListType_Translucent ? 5 : 0;
+		addEntry(ctx, { pcw.full, isp.full, tsp.full, 0, 0, 0, 0, 0 });
+
+		int count = 3 + gen() % 12;
+		for (int v = 0; v < count; v++)
+		{
+			PCW vpcw{};
+			vpcw.ParaType = ParaType_Vertex;
+			vpcw.EndOfStrip = v == count - 1;
+			float x = (float)(gen() % 640);
+			float y = (float)(gen() % 480);
+			float z = 1.f / (1.f + gen() % 1000);
+			// invalid vertices are removed from strips
+			if (gen() % 64 == 0)
+				x = NAN;
+			u32 data[8] { vpcw.full, 0, 0, 0, 0, 0, (u32)gen() | 0xff000000, 0 };
+			memcpy(&data[1], &x, 4);
+			memcpy(&data[2], &y, 4);
+			memcpy(&data[3], &z, 4);
+			addEntry(ctx, data);
+		}
+	}
+	PCW eol{};
+	eol.ParaType = ParaType_EndOfList;
+	addEntry(ctx, { eol.full, 0, 0, 0, 0, 0, 0, 0 });
+}
+
+// A 2-pass frame with about 40k indices like the heaviest games
+TA_context *makeFrame(u32 seed)
+{
+	std::mt19937 gen(seed);
+	TA_context *ctx = tactx_Alloc();
+	TA_context *pass = ctx;
+	for (int i = 0; i < 2; i++)
+	{
+		addList(pass, ListType_Opaque, 1200, gen);
+		addList(pass, ListType_Punch_Through, 200, gen);
+		addList(pass, ListType_Translucent, 600, gen);
+		if (i == 0)
+			pass = pass->nextContext = tactx_Alloc();
+	}
+	return ctx;
+}
+
+std::vector<std::vector<u32>> polyIndices(const List<PolyParam>& list, const rend_context& rc)
+{
+	std::vector<std::vector<u32>> result;
+	for (const PolyParam& pp : list)
+		result.emplace_back(rc.idx.head() + pp.first, rc.idx.head() + pp.first + pp.count);
+	return result;
+}
+
+}
+
+class TaParserTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		if (!_vmem_reserve())
+			die("_vmem_reserve failed");
+		emu.init();
+		dc_reset(true);
+	}
+	void TearDown() override {
+		config::MaxThreads.override(3);
+	}
+
+	void parse(TA_context *ctx)
+	{
+		ctx->rend.Clear();
+		ctx->rend.global_param_op.head()->count = 0;
+		ASSERT_TRUE(ta_parse(ctx));
+		ASSERT_FALSE(ctx->rend.Overrun);
+	}
+};
+
+TEST_F(TaParserTest, ParallelIndexing)
+{
+	TA_context *ctx = makeFrame(42);
+
+	config::MaxThreads.override(1);
+	parse(ctx);
+	const rend_context& rc = ctx->rend;
+	ASSERT_EQ(2, rc.render_passes.used());
+	ASSERT_GT(rc.idx.used(), 30000);
+	for (const u32 *idx = rc.idx.head(); idx != rc.idx.LastPtr(0); idx++)
+		ASSERT_LT(*idx, (u32)rc.verts.used());
+	auto op = polyIndices(rc.global_param_op, rc);
+	auto pt = polyIndices(rc.global_param_pt, rc);
+	auto tr = polyIndices(rc.global_param_tr, rc);
+	int idxCount = rc.idx.used();
+
+	config::MaxThreads.override(3);
+	parse(ctx);
+	ASSERT_EQ(idxCount, rc.idx.used());
+	ASSERT_EQ(op, polyIndices(rc.global_param_op, rc));
+	ASSERT_EQ(pt, polyIndices(rc.global_param_pt, rc));
+	ASSERT_EQ(tr, polyIndices(rc.global_param_tr, rc));
+
+	delete ctx->nextContext;
+	delete ctx;
+}
+
+TEST_F(TaParserTest, DISABLED_Benchmark)
+{
+	constexpr int Frames = 200;
+	TA_context *ctx = makeFrame(1234);
+
+	for (int threads : { 1, 3 })
+	{
+		config::MaxThreads.override(threads);
+		parse(ctx);
+		auto t0 = std::chrono::steady_clock::now();
+		for (int i = 0; i < Frames; i++)
+			parse(ctx);
+		auto elapsed = std::chrono::steady_clock::now() - t0;
+		printf("ta_parse, %d threads: %d vertices, %d indices, %.1f us per frame\n", threads,
+				ctx->rend.verts.used(), ctx->rend.idx.used(),
+				std::chrono::duration<double, std::micro>(elapsed).count() / Frames);
+	}
+	delete ctx->nextContext;
+	delete ctx;
+}
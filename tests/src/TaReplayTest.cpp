@@ -0,0 +1,244 @@
+#include "gtest/gtest.h"
+#include "types.h"
+#include "hw/mem/_vmem.h"
+#include "hw/pvr/ta_ctx.h"
+#include "hw/pvr/ta_capture.h"
+#include "hw/pvr/pvr_mem.h"
+#include "rend/norend/tareplay.h"
+#include "rend/sorter.h"
+#include "oslib/directory.h"
+#include "cfg/option.h"
+#include "emulator.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+#include <random>
+
+namespace {
+
+constexpr u32 ParaType_EndOfList = 0;
+constexpr u32 ParaType_PolyOrVol = 4;
+constexpr u32 ParaType_Vertex = 7;
+constexpr u32 TextureBase = 0x100000;
+
+void addEntry(TA_context *ctx, const u32 (&entry)[8])
+{
+	memcpy(ctx->tad.thd_data, entry, sizeof(entry));
+	ctx->tad.thd_data += sizeof(entry);
+}
+
+// Adds packed color strips to a list, half of them textured
+void addList(TA_context *ctx, u32 listType, int strips, std::mt19937& gen)
+{
+	static const u32 pixelFormats[] { Pixel1555, Pixel565, Pixel4444, PixelPal4, PixelPal8 };
+	for (int i = 0; i < strips; i++)
+	{
+		PCW pcw{};
+		pcw.ParaType = ParaType_PolyOrVol;
+		pcw.ListType = listType;
+		pcw.Gouraud = 1;
+		pcw.Texture = gen() % 2;
+		ISP_TSP isp{};
+		isp.DepthMode = 6;
+		TSP tsp{};
+		tsp.SrcInstr = 1;
+		tsp.DstInstr = listType == ListType_Translucent ? 5 : 0;
+		TCW tcw{};
+		if (pcw.Texture)
+		{
+			tsp.TexU = gen() % 4;
+			tsp.TexV = tsp.TexU;
+			tcw.PixelFmt = pixelFormats[gen() % ARRAY_SIZE(pixelFormats)];
+			tcw.ScanOrder = tcw.PixelFmt == PixelPal4 || tcw.PixelFmt == PixelPal8 ? 0 : gen() % 2;
+			tcw.TexAddr = (TextureBase + (gen() % 64) * 0x2000) >> 3;
+		}
+		addEntry(ctx, { pcw.full, isp.full, tsp.full, tcw.full, 0, 0, 0, 0 });
+
+		int count = 3 + gen() % 12;
+		for (int v = 0; v < count; v++)
+		{
+			PCW vpcw{};
+			vpcw.ParaType = ParaType_Vertex;
+			vpcw.EndOfStrip = v == count - 1;
+			float vtx[5] { (float)(gen() % 640), (float)(gen() % 480), 1.f / (1.f + gen() % 1000),
+				(gen() % 256) / 255.f, (gen() % 256) / 255.f };
+			u32 data[8] { vpcw.full, 0, 0, 0, 0, 0, (u32)gen() | 0xff000000, 0 };
+			memcpy(&data[1], vtx, pcw.Texture ? sizeof(vtx) : sizeof(float) * 3);
+			addEntry(ctx, data);
+		}
+	}
+	PCW eol{};
+	eol.ParaType = ParaType_EndOfList;
+	addEntry(ctx, { eol.full, 0, 0, 0, 0, 0, 0, 0 });
+}
+
+// Builds a 2-pass frame with random textures and takes a capture of it
+TACapture captureFrame(u32 seed)
+{
+	std::mt19937 gen(seed);
+	memset(vram.data, 0, VRAM_SIZE);
+	for (u32 i = TextureBase; i < TextureBase + 64 * 0x2000; i++)
+		vram.data[i] = (u8)gen();
+	for (u32 i = 0; i < 1024; i++)
+		PALETTE_RAM[i] = gen();
+
+	TA_context *ctx = tactx_Alloc();
+	TA_context *pass = ctx;
+	for (int i = 0; i < 2; i++)
+	{
+		addList(pass, ListType_Opaque, 600, gen);
+		addList(pass, ListType_Punch_Through, 100, gen);
+		addList(pass, ListType_Translucent, 300, gen);
+		if (i == 0)
+			pass = pass->nextContext = tactx_Alloc();
+	}
+	TACapture capture;
+	tacap_Take(ctx, capture);
+	delete ctx->nextContext;
+	delete ctx;
+
+	return capture;
+}
+
+std::vector<std::string> listCorpus(const std::string& path)
+{
+	std::vector<std::string> files;
+	DIR *dir = flycast::opendir(path.c_str());
+	if (dir == nullptr)
+		return files;
+	while (true)
+	{
+		dirent *entry = flycast::readdir(dir);
+		if (entry == nullptr)
+			break;
+		std::string name = entry->d_name;
+		if (name.length() > 4 && name.substr(name.length() - 4) == ".tac")
+			files.push_back(path + "/" + name);
+	}
+	flycast::closedir(dir);
+	std::sort(files.begin(), files.end());
+
+	return files;
+}
+
+}
+
+class TaReplayTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		if (!_vmem_reserve())
+			die("_vmem_reserve failed");
+		emu.init();
+		dc_reset(true);
+	}
+	void TearDown() override {
+		tarep_Term();
+		setComparisonSort(false);
+		config::MaxThreads.override(3);
+	}
+};
+
+TEST_F(TaReplayTest, SaveLoad)
+{
+	TACapture capture = captureFrame(42);
+	ASSERT_EQ(2u, capture.passes.size());
+	ASSERT_TRUE(tacap_Save("tareplaytest.tac", capture));
+
+	TACapture loaded;
+	bool success = tacap_Load("tareplaytest.tac", loaded);
+	std::remove("tareplaytest.tac");
+	ASSERT_TRUE(success);
+	ASSERT_EQ(capture.platform, loaded.platform);
+	ASSERT_EQ(capture.pvrRegs, loaded.pvrRegs);
+	ASSERT_EQ(capture.vram, loaded.vram);
+	ASSERT_EQ(capture.passes, loaded.passes);
+}
+
+TEST_F(TaReplayTest, Deterministic)
+{
+	TACapture capture = captureFrame(42);
+
+	TAReplayStats first;
+	ASSERT_TRUE(tarep_Replay(capture, first));
+	ASSERT_GT(first.vertices, 10000u);
+	ASSERT_GT(first.indices, first.vertices);
+	ASSERT_GT(first.textures, 10u);
+
+	// Replays don't depend on the previous ones or on the number of threads used
+	config::MaxThreads.override(1);
+	TAReplayStats other;
+	ASSERT_TRUE(tarep_Replay(captureFrame(1234), other));
+	ASSERT_NE(first.rendHash, other.rendHash);
+	TAReplayStats second;
+	ASSERT_TRUE(tarep_Replay(capture, second));
+	ASSERT_TRUE(tarep_Replay(capture, first));
+	config::MaxThreads.override(3);
+	ASSERT_TRUE(tarep_Replay(capture, second));
+	ASSERT_EQ(first.vertices, second.vertices);
+	ASSERT_EQ(first.indices, second.indices);
+	ASSERT_EQ(first.polys, second.polys);
+	ASSERT_EQ(first.textures, second.textures);
+	ASSERT_EQ(first.rendHash, second.rendHash);
+	ASSERT_EQ(first.sortHash, second.sortHash);
+	ASSERT_EQ(first.textureHash, second.textureHash);
+}
+
+// Set FLYCAST_TA_CORPUS to a directory of .tac files captured with rend.CaptureTAFrames to benchmark them.
+// A synthetic frame is used otherwise.
+TEST_F(TaReplayTest, DISABLED_Benchmark)
+{
+	constexpr int Iterations = 50;
+
+	std::vector<std::pair<std::string, TACapture>> corpus;
+	const char *corpusPath = std::getenv("FLYCAST_TA_CORPUS");
+	if (corpusPath != nullptr)
+	{
+		for (const std::string& path : listCorpus(corpusPath))
+		{
+			TACapture capture;
+			if (tacap_Load(path, capture))
+				corpus.emplace_back(path.substr(path.find_last_of('/') + 1), std::move(capture));
+		}
+	}
+	if (corpus.empty())
+		corpus.emplace_back("synthetic", captureFrame(42));
+
+	for (const auto& frame : corpus)
+	{
+		TAReplayStats total{};
+		TAReplayStats stats;
+		bool success = true;
+		for (int i = 0; i < Iterations && success; i++)
+		{
+			success = tarep_Replay(frame.second, stats);
+			total.parseTime += stats.parseTime;
+			total.indexTime += stats.indexTime;
+			total.textureTime += stats.textureTime;
+			total.sortTime += stats.sortTime;
+		}
+		if (!success)
+		{
+			printf("%s: replay failed\n", frame.first.c_str());
+			continue;
+		}
+		// Compare with the comparison sort
+		setComparisonSort(true);
+		double comparisonSortTime = 0;
+		TAReplayStats reference;
+		for (int i = 0; i < Iterations; i++)
+		{
+			ASSERT_TRUE(tarep_Replay(frame.second, reference));
+			comparisonSortTime += reference.sortTime;
+		}
+		setComparisonSort(false);
+		ASSERT_EQ(reference.sortHash, stats.sortHash) << frame.first;
+
+		printf("%s: %u vtx, %u idx, %u polys, %u textures | ta_parse %.1f us (make_index %.1f us, textures %.1f us),"
+				" sort %.1f us (stable sort %.1f us) | rend %016llx sort %016llx tex %016llx\n",
+				frame.first.c_str(), stats.vertices, stats.indices, stats.polys, stats.textures,
+				total.parseTime / Iterations, total.indexTime / Iterations, total.textureTime / Iterations,
+				total.sortTime / Iterations, comparisonSortTime / Iterations,
+				(unsigned long long)stats.rendHash, (unsigned long long)stats.sortHash, (unsigned long long)stats.textureHash);
+	}
+}
@@ -0,0 +1,190 @@
+#include "gtest/gtest.h"
+#include "types.h"
+#include "hw/mem/_vmem.h"
+#include "hw/pvr/pvr_mem.h"
+#include "rend/TexCache.h"
+#include "emulator.h"
+#include "vram_utils.h"
+
+namespace {
+
+class TestTexture final : public BaseTextureCacheData
+{
+public:
+	TestTexture(TSP tsp, TCW tcw) : BaseTextureCacheData(tsp, tcw) {}
+
+	std::string GetId() override { return "test"; }
+	void UploadToGPU(int width, int height, u8 *data, bool mipmapped, bool mipmapsIncluded) override {}
+	bool Delete() override
+	{
+		deleted++;
+		return BaseTextureCacheData::Delete();
+	}
+
+	static int deleted;
+};
+int TestTexture::deleted;
+
+class TestTextureCache : public BaseTextureCache<TestTexture>
+{
+public:
+	bool contains(u32 address) const
+	{
+		for (const auto& pair : cache)
+			if ((pair.second.tcw.TexAddr << 3) == address)
+				return true;
+		return false;
+	}
+	size_t size() const { return cache.size(); }
+};
+
+}
+
+class TexCacheTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		if (!_vmem_reserve())
+			die("_vmem_reserve failed");
+		emu.init();
+		dc_reset(true);
+		config::TextureContentCacheSize.override(0);
+		TestTexture::deleted = 0;
+		FrameCount = 1000;
+	}
+	void TearDown() override {
+		textureCache.Clear();
+		config::TextureCacheBudget.override(0);
+		config::VramDirtyBitmap.override(false);
+		VramCheckDirtyPages();
+		config::TextureContentCacheSize.override(0);
+	}
+
+	// Uses a 256x256 565 texture (128 KB) in the current frame
+	TestTexture *useTexture(u32 address, bool mipmapped = false)
+	{
+		TSP tsp{};
+		tsp.TexU = 5;
+		tsp.TexV = 5;
+		TCW tcw{};
+		tcw.TexAddr = address >> 3;
+		tcw.PixelFmt = Pixel565;
+		tcw.MipMapped = mipmapped;
+		TestTexture *texture = textureCache.getTextureCacheData(tsp, tcw);
+		if (texture->NeedsUpdate())
+			texture->Update();
+		return texture;
+	}
+
+	TestTextureCache textureCache;
+};
+
+TEST_F(TexCacheTest, Size)
+{
+	TestTexture *texture = useTexture(0x100000);
+	ASSERT_EQ(256u * 256 * 2, texture->gpuSize);
+	texture = useTexture(0x200000, true);
+	ASSERT_EQ(256u * 256 * 2 * 4 / 3, texture->gpuSize);
+
+	textureCache.CollectCleanup();
+	TextureCacheStats stats = textureCacheGetStats();
+	ASSERT_EQ(2u, stats.entries);
+	ASSERT_EQ(256u * 256 * 2 * 7 / 3, stats.bytes);
+	ASSERT_EQ(0u, stats.evictions);
+
+	textureCache.Clear();
+	stats = textureCacheGetStats();
+	ASSERT_EQ(0u, stats.entries);
+	ASSERT_EQ(0u, stats.bytes);
+}
+
+TEST_F(TexCacheTest, Budget)
+{
+	config::TextureCacheBudget.override(1);
+	// 8 textures fill the budget
+	for (u32 i = 0; i < 12; i++)
+	{
+		useTexture(0x100000 + i * 0x20000);
+		FrameCount++;
+	}
+	// Used again recently
+	useTexture(0x100000);
+	FrameCount++;
+	textureCache.CollectCleanup();
+
+	TextureCacheStats stats = textureCacheGetStats();
+	ASSERT_EQ(8u, stats.entries);
+	ASSERT_EQ(1024u * 1024, stats.bytes);
+	ASSERT_EQ(4u, stats.evictions);
+	ASSERT_TRUE(textureCache.contains(0x100000));
+	for (u32 i = 1; i < 5; i++)
+		ASSERT_FALSE(textureCache.contains(0x100000 + i * 0x20000)) << i;
+	for (u32 i = 5; i < 12; i++)
+		ASSERT_TRUE(textureCache.contains(0x100000 + i * 0x20000)) << i;
+
+	// Textures used by the last frame are kept even if over budget
+	for (u32 i = 0; i < 12; i++)
+		useTexture(0x100000 + i * 0x20000);
+	FrameCount++;
+	textureCache.CollectCleanup();
+	ASSERT_EQ(12u, textureCache.size());
+	FrameCount++;
+	textureCache.CollectCleanup();
+	ASSERT_EQ(8u, textureCache.size());
+	ASSERT_EQ(8u, textureCacheGetStats().evictions);
+}
+
+TEST_F(TexCacheTest, NoBudget)
+{
+	for (u32 i = 0; i < 12; i++)
+		useTexture(0x100000 + i * 0x20000);
+	FrameCount += 10;
+	textureCache.CollectCleanup();
+	ASSERT_EQ(12u, textureCache.size());
+	ASSERT_EQ(0, TestTexture::deleted);
+	ASSERT_EQ(0u, textureCacheGetStats().evictions);
+}
+
+TEST_F(TexCacheTest, DirtyBitmap)
+{
+	config::VramDirtyBitmap.override(true);
+	VramCheckDirtyPages();
+	TestTexture *texture = useTexture(0x100000);
+	ASSERT_FALSE(texture->NeedsUpdate());
+	VramTrackingStats stats = vramTrackingGetStats();
+
+	// Same data written again
+	VramMarkDirty(0x101000, 4);
+	VramCheckDirtyPages();
+	ASSERT_FALSE(texture->NeedsUpdate());
+	VramTrackingStats newStats = vramTrackingGetStats();
+	ASSERT_EQ(stats.dirtyPages + 1, newStats.dirtyPages);
+	ASSERT_LE(stats.hashChecks + 1, newStats.hashChecks);
+	ASSERT_EQ(stats.invalidations, newStats.invalidations);
+	// Writes elsewhere
+	VramMarkDirty(0x300000, 0x10000);
+	VramCheckDirtyPages();
+	ASSERT_FALSE(texture->NeedsUpdate());
+
+	// Tracked write
+	unprotectVram(0x101000, 1);
+	vram[0x101000] ^= 0xff;
+	VramMarkDirty(0x101000, 1);
+	VramCheckDirtyPages();
+	ASSERT_TRUE(texture->NeedsUpdate());
+	ASSERT_EQ(stats.invalidations + 1, vramTrackingGetStats().invalidations);
+	texture->Update();
+	ASSERT_FALSE(texture->NeedsUpdate());
+
+	// Untracked write caught by a write fault
+	unprotectVram(0x11f000, 1);
+	vram[0x11fffe] ^= 0xff;
+	ASSERT_FALSE(texture->NeedsUpdate());
+	VramCheckDirtyPages();
+	ASSERT_TRUE(texture->NeedsUpdate());
+	texture->Update();
+
+	// Switching back to page protection invalidates all textures
+	config::VramDirtyBitmap.override(false);
+	VramCheckDirtyPages();
+	ASSERT_TRUE(texture->NeedsUpdate());
+}
@@ -0,0 +1,202 @@
+#include "gtest/gtest.h"
+#include "types.h"
+#include "hw/mem/_vmem.h"
+#include "hw/pvr/pvr_mem.h"
+#include "rend/TexCache.h"
+#include "emulator.h"
+#include "vram_utils.h"
+
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <xxhash.h>
+
+namespace {
+
+constexpr u32 TextureBase = 0x100000;
+
+// Records the uploaded textures
+class TestTexture final : public BaseTextureCacheData
+{
+public:
+	TestTexture(TSP tsp, TCW tcw) : BaseTextureCacheData(tsp, tcw) {}
+
+	std::string GetId() override { return "test"; }
+
+	void UploadToGPU(int width, int height, u8 *data, bool mipmapped, bool mipmapsIncluded) override
+	{
+		u32 bpp = tex_type == TextureType::_8888 ? 4 : tex_type == TextureType::_8 ? 1 : 2;
+		uploads++;
+		uploadWidth = width;
+		hash = XXH64(data, width * height * bpp, 0);
+	}
+
+	int uploads = 0;
+	int uploadWidth = 0;
+	u64 hash = 0;
+};
+
+TSP makeTsp(u32 size)
+{
+	TSP tsp{};
+	for (tsp.TexU = 0; (8u << tsp.TexU) < size; tsp.TexU++)
+		;
+	tsp.TexV = tsp.TexU;
+	return tsp;
+}
+
+TCW makeTcw(u32 address, u32 pixelFmt, bool vq = false)
+{
+	TCW tcw{};
+	tcw.TexAddr = address >> 3;
+	tcw.PixelFmt = pixelFmt;
+	tcw.VQ_Comp = vq;
+	return tcw;
+}
+
+void fillVram(u32 address, u32 size, u32 seed)
+{
+	unprotectVram(address, size);
+	std::mt19937 gen(seed);
+	for (u32 i = address; i < address + size; i++)
+		vram[i] = (u8)gen();
+}
+
+// Decodes the texture and returns the hash of the uploaded data
+u64 decode(u32 address, u32 size, u32 pixelFmt, bool vq = false)
+{
+	TestTexture texture(makeTsp(size), makeTcw(address, pixelFmt, vq));
+	texture.Update();
+	texture.CheckAsyncDecode();
+	texture.Delete();
+	return texture.hash;
+}
+
+}
+
+class TexContentCacheTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		if (!_vmem_reserve())
+			die("_vmem_reserve failed");
+		emu.init();
+		dc_reset(true);
+		fillVram(TextureBase, 0x200000, 42);
+		textureContentCache.Clear();
+		config::TextureContentCacheSize.override(32);
+	}
+	void TearDown() override {
+		config::TextureContentCacheSize.override(0);
+		config::AsyncTextureDecode.override(false);
+		textureContentCache.Clear();
+	}
+};
+
+TEST_F(TexContentCacheTest, SameContentAtAnotherAddress)
+{
+	u64 hash = decode(TextureBase, 256, Pixel565);
+	ASSERT_EQ(0u, textureContentCache.getStats().hits);
+	ASSERT_EQ(1u, textureContentCache.getStats().misses);
+	ASSERT_EQ(1u, textureContentCache.getStats().entries);
+	ASSERT_EQ(256u * 256 * 2, textureContentCache.getStats().bytes);
+
+	const u32 copyAddress = TextureBase + 0x100000;
+	unprotectVram(copyAddress, 256 * 256 * 2);
+	memcpy(&vram[copyAddress], &vram[TextureBase], 256 * 256 * 2);
+	ASSERT_EQ(hash, decode(copyAddress, 256, Pixel565));
+	ASSERT_EQ(1u, textureContentCache.getStats().hits);
+	ASSERT_EQ(1u, textureContentCache.getStats().entries);
+	ASSERT_FLOAT_EQ(0.5f, textureContentCache.getStats().hitRate());
+}
+
+TEST_F(TexContentCacheTest, Rewrite)
+{
+	TestTexture texture(makeTsp(256), makeTcw(TextureBase, Pixel1555, true));
+	texture.Update();
+	u64 first = texture.hash;
+	// The game overwrites the texture then restores it
+	fillVram(TextureBase, 0x20000, 1);
+	texture.Update();
+	ASSERT_NE(first, texture.hash);
+	fillVram(TextureBase, 0x200000, 42);
+	texture.Update();
+	ASSERT_EQ(first, texture.hash);
+	ASSERT_EQ(3, texture.uploads);
+	texture.Delete();
+	ASSERT_EQ(1u, textureContentCache.getStats().hits);
+	ASSERT_EQ(2u, textureContentCache.getStats().misses);
+}
+
+TEST_F(TexContentCacheTest, DifferentFormat)
+{
+	decode(TextureBase, 256, Pixel565);
+	decode(TextureBase, 256, Pixel4444);
+	decode(TextureBase, 128, Pixel565);
+	ASSERT_EQ(0u, textureContentCache.getStats().hits);
+	ASSERT_EQ(3u, textureContentCache.getStats().entries);
+}
+
+TEST_F(TexContentCacheTest, Eviction)
+{
+	config::TextureContentCacheSize.override(1);
+	// 512 KB each
+	decode(TextureBase, 512, Pixel565);
+	decode(TextureBase + 0x80000, 512, Pixel565);
+	ASSERT_EQ(0u, textureContentCache.getStats().evictions);
+	// Most recently used
+	decode(TextureBase, 512, Pixel565);
+	ASSERT_EQ(1u, textureContentCache.getStats().hits);
+	decode(TextureBase + 0x100000, 512, Pixel565);
+	ASSERT_EQ(1u, textureContentCache.getStats().evictions);
+	ASSERT_EQ(2u, textureContentCache.getStats().entries);
+	ASSERT_EQ(1024u * 1024, textureContentCache.getStats().bytes);
+
+	decode(TextureBase, 512, Pixel565);
+	ASSERT_EQ(2u, textureContentCache.getStats().hits);
+	decode(TextureBase + 0x80000, 512, Pixel565);
+	ASSERT_EQ(2u, textureContentCache.getStats().hits);
+	ASSERT_EQ(2u, textureContentCache.getStats().evictions);
+
+	// Too big to be cached
+	decode(TextureBase, 1024, Pixel565);
+	ASSERT_EQ(2u, textureContentCache.getStats().entries);
+
+	config::TextureContentCacheSize.override(0);
+	decode(TextureBase, 256, Pixel565);
+	ASSERT_EQ(0u, textureContentCache.getStats().entries);
+	ASSERT_EQ(0u, textureContentCache.getStats().bytes);
+	ASSERT_EQ(0u, textureContentCache.getStats().misses);
+}
+
+TEST_F(TexContentCacheTest, Async)
+{
+	config::AsyncTextureDecode.override(true);
+	u64 hash = decode(TextureBase, 512, Pixel565);
+	ASSERT_EQ(1u, textureContentCache.getStats().entries);
+
+	TestTexture texture(makeTsp(512), makeTcw(TextureBase, Pixel565));
+	texture.Update();
+	// No placeholder and no decoding
+	ASSERT_EQ(nullptr, texture.decodeJob);
+	ASSERT_EQ(1, texture.uploads);
+	ASSERT_EQ(512, texture.uploadWidth);
+	ASSERT_EQ(hash, texture.hash);
+	texture.Delete();
+}
+
+// Time spent updating textures whose content was already decoded
+TEST_F(TexContentCacheTest, DISABLED_Benchmark)
+{
+	constexpr int Textures = 32;
+	for (int size : { 0, 32 })
+	{
+		config::TextureContentCacheSize.override(size);
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < Textures; i++)
+			decode(TextureBase + (i % 4) * 0x20000, 512, i % 2 ? Pixel565 : Pixel1555, true);
+		auto duration = std::chrono::steady_clock::now() - start;
+		printf("content cache %d MB: %d 512x512 VQ textures in %.1f us, %.0f%% hits\n", size, Textures,
+				std::chrono::duration<double, std::micro>(duration).count(),
+				textureContentCache.getStats().hitRate() * 100.f);
+	}
+}
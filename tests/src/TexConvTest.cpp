@@ -0,0 +1,156 @@
+#include "gtest/gtest.h"
+#include "types.h"
+#include "rend/TexCache.h"
+#include "rend/TexConvSimd.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+namespace {
+
+const char * const formatNames[] { "1555", "565", "4444", "yuv", "bumpmap", "pal4", "pal8" };
+
+template<typename Pixel>
+using Decoder = void (*)(PixelBuffer<Pixel> *pb, u8 *p_in, u32 width, u32 height);
+
+template<typename Pixel>
+std::vector<Pixel> decode(Decoder<Pixel> decoder, u8 *data, u32 width, u32 height)
+{
+	PixelBuffer<Pixel> pb;
+	pb.init(width, height);
+	// Make sure all pixels are written
+	memset(pb.data(), 0xa5, width * height * sizeof(Pixel));
+	decoder(&pb, data, width, height);
+
+	return std::vector<Pixel>(pb.data(), pb.data() + width * height);
+}
+
+// Decodes all the levels of a square mipmapped texture
+template<typename Pixel>
+std::vector<Pixel> decodeMipmaps(Decoder<Pixel> decoder, u8 *data, u32 size)
+{
+	PixelBuffer<Pixel> pb;
+	pb.init(size, size, true);
+	u32 pixels = 0;
+	for (u32 i = 0; (1u << i) <= size; i++)
+	{
+		pb.set_mipmap(i);
+		decoder(&pb, data, 1 << i, 1 << i);
+		pixels += 1 << (2 * i);
+	}
+	pb.set_mipmap(0);
+
+	return std::vector<Pixel>(pb.data(), pb.data() + pixels);
+}
+
+}
+
+class TexConvTest : public ::testing::Test {
+protected:
+	void SetUp() override
+	{
+		std::mt19937 gen(42);
+		// Codebook followed by the largest texture
+		data.resize(2048 + 1024 * 1024 * 2);
+		for (u8& b : data)
+			b = (u8)gen();
+		for (int i = 0; i < 1024; i++)
+		{
+			palette16_ram[i] = gen() & 0xffff;
+			palette32_ram[i] = gen();
+		}
+		palette_index = 0x100;
+		vq_codebook = data.data();
+	}
+
+	template<typename Pixel>
+	void compare(Decoder<Pixel> reference, Decoder<Pixel> simd, const std::string& name)
+	{
+		static const u32 sizes[][2] {
+			{ 4, 4 }, { 8, 8 }, { 8, 64 }, { 64, 8 }, { 32, 32 }, { 128, 256 }, { 1024, 8 }, { 8, 1024 }
+		};
+		if (reference == nullptr)
+		{
+			ASSERT_EQ(nullptr, simd) << name;
+			return;
+		}
+		ASSERT_NE(nullptr, simd) << name;
+		for (const auto& size : sizes)
+			ASSERT_EQ(decode(reference, data.data(), size[0], size[1]), decode(simd, data.data(), size[0], size[1]))
+				<< name << " " << size[0] << "x" << size[1];
+		ASSERT_EQ(decodeMipmaps(reference, data.data(), 256), decodeMipmaps(simd, data.data(), 256)) << name << " mipmaps";
+	}
+
+	template<typename Pixel>
+	void benchmark(Decoder<Pixel> decoder, const char *isa, const char *name)
+	{
+		constexpr u32 Size = 512;
+		constexpr int Runs = 5;
+		constexpr int Iterations = 10;
+		if (decoder == nullptr)
+			return;
+		PixelBuffer<Pixel> pb;
+		pb.init(Size, Size);
+		decoder(&pb, data.data(), Size, Size);
+		// Best run
+		double us = 1e30;
+		for (int run = 0; run < Runs; run++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			for (int i = 0; i < Iterations; i++)
+				decoder(&pb, data.data(), Size, Size);
+			us = std::min(us, std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+		}
+		printf("%-7s %-14s %7.1f Mpix/s\n", isa, name, (double)Size * Size * Iterations / us);
+	}
+
+	std::vector<u8> data;
+};
+
+TEST_F(TexConvTest, SameAsScalar)
+{
+	int tested = 0;
+	for (TexConvIsa isa : { TexConvIsa::SSE2, TexConvIsa::AVX2, TexConvIsa::NEON })
+		for (bool directX : { false, true })
+		{
+			const TexConvDecoders *reference = texconv_Decoders(TexConvIsa::None, directX);
+			const TexConvDecoders *simd = texconv_Decoders(isa, directX);
+			if (simd == nullptr)
+				continue;
+			tested++;
+			for (int fmt = Pixel1555; fmt <= PixelPal8; fmt++)
+			{
+				std::string name = std::string(texconv_IsaName(isa)) + (directX ? " directx " : " opengl ") + formatNames[fmt];
+				compare(reference[fmt].TW, simd[fmt].TW, name + " TW");
+				compare(reference[fmt].VQ, simd[fmt].VQ, name + " VQ");
+				compare(reference[fmt].TW32, simd[fmt].TW32, name + " TW32");
+				compare(reference[fmt].VQ32, simd[fmt].VQ32, name + " VQ32");
+				compare(reference[fmt].TW8, simd[fmt].TW8, name + " TW8");
+			}
+		}
+	if (tested == 0)
+		printf("No SIMD texture decoder on this platform\n");
+}
+
+TEST_F(TexConvTest, DISABLED_Benchmark)
+{
+	for (TexConvIsa isa : { TexConvIsa::None, TexConvIsa::SSE2, TexConvIsa::AVX2, TexConvIsa::NEON })
+	{
+		const TexConvDecoders *decoders = texconv_Decoders(isa, false);
+		if (decoders == nullptr)
+			continue;
+		for (int fmt = Pixel1555; fmt <= PixelPal8; fmt++)
+		{
+			if (fmt == PixelBumpMap)
+				continue;
+			std::string name = formatNames[fmt];
+			benchmark(decoders[fmt].TW, texconv_IsaName(isa), (name + " TW").c_str());
+			benchmark(decoders[fmt].VQ, texconv_IsaName(isa), (name + " VQ").c_str());
+			benchmark(decoders[fmt].TW32, texconv_IsaName(isa), (name + " TW32").c_str());
+			benchmark(decoders[fmt].VQ32, texconv_IsaName(isa), (name + " VQ32").c_str());
+			benchmark(decoders[fmt].TW8, texconv_IsaName(isa), (name + " TW8").c_str());
+		}
+	}
+}
@@ -0,0 +1,234 @@
+#include "gtest/gtest.h"
+#include "types.h"
+#include "hw/mem/_vmem.h"
+#include "hw/pvr/pvr_mem.h"
+#include "rend/TexCache.h"
+#include "emulator.h"
+#include "vram_utils.h"
+
+#include <chrono>
+#include <random>
+#include <xxhash.h>
+
+namespace {
+
+constexpr u32 TextureBase = 0x100000;
+
+// Records the uploaded textures
+class TestTexture final : public BaseTextureCacheData
+{
+public:
+	TestTexture(TSP tsp, TCW tcw) : BaseTextureCacheData(tsp, tcw) {}
+
+	std::string GetId() override { return "test"; }
+
+	void UploadToGPU(int width, int height, u8 *data, bool mipmapped, bool mipmapsIncluded) override
+	{
+		u32 bpp = tex_type == TextureType::_8888 ? 4 : tex_type == TextureType::_8 ? 1 : 2;
+		u32 size = width * height;
+		if (mipmapsIncluded)
+			for (int w = width / 2; w != 0; w /= 2)
+				size += w * w;
+		uploads++;
+		uploadWidth = width;
+		uploadHeight = height;
+		uploadType = tex_type;
+		uploadMipmaps = mipmapsIncluded;
+		hash = XXH64(data, size * bpp, 0);
+	}
+
+	int uploads = 0;
+	int uploadWidth = 0;
+	int uploadHeight = 0;
+	TextureType uploadType = TextureType::_565;
+	bool uploadMipmaps = false;
+	u64 hash = 0;
+};
+
+TSP makeTsp(u32 size)
+{
+	TSP tsp{};
+	for (tsp.TexU = 0; (8u << tsp.TexU) < size; tsp.TexU++)
+		;
+	tsp.TexV = tsp.TexU;
+	return tsp;
+}
+
+TCW makeTcw(u32 pixelFmt, bool vq, bool mipmapped)
+{
+	TCW tcw{};
+	tcw.TexAddr = TextureBase >> 3;
+	tcw.PixelFmt = pixelFmt;
+	tcw.VQ_Comp = vq;
+	tcw.MipMapped = mipmapped;
+	return tcw;
+}
+
+void fillVram(u32 seed)
+{
+	unprotectVram(TextureBase, 0x200000);
+	std::mt19937 gen(seed);
+	for (u32 i = TextureBase; i < TextureBase + 0x200000; i++)
+		vram[i] = (u8)gen();
+}
+
+}
+
+class TexDecodeTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		if (!_vmem_reserve())
+			die("_vmem_reserve failed");
+		emu.init();
+		dc_reset(true);
+		fillVram(42);
+		// Decode every texture
+		config::TextureContentCacheSize.override(0);
+	}
+	void TearDown() override {
+		config::AsyncTextureDecode.override(false);
+		config::TextureMaxStaleFrames.override(2);
+	}
+
+	// Decodes the texture synchronously
+	TestTexture reference(TSP tsp, TCW tcw)
+	{
+		config::AsyncTextureDecode.override(false);
+		TestTexture texture(tsp, tcw);
+		texture.Update();
+		texture.Delete();
+		config::AsyncTextureDecode.override(true);
+		return texture;
+	}
+};
+
+TEST_F(TexDecodeTest, SameAsSynchronous)
+{
+	struct { u32 size; u32 pixelFmt; bool vq; bool mipmapped; } textures[] {
+		{ 256, Pixel565, false, false },
+		{ 256, Pixel1555, true, false },
+		{ 512, Pixel4444, false, true },
+		{ 256, PixelYUV, false, true },
+		{ 1024, Pixel565, true, true },
+	};
+	for (const auto& t : textures)
+	{
+		TSP tsp = makeTsp(t.size);
+		TCW tcw = makeTcw(t.pixelFmt, t.vq, t.mipmapped);
+		TestTexture ref = reference(tsp, tcw);
+
+		TestTexture texture(tsp, tcw);
+		texture.Update();
+		// New textures get a placeholder
+		ASSERT_EQ(1, texture.uploads);
+		ASSERT_EQ(8, texture.uploadWidth);
+		ASSERT_NE(nullptr, texture.decodeJob);
+		// VRAM changes after the update are ignored
+		fillVram(1234);
+		texture.CheckAsyncDecode();
+		fillVram(42);
+		ASSERT_EQ(nullptr, texture.decodeJob);
+		ASSERT_FALSE(texture.IsAsyncDecodeReady());
+		ASSERT_EQ(2, texture.uploads);
+		ASSERT_EQ(ref.uploadWidth, texture.uploadWidth) << t.size << " " << t.pixelFmt;
+		ASSERT_EQ(ref.uploadHeight, texture.uploadHeight);
+		ASSERT_EQ(ref.uploadType, texture.uploadType);
+		ASSERT_EQ(ref.uploadMipmaps, texture.uploadMipmaps);
+		ASSERT_EQ(ref.hash, texture.hash) << t.size << " " << t.pixelFmt;
+		texture.Delete();
+	}
+}
+
+TEST_F(TexDecodeTest, Staleness)
+{
+	config::AsyncTextureDecode.override(true);
+	config::TextureMaxStaleFrames.override(3);
+	TestTexture texture(makeTsp(1024), makeTcw(Pixel565, false, false));
+	texture.Update();
+	ASSERT_NE(nullptr, texture.decodeJob);
+	FrameCount += 2;
+	ASSERT_EQ(texture.decodeJob->state == TextureDecodeJob::Done, texture.IsAsyncDecodeReady());
+	FrameCount++;
+	ASSERT_TRUE(texture.IsAsyncDecodeReady());
+	texture.CheckAsyncDecode();
+	ASSERT_EQ(2, texture.uploads);
+	texture.Delete();
+}
+
+TEST_F(TexDecodeTest, UpdateWhilePending)
+{
+	TSP tsp = makeTsp(512);
+	TCW tcw = makeTcw(Pixel1555, false, false);
+	fillVram(1);
+	TestTexture first = reference(tsp, tcw);
+	fillVram(2);
+	TestTexture second = reference(tsp, tcw);
+	ASSERT_NE(first.hash, second.hash);
+
+	fillVram(1);
+	TestTexture texture(tsp, tcw);
+	texture.Update();
+	std::shared_ptr<TextureDecodeJob> firstJob = texture.decodeJob;
+	fillVram(2);
+	texture.Update();
+	ASSERT_TRUE(firstJob->cancelled);
+	ASSERT_NE(firstJob, texture.decodeJob);
+	// The placeholder is only uploaded once
+	ASSERT_EQ(1, texture.uploads);
+	texture.CheckAsyncDecode();
+	ASSERT_EQ(2, texture.uploads);
+	ASSERT_EQ(second.hash, texture.hash);
+
+	// The previous version is kept until the new one is ready
+	texture.Update();
+	ASSERT_EQ(2, texture.uploads);
+	std::shared_ptr<TextureDecodeJob> job = texture.decodeJob;
+	texture.Delete();
+	ASSERT_TRUE(job->cancelled);
+	ASSERT_EQ(nullptr, texture.decodeJob);
+}
+
+TEST_F(TexDecodeTest, Synchronous)
+{
+	config::AsyncTextureDecode.override(true);
+	// Small texture
+	TestTexture small(makeTsp(64), makeTcw(Pixel565, false, false));
+	small.Update();
+	ASSERT_EQ(nullptr, small.decodeJob);
+	ASSERT_EQ(1, small.uploads);
+	ASSERT_EQ(64, small.uploadWidth);
+	small.Delete();
+	// Paletted texture
+	TestTexture paletted(makeTsp(256), makeTcw(PixelPal8, false, false));
+	paletted.Update();
+	ASSERT_EQ(nullptr, paletted.decodeJob);
+	ASSERT_EQ(1, paletted.uploads);
+	paletted.Delete();
+}
+
+// Time spent in Update on the render thread
+TEST_F(TexDecodeTest, DISABLED_Benchmark)
+{
+	constexpr int Textures = 32;
+	for (bool async : { false, true })
+	{
+		config::AsyncTextureDecode.override(async);
+		std::vector<std::unique_ptr<TestTexture>> textures;
+		for (int i = 0; i < Textures; i++)
+			textures.emplace_back(new TestTexture(makeTsp(512), makeTcw(i % 2 ? Pixel565 : Pixel4444, i % 4 >= 2, false)));
+
+		auto start = std::chrono::steady_clock::now();
+		for (auto& texture : textures)
+			texture->Update();
+		auto update = std::chrono::steady_clock::now() - start;
+		for (auto& texture : textures)
+			texture->CheckAsyncDecode();
+		auto total = std::chrono::steady_clock::now() - start;
+		for (auto& texture : textures)
+			texture->Delete();
+
+		printf("%s: %d 512x512 textures, Update %.1f us, decoded in %.1f us\n", async ? "async" : "sync", Textures,
+				std::chrono::duration<double, std::micro>(update).count(),
+				std::chrono::duration<double, std::micro>(total).count());
+	}
+}
@@ -0,0 +1,14 @@
+/*
+	VRAM helpers for the texture tests.
+*/
+#pragma once
+#include "types.h"
+#include "rend/TexCache.h"
+
+// Does what the fault handler would do if the pages are protected.
+// Test binaries don't install it.
+inline void unprotectVram(u32 address, u32 size)
+{
+	for (u32 page = address & ~PAGE_MASK; page < address + size; page += PAGE_SIZE)
+		VramLockedWriteOffset(page);
+}